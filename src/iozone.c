@@ -169,7 +169,8 @@ char *help[] = {
 "           -i #  Test to run (0=write/rewrite, 1=read/re-read, 2=random-read/write",
 "                 3=Read-backwards, 4=Re-write-record, 5=stride-read, 6=fwrite/re-fwrite",
 "                 7=fread/Re-fread, 8=random_mix, 9=pwrite/Re-pwrite, 10=pread/Re-pread",
-"                 11=pwritev/Re-pwritev, 12=preadv/Re-preadv)",
+"                 11=pwritev/Re-pwritev, 12=preadv/Re-preadv,",
+"                 13=zero-copy sendfile/splice/copy_file_range)",
 "           -I  Use VxFS VX_DIRECT, O_DIRECT,or O_DIRECTIO for all file operations",
 "           -j #  Set stride of file accesses to (# * record size)",
 "           -J #  milliseconds of compute cycle before each I/O operation",
@@ -217,7 +218,8 @@ char *help[] = {
 "           -+d  File I/O diagnostic mode. (To troubleshoot a broken file I/O subsystem)",
 "           -+u  Enable CPU utilization output (Experimental)",
 "           -+x # Multiplier to use for incrementing file and record sizes",
-"           -+p # Percentage of mix to be reads",
+"           -+p #[:op] Percentage of mix to be reads. With :op every child mixes",
+"                 reads and writes to its own file, random offsets unless -+B",
 "           -+r Enable O_RSYNC|O_SYNC for all testing.",
 "           -+t Enable network performance test. Requires -+m ",
 "           -+n No retests selected.",
@@ -233,6 +235,14 @@ char *help[] = {
 "           -+A #  Enable madvise. 0 = normal, 1=random, 2=sequential",
 "                                  3=dontneed, 4=willneed",
 #endif
+"           -+e Prefault mmap files (MAP_POPULATE)",
+"           -+W nowait[,hipri] Use preadv2/pwritev2 with RWF_NOWAIT, RWF_HIPRI",
+"           -+M block|spin|hybrid[:usec][,iopoll] Async I/O completion waits,",
+"                 iopoll uses an IORING_SETUP_IOPOLL ring with -+I uring -I",
+"           -+g page|huge[,prefault][,local] Page or huge page aligned buffers,",
+"                 prefault them, with local each thread faults in its own",
+"           -+v n|size,size,..[:seq|:rand] Vectored I/O, records moved with",
+"                 readv()/writev() of n equal segments or of the given sizes",
 "           -+N Do not truncate existing files on sequential writes.",
 "           -+S # Dedup-able data is limited to sharing within each numerically",
 "                 identified file set",
@@ -250,7 +260,25 @@ char *help[] = {
 "           -+C ## Percent of dedup-able within & not across files in buffers.",
 "           -+H Hostname    Hostname of the PIT server.",
 "           -+P Service     Service  of the PIT server.",
-"           -+z Enable latency histogram logging.",
+"           -+z Enable latency histogram logging, with percentiles.",
+"           -+R c[:d[:b]] Data reduction profile: compress ratio c, dedup ratio d",
+"               at b Kbyte block granularity (default 1:1:4)",
+"           -+o # Sample per child throughput every # ms to Iozone_samples.txt",
+"           -+F Use the CPU cycle counter (TSC/timebase) as the clock",
+"           -+Q # Binary offset/latency files, # records per child (see iozone_trace)",
+"           -+Y dist  Random access distribution: uniform, zipf:theta,",
+"                 hot:pct[:share], pareto:alpha or seq:runlength",
+"           -+I engine  Async I/O engine for -k/-H: posix, uring[:entries]",
+"                 or aio[:entries] (Linux native aio, needs -I)",
+"           -+f secs[:ramp] Throughput phases run for secs seconds after ramp",
+"                 seconds, wrapping in the file. Ramp-up is not counted",
+"           -+G none|rr|compact|scatter Persistent -T worker pool, created once",
+"                 per run and pinned by policy. -P offsets the CPU list",
+"           -+J prio=#[:step],stack=KB,fifo|timeslice,sched=name,cpus=lo[-hi]",
+"                 RTEMS child task priority, stack size (0 = default), scheduling",
+"                 policy, and on SMP the scheduler instance and processors",
+"           -+O #[:poisson] Open-loop rate of # ops/sec per child, constant or",
+"                 Poisson arrivals. Latency is measured from the scheduled start",
 "" };
 
 char *head1[] = {
@@ -294,51 +322,36 @@ THISVERSION,
 #ifndef __rtems__
 #include <sys/mman.h>
 #else
-#define PROT_READ 0
-#define PROT_WRITE 1
-#define MAP_FILE 1
-#define MAP_SHARED 2
-#define MAP_PRIVATE 4
-#define MAP_ANONYMOUS 8
+/* No MMU backed mmap(), it is emulated. See emap_touch() */
+#define PROT_READ 1
+#define PROT_WRITE 2
+#define MAP_FILE 0
+#define MAP_SHARED 1
+#define MAP_PRIVATE 2
+#define MAP_ANONYMOUS 0x20
+#define MAP_POPULATE 0x8000
 #define MAP_FAILED ((void*)-1)
+#define MS_ASYNC 1
+#define MS_SYNC 4
 
-#ifndef RTEMS_VAR_UNUSED
-#define RTEMS_VAR_UNUSED __attribute__((unused))
-#endif
-
-static inline void* mmap(
-    void* addr RTEMS_VAR_UNUSED,
-    size_t length RTEMS_VAR_UNUSED,
-    int prot RTEMS_VAR_UNUSED,
-    int flags RTEMS_VAR_UNUSED,
-    int fd RTEMS_VAR_UNUSED,
-    off_t offset RTEMS_VAR_UNUSED)
-{
-  /* TODO: unused variables */
-  errno = ENOSYS;
-  return MAP_FAILED;
-}
-
-static inline int munmap(
-    void* addr RTEMS_VAR_UNUSED,
-    size_t length RTEMS_VAR_UNUSED)
-{
-  errno = ENOSYS;
-  return -1;
-}
-
-static inline int msync(
-    void* addr RTEMS_VAR_UNUSED,
-    size_t length RTEMS_VAR_UNUSED,
-    int flags RTEMS_VAR_UNUSED)
-{
-  errno = ENOSYS;
-  return -1;
-}
+static void *mmap(void *, size_t, int, int, int, off_t);
+static int munmap(void *, size_t);
+static int msync(void *, size_t, int);
+static void emap_touch(char *, long long, int);
 #endif
 #include <stdio.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#if defined(linux) && ! defined(DONT_HAVE_O_DIRECT)
+#define DIO_FALLBACK		/* -I ops O_DIRECT refuses are redone buffered */
+#include <sys/ioctl.h>
+#include <sys/mount.h>
+#endif
+#ifdef HAVE_ZCOPY
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#endif
 
 #include <fcntl.h>
 #if !defined(__FreeBSD__) && !defined(__OpenBSD__) && !defined(__APPLE__) && !defined(__DragonFly__)
@@ -462,12 +475,37 @@ typedef long long off64_t;
 #endif
 
 #include <sys/time.h>
+#include <time.h>
 
 #ifdef SHARED_MEM
 #include <sys/shm.h>
 #endif
 
-#if (defined(bsd4_2) && !defined(MS_SYNC)) || defined(__rtems__)
+/*
+ * Vector units used by the fill/verify kernels. The AVX2 kernels are
+ * built with a target attribute and only used when the CPU has AVX2.
+ */
+#if defined(__SSE2__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define HAVE_SSE2_KERNEL
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 5)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL
+#endif
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNEL
+#endif
+#if defined(__ALTIVEC__) && defined(__BIG_ENDIAN__)
+#include <altivec.h>
+#undef vector
+#undef pixel
+#undef bool
+#define HAVE_ALTIVEC_KERNEL
+#endif
+
+#if defined(bsd4_2) && !defined(MS_SYNC)
 #define MS_SYNC 0
 #define MS_ASYNC 0
 #endif
@@ -494,9 +532,23 @@ long long page_size = PAGE_SIZE;
 long long page_size = 4096; /* Used when all else fails */
 #endif
 
+/*
+ * Vectored I/O (-+v). Most tests move a record with one read() or
+ * write(). With -+v every such record goes through one readv() or
+ * writev() of vec_count segments instead, back to back in the buffer.
+ * The segment sizes either split the record evenly or repeat the
+ * list given with -+v until the record is covered. The file layout
+ * is the test's own: sequential for write/read, permuted for random.
+ * The preadv/pwritev tests move vec_count records per call, taken
+ * from the record permutation (:rand, the default) or contiguous
+ * (:seq). At most VEC_MAX segments, the IOV_MAX of most systems.
+ */
+#define VEC_MAX 256
+
 #ifdef HAVE_PREAD
 #ifdef HAVE_PREADV
-#define PVECMAX 16
+#define PVECMAX VEC_MAX
+#define PVECDEF 16	/* records per preadv()/pwritev() without -+v */
 
 #ifdef _HPUX_SOURCE
 #define PER_VECTOR_OFFSET
@@ -514,20 +566,121 @@ struct iovec piov[PVECMAX];
 
 #define DEDUPSEED 0x2719362
 
+#include "iozone_trace.h"
+
 
 /*
  * In multi thread/process throughput mode each child keeps track of
  * statistics and communicates them through various flavors of
  * shared memory, and via messages.
  */
+/*
+ * One block per child in the memory shared with the master, padded to
+ * CHILD_STATS_LINE so that no two children, and no child and the
+ * master, ever write to the same cache line. flag is only accessed
+ * through child_flag_get()/child_flag_set(). live_kb/live_ops are the
+ * child's running totals while a test runs, written with
+ * child_publish(), under the seq counter where needed, and read by the
+ * master with child_sample(). phase_start is set by child_begin().
+ */
+#ifndef CHILD_STATS_LINE
+#define CHILD_STATS_LINE	128	/* covers 32, 64 and 128 byte lines */
+#endif
+#define CHILD_STATS_USED	(2 * sizeof(int) + 7 * sizeof(float) + \
+				 3 * sizeof(double))
+
 struct child_stats {
-	long long flag;		/* control space */
-	long long flag1;	/* pad */
+	int flag;		/* control space */
+	unsigned int seq;	/* odd while live_* is being updated */
 	float walltime;	        /* child elapsed time */
 	float cputime;		/* child CPU time */
 	float throughput; 	/* Throughput in either kb/sec or ops/sec */
 	float actual;	   	/* Either actual kb read or # of ops performed */
+	double live_kb;		/* kb moved so far in this test */
+	double live_ops;	/* operations so far in this test */
+	double phase_start;	/* when the master released the children */
+	float read_actual;	/* -+p #:op, the part of actual that was reads */
+	float read_time;	/* -+p #:op, seconds spent in reads */
+	float write_time;	/* -+p #:op, seconds spent in writes */
+	char pad[CHILD_STATS_LINE - CHILD_STATS_USED];
 } VOLATILE *child_stat;
+/* Keep the doubles together: a hole would push a block past its line */
+typedef char child_stats_size_check[
+	(sizeof(struct child_stats) == CHILD_STATS_LINE) ? 1 : -1];
+
+/*
+ * Per child latency histogram. See hist_insert().
+ */
+#define HIST_SUB_BITS		7
+#define HIST_SUB_BUCKETS	(1 << HIST_SUB_BITS)
+#define HIST_HALF_BUCKETS	(HIST_SUB_BUCKETS >> 1)
+/* Largest latency tracked is 2^40 ns (about 18 minutes) */
+#define HIST_MAX_BITS		40
+#define HIST_MAX_VALUE		((1ULL << HIST_MAX_BITS) - 1)
+#define HIST_BUCKETS		(HIST_MAX_BITS - HIST_SUB_BITS + 1)
+#define HIST_COUNTS		((HIST_BUCKETS + 1) * HIST_HALF_BUCKETS)
+
+struct lat_hist {
+	unsigned long long total;	/* number of samples */
+	unsigned long long min;		/* smallest sample in ns */
+	unsigned long long max;		/* largest sample in ns */
+	double sum;			/* sum of the samples in ns */
+	unsigned long long counts[HIST_COUNTS];
+};
+
+/*
+ * Per child ring of binary latency records. See trace_insert().
+ */
+struct trace_ring {
+	struct trace_header hdr;
+	struct trace_rec *rec;		/* preallocated records */
+	long long size;			/* number of records in rec[] */
+	long long next;			/* next slot to fill */
+	unsigned long long total;	/* records inserted since trace_open() */
+	unsigned int op;		/* TRACE_OP_xxx of this test */
+	char binname[256];
+};
+
+/*
+ * Keyed permutation of the records of a file. See perm_index().
+ */
+#define PERM_ROUNDS	6
+#define PERMSEED	0x7065726dULL
+
+struct perm {
+	unsigned long long n;			/* records, output is [0,n) */
+	unsigned long long key[PERM_ROUNDS];	/* round keys */
+	int rbits;				/* width of the right half */
+	unsigned long long lmask, rmask;	/* masks of the two halves */
+};
+
+/*
+ * Skewed random access distributions (-+Y). See dist_setup().
+ */
+#define DIST_UNIFORM	0
+#define DIST_ZIPF	1
+#define DIST_HOT	2
+#define DIST_PARETO	3
+#define DIST_SEQ	4
+#define DIST_BUCKETS	4096	/* alias table entries */
+#define DIST_EXACT	1024	/* hottest ranks with an entry of their own */
+#define DISTSEED	0x64697374ULL
+
+struct dist {
+	unsigned long long n;		/* records the table was built for */
+	int buckets;			/* entries in use */
+	unsigned long long *start;	/* first rank of each entry, then n */
+	double *prob;			/* chance of keeping the entry drawn */
+	int *alias;			/* entry taken otherwise */
+	struct perm order;		/* rank to record */
+};
+
+struct dist_walk {
+	unsigned long long next;	/* next record of the current run */
+	unsigned long long left;	/* records left in the current run */
+	unsigned long long stream;	/* counter_rand() stream of the child */
+	unsigned long long draws;	/* random numbers taken so far */
+};
 
 /*
  * Used for cpu time statistics.
@@ -619,6 +772,7 @@ struct client_command {
 	int c_direct_flag;
 	int c_cpuutilflag;
 	int c_seq_mix;
+	int c_op_mix;
 	int c_client_number;
 	int c_command;
 	int c_testnum;
@@ -719,6 +873,7 @@ struct client_neutral_command {
 	char c_direct_flag[2]; 		/* small int */
 	char c_cpuutilflag[2]; 		/* small int */
 	char c_seq_mix[2]; 		/* small int */
+	char c_op_mix[2]; 		/* small int */
 	char c_stride[10]; 		/* small long long */
 	char c_rest_val[10]; 		/* small long long */
 	char c_purge[10]; 		/* very small long long */
@@ -993,6 +1148,7 @@ struct master_neutral_command {
 #define PWRITEV_TEST		11
 #define PREADV_TEST		12
 #endif /* HAVE_PREADV */
+#define ZCOPY_TEST		13	/* not in func[], see auto_test() */
 
 #define WRITER_MASK		(1 << WRITER_TEST)
 #define READER_MASK		(1 << READER_TEST)
@@ -1011,6 +1167,7 @@ struct master_neutral_command {
 #define PWRITEV_MASK		(1 << PWRITEV_TEST)
 #define PREADV_MASK		(1 << PREADV_TEST)
 #endif /* HAVE_PREADV */
+#define ZCOPY_MASK		(1 << ZCOPY_TEST)
 
 /*
  * child_stat->flag values and transitions
@@ -1044,6 +1201,9 @@ void mmap_end();
 void alloc_pbuf();
 void auto_test();		/* perform automatic test series  */
 void show_help();		/* show development help          */
+#if defined(__i386__) || defined(__x86_64__) || defined(__powerpc__) || defined(__PPC__)
+#define HAVE_CYCLE_COUNTER	/* rdtsc or the PowerPC timebase */
+#endif
 static double time_so_far();	/* time since start of program    */
 
 #ifdef unix
@@ -1056,6 +1216,10 @@ static double cputime_so_far();
 #endif
 
 static double time_so_far1();	/* time since start of program    */
+static double clock_so_far();	/* time_so_far() on the system clock */
+static double clock_so_far1();	/* time_so_far1() on the system clock */
+static double cycle_so_far();	/* time from the cycle counter	  */
+int calibrate_cycles();		/* scale cycle counter to seconds */
 void get_resolution();
 void get_rusage_resolution();
 void signal_handler();		/* clean up if user interrupts us */
@@ -1096,6 +1260,10 @@ void preadv_perf_test();	/* preadv/re-preadv test	  */
 void pwritev_perf_test();	/* pwritev/re-pwritev test	  */
 #endif /* HAVE_PREADV */
 
+#ifdef HAVE_ZCOPY
+void zcopy_perf_test();		/* sendfile/splice/copy_file_range */
+#endif /* HAVE_ZCOPY */
+
 void store_dvalue();		/* Store doubles array 		  */
 void dump_excel();
 void dump_throughput();
@@ -1117,6 +1285,14 @@ int system();
 
 void my_nap();
 void my_unap();
+static double rate_wait();
+static double dist_ln();
+static void dur_start();
+static void dur_restart();
+static int dur_next();
+static void opmix_report();
+void pool_topology();
+void pool_stop();
 int thread_exit();
 
 #ifdef ASYNC_IO
@@ -1127,12 +1303,24 @@ int async_read_no_copy();
 size_t async_write_no_copy();
 void end_async();
 void async_init();
+extern int async_engine;	/* libasync.c: ASYNC_ENGINE_* */
+extern int async_ring_entries;
+#define ASYNC_ENGINE_POSIX 0
+#define ASYNC_ENGINE_URING 1
+#define ASYNC_ENGINE_KAIO 2
+extern int async_poll;		/* libasync.c: ASYNC_POLL_* */
+extern int async_spin_usec;
+extern int async_iopoll;
+#define ASYNC_POLL_BLOCK 0
+#define ASYNC_POLL_SPIN 1
+#define ASYNC_POLL_HYBRID 2
 /*TODO: double check it */
 //#else
 //size_t async_write();
 //size_t async_write_no_copy();
 //void async_release();
 #endif
+char *async_write_buffer();
 
 #ifdef EXCEL
 void do_float();
@@ -1169,6 +1357,8 @@ static double cpu_util(double, double);
 void dump_cputimes(void);
 void purge_buffer_cache(void);
 char *alloc_mem(long long,int);
+void free_mem(char *);
+char *mem_local(char *);
 
 #ifdef __rtems__
 rtems_task (thread_rwrite_test)(void *);
@@ -1195,6 +1385,7 @@ void *(thread_cleanup_test)(void*);
 void *(thread_cleanup_quick)(void*);
 void *(thread_ranread_test)(void *);
 void *(thread_mix_test)(void *);
+void *(thread_opmix_test)(void *);
 void *(thread_ranwrite_test)(void *);
 void *(thread_rread_test)(void *);
 void *(thread_reverse_read_test)(void *);
@@ -1222,8 +1413,38 @@ off64_t get_next_record_size(off64_t);
 void add_record_size(off64_t);
 void init_record_sizes( off64_t,  off64_t);
 void del_record_sizes( void );
-void hist_insert(double );
+int hist_alloc(int);
+void hist_reset(int);
+void hist_insert(int, double);
+void hist_merge(struct lat_hist *, struct lat_hist *);
+unsigned long long hist_percentile(struct lat_hist *, double);
 void dump_hist(char *,int );
+void dump_hist_all(char *,int );
+struct trace_ring *trace_open(int, char *, char *, int);
+void trace_insert(struct trace_ring *, double, off64_t, long long, double);
+void trace_close(struct trace_ring *);
+int child_flag_get(VOLATILE struct child_stats *);
+void child_flag_set(VOLATILE struct child_stats *, int);
+void child_begin(VOLATILE struct child_stats *, int);
+double phase_origin(long long);
+void child_wait_ready(VOLATILE struct child_stats *);
+void child_publish(VOLATILE struct child_stats *, double, double);
+int child_sample(VOLATILE struct child_stats *, double *, double *);
+void sample_children(char *, int);
+void select_kernels(void);
+unsigned long long counter_rand(unsigned long long, unsigned long long,
+	unsigned long long);
+void perm_init(struct perm *, unsigned long long, unsigned long long);
+unsigned long long perm_index(struct perm *, unsigned long long);
+void dist_setup(unsigned long long);
+void dist_start(struct dist_walk *, int);
+unsigned long long dist_record(struct dist_walk *, struct perm *,
+	unsigned long long);
+int parse_vec(char *);
+ssize_t rec_io(int, char *, long long, off64_t, int);
+void dio_stdio(int, char *, long long);
+int init_reduce(void);
+long long gen_reduce_buf(char *, long long, long long, int);
 void do_speed_check(int);
 
 #else /* HAVE_ANSIC_C */
@@ -1238,6 +1459,14 @@ int system();
 
 void my_nap();
 void my_unap();
+static double rate_wait();
+static double dist_ln();
+static void dur_start();
+static void dur_restart();
+static int dur_next();
+static void opmix_report();
+void pool_topology();
+void pool_stop();
 int thread_exit();
 
 #ifdef EXCELL
@@ -1254,6 +1483,7 @@ size_t async_write_no_copy();
 int async_read();
 int async_read_no_copy();
 #endif
+char *async_write_buffer();
 
 int mylockf();
 int mylockr();
@@ -1274,6 +1504,8 @@ FILE *open_r_traj();
 void create_temp();
 void fill_buffer();
 char *alloc_mem();
+void free_mem();
+char *mem_local();
 void *(thread_rwrite_test)();
 void *(thread_write_test)();
 void *(thread_fwrite_test)();
@@ -1282,6 +1514,7 @@ void *(thread_read_test)();
 void *(thread_cleanup_test)();
 void *(thread_ranread_test)();
 void *(thread_mix_test)();
+void *(thread_opmix_test)();
 void *(thread_ranwrite_test)();
 void *(thread_rread_test)();
 void *(thread_reverse_read_test)();
@@ -1299,8 +1532,36 @@ void add_record_size();
 void dump_cputimes();
 static double cpu_util();
 void del_record_sizes();
+int hist_alloc();
+void hist_reset();
 void hist_insert();
+void hist_merge();
+unsigned long long hist_percentile();
 void dump_hist();
+void dump_hist_all();
+struct trace_ring *trace_open();
+void trace_insert();
+void trace_close();
+int child_flag_get();
+void child_flag_set();
+void child_begin();
+double phase_origin();
+void child_wait_ready();
+void child_publish();
+int child_sample();
+void sample_children();
+void select_kernels();
+unsigned long long counter_rand();
+void perm_init();
+unsigned long long perm_index();
+void dist_setup();
+void dist_start();
+unsigned long long dist_record();
+int parse_vec();
+ssize_t rec_io();
+void dio_stdio();
+int init_reduce();
+long long gen_reduce_buf();
 
 #endif /* HAVE_ANSIC_C */
 
@@ -1311,8 +1572,8 @@ void dump_hist();
 #define I_FOPEN(x,y) 	fopen64(x,y)
 #define I_STAT(x,y) 	stat64(x,y)
 #ifdef HAVE_PREAD
-#define I_PREAD(a,b,c,d)	pread64(a,b,(size_t)(c),(off64_t)(d))
-#define I_PWRITE(a,b,c,d)	pwrite64(a,b,(size_t)(c),(off64_t)(d))
+#define I_PREAD_SYS(a,b,c,d)	pread64(a,b,(size_t)(c),(off64_t)(d))
+#define I_PWRITE_SYS(a,b,c,d)	pwrite64(a,b,(size_t)(c),(off64_t)(d))
 #endif
 #define I_MMAP(a,b,c,d,e,f) 	mmap64((void *)(a),(size_t)(b),(int)(c),(int)(d),(int)(e),(off64_t)(f))
 #else
@@ -1322,12 +1583,27 @@ void dump_hist();
 #define I_FOPEN(x,y) 	fopen(x,y)
 #define I_STAT(x,y) 	stat(x,y)
 #ifdef HAVE_PREAD
-#define I_PREAD(a,b,c,d)	pread(a,b,(size_t)(c),(off_t)(d))
-#define I_PWRITE(a,b,c,d)	pwrite(a,b,(size_t)(c),(off_t)(d))
+#define I_PREAD_SYS(a,b,c,d)	pread(a,b,(size_t)(c),(off_t)(d))
+#define I_PWRITE_SYS(a,b,c,d)	pwrite(a,b,(size_t)(c),(off_t)(d))
 #endif
 #define I_MMAP(a,b,c,d,e,f) 	mmap((void *)(a),(size_t)(b),(int)(c),(int)(d),(int)(e),(off_t)(f))
 #endif
 
+/*
+ * Record I/O of the tests. Plain system calls, unless -+v, -+W or
+ * -I (with DIO_FALLBACK) set rec_hook and rec_io() has to do it.
+ */
+#define I_READ(a,b,c)	(rec_hook ? rec_io((int)(a),(char *)(b),(long long)(c),(off64_t)-1,0) \
+	: read((int)(a),(void *)(b),(size_t)(c)))
+#define I_WRITE(a,b,c)	(rec_hook ? rec_io((int)(a),(char *)(b),(long long)(c),(off64_t)-1,1) \
+	: write((int)(a),(void *)(b),(size_t)(c)))
+#ifdef HAVE_PREAD
+#define I_PREAD(a,b,c,d)	(rec_hook ? rec_io((int)(a),(char *)(b),(long long)(c),(off64_t)(d),0) \
+	: I_PREAD_SYS(a,b,c,d))
+#define I_PWRITE(a,b,c,d)	(rec_hook ? rec_io((int)(a),(char *)(b),(long long)(c),(off64_t)(d),1) \
+	: I_PWRITE_SYS(a,b,c,d))
+#endif
+
 
 /************************************************************************/
 /* The list of tests to be called.					*/
@@ -1399,6 +1675,14 @@ rtems_id       stopBarrier;
 rtems_interval ticks_per_second;
 
 rtems_name     bar_name = rtems_build_name('S','B','A','R');
+
+/* Child task attributes (-+J). Zero or empty means the default */
+rtems_task_priority task_prio;		/* Priority of child 0 */
+rtems_task_priority task_prio_step;	/* Added for each further child */
+size_t         task_stack;		/* Stack size in bytes */
+rtems_mode     task_mode = RTEMS_PREEMPT|RTEMS_TIMESLICE|RTEMS_NO_ASR|RTEMS_INTERRUPT_LEVEL(0);
+char           task_sched[5];		/* SMP scheduler instance name */
+int            task_cpu_lo = -1, task_cpu_hi = -1;	/* SMP processors */
 #endif
 
 /*
@@ -1414,6 +1698,9 @@ double totaltime,total_time, temp_time ,total_kilos;
 off64_t report_array[MAX_X][MAX_Y];
 double report_darray[MAX_X][MAXSTREAMS];
 double time_res,cputime_res;
+char cycle_flag;			/* -+F asked for the cycle counter  */
+double cycle_rate;			/* counter ticks/sec, 0 when unused */
+unsigned long long cycle_base;		/* counter value at calibration	    */
 long long throughput_array[MAX_X];	/* Filesize & record size are constants */
 short current_x, current_y;
 long long orig_size;
@@ -1443,8 +1730,39 @@ int bif_fd,s_count;
 int bif_row,bif_column;
 int dedup_mseed = 1;
 int hist_summary;
+/************************************************************************/
+/* Open-loop rate control (-+O).					*/
+/* Each child issues its ops on a fixed timeline that starts when the	*/
+/* master releases the children, and never slips. An op that is late	*/
+/* because the previous one was slow is issued at once, and its latency	*/
+/* is taken from when it should have started, so queueing delay shows	*/
+/* up in the histogram and trace instead of being hidden.		*/
+/************************************************************************/
+#define RATE_CONST	1	/* Fixed interval between ops */
+#define RATE_POISSON	2	/* Exponential interarrival times */
+#define RATE_SPIN	0.0001	/* Spin, not sleep, for the last 100 us */
+struct rate_sched {
+	double next;			/* Intended start of the next op */
+	unsigned long long seed;	/* Interarrival generator */
+};
+/************************************************************************/
+/* Time based duration (-+f).						*/
+/* The throughput children loop over their file, wrapping back to the	*/
+/* first record, until the phase has run for dur_secs after a ramp-up	*/
+/* of dur_ramp seconds. Counters, timers and histograms restart when	*/
+/* the ramp-up ends, so only the steady state is reported.		*/
+/************************************************************************/
+#define DUR_RUN		0	/* Keep going */
+#define DUR_RAMPED	1	/* Ramp-up just ended, restart the statistics */
+#define DUR_DONE	2	/* Phase is over */
+struct dur_clock {
+	double ramp_end;
+	double end;
+	int ramped;
+};
+double dur_secs, dur_ramp;
 int op_rate;
-int op_rate_flag;
+int op_rate_flag;	/* RATE_CONST or RATE_POISSON */
 char aflag, Eflag, hflag, Rflag, rflag, sflag;
 char diag_v,sent_stop,dedup,dedup_interior,dedup_compress;
 char *dedup_ibuf;
@@ -1467,7 +1785,9 @@ char imon_sync;
 char trflag; 
 char cpuutilflag;
 char seq_mix;
+char op_mix;		/* -+p #:op, mix reads and writes inside each child */
 long base_time;
+double run_start;	/* time_so_far() at startup, the -+Q trace origin */
 long long mint, maxt; 
 long long w_traj_ops, r_traj_ops, w_traj_fsize,r_traj_fsize;
 long long r_traj_ops_completed,r_traj_bytes_completed;
@@ -1484,6 +1804,38 @@ int pct_read,speed_code;
 #ifndef NO_THREADS
 pthread_t p_childids[MAXSTREAMS+1];
 #endif
+
+/************************************************************************/
+/* Worker pool (-+G).							*/
+/* Without it every child of every test phase is a new thread or RTEMS	*/
+/* task, placed wherever the scheduler likes. With it the children are	*/
+/* created once per run, pinned by the chosen policy, and park between	*/
+/* phases. mythread_create() and spawnTask() hand each phase to the	*/
+/* parked worker, thread_join() waits for it to park again, and the	*/
+/* READY/BEGIN child state handshake is still the start barrier.	*/
+/************************************************************************/
+#define POOL_NONE	0	/* Pool only, no pinning */
+#define POOL_RR		1	/* CPUs in number order, as -P */
+#define POOL_COMPACT	2	/* Fill a NUMA node, core siblings adjacent */
+#define POOL_SCATTER	3	/* Spread over nodes, then cores, then siblings */
+#define POOL_MAXCPU	1024
+#define POOL_MAXNODE	64
+int pool_flag, pool_policy;
+int pool_cpus[POOL_MAXCPU], pool_ncpus;
+#ifndef NO_THREADS
+struct pool_worker {
+	pthread_t tid;
+	pthread_cond_t go;
+	void *(*func)(void *);	/* Phase to run, 0 while parked */
+	void *arg;
+	int cpu;		/* Pinned CPU, -1 for none */
+	int started;
+};
+struct pool_worker pool_w[MAXSTREAMS+1];
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+int pool_quit;
+#endif
 off64_t next64;
 char wol_opened, rol_opened;
 FILE *wqfd,*rwqfd,*rqfd,*rrqfd;
@@ -1665,6 +2017,21 @@ int restf;
 char sverify = 1;
 char odsync = 0;
 char Q_flag,OPS_flag;
+char Q_bin_flag;
+int sample_interval;		/* -+o, ms between throughput samples */
+char *kernel_name = "scalar";	/* fill/verify kernel, see select_kernels() */
+char reduce_flag;		/* -+R data reduction profile, see init_reduce() */
+double reduce_comp = 1.0;	/* target compression ratio */
+double reduce_dedup = 1.0;	/* target dedup ratio */
+long long reduce_block = 4096;	/* dedup block size in bytes */
+long long reduce_rnd;		/* random bytes per REDUCE_CHUNK */
+unsigned long long *reduce_template;
+long long reduce_twords;	/* words in reduce_template */
+int dist_type = DIST_UNIFORM;	/* -+Y random access distribution */
+double dist_param;		/* theta, alpha, hot set percent or run length */
+double dist_share = 80.0;	/* percent of the accesses that go to the hot set */
+struct dist access_dist;	/* shared, built by dist_setup() */
+int trace_recs = TRACE_DEFAULT_RECS;
 char L_flag=0;
 char no_copy_flag,include_close,include_flush;
 char disrupt_flag,compute_flag,xflag,Z_flag, X_flag;
@@ -1674,6 +2041,39 @@ int r_traj_flag,w_traj_flag;
 int mygen;
 char MS_flag;
 int advise_op,advise_flag;
+int mmap_populate;
+int vec_count;			/* -+v segments per record, 0 is off */
+int vec_nsizes;			/* -+v explicit segment sizes, or 0 */
+long long vec_sizes[VEC_MAX];
+int vec_random;			/* -+v :rand layout for preadv/pwritev */
+short zcopy_x;			/* Excel column of the -i 13 results */
+
+/*
+ * -+g buffer policy. Any of these makes alloc_mem() hand out page
+ * aligned buffers rounded to whole pages instead of plain malloc().
+ */
+#define MEM_ALIGN	1	/* page aligned */
+#define MEM_HUGE	2	/* hugetlb pages, else transparent huge pages */
+#define MEM_PREFAULT	4	/* fault in every page before the tests */
+#define MEM_LOCAL	8	/* thread buffers are faulted by their thread */
+#define HUGE_PAGE_SIZE	(2*1024*1024)
+int mem_flags;
+int rec_hook;			/* I_READ() and friends go through rec_io() */
+int dio_rwf;			/* -+W preadv2()/pwritev2() flags */
+long long dio_mem, dio_block;	/* -I buffer and offset/length alignment */
+long long dio_fallback;		/* -I ops redone with buffered I/O */
+long long dio_again;		/* -+W nowait ops reissued without it */
+/* The dio_ counters are bumped by all the -T threads at once */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)) && \
+	__GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#define DIO_COUNT(c)	__atomic_fetch_add(&(c), 1, __ATOMIC_RELAXED)
+#else
+#define DIO_COUNT(c)	((c)++)
+#endif
+struct mem_seg {		/* hugetlb mappings, free_mem() unmaps them */
+	char *addr;
+	size_t len;
+} mem_segs[MAXSTREAMS+4];
 int direct_flag;
 int current_client_number;
 long long chid;
@@ -1787,6 +2187,7 @@ char **argv;
 	unsigned char inp_pat;
 	time_t time_run;
 	char *port,*subarg;
+	char *attr;
 	int num_child1;
 	int cret;
 	int anwser,bind_cpu;
@@ -2365,6 +2766,17 @@ char **argv;
 		case 'i':	/* Specify specific tests */
 			tval=(long long)(atoi(optarg));
 			if(tval < 0) tval=0;
+			if(tval == ZCOPY_TEST)
+			{
+#ifdef HAVE_ZCOPY
+				include_test[tval]++;
+				include_tflag++;
+				break;
+#else
+				printf("\tZero-copy tests not available on this operating system.\n");
+				goto out; //exit(183);
+#endif
+			}
 #ifndef HAVE_PREAD
 			if(tval > RANDOM_MIX_TEST)
 			{
@@ -2662,7 +3074,10 @@ char **argv;
 						pct_read = 1;
 					if(pct_read >=100)
 						pct_read = 100;
-    					sprintf(splash[splash_line++],"\tPercent read in mix test is %d\n",pct_read);
+					if(strstr(subarg,":op"))
+						op_mix = 1;
+    					sprintf(splash[splash_line++],"\tPercent read in mix test is %d%s\n",pct_read,
+						op_mix?", mixed per op within each child":"");
 					break;
 				case 't':  /* Speed code activated */
 					speed_code=1;
@@ -2686,6 +3101,112 @@ char **argv;
 					sprintf(splash[splash_line++],"\tMadvise enabled: %d\n",advise_op);
 					break;
 #endif
+				case 'M':  /* Async completion strategy */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+M takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+#ifdef ASYNC_IO
+					if(strstr(subarg,"iopoll"))
+						async_iopoll = 1;
+					if(strstr(subarg,"hybrid"))
+					{
+						async_poll = ASYNC_POLL_HYBRID;
+						if(strchr(subarg,':'))
+							async_spin_usec = atoi(strchr(subarg,':')+1);
+					}
+					else if(strstr(subarg,"spin"))
+						async_poll = ASYNC_POLL_SPIN;
+					else if(strstr(subarg,"block"))
+						async_poll = ASYNC_POLL_BLOCK;
+					else if(!async_iopoll)
+					{
+					     printf("-+M unknown strategy %s\n",subarg);
+					     goto out; //exit(200);
+					}
+					if(async_poll == ASYNC_POLL_HYBRID)
+						sprintf(splash[splash_line++],"\tAsync completions: spin %d usec, then sleep%s\n",
+							async_spin_usec,async_iopoll ? ", IOPOLL ring" : "");
+					else
+						sprintf(splash[splash_line++],"\tAsync completions: %s%s\n",
+							async_poll == ASYNC_POLL_SPIN ? "busy-poll" : "blocking",
+							async_iopoll ? ", IOPOLL ring" : "");
+#else
+					printf("\n\tSorry ... This version does not support async I/O\n\n");
+					goto out; //exit(19);
+#endif
+					break;
+				case 'W':  /* preadv2/pwritev2 flags */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+W takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+#ifdef RWF_NOWAIT
+					dio_rwf=0;
+					if(strstr(subarg,"nowait"))
+						dio_rwf|=RWF_NOWAIT;
+					if(strstr(subarg,"hipri"))
+						dio_rwf|=RWF_HIPRI;
+					sprintf(splash[splash_line++],"\tpreadv2/pwritev2 with%s%s\n",
+						(dio_rwf & RWF_NOWAIT) ? " RWF_NOWAIT" : "",
+						(dio_rwf & RWF_HIPRI) ? " RWF_HIPRI" : "");
+#else
+					sprintf(splash[splash_line++],"\tpreadv2/pwritev2 not available on this operating system.\n");
+#endif
+					break;
+				case 'g':  /* Buffer alignment and huge pages */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+g takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					mem_flags=MEM_ALIGN;
+					for(attr=strtok(subarg,",");attr;attr=strtok((char *)0,","))
+					{
+						if(strcmp(attr,"page")==0)
+							mem_flags&=~MEM_HUGE;
+						else if(strcmp(attr,"huge")==0)
+							mem_flags|=MEM_HUGE;
+						else if(strcmp(attr,"prefault")==0)
+							mem_flags|=MEM_PREFAULT;
+						else if(strcmp(attr,"local")==0)
+							mem_flags|=MEM_LOCAL|MEM_PREFAULT;
+						else
+						{
+							printf("-+g unknown operand %s\n",attr);
+							printf(USAGE);
+							goto out; //exit(200);
+						}
+					}
+					break;
+				case 'v':  /* Vectored I/O */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+v takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					if(parse_vec(subarg) < 0)
+					{
+					     printf("-+v bad segment list %s\n",subarg);
+					     goto out; //exit(200);
+					}
+					if(vec_nsizes)
+						sprintf(splash[splash_line++],"\tVectored I/O: %d segment sizes, %s preadv/pwritev layout\n",
+							vec_nsizes,vec_random ? "random" : "sequential");
+					else
+						sprintf(splash[splash_line++],"\tVectored I/O: %d segments per record, %s preadv/pwritev layout\n",
+							vec_count,vec_random ? "random" : "sequential");
+					break;
+				case 'e':  /* Prefault mmap files */
+					mmap_populate=1;
+					sprintf(splash[splash_line++],"\tPrefaulting mmap files (MAP_POPULATE).\n");
+					break;
 				case 'n':	/* Set no-retest */
 					noretest = 1;	
     					sprintf(splash[splash_line++],"\tNo retest option selected\n");
@@ -2868,6 +3389,238 @@ char **argv;
 					hist_summary=1;
 					sprintf(splash[splash_line++],"\tHistogram summary enabled.\n");
 					break;
+				case 'Q':  /* Binary offset/latency trace, # records */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+Q takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					trace_recs = atoi(subarg);
+					if(trace_recs <= 0)
+						trace_recs = TRACE_DEFAULT_RECS;
+					Q_flag++;
+					Q_bin_flag=1;
+					sprintf(splash[splash_line++],"\tBinary offset/latency trace enabled, %d records per child.\n",trace_recs);
+					break;
+				case 'R':  /* Data reduction profile comp:dedup:blockKB */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+R takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					reduce_comp = reduce_dedup = 1.0;
+					reduce_block = 4;
+					sscanf(subarg,"%lf:%lf:%lld",&reduce_comp,&reduce_dedup,&reduce_block);
+					if(reduce_comp < 1.0)
+						reduce_comp = 1.0;
+					if(reduce_comp > 32.0)
+						reduce_comp = 32.0;
+					if(reduce_dedup < 1.0)
+						reduce_dedup = 1.0;
+					if(reduce_block <= 0)
+						reduce_block = 4;
+					reduce_block *= 1024;
+					reduce_flag = 1;
+					dedup = 100;	/* take the per record dedup fill path */
+					sprintf(splash[splash_line++],"\tData reduction profile: compress %.2f:1, dedup %.2f:1, %lld Kbyte blocks.\n",
+						reduce_comp,reduce_dedup,reduce_block/1024);
+					break;
+				case 'Y':  /* Random access distribution */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+Y takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					if(strncmp(subarg,"zipf",4)==0)
+					{
+						dist_type = DIST_ZIPF;
+						dist_param = 0.99;
+						sscanf(subarg,"zipf:%lf",&dist_param);
+						if(dist_param <= 0.0)
+							dist_param = 0.99;
+						sprintf(splash[splash_line++],"\tRandom access distribution: Zipf, theta %.3f\n",dist_param);
+					}
+					else if(strncmp(subarg,"hot",3)==0)
+					{
+						dist_type = DIST_HOT;
+						dist_param = 20.0;
+						sscanf(subarg,"hot:%lf:%lf",&dist_param,&dist_share);
+						if(dist_param <= 0.0 || dist_param >= 100.0)
+							dist_param = 20.0;
+						if(dist_share < 0.0 || dist_share > 100.0)
+							dist_share = 80.0;
+						sprintf(splash[splash_line++],"\tRandom access distribution: %.1f%% of the accesses to a %.1f%% hot set\n",
+							dist_share,dist_param);
+					}
+					else if(strncmp(subarg,"pareto",6)==0)
+					{
+						dist_type = DIST_PARETO;
+						dist_param = 1.16;
+						sscanf(subarg,"pareto:%lf",&dist_param);
+						if(dist_param <= 0.0)
+							dist_param = 1.16;
+						sprintf(splash[splash_line++],"\tRandom access distribution: Pareto, alpha %.3f\n",dist_param);
+					}
+					else if(strncmp(subarg,"seq",3)==0)
+					{
+						dist_type = DIST_SEQ;
+						dist_param = 16.0;
+						sscanf(subarg,"seq:%lf",&dist_param);
+						if(dist_param < 1.0)
+							dist_param = 1.0;
+						sprintf(splash[splash_line++],"\tRandom access distribution: sequential runs of %.0f records\n",dist_param);
+					}
+					else if(strncmp(subarg,"uniform",7)==0)
+						dist_type = DIST_UNIFORM;
+					else
+					{
+					     printf("-+Y unknown distribution %s\n",subarg);
+					     goto out; //exit(200);
+					}
+					break;
+				case 'I':  /* Async I/O engine */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+I takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+#ifdef ASYNC_IO
+					if(strncmp(subarg,"uring",5)==0)
+					{
+						async_engine = ASYNC_ENGINE_URING;
+						sscanf(subarg,"uring:%d",&async_ring_entries);
+						if(async_ring_entries <= 0)
+							async_ring_entries = 128;
+						sprintf(splash[splash_line++],"\tAsync I/O engine: io_uring, %d entries\n",async_ring_entries);
+					}
+					else if(strncmp(subarg,"aio",3)==0)
+					{
+						async_engine = ASYNC_ENGINE_KAIO;
+						sscanf(subarg,"aio:%d",&async_ring_entries);
+						if(async_ring_entries <= 0)
+							async_ring_entries = 128;
+						sprintf(splash[splash_line++],"\tAsync I/O engine: Linux aio, %d entries\n",async_ring_entries);
+					}
+					else if(strncmp(subarg,"posix",5)==0)
+						async_engine = ASYNC_ENGINE_POSIX;
+					else
+					{
+					     printf("-+I unknown engine %s\n",subarg);
+					     goto out; //exit(200);
+					}
+#else
+					printf("\n\tSorry ... This version does not support async I/O\n\n");
+					goto out; //exit(19);
+#endif
+					break;
+				case 'o':  /* Throughput sampling interval in ms */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+o takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					sample_interval = atoi(subarg);
+					if(sample_interval <= 0)
+						sample_interval = 100;
+					sprintf(splash[splash_line++],"\tThroughput sampled every %d ms.\n",sample_interval);
+					break;
+				case 'F':  /* Time with the cycle counter */
+					cycle_flag=1;
+					break;
+				case 'f':  /* Time based duration */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+f takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					dur_secs = atof(subarg);
+					if(strchr(subarg,':'))
+						dur_ramp = atof(strchr(subarg,':')+1);
+					if(dur_secs <= 0.0)
+						dur_secs = 1.0;
+					if(dur_ramp < 0.0)
+						dur_ramp = 0.0;
+					sprintf(splash[splash_line++],"\tTime based: each phase runs %g seconds after a %g second ramp-up.\n",
+						dur_secs,dur_ramp);
+					break;
+				case 'G':  /* Persistent worker pool */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+G takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+					if(strcmp(subarg,"none")==0)
+						pool_policy = POOL_NONE;
+					else if(strcmp(subarg,"rr")==0)
+						pool_policy = POOL_RR;
+					else if(strcmp(subarg,"compact")==0)
+						pool_policy = POOL_COMPACT;
+					else if(strcmp(subarg,"scatter")==0)
+						pool_policy = POOL_SCATTER;
+					else
+					{
+					     printf("-+G policy must be none, rr, compact or scatter\n");
+					     goto out; //exit(200);
+					}
+					pool_flag = 1;
+#ifndef NO_THREADS
+					use_thread++;
+#endif
+					sprintf(splash[splash_line++],"\tPersistent worker pool, %s pinning.\n",subarg);
+					break;
+				case 'J':  /* RTEMS child task attributes */
+					subarg=argv[optind++];
+					if(subarg==(char *)0)
+					{
+					     printf("-+J takes an operand !!\n");
+					     goto out; //exit(200);
+					}
+#ifdef __rtems__
+					for(attr=strtok(subarg,",");attr;attr=strtok((char *)0,","))
+					{
+						if(strncmp(attr,"prio=",5)==0)
+						{
+							task_prio=(rtems_task_priority)atoi(attr+5);
+							if(strchr(attr,':'))
+								task_prio_step=(rtems_task_priority)atoi(strchr(attr,':')+1);
+						}
+						else if(strncmp(attr,"stack=",6)==0)
+							task_stack=(size_t)atoi(attr+6)*1024;
+						else if(strcmp(attr,"fifo")==0)
+							task_mode=(task_mode & ~RTEMS_TIMESLICE_MASK)|RTEMS_NO_TIMESLICE;
+						else if(strcmp(attr,"timeslice")==0)
+							task_mode=(task_mode & ~RTEMS_TIMESLICE_MASK)|RTEMS_TIMESLICE;
+						else if(strncmp(attr,"sched=",6)==0)
+							strncpy(task_sched,attr+6,sizeof(task_sched)-1);
+						else if(strncmp(attr,"cpus=",5)==0)
+						{
+							task_cpu_lo=task_cpu_hi=atoi(attr+5);
+							if(strchr(attr,'-'))
+								task_cpu_hi=atoi(strchr(attr,'-')+1);
+							if(task_cpu_hi < task_cpu_lo)
+								task_cpu_hi=task_cpu_lo;
+						}
+						else
+						{
+							printf("-+J unknown attribute %s\n",attr);
+							goto out; //exit(200);
+						}
+					}
+					sprintf(splash[splash_line++],"\tChild tasks: priority %d step %d, stack %ld, %s%s%s\n",
+						(int)task_prio,(int)task_prio_step,(long)task_stack,
+						(task_mode & RTEMS_TIMESLICE_MASK)==RTEMS_TIMESLICE?"timeslice":"fifo",
+						task_sched[0]?", scheduler ":"",task_sched);
+#else
+					printf("-+J is only supported on RTEMS. Ignored.\n");
+#endif
+					break;
 				case 'O':  /* Argument is the Op rate */
 					subarg=argv[optind++];
 					if(subarg==(char *)0)
@@ -2878,8 +3631,11 @@ char **argv;
 					op_rate = atoi(subarg);
 					if(op_rate <= 0)
 						op_rate = 1;
-					op_rate_flag = 1;
-					sprintf(splash[splash_line++],"\tRate control active %d Ops/sec .\n",op_rate);
+					op_rate_flag = RATE_CONST;
+					if(strstr(subarg,":poisson"))
+						op_rate_flag = RATE_POISSON;
+					sprintf(splash[splash_line++],"\tOpen-loop rate control active %d Ops/sec, %s arrivals.\n",
+						op_rate,op_rate_flag==RATE_POISSON?"Poisson":"constant");
 					break;
 				default:
 					printf("Unsupported Plus option -> %s <-\n",optarg);
@@ -2896,7 +3652,65 @@ char **argv;
 //        printf(".. %s(): /* probably this is correct place to init rtems timer */\n", __FUNCTION__);
         benchmark_timer_initialize();
 #endif
-	base_time=(long)time_so_far();
+	select_kernels();
+	rec_hook = vec_count || dio_rwf;
+#ifdef DIO_FALLBACK
+	if(direct_flag)
+		rec_hook = 1;
+#endif
+	if(mem_flags)
+	{
+		/* 
+		 * The main buffers were allocated before -+g was seen.
+		 * b0 keeps the cache_size slack for the alignment below.
+		 */
+		free(b0);
+		b0 = buffer = alloc_mem((long long)(MAXBUFFERSIZE + (2 * cache_size)),(int)0);
+		if(buffer == 0) {
+			perror("(1) Memory allocation failed:");
+			goto out; //exit(1);
+		}
+#ifdef _64BIT_ARCH_
+     		buffer = (char *) ((long long )(buffer + cache_size ) & 
+			~(cache_size-1));
+#else
+     		buffer = (char *) ((long)(buffer + cache_size ) & 
+			~((long)cache_size-1));
+#endif
+		mainbuffer = buffer;
+		if(multi_buffer)
+		{
+			free_mem(mbuffer);
+     			mbuffer = alloc_mem((long long)MAXBUFFERSIZE,(int)0);
+			if(mbuffer == 0) {
+                        	perror("(4) Memory allocation failed:");
+                          	goto out; //exit(8);
+			}
+		}
+		sprintf(splash[splash_line++],"\tBuffers %s aligned%s%s\n",
+			(mem_flags & MEM_HUGE) ? (mem_segs[0].addr ?
+			"huge page" : "transparent huge page") : "page",
+			(mem_flags & MEM_PREFAULT) ? ", prefaulted" : "",
+			(mem_flags & MEM_LOCAL) ? " by their thread" : "");
+	}
+	if(reduce_flag && init_reduce() != 0)
+	{
+		printf("Unable to allocate the data reduction template\n");
+		goto out; //exit(1);
+	}
+	/* Only worth a line when -V or -+d asked for full verification */
+	if(diag_v || (verify && sverify == 0))
+		sprintf(splash[splash_line++],"\tPattern fill/verify kernel: %s\n",kernel_name);
+	cycle_rate=0.0;
+	if(cycle_flag)
+	{
+		if(pit_hostname[0] || calibrate_cycles() != 0)
+			sprintf(splash[splash_line++],"\tCycle counter not available, using the system clock.\n");
+		else
+			sprintf(splash[splash_line++],"\tCycle counter timer, %.3f MHz.\n",cycle_rate/1000000.0);
+	}
+	base_time=(long)clock_so_far();
+	run_start=time_so_far();
 	get_resolution(); 		/* Get clock resolution */
 	if(speed_code)
 	{
@@ -2931,6 +3745,14 @@ char **argv;
 	{
 		alloc_pbuf();
 	}
+	if(hist_summary) /* One latency histogram per child */
+	{
+		if(hist_alloc(trflag ? (int)l_max(maxt,num_child) : 1) != 0)
+		{
+			printf("\tUnable to allocate the latency histograms.\n");
+			hist_summary=0;
+		}
+	}
 	if(distributed && master_iozone)
 	{
 		if(maxt > clients_found)
@@ -3147,6 +3969,11 @@ char **argv;
 		for(i=0;i<sizeof(func)/sizeof(char *);i++)
 			if(include_test[i])
 				include_mask|=(long long)(1<<i);
+		if(include_test[ZCOPY_TEST])
+			include_mask|=(long long)ZCOPY_MASK;
+		/* Throughput mode runs the mix test even when func[] has none */
+		if(include_test[RANDOM_MIX_TEST])
+			include_mask|=(long long)RANDOM_MIX_MASK;
 		/* printf(">> %llx",include_mask);  HERE */
 	}
 	if(no_write) /* Disable if any writer would disturbe existing file */
@@ -3182,7 +4009,14 @@ char **argv;
 		max_rec_size=min_rec_size;
 
 	init_record_sizes(min_rec_size,max_rec_size);
-    	if(!silent) printf("\tTime Resolution = %1.6f seconds.\n",time_res);
+	if(cycle_rate != 0.0)
+	{
+    		if(!silent) printf("\tTime Resolution = %1.9f seconds.\n",time_res);
+	}
+	else
+	{
+    		if(!silent) printf("\tTime Resolution = %1.6f seconds.\n",time_res);
+	}
 #ifdef NO_PRINT_LLD
     	if(!silent) printf("\tProcessor cache size set to %ld Kbytes.\n",cache_size/1024);
     	if(!silent) printf("\tProcessor cache line size set to %ld bytes.\n",cache_line_size);
@@ -3267,6 +4101,17 @@ char **argv;
 		bzero(buffer,(size_t)l_min(reclen,(long long)cache_size));
 	}
 
+	if(dur_secs != 0.0 && (w_traj_flag || r_traj_flag))
+	{
+		printf("\tTime based mode does not apply to trajectory files, -+f ignored.\n");
+		dur_secs = 0.0;
+	}
+	if(pool_flag)
+	{
+		if(ioz_processor_bind && pool_policy == POOL_NONE)
+			pool_policy = POOL_RR;
+		pool_topology();
+	}
 #ifndef NO_THREADS
 #if defined( _HPUX_SOURCE ) || defined ( linux )
 	if(ioz_processor_bind)
@@ -3286,6 +4131,8 @@ char **argv;
 	}
 #endif
 #endif
+	if(pool_flag)
+		ioz_processor_bind = 0;	/* The workers are pinned once */
 	orig_size=kilobytes64;
 	if(trflag){
             printf(".. Multi throughput test: mint=%lld, maxt=%lld\n", mint, maxt);
@@ -3315,6 +4162,22 @@ out:
 		if(check_filename(dummyfile[0]))
 	      	   unlink(dummyfile[0]);	/* delete the file */
 	}
+#ifdef DIO_FALLBACK
+	if(direct_flag && dio_block && !silent)
+#ifdef NO_PRINT_LLD
+		printf("\n\tO_DIRECT alignment %ld bytes in memory, %ld in the file, %ld ops fell back to buffered I/O.\n",
+			dio_mem,dio_block,dio_fallback);
+#else
+		printf("\n\tO_DIRECT alignment %lld bytes in memory, %lld in the file, %lld ops fell back to buffered I/O.\n",
+			dio_mem,dio_block,dio_fallback);
+#endif
+#endif
+	if(dio_again && !silent)
+#ifdef NO_PRINT_LLD
+		printf("\n\t%ld RWF_NOWAIT ops would have blocked and were reissued without it.\n",dio_again);
+#else
+		printf("\n\t%lld RWF_NOWAIT ops would have blocked and were reissued without it.\n",dio_again);
+#endif
 	if(!silent) printf("\niozone test complete.\n");
 	if(res_prob)
 	{
@@ -3328,7 +4191,8 @@ out:
 		dump_excel();
 #endif
 	}
-        free(b0);
+	pool_stop();
+        free_mem(b0);
         free(b1);
 	return(0);	
 }
@@ -3379,6 +4243,9 @@ long long reclength;
 {
 	long long num_tests,test_num,i,j;
 	long long data1[MAXTESTS], data2[MAXTESTS];
+#ifdef HAVE_ZCOPY
+	long long zdata1,zdata2;
+#endif
 	num_tests = sizeof(func)/sizeof(char *);
 #if 0
         printf(".. %s().\n", __FUNCTION__);
@@ -3466,6 +4333,17 @@ long long reclength;
 					store_value((off64_t)0);
 			}
 		}
+#ifdef HAVE_ZCOPY
+		/* 
+		 * Its columns follow whatever this build has in func[],
+		 * so remember where they landed for the Excel report.
+		 */
+		if(include_mask & (long long)ZCOPY_MASK)
+		{
+			zcopy_x=current_x;
+			zcopy_perf_test(kilobytes64,reclen,&zdata1,&zdata2);
+		}
+#endif
 	}
 	else
 	{
@@ -3726,15 +4604,19 @@ void auto_test()
 /* Data in shared memory format is:				*/
 /*								*/
 /* struct child_stats {						*/
-/* 	long long flag; 	Used to barrier			*/
-/*	double walltime;	Child's elapsed time		*/
-/*	double cputime;		Child's CPU time		*/
-/* 	double throughput;	Child's throughput		*/
-/* 	double actual;		Child's actual read/written	*/
+/* 	int flag; 		Used to barrier			*/
+/* 	unsigned int seq;	live_* sequence counter		*/
+/*	float walltime;		Child's elapsed time		*/
+/*	float cputime;		Child's CPU time		*/
+/* 	float throughput;	Child's throughput		*/
+/* 	float actual;		Child's actual read/written	*/
+/* 	double live_kb;		Running total while testing	*/
+/* 	double live_ops;	Running op count while testing	*/
+/* 	double phase_start;	Time children were released	*/
 /* } 								*/
 /*								*/
 /* There is an array of child_stat structures layed out in 	*/
-/* shared memory.						*/
+/* shared memory, one cache line (CHILD_STATS_LINE) apart.	*/
 /*								*/
 /****************************************************************/
 
@@ -3777,7 +4659,7 @@ throughput_test()
 
 	if(!haveshm)
 	{
-		shmaddr=(struct child_stats *)alloc_mem((long long)SHMSIZE,(int)1);
+		shmaddr=(struct child_stats *)alloc_mem((long long)SHMSIZE+CHILD_STATS_LINE,(int)1);
 #ifdef _64BIT_ARCH_
 		if((long long)shmaddr==(long long)-1)
 #else
@@ -3787,6 +4669,9 @@ throughput_test()
 			printf("\nShared memory not working\n");
 			exit(24);
 		}
+		/* malloc()ed blocks need not start on a cache line */
+		shmaddr=(struct child_stats *)(((unsigned long)shmaddr +
+			CHILD_STATS_LINE - 1) & ~(unsigned long)(CHILD_STATS_LINE - 1));
 		haveshm=(char*)shmaddr;
 	}
 	else
@@ -3801,7 +4686,10 @@ throughput_test()
 	}
 	for(xyz=0;xyz<num_child;xyz++){ /* all children to state 0 (HOLD) */
 		child_stat = (struct child_stats *)&shmaddr[xyz];
-		child_stat->flag=CHILD_STATE_HOLD;
+		child_flag_set(child_stat,CHILD_STATE_HOLD);
+		child_stat->seq=0;
+		child_stat->live_kb=0;
+		child_stat->live_ops=0;
 		child_stat->actual=0;
 		child_stat->throughput=0;
 		child_stat->cputime=0;
@@ -3815,6 +4703,7 @@ throughput_test()
 	if(aggflag)
 		kilobytes64=orig_size/num_child;
         numrecs64 = (long long)(kilobytes64*1024)/reclen;
+	dist_setup((unsigned long long)numrecs64);
 	buffer=mainbuffer;
 	if(use_thread)
 		port="thread";
@@ -3971,8 +4860,7 @@ throughput_test()
 #endif
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];	
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++)	/* Start all children going */
 		{
@@ -3980,7 +4868,7 @@ throughput_test()
 				Poll((long long)delay_start);
 						/* State "go" */
 			child_stat = (struct child_stats *)&shmaddr[i];	
-			child_stat->flag=CHILD_STATE_BEGIN;
+			child_begin(child_stat,(int)i);
 #ifdef NET_BENCH
 			if(distributed && master_iozone)
 				tell_children_begin(i);
@@ -3994,6 +4882,8 @@ waitout:
 	getout=0;
 	if((long long)getpid() == myid) {	/* Parent only */
 		starttime1 = time_so_far(); /* Wait for all children */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -4037,6 +4927,8 @@ waitout:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* get parents total time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res; 
@@ -4087,7 +4979,7 @@ waitout:
 	
 	for(xyz=0;xyz<num_child;xyz++){
 		child_stat = (struct child_stats *) &shmaddr[xyz];
-		child_stat->flag = CHILD_STATE_HOLD; /* Start children at state 0 (HOLD) */
+		child_flag_set(child_stat,CHILD_STATE_HOLD); /* Start children at state 0 (HOLD) */
 	}
 	if(cpuutilflag)
 		store_times (walltime, cputime);	/* Must be Before store_dvalue(). */
@@ -4103,6 +4995,8 @@ waitout:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -4256,13 +5150,12 @@ waitout:
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
 					/* wait for children to start */
-			while(child_stat->flag==CHILD_STATE_HOLD) 
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++)
 		{
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -4277,6 +5170,8 @@ waitout:
 jump3:
 	getout=0;
 	if((long long)myid == getpid()){	/* Parent only here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -4320,6 +5215,8 @@ jump3:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents total time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time  < (double).000001) 
 	{
 		total_time=time_res;
@@ -4372,7 +5269,7 @@ jump3:
 
 	for(xyz=0;xyz<num_child;xyz++){	/* Reset state to 0 (HOLD) */
 		child_stat=(struct child_stats *)&shmaddr[xyz];
-		child_stat->flag = CHILD_STATE_HOLD;
+		child_flag_set(child_stat,CHILD_STATE_HOLD);
 	}
 	if(cpuutilflag)
 		store_times (walltime, cputime);	/* Must be Before store_dvalue(). */
@@ -4388,6 +5285,8 @@ jump3:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -4534,13 +5433,12 @@ next0:
 		}
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat=(struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++)
 		{
 			child_stat=(struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN; /* tell children to go */
+			child_begin(child_stat,(int)i); /* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -4554,6 +5452,8 @@ next0:
 jumpend4:
 	getout=0;
 	if(myid == (long long)getpid()){	/* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -4597,6 +5497,8 @@ jumpend4:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res; 
@@ -4654,6 +5556,8 @@ jumpend4:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -4804,12 +5708,11 @@ jumpend4:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -4824,6 +5727,8 @@ jumpend4:
 jumpend2:
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -4867,6 +5772,8 @@ jumpend2:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res;
@@ -4927,6 +5834,8 @@ jumpend2:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -5078,12 +5987,11 @@ next1:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -5096,6 +6004,8 @@ next1:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -5200,6 +6110,8 @@ next1:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -5347,12 +6259,11 @@ next2:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -5365,6 +6276,8 @@ next2:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -5469,6 +6382,8 @@ next2:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -5617,12 +6532,11 @@ next3:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -5635,6 +6549,8 @@ next3:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -5678,6 +6594,8 @@ next3:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res;
@@ -5734,6 +6652,8 @@ next3:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -5882,12 +6802,11 @@ next4:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -5900,6 +6819,8 @@ next4:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -5943,6 +6864,8 @@ next4:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0 && op_mix)
+		total_time -= dur_ramp;	/* only -+p #:op honours -+f */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res;
@@ -5999,6 +6922,10 @@ next4:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(op_mix && !silent && !distributed)
+		opmix_report(unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -6143,12 +7070,11 @@ next5:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -6161,6 +7087,8 @@ next5:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -6204,6 +7132,8 @@ next5:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res;
@@ -6260,6 +7190,8 @@ next5:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -6411,12 +7343,11 @@ next6:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -6429,6 +7360,8 @@ next6:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -6472,6 +7405,8 @@ next6:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res;
@@ -6528,6 +7463,8 @@ next6:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -6681,12 +7618,11 @@ next7:
                 }
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat = (struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++){
 			child_stat = (struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+			child_begin(child_stat,(int)i);	/* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -6699,6 +7635,8 @@ next7:
 	
 	getout=0;
 	if(myid == (long long)getpid()){	 /* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -6742,6 +7680,8 @@ next7:
 		}
 	}
 	total_time = (time_so_far() - starttime1)-time_res; /* Parents time */
+	if(dur_secs != 0.0)
+		total_time -= dur_ramp;	/* -+f ramp-up is not measured */
 	if(total_time < (double).000001) 
 	{
 		total_time=time_res;
@@ -6798,6 +7738,8 @@ next7:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -6941,13 +7883,12 @@ next8:
 		}
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat=(struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++)
 		{
 			child_stat=(struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN; /* tell children to go */
+			child_begin(child_stat,(int)i); /* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -6961,6 +7902,8 @@ next8:
 jumpend1:
 	getout=0;
 	if(myid == (long long)getpid()){	/* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -7061,6 +8004,8 @@ jumpend1:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -7206,13 +8151,12 @@ next9:
 		}
 		for(i=0;i<num_child; i++){ /* wait for children to start */
 			child_stat=(struct child_stats *)&shmaddr[i];
-			while(child_stat->flag==CHILD_STATE_HOLD)
-				Poll((long long)1);
+			child_wait_ready(child_stat);
 		}
 		for(i=0;i<num_child; i++)
 		{
 			child_stat=(struct child_stats *)&shmaddr[i];
-			child_stat->flag = CHILD_STATE_BEGIN; /* tell children to go */
+			child_begin(child_stat,(int)i); /* tell children to go */
 			if(delay_start!=0)
 				Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -7226,6 +8170,8 @@ next9:
 jumpend3:
 	getout=0;
 	if(myid == (long long)getpid()){	/* Parent here */
+		if(sample_interval)
+			sample_children(&toutput[toutputindex][0],(int)num_child);
 #if defined(__rtems__)
            /* This way the main task wait for spawned tasks completion */
            {
@@ -7326,6 +8272,8 @@ jumpend3:
 	if(!silent) printf("\tMax throughput per %s \t\t\t= %10.2f %s/sec\n", port,max_throughput,unit);
 	if(!silent) printf("\tAvg throughput per %s \t\t\t= %10.2f %s/sec\n", port,avg_throughput,unit);
 	if(!silent) printf("\tMin xfer \t\t\t\t\t= %10.2f %s\n", min_xfer,unit);
+	if(hist_summary)
+		dump_hist_all(&toutput[toutputindex][0],(int)num_child);
 	/* CPU% can be > 100.0 for multiple CPUs */
 	if(cpuutilflag)
 	{
@@ -7457,13 +8405,12 @@ next10:
 			for(i=0;i<num_child; i++){
 				child_stat = (struct child_stats *)&shmaddr[i];
 						/* wait for children to start */
-				while(child_stat->flag==CHILD_STATE_HOLD) 
-					Poll((long long)1);
+				child_wait_ready(child_stat);
 			}
 			for(i=0;i<num_child; i++)
 			{
 				child_stat = (struct child_stats *)&shmaddr[i];
-				child_stat->flag = CHILD_STATE_BEGIN;	/* tell children to go */
+				child_begin(child_stat,(int)i);	/* tell children to go */
 				if(delay_start!=0)
 					Poll((long long)delay_start);
 #ifdef NET_BENCH
@@ -7510,7 +8457,7 @@ next10:
 
 		for(xyz=0;xyz<num_child;xyz++){	/* Reset state to 0 (HOLD) */
 			child_stat=(struct child_stats *)&shmaddr[xyz];
-			child_stat->flag = CHILD_STATE_HOLD;
+			child_flag_set(child_stat,CHILD_STATE_HOLD);
 		}
 		sync();
 		sleep(2);
@@ -7548,6 +8495,22 @@ static double
 time_so_far()
 #endif
 {
+#ifdef HAVE_CYCLE_COUNTER
+	if(cycle_rate != 0.0)
+		return(cycle_so_far());
+#endif
+	return(clock_so_far());
+}
+
+/* The system clock. Also the reference the cycle counter is calibrated against */
+#ifdef HAVE_ANSIC_C
+static double
+clock_so_far(void)
+#else
+static double
+clock_so_far()
+#endif
+{
 #ifdef Windows
    LARGE_INTEGER freq,counter;
    double wintime,bigcounter;
@@ -7583,13 +8546,13 @@ time_so_far()
   if (getclock(TIMEOFDAY, (struct timespec *) &gp) == -1)
     perror("getclock");
   return (( (double) (gp.tv_sec)) +
-    ( ((float)(gp.tv_nsec)) * 0.000000001 ));
+    ( ((double)(gp.tv_nsec)) * 0.000000001 ));
 #else
 #if defined (__rtems__)
   struct timespec gp;
   rtems_clock_get_uptime(&gp);
   return (( (double) (gp.tv_sec)) +
-    ( ((float)(gp.tv_nsec)) * 0.000000001 ));
+    ( ((double)(gp.tv_nsec)) * 0.000000001 ));
 #else
   struct timeval tp;
 
@@ -7642,6 +8605,487 @@ long long length;
 	}
 }
 
+/************************************************************************/
+/* Pattern kernels for fill_buffer() and verify_buffer().		*/
+/* Every pattern iozone writes is a run of 64 bit words that either	*/
+/* repeat (step 0) or grow by a constant step (diag_v). fill_words()	*/
+/* stores such a run and cmp_words() returns the index of the first	*/
+/* word that does not match it, or -1. Both point at the fastest	*/
+/* kernel this CPU has, picked once by select_kernels(). All kernels	*/
+/* produce exactly the words the scalar loop would.			*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static void
+fill_scalar(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+#else
+static void
+fill_scalar(w, n, v, step)
+unsigned long long *w;
+long long n;
+unsigned long long v, step;
+#endif
+{
+	long long k;
+
+	for(k = 0; k < n; k++)
+	{
+		w[k] = v;
+		v += step;
+	}
+}
+
+#ifdef HAVE_ANSIC_C
+static long long
+cmp_scalar(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+#else
+static long long
+cmp_scalar(w, n, v, step)
+unsigned long long *w;
+long long n;
+unsigned long long v, step;
+#endif
+{
+	long long k;
+
+	for(k = 0; k < n; k++)
+	{
+		if(w[k] != v)
+			return(k);
+		v += step;
+	}
+	return(-1);
+}
+
+/*
+ * The vector kernels below work on 8 words per iteration and leave
+ * the tail to the scalar code. The compares OR together the XOR of a
+ * whole block and only rescan a block that differs.
+ */
+#ifdef HAVE_SSE2_KERNEL
+static void
+fill_sse2(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	__m128i c0, c1, c2, c3, inc;
+	long long k;
+
+	c0 = _mm_set_epi64x((long long)(v + step), (long long)v);
+	inc = _mm_set1_epi64x((long long)(2 * step));
+	c1 = _mm_add_epi64(c0, inc);
+	c2 = _mm_add_epi64(c1, inc);
+	c3 = _mm_add_epi64(c2, inc);
+	inc = _mm_set1_epi64x((long long)(8 * step));
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		_mm_storeu_si128((__m128i *)&w[k], c0);
+		_mm_storeu_si128((__m128i *)&w[k + 2], c1);
+		_mm_storeu_si128((__m128i *)&w[k + 4], c2);
+		_mm_storeu_si128((__m128i *)&w[k + 6], c3);
+		c0 = _mm_add_epi64(c0, inc);
+		c1 = _mm_add_epi64(c1, inc);
+		c2 = _mm_add_epi64(c2, inc);
+		c3 = _mm_add_epi64(c3, inc);
+	}
+	fill_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+}
+
+static long long
+cmp_sse2(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	__m128i c0, c1, c2, c3, inc, x;
+	long long k, r;
+
+	c0 = _mm_set_epi64x((long long)(v + step), (long long)v);
+	inc = _mm_set1_epi64x((long long)(2 * step));
+	c1 = _mm_add_epi64(c0, inc);
+	c2 = _mm_add_epi64(c1, inc);
+	c3 = _mm_add_epi64(c2, inc);
+	inc = _mm_set1_epi64x((long long)(8 * step));
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		x = _mm_xor_si128(_mm_loadu_si128((__m128i *)&w[k]), c0);
+		x = _mm_or_si128(x, _mm_xor_si128(
+			_mm_loadu_si128((__m128i *)&w[k + 2]), c1));
+		x = _mm_or_si128(x, _mm_xor_si128(
+			_mm_loadu_si128((__m128i *)&w[k + 4]), c2));
+		x = _mm_or_si128(x, _mm_xor_si128(
+			_mm_loadu_si128((__m128i *)&w[k + 6]), c3));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128()))
+		   != 0xffff)
+			break;
+		c0 = _mm_add_epi64(c0, inc);
+		c1 = _mm_add_epi64(c1, inc);
+		c2 = _mm_add_epi64(c2, inc);
+		c3 = _mm_add_epi64(c3, inc);
+	}
+	r = cmp_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+	return(r < 0 ? r : k + r);
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNEL
+__attribute__((target("avx2"))) static void
+fill_avx2(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	__m256i c0, c1, inc;
+	long long k;
+
+	c0 = _mm256_set_epi64x((long long)(v + 3 * step),
+		(long long)(v + 2 * step), (long long)(v + step), (long long)v);
+	c1 = _mm256_add_epi64(c0, _mm256_set1_epi64x((long long)(4 * step)));
+	inc = _mm256_set1_epi64x((long long)(8 * step));
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		_mm256_storeu_si256((__m256i *)&w[k], c0);
+		_mm256_storeu_si256((__m256i *)&w[k + 4], c1);
+		c0 = _mm256_add_epi64(c0, inc);
+		c1 = _mm256_add_epi64(c1, inc);
+	}
+	fill_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+}
+
+__attribute__((target("avx2"))) static long long
+cmp_avx2(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	__m256i c0, c1, inc, x;
+	long long k, r;
+
+	c0 = _mm256_set_epi64x((long long)(v + 3 * step),
+		(long long)(v + 2 * step), (long long)(v + step), (long long)v);
+	c1 = _mm256_add_epi64(c0, _mm256_set1_epi64x((long long)(4 * step)));
+	inc = _mm256_set1_epi64x((long long)(8 * step));
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		x = _mm256_xor_si256(_mm256_loadu_si256((__m256i *)&w[k]), c0);
+		x = _mm256_or_si256(x, _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i *)&w[k + 4]), c1));
+		if(!_mm256_testz_si256(x, x))
+			break;
+		c0 = _mm256_add_epi64(c0, inc);
+		c1 = _mm256_add_epi64(c1, inc);
+	}
+	r = cmp_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+	return(r < 0 ? r : k + r);
+}
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+static void
+fill_neon(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	uint64x2_t c0, c1, c2, c3, inc;
+	long long k;
+
+	c0 = vcombine_u64(vcreate_u64(v), vcreate_u64(v + step));
+	inc = vdupq_n_u64(2 * step);
+	c1 = vaddq_u64(c0, inc);
+	c2 = vaddq_u64(c1, inc);
+	c3 = vaddq_u64(c2, inc);
+	inc = vdupq_n_u64(8 * step);
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		vst1q_u64((uint64_t *)&w[k], c0);
+		vst1q_u64((uint64_t *)&w[k + 2], c1);
+		vst1q_u64((uint64_t *)&w[k + 4], c2);
+		vst1q_u64((uint64_t *)&w[k + 6], c3);
+		c0 = vaddq_u64(c0, inc);
+		c1 = vaddq_u64(c1, inc);
+		c2 = vaddq_u64(c2, inc);
+		c3 = vaddq_u64(c3, inc);
+	}
+	fill_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+}
+
+static long long
+cmp_neon(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	uint64x2_t c0, c1, c2, c3, inc, x;
+	long long k, r;
+
+	c0 = vcombine_u64(vcreate_u64(v), vcreate_u64(v + step));
+	inc = vdupq_n_u64(2 * step);
+	c1 = vaddq_u64(c0, inc);
+	c2 = vaddq_u64(c1, inc);
+	c3 = vaddq_u64(c2, inc);
+	inc = vdupq_n_u64(8 * step);
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		x = veorq_u64(vld1q_u64((uint64_t *)&w[k]), c0);
+		x = vorrq_u64(x, veorq_u64(vld1q_u64((uint64_t *)&w[k + 2]), c1));
+		x = vorrq_u64(x, veorq_u64(vld1q_u64((uint64_t *)&w[k + 4]), c2));
+		x = vorrq_u64(x, veorq_u64(vld1q_u64((uint64_t *)&w[k + 6]), c3));
+		if(vgetq_lane_u64(x, 0) | vgetq_lane_u64(x, 1))
+			break;
+		c0 = vaddq_u64(c0, inc);
+		c1 = vaddq_u64(c1, inc);
+		c2 = vaddq_u64(c2, inc);
+		c3 = vaddq_u64(c3, inc);
+	}
+	r = cmp_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+	return(r < 0 ? r : k + r);
+}
+#endif
+
+#ifdef HAVE_ALTIVEC_KERNEL
+/*
+ * AltiVec has no 64 bit add. Words are big endian, so each 64 bit
+ * lane is (hi, lo) in 32 bit lanes: add, then carry lo into hi.
+ */
+static __vector unsigned int
+altivec_add64(__vector unsigned int a, __vector unsigned int b)
+{
+	const __vector unsigned int himask = { ~0U, 0, ~0U, 0 };
+	__vector unsigned int carry;
+
+	carry = vec_addc(a, b);
+	carry = vec_and(vec_sld(carry, vec_splat_u32(0), 4), himask);
+	return(vec_add(vec_add(a, b), carry));
+}
+
+static __vector unsigned int
+altivec_pair(unsigned long long a, unsigned long long b)
+{
+	union {
+		unsigned long long u[2];
+		__vector unsigned int v;
+	} p;
+
+	p.u[0] = a;
+	p.u[1] = b;
+	return(p.v);
+}
+
+/* vec_ld/vec_st need 16 byte alignment, other buffers go scalar */
+static void
+fill_altivec(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	__vector unsigned int c0, c1, c2, c3, inc;
+	long long k;
+
+	k = 0;
+	if(((unsigned long)w & 15) == 0)
+	{
+		c0 = altivec_pair(v, v + step);
+		inc = altivec_pair(2 * step, 2 * step);
+		c1 = altivec_add64(c0, inc);
+		c2 = altivec_add64(c1, inc);
+		c3 = altivec_add64(c2, inc);
+		inc = altivec_pair(8 * step, 8 * step);
+		for(; k + 8 <= n; k += 8)
+		{
+			vec_st(c0, 0, (unsigned int *)&w[k]);
+			vec_st(c1, 16, (unsigned int *)&w[k]);
+			vec_st(c2, 32, (unsigned int *)&w[k]);
+			vec_st(c3, 48, (unsigned int *)&w[k]);
+			c0 = altivec_add64(c0, inc);
+			c1 = altivec_add64(c1, inc);
+			c2 = altivec_add64(c2, inc);
+			c3 = altivec_add64(c3, inc);
+		}
+	}
+	fill_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+}
+
+static long long
+cmp_altivec(unsigned long long *w, long long n, unsigned long long v,
+	unsigned long long step)
+{
+	__vector unsigned int c0, c1, c2, c3, inc, x;
+	long long k, r;
+
+	k = 0;
+	if(((unsigned long)w & 15) == 0)
+	{
+		c0 = altivec_pair(v, v + step);
+		inc = altivec_pair(2 * step, 2 * step);
+		c1 = altivec_add64(c0, inc);
+		c2 = altivec_add64(c1, inc);
+		c3 = altivec_add64(c2, inc);
+		inc = altivec_pair(8 * step, 8 * step);
+		for(; k + 8 <= n; k += 8)
+		{
+			x = vec_xor(vec_ld(0, (unsigned int *)&w[k]), c0);
+			x = vec_or(x, vec_xor(vec_ld(16, (unsigned int *)&w[k]), c1));
+			x = vec_or(x, vec_xor(vec_ld(32, (unsigned int *)&w[k]), c2));
+			x = vec_or(x, vec_xor(vec_ld(48, (unsigned int *)&w[k]), c3));
+			if(!vec_all_eq(x, vec_splat_u32(0)))
+				break;
+			c0 = altivec_add64(c0, inc);
+			c1 = altivec_add64(c1, inc);
+			c2 = altivec_add64(c2, inc);
+			c3 = altivec_add64(c3, inc);
+		}
+	}
+	r = cmp_scalar(&w[k], n - k, v + (unsigned long long)k * step, step);
+	return(r < 0 ? r : k + r);
+}
+#endif
+
+/*
+ * xor_words() stores src[k] ^ key into dst[k]. It is the inner loop of
+ * the data reduction generator, see gen_reduce_buf().
+ */
+#ifdef HAVE_ANSIC_C
+static void
+xor_scalar(unsigned long long *dst, unsigned long long *src, long long n,
+	unsigned long long key)
+#else
+static void
+xor_scalar(dst, src, n, key)
+unsigned long long *dst, *src;
+long long n;
+unsigned long long key;
+#endif
+{
+	long long k;
+
+	for(k = 0; k < n; k++)
+		dst[k] = src[k] ^ key;
+}
+
+#ifdef HAVE_SSE2_KERNEL
+static void
+xor_sse2(unsigned long long *dst, unsigned long long *src, long long n,
+	unsigned long long key)
+{
+	__m128i kv;
+	long long k;
+
+	kv = _mm_set1_epi64x((long long)key);
+	for(k = 0; k + 4 <= n; k += 4)
+	{
+		_mm_storeu_si128((__m128i *)&dst[k], _mm_xor_si128(
+			_mm_loadu_si128((__m128i *)&src[k]), kv));
+		_mm_storeu_si128((__m128i *)&dst[k + 2], _mm_xor_si128(
+			_mm_loadu_si128((__m128i *)&src[k + 2]), kv));
+	}
+	xor_scalar(&dst[k], &src[k], n - k, key);
+}
+#endif
+
+#ifdef HAVE_AVX2_KERNEL
+__attribute__((target("avx2"))) static void
+xor_avx2(unsigned long long *dst, unsigned long long *src, long long n,
+	unsigned long long key)
+{
+	__m256i kv;
+	long long k;
+
+	kv = _mm256_set1_epi64x((long long)key);
+	for(k = 0; k + 8 <= n; k += 8)
+	{
+		_mm256_storeu_si256((__m256i *)&dst[k], _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i *)&src[k]), kv));
+		_mm256_storeu_si256((__m256i *)&dst[k + 4], _mm256_xor_si256(
+			_mm256_loadu_si256((__m256i *)&src[k + 4]), kv));
+	}
+	xor_scalar(&dst[k], &src[k], n - k, key);
+}
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+static void
+xor_neon(unsigned long long *dst, unsigned long long *src, long long n,
+	unsigned long long key)
+{
+	uint64x2_t kv;
+	long long k;
+
+	kv = vdupq_n_u64(key);
+	for(k = 0; k + 4 <= n; k += 4)
+	{
+		vst1q_u64((uint64_t *)&dst[k],
+			veorq_u64(vld1q_u64((uint64_t *)&src[k]), kv));
+		vst1q_u64((uint64_t *)&dst[k + 2],
+			veorq_u64(vld1q_u64((uint64_t *)&src[k + 2]), kv));
+	}
+	xor_scalar(&dst[k], &src[k], n - k, key);
+}
+#endif
+
+#ifdef HAVE_ALTIVEC_KERNEL
+static void
+xor_altivec(unsigned long long *dst, unsigned long long *src, long long n,
+	unsigned long long key)
+{
+	__vector unsigned int kv;
+	long long k;
+
+	k = 0;
+	if((((unsigned long)dst | (unsigned long)src) & 15) == 0)
+	{
+		kv = altivec_pair(key, key);
+		for(; k + 4 <= n; k += 4)
+		{
+			vec_st(vec_xor(vec_ld(0, (unsigned int *)&src[k]), kv),
+				0, (unsigned int *)&dst[k]);
+			vec_st(vec_xor(vec_ld(16, (unsigned int *)&src[k]), kv),
+				16, (unsigned int *)&dst[k]);
+		}
+	}
+	xor_scalar(&dst[k], &src[k], n - k, key);
+}
+#endif
+
+#ifdef HAVE_ANSIC_C
+void (*fill_words)(unsigned long long *, long long, unsigned long long,
+	unsigned long long) = fill_scalar;
+long long (*cmp_words)(unsigned long long *, long long, unsigned long long,
+	unsigned long long) = cmp_scalar;
+void (*xor_words)(unsigned long long *, unsigned long long *, long long,
+	unsigned long long) = xor_scalar;
+#else
+void (*fill_words)() = fill_scalar;
+long long (*cmp_words)() = cmp_scalar;
+void (*xor_words)() = xor_scalar;
+#endif
+
+#ifdef HAVE_ANSIC_C
+void
+select_kernels(void)
+#else
+void
+select_kernels()
+#endif
+{
+#ifdef HAVE_SSE2_KERNEL
+	fill_words = fill_sse2;
+	cmp_words = cmp_sse2;
+	xor_words = xor_sse2;
+	kernel_name = "sse2";
+#endif
+#ifdef HAVE_AVX2_KERNEL
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+	{
+		fill_words = fill_avx2;
+		cmp_words = cmp_avx2;
+		xor_words = xor_avx2;
+		kernel_name = "avx2";
+	}
+#endif
+#ifdef HAVE_NEON_KERNEL
+	fill_words = fill_neon;
+	cmp_words = cmp_neon;
+	xor_words = xor_neon;
+	kernel_name = "neon";
+#endif
+#ifdef HAVE_ALTIVEC_KERNEL
+	fill_words = fill_altivec;
+	cmp_words = cmp_altivec;
+	xor_words = xor_altivec;
+	kernel_name = "altivec";
+#endif
+}
+
 /************************************************************************/
 /* Verify that the buffer contains expected pattern			*/
 /************************************************************************/
@@ -7674,7 +9118,6 @@ char sverify;
 	char *where2;
 	char *pattern_ptr;
 	long long mpattern,xx2;
-	unsigned int seed;
 	unsigned long x;
 	unsigned long long value,value1;
 	unsigned long long a= 0x01020304;
@@ -7682,6 +9125,8 @@ char sverify;
 	unsigned long long c= 0x01010101;
 	unsigned long long d = 0x01010101;
 	unsigned long long pattern_buf;
+	unsigned long long first,step;
+	long long words,bad;
 	int lite = 1;	/* Only validate 1 long when running 
 			   de-deup validation */
 
@@ -7705,6 +9150,21 @@ char sverify;
 	  }
 	  return(0);
 	}
+	if(reduce_flag)
+	{
+		file_position=gen_reduce_buf((char *)buffer,length,recnum,1);
+		if(file_position < 0)
+			return(0);
+		if(!silent)
+#ifdef NO_PRINT_LLD
+		   printf("\nData reduction mis-compare in chunk at %ld\n",
+			(long)((recnum*recsize)+file_position));
+#else
+		   printf("\nData reduction mis-compare in chunk at %lld\n",
+			(long long)((recnum*recsize)+file_position));
+#endif
+		return(1);
+	}
 	if(dedup)
 	{
 		gen_new_buf((char *)dedup_ibuf,(char *)dedup_temp, (long)recnum, (int)length,(int)dedup, (int) dedup_interior, dedup_compress, 0);
@@ -7734,10 +9194,8 @@ char sverify;
 	{
 		if(no_unlink)
 			base_time=0;
-		seed= (unsigned int)(base_time+xx2+recnum);
-	        srand(seed);
-	        mpattern=(long long)rand();
-	        mpattern=(mpattern<<48) | (mpattern<<32) | (mpattern<<16) | mpattern;
+		mpattern=(long long)counter_rand((unsigned long long)base_time,
+			(unsigned long long)xx2,(unsigned long long)recnum);
 		mpattern=mpattern+value;
 	}
 
@@ -7774,22 +9232,25 @@ char sverify;
 	}
 	if(sverify == 0)
 	{
-	  for(i=0;i<(length/cache_line_size);i++)
+	  words=(length/cache_line_size)*(cache_line_size/sizeof(long long));
+	  if(diag_v)
 	  {
-	   for(j=0;j<(cache_line_size/sizeof(long long));j++)
-	   {
-              if(diag_v)
-	      {
-		 pattern_buf=mpattern;
-	      }
-	      else
-              {
-		pattern_buf= mpattern<<32 | mpattern;
-	      }
-
+		first=(unsigned long long)mpattern;
+		step=value1;
+	  }
+	  else
+	  {
+		first=(unsigned long long)(mpattern<<32 | mpattern);
+		step=0;
+	  }
+	  bad=cmp_words((unsigned long long *)buffer,words,first,step);
+	  if(bad >= 0)
+	  {
+	      i=bad/(cache_line_size/sizeof(long long));
+	      j=bad%(cache_line_size/sizeof(long long));
+	      where=(unsigned long long *)buffer+bad;
+	      pattern_buf=first+(unsigned long long)bad*step;
 	      pattern_ptr =(char *)&pattern_buf;
-
-	      if(*where != (unsigned long long)pattern_buf)
 	      {
 		   file_position = (off64_t)( (recnum * recsize))+
 			((i*cache_line_size)+(j*sizeof(long long)));
@@ -7815,10 +9276,6 @@ char sverify;
 	printf("Found pattern: Hex >>%x<< Expecting >>%x<<\n", *where2,*pattern_ptr);
 		   return(1);
 	      }
-	      where++;
-	      if(diag_v)
-	         mpattern=mpattern+value1;
-	   }	
 	  }
 	}
 	return(0);
@@ -7840,9 +9297,8 @@ char sverify;
 #endif
 {
 	unsigned long long *where;
-	long long i,j,xx2;
+	long long i,xx2,words;
 	long long mpattern;
-	unsigned int seed;
 	unsigned long x;
 	unsigned long long value,value1;
 	unsigned long long a = 0x01020304;
@@ -7859,6 +9315,11 @@ char sverify;
 	x=0;
 	mpattern=pattern;
 	/* printf("Fill: Sverify %d verify %d diag_v %d\n",sverify,verify,diag_v);*/
+	if(reduce_flag)
+	{
+		gen_reduce_buf(buffer,length,recnum,0);
+		return;
+	}
 	if(dedup)
 	{
 		gen_new_buf((char *)dedup_ibuf,(char *)buffer, (long)recnum, (int)length,(int)dedup, (int) dedup_interior, dedup_compress, 1);
@@ -7871,10 +9332,8 @@ char sverify;
 		*/
 		if(no_unlink)
 			base_time=0;
-		seed= (unsigned int)(base_time+xx2+recnum);
-	        srand(seed);
-		mpattern=(long long)rand();
-		mpattern=(mpattern<<48) | (mpattern<<32) | (mpattern<<16) | mpattern;
+		mpattern=(long long)counter_rand((unsigned long long)base_time,
+			(unsigned long long)xx2,(unsigned long long)recnum);
 		mpattern=mpattern+value;
 	}
 	where=(unsigned long long *)buffer;
@@ -7889,20 +9348,12 @@ char sverify;
 	}
 	else
 	{
-		for(i=0;i<(length/cache_line_size);i++)
-		{
-			for(j=0;j<(cache_line_size/sizeof(long long));j++)
-			{
-				if(diag_v)
-				{
-					*where = (long long)(mpattern);
-					mpattern=mpattern+value1;
-				}
-				else
-					*where = (long long)((pattern<<32) | pattern);
-				where++;
-			}	
-		}
+		words=(length/cache_line_size)*(cache_line_size/sizeof(long long));
+		if(diag_v)
+			fill_words(where,words,(unsigned long long)mpattern,value1);
+		else
+			fill_words(where,words,
+				(unsigned long long)((pattern<<32) | pattern),0);
 	}
 }
 
@@ -8323,8 +9774,9 @@ long long *data2;
 			}
 			if(async_flag && no_copy_flag)
 			{
-				free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-				nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
+#ifdef ASYNC_IO
+				free_addr=nbuff=async_write_buffer(gc,reclen,depth);
+#endif
 				if(verify || dedup || dedup_interior)
 					fill_buffer(nbuff,reclen,(long long)pattern,sverify,i);
 				if(purge)
@@ -8370,7 +9822,7 @@ long long *data2;
 			    else
 			    {
 #endif
-			    wval=write(fd, pbuff, (size_t ) reclen);
+			    wval=I_WRITE(fd, pbuff, reclen);
 			    if(wval != reclen)
 			    {
 #ifdef NO_PRINT_LLD
@@ -8393,7 +9845,7 @@ long long *data2;
 			{
 				qtime_stop=time_so_far();
 				hist_time =(qtime_stop-qtime_start-time_res);
-				hist_insert(hist_time);
+				hist_insert(0,hist_time);
 			}
 			if(Q_flag)
 			{
@@ -8656,8 +10108,13 @@ long long *data2;
 #endif
 		fd=fileno(stream);
 		fsync(fd);
-		setvbuf(stream,stdio_buf,_IOFBF,reclen);
+		if(direct_flag)
+			setvbuf(stream,stdio_buf,_IONBF,reclen);
+		else
+			setvbuf(stream,stdio_buf,_IOFBF,reclen);
 		buffer=mainbuffer;
+		if(direct_flag)
+			dio_stdio(fd,buffer,reclen);
 		if(fetchon)
 			fetchit(buffer,reclen);
 		if(verify || dedup || dedup_interior)
@@ -8865,8 +10322,13 @@ long long *data1,*data2;
 		fd=I_OPEN(filename,O_RDONLY,0);
 		fsync(fd);
 		close(fd);
-		setvbuf(stream,stdio_buf,_IOFBF,reclen);
+		if(direct_flag)
+			setvbuf(stream,stdio_buf,_IONBF,reclen);
+		else
+			setvbuf(stream,stdio_buf,_IOFBF,reclen);
 		buffer=mainbuffer;
+		if(direct_flag)
+			dio_stdio(fileno(stream),buffer,reclen);
 		if(fetchon)
 			fetchit(buffer,reclen);
 		compute_val=(double)0;
@@ -8993,87 +10455,329 @@ long long *data1,*data2;
 #endif
 }
 
+#ifdef HAVE_ZCOPY
 /************************************************************************/
-/* read_perf_test				        		*/
-/* Read and re-fread test						*/
+/* zcopy_drain()							*/
+/* Empties the reading end of the sendfile() socketpair into /dev/null	*/
+/* through a pipe, so the consumer side stays in the kernel as well.	*/
 /************************************************************************/
 #ifdef HAVE_ANSIC_C
-void 
-read_perf_test(off64_t kilo64,long long reclen,long long *data1,long long *data2)
+static void
+zcopy_drain(int sock, int *pfd, int nullfd)
 #else
-void 
-read_perf_test(kilo64,reclen,data1,data2)
+static void
+zcopy_drain(sock, pfd, nullfd)
+int sock;
+int *pfd;
+int nullfd;
+#endif
+{
+	ssize_t got, put;
+
+	for(;;)
+	{
+		got = splice(sock, 0, pfd[1], 0, (size_t)(1024*1024),
+			SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+		if(got < 0 && errno == EINVAL)
+			/* Old kernels can not splice from AF_UNIX */
+			got = recv(sock, mainbuffer, (size_t)MAXBUFFERSIZE,
+				MSG_DONTWAIT);
+		else while(got > 0 && (put = splice(pfd[0], 0, nullfd, 0,
+			(size_t)got, SPLICE_F_MOVE)) > 0)
+			got -= put;
+		if(got <= 0)
+			return;
+	}
+}
+
+/************************************************************************/
+/* zcopy_perf_test							*/
+/* Zero-copy transfers of the test file. sendfile() into a local	*/
+/* socketpair, splice() through a pipe into /dev/null, and		*/
+/* copy_file_range() into a second file. Needs the file from -i 0.	*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+void zcopy_perf_test(off64_t kilo64,long long reclen,long long *data1,long long *data2)
+#else
+void zcopy_perf_test(kilo64,reclen,data1,data2)
 off64_t kilo64;
 long long reclen;
 long long *data1,*data2;
 #endif
 {
 	double starttime2;
-	double compute_val = (double)0;
-	double readtime[2];
-	double walltime[2], cputime[2];
-#ifdef unix
-	double qtime_u_start,qtime_u_stop;
-	double qtime_s_start,qtime_s_stop;
-#endif
-	long long j;
-	long long traj_size;
-	off64_t i,numrecs64,traj_offset;
-	off64_t lock_offset=0;
-	long long Index = 0;
-	unsigned long long readrate[2];
-	off64_t filebytes64;
-	volatile char *buffer1;
-	char *nbuff;
-	char *maddr;
-	char *wmaddr;
-	int fd,open_flags;
-	int test_foo,ltest;
-	long wval;
-	double qtime_start,qtime_stop;
-	double hist_time;
-#ifdef ASYNC_IO
-	struct cache *gc=0;
+	double xfertime[3];
+	double walltime[3], cputime[3];
+	unsigned long long xferrate[3];
+	off64_t numrecs64,filebytes64;
+	off64_t in_off,out_off;
+	long long j,len;
+	ssize_t got,put,left;
+	int fd,outfd,nullfd,unsup = 0;
+	int sv[2],pfd[2];
+	char zname[MAXNAMESIZE+4];
 
-#else
-/* igorv long long *gc=0; */
-#endif
-
-#ifdef unix
-	qtime_u_start=qtime_u_stop=0;
-	qtime_s_start=qtime_s_stop=0;
-#endif
-	hist_time=qtime_start=qtime_stop=0;
-	maddr=0;
-	traj_offset=0;
-	test_foo=0;
 	numrecs64 = (kilo64*1024)/reclen;
-
-	open_flags = O_RDONLY;
-#if defined(_HPUX_SOURCE) || defined(linux)
-	if(read_sync)
-		open_flags |=O_RSYNC|O_SYNC;
-#endif
-#if ! defined(DONT_HAVE_O_DIRECT)
-#if defined(linux) || defined(__AIX__) || defined(IRIX) || defined(IRIX64) || defined(Windows) || defined (__FreeBSD__)
-	if(direct_flag)
-		open_flags |=O_DIRECT;
-#endif
-#if defined(TRU64)
-	if(direct_flag)
-		open_flags |=O_DIRECTIO;
-#endif
-#endif
-	if(r_traj_flag)
+	filebytes64 = numrecs64*reclen;
+	sprintf(zname,"%s.zc",filename);
+	if((nullfd=open("/dev/null",O_WRONLY)) < 0 || pipe(pfd) < 0)
 	{
-		numrecs64=r_traj_ops;
-		filebytes64 = r_traj_fsize;
-	} else
-		filebytes64 = numrecs64*reclen;
-	fd = 0;
-	if(Q_flag && (!rol_opened))
+		perror("zcopy setup");
+		exit(187);
+	}
+#ifdef F_SETPIPE_SZ
+	/* Let one record fit in the pipe, the kernel caps this itself */
+	if(reclen > 65536)
+		fcntl(pfd[1],F_SETPIPE_SZ,(int)reclen);
+#endif
+
+	for(j=0;j<3;j++)
 	{
-		rol_opened++;
+		if(Uflag) /* Unmount and re-mount the mountpoint */
+		{
+			purge_buffer_cache();
+		}
+		if((fd=I_OPEN(filename,(int)O_RDONLY,0))<0)
+		{
+			printf("\nCan not open temporary file %s for read\n",filename);
+			perror("open");
+			exit(188);
+		}
+		outfd = -1;
+		if(j==0)
+		{
+			if(socketpair(AF_UNIX,SOCK_STREAM,0,sv) < 0)
+			{
+				perror("socketpair");
+				exit(187);
+			}
+			fcntl(sv[0],F_SETFL,O_NONBLOCK);
+		}
+		if(j==2 && (outfd=I_CREAT(zname,0640)) < 0)
+		{
+			printf("\nCan not create %s\n",zname);
+			perror("creat");
+			exit(188);
+		}
+		if(cpuutilflag)
+		{
+			walltime[j] = time_so_far();
+			cputime[j]  = cputime_so_far();
+		}
+		starttime2 = time_so_far();
+		in_off = out_off = 0;
+		while(in_off < filebytes64)
+		{
+			len = filebytes64 - in_off;
+			if(len > reclen)
+				len = reclen;
+			switch(j)
+			{
+			case 0:
+				/* sendfile() advances in_off */
+				got = sendfile(sv[0],fd,&in_off,(size_t)len);
+				zcopy_drain(sv[1],pfd,nullfd);
+				if(got < 0 && errno == EAGAIN)
+					continue;	/* Socket was full, drained now */
+				break;
+			case 1:
+				got = splice(fd,&in_off,pfd[1],0,(size_t)len,
+					SPLICE_F_MOVE);
+				for(left = got; left > 0; left -= put)
+					if((put = splice(pfd[0],0,nullfd,0,
+						(size_t)left,SPLICE_F_MOVE)) <= 0)
+					{
+						got = -1;
+						break;
+					}
+				break;
+			default:
+				got = copy_file_range(fd,&in_off,outfd,&out_off,
+					(size_t)len,0);
+				break;
+			}
+			if(got < 0 && j == 2 && (errno == EXDEV ||
+				errno == EOPNOTSUPP || errno == ENOSYS))
+			{
+				/* Not on this filesystem, report zero */
+				unsup = 1;
+				break;
+			}
+			if(got < 0)
+			{
+#ifdef NO_PRINT_LLD
+				printf("\nError in zero-copy test %ld at offset %ld\n",
+					j,in_off);
+#else
+				printf("\nError in zero-copy test %lld at offset %lld\n",
+					j,(long long)in_off);
+#endif
+				perror(j==0 ? "sendfile" : (j==1 ? "splice" :
+					"copy_file_range"));
+				exit(189);
+			}
+			if(got == 0)
+				break;		/* File shorter than expected */
+		}
+		if(include_flush && outfd >= 0)
+			fsync(outfd);
+		if(include_close)
+		{
+			close(fd);
+			if(outfd >= 0)
+				close(outfd);
+		}
+		xfertime[j] = ((time_so_far() - starttime2)-time_res);
+		if(xfertime[j] < (double).000001) 
+		{
+			xfertime[j]= time_res;
+			if(rec_prob < reclen)
+				rec_prob = reclen;
+			res_prob=1;
+		}
+		if(cpuutilflag)
+		{
+			cputime[j]  = cputime_so_far() - cputime[j];
+			if (cputime[j] < cputime_res)
+				cputime[j] = 0.0;
+			walltime[j] = time_so_far() - walltime[j];
+			if (walltime[j] < cputime[j])
+			   walltime[j] = cputime[j];
+		}
+		if(!include_close)
+		{
+			close(fd);
+			if(outfd >= 0)
+				close(outfd);
+		}
+		if(j==0)
+		{
+			close(sv[0]);
+			close(sv[1]);
+		}
+		if(restf)
+			sleep((int)rest_val);
+	}
+	unlink(zname);
+	close(pfd[0]);
+	close(pfd[1]);
+	close(nullfd);
+	if(OPS_flag || MS_flag){
+	   filebytes64=filebytes64/reclen;
+	}
+	for(j=0;j<3;j++)
+	{
+		if(MS_flag)
+		{
+			xferrate[j]=1000000.0*(xfertime[j] / (double)filebytes64);
+			continue;
+		}
+		xferrate[j] = 
+		      (unsigned long long) ((double) filebytes64 / xfertime[j]);
+		if(j == 2 && unsup)
+			xferrate[j] = 0;
+		if(!(OPS_flag || MS_flag))
+			xferrate[j] >>= 10;
+	}
+	data1[0]=xferrate[0];
+	data2[0]=1;
+	/* Must save walltime & cputime before calling store_value() for each/any cell.*/
+	for(j=0;j<3;j++)
+	{
+		if(cpuutilflag)
+			store_times(walltime[j], cputime[j]);
+		store_value((off64_t)xferrate[j]);
+	}
+#ifdef NO_PRINT_LLD
+	if(!silent) printf("%10ld%10ld%10ld",xferrate[0],xferrate[1],xferrate[2]);
+#else
+	if(!silent) printf("%10lld%10lld%10lld",xferrate[0],xferrate[1],xferrate[2]);
+#endif
+	if(!silent) fflush(stdout);
+}
+#endif /* HAVE_ZCOPY */
+
+/************************************************************************/
+/* read_perf_test				        		*/
+/* Read and re-fread test						*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+void 
+read_perf_test(off64_t kilo64,long long reclen,long long *data1,long long *data2)
+#else
+void 
+read_perf_test(kilo64,reclen,data1,data2)
+off64_t kilo64;
+long long reclen;
+long long *data1,*data2;
+#endif
+{
+	double starttime2;
+	double compute_val = (double)0;
+	double readtime[2];
+	double walltime[2], cputime[2];
+#ifdef unix
+	double qtime_u_start,qtime_u_stop;
+	double qtime_s_start,qtime_s_stop;
+#endif
+	long long j;
+	long long traj_size;
+	off64_t i,numrecs64,traj_offset;
+	off64_t lock_offset=0;
+	long long Index = 0;
+	unsigned long long readrate[2];
+	off64_t filebytes64;
+	volatile char *buffer1;
+	char *nbuff;
+	char *maddr;
+	char *wmaddr;
+	int fd,open_flags;
+	int test_foo,ltest;
+	long wval;
+	double qtime_start,qtime_stop;
+	double hist_time;
+#ifdef ASYNC_IO
+	struct cache *gc=0;
+
+#else
+/* igorv long long *gc=0; */
+#endif
+
+#ifdef unix
+	qtime_u_start=qtime_u_stop=0;
+	qtime_s_start=qtime_s_stop=0;
+#endif
+	hist_time=qtime_start=qtime_stop=0;
+	maddr=0;
+	traj_offset=0;
+	test_foo=0;
+	numrecs64 = (kilo64*1024)/reclen;
+
+	open_flags = O_RDONLY;
+#if defined(_HPUX_SOURCE) || defined(linux)
+	if(read_sync)
+		open_flags |=O_RSYNC|O_SYNC;
+#endif
+#if ! defined(DONT_HAVE_O_DIRECT)
+#if defined(linux) || defined(__AIX__) || defined(IRIX) || defined(IRIX64) || defined(Windows) || defined (__FreeBSD__)
+	if(direct_flag)
+		open_flags |=O_DIRECT;
+#endif
+#if defined(TRU64)
+	if(direct_flag)
+		open_flags |=O_DIRECTIO;
+#endif
+#endif
+	if(r_traj_flag)
+	{
+		numrecs64=r_traj_ops;
+		filebytes64 = r_traj_fsize;
+	} else
+		filebytes64 = numrecs64*reclen;
+	fd = 0;
+	if(Q_flag && (!rol_opened))
+	{
+		rol_opened++;
 		rqfd=fopen("rol.dat","a");
 		if(rqfd==0)
 		{
@@ -9183,7 +10887,7 @@ long long *data1,*data2;
 		if(!unbuffered)
 		{
 #endif
-		if(read(fd, (void *)nbuff, (size_t) reclen) != reclen)
+		if(I_READ(fd, nbuff, reclen) != reclen)
 		{
 #ifdef _64BIT_ARCH_
 			printf("\nError reading block %d %llx\n", 0,
@@ -9301,7 +11005,7 @@ long long *data1,*data2;
 			    }
 			    else
 #endif
-			      wval=read((int)fd, (void*)nbuff, (size_t) reclen);
+			      wval=I_READ(fd, nbuff, reclen);
 			    if(wval != reclen)
 			    {
 #ifdef _64BIT_ARCH_
@@ -9349,7 +11053,7 @@ long long *data1,*data2;
 			{
 				qtime_stop=time_so_far();
 				hist_time =(qtime_stop-qtime_start-time_res);
-				hist_insert(hist_time);
+				hist_insert(0,hist_time);
 			}
 			if(Q_flag)
 			{
@@ -9526,10 +11230,6 @@ long long *data1, *data2;
 	double starttime2;
 	double walltime[2], cputime[2];
 	double compute_val = (double)0;
-#if defined (bsd4_2) || defined(Windows)
-	long long rand1,rand2,rand3;
-#endif
-	unsigned long long big_rand;
 	long long j;
 	off64_t i,numrecs64;
 	long long Index=0;
@@ -9543,7 +11243,8 @@ long long *data1, *data2;
 	char *wmaddr,*nbuff;
 	char *maddr,*free_addr;
 	int fd,wval;
-	long long *recnum= 0;
+	struct perm recnum;
+	struct dist_walk walk;
 #if defined(VXFS) || defined(solaris)
 	int test_foo=0;
 #endif
@@ -9551,65 +11252,13 @@ long long *data1, *data2;
 	struct cache *gc=0;
 #else
 /* igorv	long long *gc=0; */
-#endif
-#ifdef MERSENNE
-    unsigned long long init[4]={0x12345ULL, 0x23456ULL, 0x34567ULL, 0x45678ULL};
-    unsigned long long length=4;
 #endif
 
 	maddr=free_addr=0;
 	numrecs64 = (kilo64*1024)/reclen;
-#ifdef MERSENNE
-       init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-        srand(0);
-#else
-#ifdef Windows
-        srand(0);
-#else
-        srand48(0);
-#endif
-#endif
-#endif
-        recnum = (long long *)malloc(sizeof(*recnum)*numrecs64);
-        if (recnum){
-             /* pre-compute random sequence based on 
-		Fischer-Yates (Knuth) card shuffle */
-            for(i = 0; i < numrecs64; i++){
-                recnum[i] = i;
-            }
-            for(i = 0; i < numrecs64; i++) {
-                long long tmp;
-#ifdef MERSENNE
-      	       big_rand=genrand64_int64();
-#else
-#ifdef bsd4_2
-               rand1=(long long)rand();
-               rand2=(long long)rand();
-               rand3=(long long)rand();
-               big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-#else
-#ifdef Windows
-               rand1=(long long)rand();
-               rand2=(long long)rand();
-               rand3=(long long)rand();
-               big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-#else
-               big_rand = lrand48();
-#endif
-#endif
-#endif
-               big_rand = big_rand%numrecs64;
-               tmp = recnum[i];
-               recnum[i] = recnum[big_rand];
-               recnum[big_rand] = tmp;
-            }
-        }
-	else
-	{
-		fprintf(stderr,"Random uniqueness fallback.\n");
-	}
+	/* Every record once, in the same random order on each pass */
+	perm_init(&recnum,(unsigned long long)numrecs64,PERMSEED);
+	dist_setup((unsigned long long)numrecs64);
 	flags = O_RDWR;
 #if ! defined(DONT_HAVE_O_DIRECT)
 #if defined(linux) || defined(__AIX__) || defined(IRIX) || defined(IRIX64) || defined(Windows) || defined (__FreeBSD__)
@@ -9690,19 +11339,7 @@ long long *data1, *data2;
 	     nbuff=mainbuffer;
 	     if(fetchon)
 		   fetchit(nbuff,reclen);
-#ifdef MERSENNE
-    	    init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-	     srand(0);
-#else
-#ifdef Windows
-             srand(0);
-#else
-             srand48(0);
-#endif
-#endif
-#endif
+	     dist_start(&walk,0);
 	     compute_val=(double)0;
 	     starttime2 = time_so_far();
 	     if ( j==0 ){
@@ -9718,35 +11355,8 @@ long long *data1, *data2;
                         }
 			if(purge)
 				purgeit(nbuff,reclen);
-                        if (recnum) {
-				offset64 = reclen * (long long)recnum[i];
-                        }
-			else
-			{
-
-#ifdef MERSENNE
-      			   big_rand =genrand64_int64();
-			   offset64 = reclen * (big_rand%numrecs64);
-#else
-#ifdef bsd4_2
-			   rand1=(long long)rand();
-			   rand2=(long long)rand();
-			   rand3=(long long)rand();
-			   big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-                           offset64 = reclen * (big_rand%numrecs64);
-#else
-#ifdef Windows
-			   rand1=(long long)rand();
-			   rand2=(long long)rand();
-			   rand3=(long long)rand();
-			   big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-                           offset64 = reclen * (big_rand%numrecs64);
-#else
-			   offset64 = reclen * (lrand48()%numrecs64);
-#endif
-#endif
-#endif
-			}
+			offset64 = reclen * (long long)dist_record(&walk,&recnum,
+				(unsigned long long)i);
 
 			if( !(h_flag || k_flag || mmapflag))
 			{
@@ -9782,7 +11392,7 @@ long long *data1, *data2;
 			  }
 			  else
 			  {
-		  	     if(read(fd, (void *)nbuff, (size_t)reclen) != reclen)
+		  	     if(I_READ(fd, nbuff, reclen) != reclen)
 		  	     {
 #ifdef NO_PRINT_LLD
 				 printf("\nError reading block at %ld\n",
@@ -9839,33 +11449,13 @@ long long *data1, *data2;
                                	         Index=0;
                                	    nbuff = mbuffer + Index;
                         	}
-                                if (recnum) {
-				  offset64 = reclen * (long long)recnum[i];
-                                }
-			        else
-			        {
-#ifdef bsd4_2
-				  rand1=(long long)rand();
-				  rand2=(long long)rand();
-				  rand3=(long long)rand();
-				  big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-				  offset64 = reclen * (big_rand%numrecs64);
-#else
-#ifdef Windows
-				  rand1=(long long)rand();
-				  rand2=(long long)rand();
-				  rand3=(long long)rand();
-				  big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-				  offset64 = reclen * (big_rand%numrecs64);
-#else
-				  offset64 = reclen * (lrand48()%numrecs64);
-#endif
-#endif
-				}
+				offset64 = reclen * (long long)dist_record(&walk,&recnum,
+					(unsigned long long)i);
 				if(async_flag && no_copy_flag)
 				{
-					free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-					nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
+#ifdef ASYNC_IO
+					free_addr=nbuff=async_write_buffer(gc,reclen,depth);
+#endif
 					if(verify || dedup || dedup_interior)
 						fill_buffer(nbuff,reclen,(long long)pattern,sverify,offset64/reclen);
 				}
@@ -9911,7 +11501,7 @@ long long *data1, *data2;
 			  		}
 			  		else
 			  		{
-			  		  wval=write(fd, nbuff,(size_t)reclen);
+			  		  wval=I_WRITE(fd, nbuff, reclen);
 			  		  if(wval != reclen)
 			  		  {
 #ifdef NO_PRINT_LLD
@@ -10048,8 +11638,6 @@ long long *data1, *data2;
 	if(!silent) printf("%8lld",randreadrate[1]);
 	if(!silent) fflush(stdout);
 #endif
-	if(recnum)
-		free(recnum);
 }
 
 /************************************************************************/
@@ -10229,7 +11817,7 @@ long long *data1,*data2;
 #endif
 			}else
 			{
-				if(read((int)fd, (void*)nbuff, (size_t) reclen) != reclen)
+				if(I_READ(fd, nbuff, reclen) != reclen)
 				{
 #ifdef NO_PRINT_LLD
 					printf("\nError reading block %ld\n", i); 
@@ -10515,8 +12103,9 @@ long long *data1,*data2;
                 }
 		if(async_flag && no_copy_flag)
 		{
-			free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-			nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
+#ifdef ASYNC_IO
+			free_addr=nbuff=async_write_buffer(gc,reclen,depth);
+#endif
 			if(verify || dedup || dedup_interior)
 				fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)0);
 		}
@@ -10549,7 +12138,7 @@ long long *data1,*data2;
 			  }
 			  else
 			  {
-			       wval=write(fd, nbuff, (size_t) reclen);
+			       wval=I_WRITE(fd, nbuff, reclen);
 			       if(wval != reclen)
 			       {
 #ifdef NO_PRINT_LLD
@@ -10831,7 +12420,7 @@ long long *data1, *data2;
 		   	}
 			else
 			{
-		   	  if((uu=read((int)fd, (void*)nbuff, (size_t) reclen)) != reclen)
+		   	  if((uu=I_READ(fd, nbuff, reclen)) != reclen)
 		   	  {
 #ifdef NO_PRINT_LLD
 		    		printf("\nError reading block %ld, fd= %d Filename %s Read returned %ld\n", i, fd,filename,uu);
@@ -11552,9 +13141,6 @@ long long *data1,*data2;
 #endif
 	long long flags_here;
 	char *nbuff;
-#ifdef MERSENNE
-        unsigned long long init[4]={0x12345ULL, 0x23456ULL, 0x34567ULL, 0x45678ULL}, length=4;
-#endif
 
 	numrecs64 = (kilos64*1024)/reclen;
 	filebytes64 = numrecs64*reclen;
@@ -11638,23 +13224,10 @@ long long *data1,*data2;
 		mbuffer=mainbuffer;
 		if(fetchon)
 			fetchit(nbuff,reclen);
-		numvecs=PVECMAX;
+		numvecs=vec_count ? vec_count : PVECDEF;
                 if(numrecs64 < numvecs) numvecs=numrecs64;
-                if(MAXBUFFERSIZE/reclen < PVECMAX) numvecs=MAXBUFFERSIZE/reclen;
+                if(MAXBUFFERSIZE/reclen < numvecs) numvecs=MAXBUFFERSIZE/reclen;
 
-#ifdef MERSENNE
-    	        init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-	        srand(0);
-#else
-#ifdef Windows
-                srand(0);
-#else
-	        srand48(0);
-#endif
-#endif
-#endif
 		starttime1 = time_so_far();
 	        compute_val=(double)0;
 		for(i=0; i<numrecs64; i+=numvecs){
@@ -11662,7 +13235,8 @@ long long *data1,*data2;
 				compute_val+=do_compute(compute_time);
 			if((numrecs64-i) < numvecs) 
 				numvecs=numrecs64-i;
-			create_list((long long *)list_off, reclen, numrecs64);
+			create_list((long long *)list_off, reclen, numrecs64, i,
+				numvecs);
 			for(xx=0;xx<numvecs;xx++)
 			{
 				piov[xx].piov_base = 
@@ -11794,73 +13368,40 @@ long long *data1,*data2;
 #ifdef HAVE_PREADV
 /**************************************************************************/
 /* create_list() 							  */
-/* Creates a list of PVECMAX entries that are unique (non over lapping ). */
+/* Creates a list of numvecs entries that are unique (non over lapping ). */
 /* Each of these offsets are then used in a vector (preadv/pwritev)	  */
+/* The entries are positions start .. start+numvecs-1 of a permutation	  */
+/* of the file's records, so successive lists cover every record once.	  */
+/* With -+v :seq the records are simply start .. start+numvecs-1.	  */
 /**************************************************************************/
 #ifdef HAVE_ANSIC_C
-void create_list(long long *list_off, long long reclen, off64_t numrecs64)
+void create_list(long long *list_off, long long reclen, off64_t numrecs64,
+	off64_t start, long long numvecs)
 #else
-void create_list(list_off, reclen, numrecs64)
+void create_list(list_off, reclen, numrecs64, start, numvecs)
 long long *list_off;
 long long reclen; 
 off64_t numrecs64;
+off64_t start;
+long long numvecs;
 #endif
 {
-	long long found,i,j;
-	long long numvecs;
-	unsigned long long big_rand = -1;
-#if defined (bsd4_2) || defined(Windows)
-	long long rand1,rand2,rand3;
-#endif
+	long long j;
+	struct perm order;
 
-	numvecs = PVECMAX;
 	if(numrecs64< numvecs)
 		numvecs = numrecs64;
-	for(j=0;j<numvecs;j++)
-		list_off[j]=0;	
-	for(j=0;j<numvecs;j++)
+	if(vec_count && !vec_random)
 	{
-again:
-		found = 0;
-#ifdef MERSENNE
-                big_rand = genrand64_int64();
-		offset64 = reclen * (big_rand%numrecs64);
-#else
-#ifdef bsd4_2
-		rand1=(long long)rand();
-		rand2=(long long)rand();
-		rand3=(long long)rand();
-		big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-		offset64 = reclen * (big_rand%numrecs64);
-#else
-#ifdef Windows
-		rand1=(long long)rand();
-		rand2=(long long)rand();
-		rand3=(long long)rand();
-		big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-		offset64 = reclen * (big_rand%numrecs64);
-#else
-		offset64 = reclen * (lrand48()%numrecs64);
-#endif
-#endif
-#endif
-
-		for(i=0;i<j;i++)
-		{
-			if(list_off[i] == offset64)
-			{
-				found++;
-				break;
-			}
-		}
-		if(!found)
-			list_off[j]=offset64;
-		else
-		{
-			goto again;
-		}
-	}
-}
+		for(j=0;j<numvecs;j++)
+			list_off[j] = reclen * (long long)(start + j);
+		return;
+	}
+	perm_init(&order,(unsigned long long)numrecs64,PERMSEED);
+	for(j=0;j<numvecs;j++)
+		list_off[j] = reclen * (long long)perm_index(&order,
+			(unsigned long long)(start + j));
+}
 #endif
 
 #ifdef HAVE_PREADV
@@ -11891,9 +13432,6 @@ long long *data1,*data2;
 	int test_foo = 0;
 #endif
 	char *nbuff;
-#ifdef MERSENNE
-        unsigned long long init[4]={0x12345ULL, 0x23456ULL, 0x34567ULL, 0x45678ULL}, length=4;
-#endif
 
 	open_flags=O_RDONLY;
 #if ! defined(DONT_HAVE_O_DIRECT)
@@ -11966,23 +13504,10 @@ long long *data1,*data2;
 		mbuffer=mainbuffer;
 		if(fetchon)
 			fetchit(nbuff,reclen);
-		numvecs=PVECMAX;
+		numvecs=vec_count ? vec_count : PVECDEF;
                 if(numrecs64 < numvecs) numvecs=numrecs64;
-                if(MAXBUFFERSIZE/reclen < PVECMAX) numvecs=MAXBUFFERSIZE/reclen;
+                if(MAXBUFFERSIZE/reclen < numvecs) numvecs=MAXBUFFERSIZE/reclen;
 
-#ifdef MERSENNE
-    	       init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-	        srand(0);
-#else
-#ifdef Windows
-                srand(0);
-#else
-	        srand48(0);
-#endif
-#endif
-#endif
 		starttime2 = time_so_far();
 	        compute_val=(double)0;
 		for(i=0; i<(numrecs64); i+=numvecs) 
@@ -11991,7 +13516,8 @@ long long *data1,*data2;
 				compute_val+=do_compute(compute_time);
 			if((numrecs64-i) < numvecs) 
 				numvecs=numrecs64-i;
-			create_list((long long *)list_off, reclen, numrecs64);
+			create_list((long long *)list_off, reclen, numrecs64, i,
+				numvecs);
 			for(xx=0;xx<numvecs;xx++)
 			{
 				piov[xx].piov_base = 
@@ -12261,6 +13787,11 @@ void print_header()
 				);
 		}
 	}
+#ifdef HAVE_ZCOPY
+	if((include_mask & (long long)ZCOPY_MASK) && !silent)
+		printf("%16s%8s  the last three columns are sendfile, splice and copy_file_range\n",
+			" "," ");
+#endif
 }
 
 /************************************************************************/
@@ -12545,6 +14076,22 @@ void dump_excel()
 		}
 #endif
 	}
+#endif
+#ifdef HAVE_ZCOPY
+	if (include_mask & (long long)ZCOPY_MASK) {
+		if(bif_flag)
+			do_label(bif_fd,"Sendfile Report",bif_row++,bif_column);
+		if(!silent) printf("\n%cSendfile report%c\n",'"','"');
+		dump_report(zcopy_x); 
+		if(bif_flag)
+			do_label(bif_fd,"Splice Report",bif_row++,bif_column);
+		if(!silent) printf("\n%cSplice report%c\n",'"','"');
+		dump_report(zcopy_x+1); 
+		if(bif_flag)
+			do_label(bif_fd,"Copy_file_range Report",bif_row++,bif_column);
+		if(!silent) printf("\n%cCopy_file_range report%c\n",'"','"');
+		dump_report(zcopy_x+2); 
+	}
 #endif
 	if (cpuutilflag)
 		dump_cputimes();
@@ -12767,9 +14314,152 @@ void dump_cputimes(void)
 #endif
 	}
 #endif
+#ifdef HAVE_ZCOPY
+	if (include_mask & (long long)ZCOPY_MASK) {
+		if(bif_flag)
+			do_label(bif_fd, "Sendfile CPU utilization report (Zero values should be ignored)", bif_row++, bif_column);
+		if(!silent) printf("\n%cSendfile CPU utilization report (Zero values should be ignored)%c\n",'"','"');
+		dump_times(zcopy_x); 
+		if(bif_flag)
+			do_label(bif_fd, "Splice CPU utilization report (Zero values should be ignored)", bif_row++, bif_column);
+		if(!silent) printf("\n%cSplice CPU utilization report (Zero values should be ignored)%c\n",'"','"');
+		dump_times(zcopy_x+1); 
+		if(bif_flag)
+			do_label(bif_fd, "Copy_file_range CPU utilization report (Zero values should be ignored)", bif_row++, bif_column);
+		if(!silent) printf("\n%cCopy_file_range CPU utilization report (Zero values should be ignored)%c\n",'"','"');
+		dump_times(zcopy_x+2); 
+	}
+#endif
 }
 #endif /* EXCEL */
 
+/************************************************************************/
+/* mem_touch()								*/
+/* Faults in each page of a buffer without changing its contents.	*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static void
+mem_touch(char *addr, long long size)
+#else
+static void
+mem_touch(addr, size)
+char *addr;
+long long size;
+#endif
+{
+	volatile char *p;
+
+	for(p = addr; p < addr + size; p += page_size)
+		*p = *p;
+}
+
+/************************************************************************/
+/* mem_local()								*/
+/* Hands a thread its buffer. With -+g local the thread is the first	*/
+/* to write each page, so the kernel places them on the thread's node.	*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+char *
+mem_local(char *addr)
+#else
+char *
+mem_local(addr)
+char *addr;
+#endif
+{
+	if(mem_flags & MEM_LOCAL)
+		mem_touch(addr, (long long)MAXBUFFERSIZE);
+	return(addr);
+}
+
+/************************************************************************/
+/* alloc_private()							*/
+/* Private buffers. malloc() unless -+g asked for alignment, then a	*/
+/* hugetlb mapping or page aligned memory, rounded to whole pages.	*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static char *
+alloc_private(long long size)
+#else
+static char *
+alloc_private(size)
+long long size;
+#endif
+{
+	void *addr;
+	long long align;
+	int i;
+
+	if(!mem_flags)
+		return((char *)malloc((size_t)size));
+	align = (mem_flags & MEM_HUGE) ? HUGE_PAGE_SIZE : page_size;
+	size = (size + align - 1) & ~(align - 1);
+	addr = 0;
+#ifdef MAP_HUGETLB
+	if(mem_flags & MEM_HUGE)
+	{
+		for(i = 0; i < MAXSTREAMS+4 && mem_segs[i].addr; i++)
+			;
+		if(i < MAXSTREAMS+4)
+		{
+			addr = mmap(0, (size_t)size, PROT_READ|PROT_WRITE,
+				MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+			if(addr == MAP_FAILED)
+				addr = 0;	/* none reserved, use THP */
+			else
+			{
+				mem_segs[i].addr = (char *)addr;
+				mem_segs[i].len = (size_t)size;
+			}
+		}
+	}
+#endif
+	if(addr == 0)
+	{
+		if(posix_memalign(&addr, (size_t)align, (size_t)size) != 0)
+			return(0);
+#if !defined(NO_MADVISE) && defined(MADV_HUGEPAGE)
+		if(mem_flags & MEM_HUGE)
+			madvise(addr, (size_t)size, MADV_HUGEPAGE);
+#endif
+	}
+	/* With -+g local the owning thread does this in mem_local() */
+	if((mem_flags & MEM_PREFAULT) && !((mem_flags & MEM_LOCAL) && use_thread))
+		mem_touch((char *)addr, size);
+	return((char *)addr);
+}
+
+/************************************************************************/
+/* free_mem()								*/
+/* Releases a buffer from alloc_mem()'s private paths.			*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+void
+free_mem(char *addr)
+#else
+void
+free_mem(addr)
+char *addr;
+#endif
+{
+	int i;
+
+	for(i = 0; i < MAXSTREAMS+4 && mem_segs[i].addr; i++)
+		if(mem_segs[i].addr == addr)
+		{
+			munmap(addr, mem_segs[i].len);
+			/* Keep the table dense */
+			while(i < MAXSTREAMS+3 && mem_segs[i+1].addr)
+			{
+				mem_segs[i] = mem_segs[i+1];
+				i++;
+			}
+			mem_segs[i].addr = 0;
+			return;
+		}
+	free(addr);
+}
+
 /************************************************************************/
 /* Internal memory allocation mechanism. Uses shared memory or mmap 	*/
 /************************************************************************/
@@ -12805,18 +14495,18 @@ int shared_flag;
 	{
 		if(!trflag)
 		{
-			addr=(char *)malloc((size_t)size1);
+			addr=alloc_private(size1);
 			return(addr);
 		}
 		if(use_thread)
 		{
-			addr=(char *)malloc((size_t)size1);
+			addr=alloc_private(size1);
 			return(addr);
 		}
 	}
 	if(!shared_flag)
 	{
-		addr=(char *)malloc((size_t)size1);
+		addr=alloc_private(size1);
 		return(addr);
 	}
 #ifdef SHARED_MEM
@@ -12930,16 +14620,338 @@ long  long time1;
 {
 #if defined(__rtems__)
 
-        rtems_task_wake_after(time1 * (ticks_per_second/1000000));
+        rtems_task_wake_after((time1 * ticks_per_second) / 1000000);
 #else
 	struct timeval howlong;
-	howlong.tv_sec=(int)(time1/100000);
-	howlong.tv_usec=(int)(time1%100000); /* Get into u.s. */
+	howlong.tv_sec=(int)(time1/1000000);
+	howlong.tv_usec=(int)(time1%1000000); /* Get into u.s. */
 	select(0, 0, 0, 0, &howlong);
 #endif
         return;
 }
 
+/************************************************************************/
+/* Access to the per child control blocks.				*/
+/* The blocks are shared between the master and the children, which	*/
+/* are processes, threads or RTEMS tasks, so the state flag and the	*/
+/* live counters are accessed with explicit ordering instead of	*/
+/* relying on volatile alone. 32 bit fields keep the atomics lock	*/
+/* free on 32 bit PowerPC. Where 64 bit atomics are lock free too	*/
+/* (STATS_ATOMIC64) the live counters are published directly, else	*/
+/* under the seq counter.						*/
+/************************************************************************/
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+#define STATS_LOAD(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STATS_STORE(p,v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define STATS_WFENCE()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define STATS_RFENCE()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#if __GCC_ATOMIC_LLONG_LOCK_FREE == 2
+#define STATS_ATOMIC64
+#endif
+#elif defined(__GNUC__)
+#define STATS_LOAD(p)		(*(p))
+#define STATS_STORE(p,v)	do { __sync_synchronize(); *(p) = (v); } while(0)
+#define STATS_WFENCE()		__sync_synchronize()
+#define STATS_RFENCE()		__sync_synchronize()
+#else
+#define STATS_LOAD(p)		(*(p))
+#define STATS_STORE(p,v)	(*(p) = (v))
+#define STATS_WFENCE()
+#define STATS_RFENCE()
+#endif
+
+/* Longest nap, in microseconds, of the master waiting for children */
+#define CHILD_WAIT_MAX	1000
+#define SAMPLE_SLICE	10000	/* us, sampler check for finished children */
+
+#ifdef HAVE_ANSIC_C
+int
+child_flag_get(VOLATILE struct child_stats *cs)
+#else
+int
+child_flag_get(cs)
+VOLATILE struct child_stats *cs;
+#endif
+{
+	int flag;
+
+	flag = STATS_LOAD(&cs->flag);
+#if defined(__GNUC__) && !(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7))
+	__sync_synchronize();
+#endif
+	return(flag);
+}
+
+#ifdef HAVE_ANSIC_C
+void
+child_flag_set(VOLATILE struct child_stats *cs, int flag)
+#else
+void
+child_flag_set(cs, flag)
+VOLATILE struct child_stats *cs;
+int flag;
+#endif
+{
+	STATS_STORE(&cs->flag, flag);
+}
+
+/*
+ * Master side release of child i into BEGIN. Releasing child 0 starts
+ * the phase, and every child is handed that one time before its flag
+ * flips, so the children share a timeline however late each of them
+ * gets to its loop.
+ */
+#ifdef HAVE_ANSIC_C
+void
+child_begin(VOLATILE struct child_stats *cs, int i)
+#else
+void
+child_begin(cs, i)
+VOLATILE struct child_stats *cs;
+int i;
+#endif
+{
+	static double start;
+
+	if(i == 0)
+		start = time_so_far();
+	cs->phase_start = start;
+	child_flag_set(cs, CHILD_STATE_BEGIN);
+}
+
+/*
+ * Child side: the start of the current phase, the origin for the -+f
+ * ramp-up and end and the -+O schedule. A distributed client has no
+ * master in its memory and falls back to its own clock.
+ */
+#ifdef HAVE_ANSIC_C
+double
+phase_origin(long long xx)
+#else
+double
+phase_origin(xx)
+long long xx;
+#endif
+{
+	double start;
+
+	start = 0.0;
+	if(!(distributed && client_iozone))
+		start = shmaddr[xx].phase_start;
+	if(start == 0.0)
+		start = time_so_far();
+	return(start);
+}
+
+/*
+ * Master side wait for a child to leave HOLD. The children are only
+ * released together afterwards, so there is no need to notice at once:
+ * back off instead of spinning on every child's flag.
+ */
+#ifdef HAVE_ANSIC_C
+void
+child_wait_ready(VOLATILE struct child_stats *cs)
+#else
+void
+child_wait_ready(cs)
+VOLATILE struct child_stats *cs;
+#endif
+{
+	long long nap = 1;
+
+	while(child_flag_get(cs) == CHILD_STATE_HOLD)
+	{
+		Poll(nap);
+		if(nap < CHILD_WAIT_MAX)
+			nap <<= 1;
+	}
+}
+
+/*
+ * Child side: make the running totals visible to the master. Both only
+ * ever grow during a test, so with 64 bit atomics a relaxed kb and a
+ * release ops store are enough: a sampler that sees ops sees at least
+ * as much kb. Otherwise there is a single writer per block and a plain
+ * sequence counter keeps the doubles from being read torn.
+ */
+#ifdef HAVE_ANSIC_C
+void
+child_publish(VOLATILE struct child_stats *cs, double kb, double ops)
+#else
+void
+child_publish(cs, kb, ops)
+VOLATILE struct child_stats *cs;
+double kb;
+double ops;
+#endif
+{
+#ifdef STATS_ATOMIC64
+	__atomic_store(&cs->live_kb, &kb, __ATOMIC_RELAXED);
+	__atomic_store(&cs->live_ops, &ops, __ATOMIC_RELEASE);
+#else
+	unsigned int seq;
+
+	seq = cs->seq;
+	cs->seq = seq + 1;
+	STATS_WFENCE();
+	cs->live_kb = kb;
+	cs->live_ops = ops;
+	STATS_STORE(&cs->seq, seq + 2);
+#endif
+}
+
+/*
+ * Master side: read a consistent pair of running totals without
+ * stopping the child. Returns 0, or -1 if the child kept updating
+ * faster than it could be read.
+ */
+#ifdef HAVE_ANSIC_C
+int
+child_sample(VOLATILE struct child_stats *cs, double *kb, double *ops)
+#else
+int
+child_sample(cs, kb, ops)
+VOLATILE struct child_stats *cs;
+double *kb;
+double *ops;
+#endif
+{
+#ifdef STATS_ATOMIC64
+	__atomic_load(&cs->live_ops, ops, __ATOMIC_ACQUIRE);
+	__atomic_load(&cs->live_kb, kb, __ATOMIC_ACQUIRE);
+	return(0);
+#else
+	unsigned int seq1, seq2;
+	int tries;
+
+	for(tries = 0; tries < 100; tries++)
+	{
+		seq1 = STATS_LOAD(&cs->seq);
+		if(seq1 & 1)
+			continue;
+		*kb = cs->live_kb;
+		*ops = cs->live_ops;
+		STATS_RFENCE();
+		seq2 = cs->seq;
+		if(seq1 == seq2)
+			return(0);
+	}
+	return(-1);
+#endif
+}
+
+/*
+ * Master side time series of the children's progress (-+o). Runs
+ * after the children have been told to BEGIN and returns once none of
+ * them is running any more. Every sample_interval ms it appends, per
+ * child and for all of them, the kb and ops done so far and the rates
+ * over the last interval to Iozone_samples.txt. The children only pay
+ * for the child_publish() they do anyway.
+ */
+#ifdef HAVE_ANSIC_C
+void
+sample_children(char *what, int count)
+#else
+void
+sample_children(what, count)
+char *what;
+int count;
+#endif
+{
+	static double prev_kb[MAXSTREAMS], prev_ops[MAXSTREAMS];
+	static char gone[MAXSTREAMS];
+	VOLATILE struct child_stats *cs;
+	double start, last, now, due, dt, kb, ops, tkb, tops, tdkb, tdops;
+	long long nap;
+	int i, running, stonewalled;
+	FILE *fp;
+#if !defined(__rtems__) && !defined(Windows)
+	int status;
+#endif
+
+	if(distributed && master_iozone)
+		return;
+	fp = fopen("Iozone_samples.txt", "a");
+	if(fp == 0)
+		return;
+	fprintf(fp, "# %s, %d children, %d ms interval\n", what, count,
+		sample_interval);
+	fprintf(fp, "#   time(s) child           KB          ops       KB/sec      ops/sec\n");
+	for(i = 0; i < count; i++)
+	{
+		prev_kb[i] = prev_ops[i] = 0;
+		gone[i] = 0;
+	}
+	start = last = time_so_far();
+	stonewalled = 0;
+	do {
+		/*
+		 * Sleep in short slices and cut the interval short once no
+		 * child is in BEGIN, so the parent's join does not wait out
+		 * the rest of an interval after the children are done.
+		 */
+		due = last + (double)sample_interval / 1000.0;
+		while((now = time_so_far()) < due)
+		{
+			nap = (long long)((due - now) * 1000000.0);
+			if(nap > SAMPLE_SLICE)
+				nap = SAMPLE_SLICE;
+			Poll(nap);
+			for(i = 0; i < count; i++)
+				if(!gone[i] &&
+				   child_flag_get(&shmaddr[i]) == CHILD_STATE_BEGIN)
+					break;
+			if(i == count)
+				break;
+		}
+		now = time_so_far();
+		dt = now - last;
+		if(dt <= 0)
+			dt = time_res;
+		running = 0;
+		tkb = tops = tdkb = tdops = 0;
+		for(i = 0; i < count; i++)
+		{
+			cs = &shmaddr[i];
+			if(child_flag_get(cs) == CHILD_STATE_BEGIN && !gone[i])
+			{
+#if !defined(__rtems__) && !defined(Windows)
+				/* A child process that died never leaves BEGIN */
+				if(!use_thread &&
+				   waitpid((pid_t)childids[i], &status, WNOHANG) > 0)
+					gone[i] = 1;
+				else
+#endif
+					running++;
+			}
+			if(child_sample(cs, &kb, &ops) != 0)
+			{
+				kb = prev_kb[i];
+				ops = prev_ops[i];
+			}
+			fprintf(fp, "%11.3f %5d %12.0f %12.0f %12.2f %12.2f\n",
+				now - start, i, kb, ops,
+				(kb - prev_kb[i]) / dt, (ops - prev_ops[i]) / dt);
+			tkb += kb;
+			tops += ops;
+			tdkb += kb - prev_kb[i];
+			tdops += ops - prev_ops[i];
+			prev_kb[i] = kb;
+			prev_ops[i] = ops;
+		}
+		fprintf(fp, "%11.3f   all %12.0f %12.0f %12.2f %12.2f\n",
+			now - start, tkb, tops, tdkb / dt, tdops / dt);
+		if(*stop_flag && !stonewalled)
+		{
+			fprintf(fp, "# stonewall at %.3f\n", now - start);
+			stonewalled = 1;
+		}
+		last = now;
+	} while(running);
+	fprintf(fp, "\n");
+	fclose(fp);
+}
+
 /************************************************************************/
 /* Implementation of max() function.					*/
 /************************************************************************/
@@ -13112,8 +15124,9 @@ thread_write_test( x)
 	float delay = (float)0;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	off64_t traj_offset;
 	off64_t lock_offset=0;
 	off64_t save_offset=0;
@@ -13138,6 +15151,7 @@ thread_write_test( x)
 	off64_t filebytes64;
 	char tmpname[256];
 	FILE *thread_wqfd;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd;
 
 #ifdef ASYNC_IO
@@ -13199,7 +15213,7 @@ thread_write_test( x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	if(debug1 )
@@ -13355,7 +15369,10 @@ thread_write_test( x)
 	child_stat = (struct child_stats *)&shmaddr[xx];	
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
-	child_stat->flag=CHILD_STATE_READY; /* Tell parent child is ready to go */
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY); /* Tell parent child is ready to go */
 #ifdef NET_BENCH
 	if(distributed && client_iozone)
 		tell_master_ready(chid);
@@ -13378,7 +15395,7 @@ thread_write_test( x)
 	}
 	else
 	{
-		while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+		while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
 			Poll((long long)1);
 	}
 
@@ -13390,7 +15407,7 @@ thread_write_test( x)
 	if(file_lock)
 		if(mylockf((int) fd, (int) 1, (int)0) != 0)
 			printf("File lock for write failed. %d\n",errno);
-	if(Q_flag)
+	if(Q_flag && !Q_bin_flag)
 	{
 		sprintf(tmpname,"Child_%d_wol.dat",(int)xx);
 		thread_wqfd=fopen(tmpname,"a");
@@ -13406,6 +15423,18 @@ thread_write_test( x)
 		}
 		fprintf(thread_wqfd,"Offset in Kbytes   Latency in microseconds Transfer size in bytes\n");
 	}
+	if(Q_flag && Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_wol.dat",(int)xx);
+		thread_qtr=trace_open((int)xx,tmpname,
+			"Offset in Kbytes   Latency in microseconds Transfer size in bytes",
+			TRACE_OP_WRITE);
+		if(thread_qtr==0)
+		{
+			printf("Unable to allocate trace ring for %s\n",tmpname);
+			exit(40);
+		}
+	}
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -13431,7 +15460,21 @@ thread_write_test( x)
 	}
 	if(w_traj_flag)
 		rewind(w_traj_fd);
-	for(i=0; i<numrecs64; i++){
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,mmapflag ? -1 : fd)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				written_so_far=0;
+				w_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		if(w_traj_flag)
 		{
 			traj_offset=get_traj(w_traj_fd, (long long *)&traj_size,(float *)&delay, (long)1);
@@ -13519,7 +15562,10 @@ thread_write_test( x)
 			purgeit(nbuff,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
 		{
-			thread_qtime_start=time_so_far();
+			if(op_rate_flag)
+				thread_qtime_start=rate_wait(&rsched,(long long)xx);
+			else
+				thread_qtime_start=time_so_far();
 		}
 again:		
 		if(mmapflag)
@@ -13542,8 +15588,7 @@ again:
 #ifdef ASYNC_IO
 			     if(no_copy_flag)
 			     {
-				free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-				nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
+				free_addr=nbuff=async_write_buffer(gc,reclen,depth);
 				if(verify || dedup || dedup_interior)
 					fill_buffer(nbuff,reclen,(long long)pattern,sverify,i);
 			        async_write_no_copy(gc, (long long)fd, nbuff, reclen, (i*reclen), depth,free_addr);
@@ -13562,7 +15607,7 @@ again:
 		      else
 		      {
 #endif
-		      wval=write(fd, nbuff, (size_t) reclen);
+		      wval=I_WRITE(fd, nbuff, reclen);
 #if defined(Windows)
 		      }
 #endif
@@ -13621,7 +15666,7 @@ again:
 			   if(check_filename(dummyfile[xx]))
 				unlink(dummyfile[xx]);
 			}
-			child_stat->flag = CHILD_STATE_HOLD;
+			child_flag_set(child_stat,CHILD_STATE_HOLD);
 		    	exit(127);
 		      }
 		    }
@@ -13630,23 +15675,15 @@ again:
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-			      my_unap((unsigned long long)((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
 		if(Q_flag)
 		{
 			thread_qtime_stop=time_so_far();
+			if(thread_qtr)
+				trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+				  thread_qtime_stop-thread_qtime_start-time_res);
+			else
 #ifdef NO_PRINT_LLD
 			fprintf(thread_wqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -13656,6 +15693,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 		w_traj_ops_completed++;
 		w_traj_bytes_completed+=reclen;
 		written_so_far+=reclen/1024;
+		child_publish(child_stat,(double)written_so_far,(double)written_so_far*1024.0/(double)reclen);
 		if(*stop_flag)
 		{
 			written_so_far-=reclen/1024;
@@ -13755,7 +15793,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			xx, walltime, cputime,
 			cpu_util(cputime, walltime));
 	}
-	child_stat->flag = CHILD_STATE_HOLD; /* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD); /* Tell parent I'm done */
 	stopped=0;
 	/*******************************************************************/
 	/* End write performance test. *************************************/
@@ -13782,8 +15820,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 #endif
 		close(fd);
 	}
-	if(Q_flag && (thread_wqfd !=0) )
+	if(Q_flag && !Q_bin_flag && (thread_wqfd !=0) )
 		fclose(thread_wqfd);
+	if(thread_qtr)
+		trace_close(thread_qtr);
 	free(dummyfile[xx]);
 	if(w_traj_flag)
 		fclose(w_traj_fd);
@@ -13802,7 +15842,8 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
             rtems_status_code status;
             printf("thread_write_test(), task:%lld waiting on barrier\n", xx);
             status = rtems_barrier_wait(stopBarrier, RTEMS_NO_TIMEOUT);
-            rtems_task_delete(RTEMS_SELF);
+            if(!pool_flag)
+                rtems_task_delete(RTEMS_SELF);
         }
 #else
 #ifdef NET_BENCH
@@ -13843,8 +15884,9 @@ thread_pwrite_test( x)
 	float delay = (float)0;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	off64_t traj_offset;
 	off64_t lock_offset=0;
 	long long flags,traj_size;
@@ -13868,6 +15910,7 @@ thread_pwrite_test( x)
 	off64_t filebytes64;
 	char tmpname[256];
 	FILE *thread_wqfd;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd;
 
 #ifdef ASYNC_IO
@@ -13928,7 +15971,7 @@ thread_pwrite_test( x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	if(debug1 )
@@ -14070,7 +16113,10 @@ thread_pwrite_test( x)
 	child_stat = (struct child_stats *)&shmaddr[xx];	
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
-	child_stat->flag=CHILD_STATE_READY; /* Tell parent child is ready to go */
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY); /* Tell parent child is ready to go */
 #ifdef NET_BENCH
 	if(distributed && client_iozone)
 		tell_master_ready(chid);
@@ -14093,7 +16139,7 @@ thread_pwrite_test( x)
 	}
 	else
 	{
-		while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+		while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
 			Poll((long long)1);
 	}
 
@@ -14105,7 +16151,7 @@ thread_pwrite_test( x)
 	if(file_lock)
 		if(mylockf((int) fd, (int) 1, (int)0) != 0)
 			printf("File lock for write failed. %d\n",errno);
-	if(Q_flag)
+	if(Q_flag && !Q_bin_flag)
 	{
 		sprintf(tmpname,"Child_%d_pwol.dat",(int)xx);
 		thread_wqfd=fopen(tmpname,"a");
@@ -14121,6 +16167,18 @@ thread_pwrite_test( x)
 		}
 		fprintf(thread_wqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
 	}
+	if(Q_flag && Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_pwol.dat",(int)xx);
+		thread_qtr=trace_open((int)xx,tmpname,
+			"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+			TRACE_OP_PWRITE);
+		if(thread_qtr==0)
+		{
+			printf("Unable to allocate trace ring for %s\n",tmpname);
+			exit(40);
+		}
+	}
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -14146,7 +16204,21 @@ thread_pwrite_test( x)
 	}
 	if(w_traj_flag)
 		rewind(w_traj_fd);
-	for(i=0; i<numrecs64; i++){
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,-1)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				written_so_far=0;
+				w_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		traj_offset= ( i * reclen );
 		if(w_traj_flag)
 		{
@@ -14198,7 +16270,10 @@ thread_pwrite_test( x)
 			purgeit(nbuff,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
 		{
-			thread_qtime_start=time_so_far();
+			if(op_rate_flag)
+				thread_qtime_start=rate_wait(&rsched,(long long)xx);
+			else
+				thread_qtime_start=time_so_far();
 		}
 again:		
 		if(mmapflag)
@@ -14220,8 +16295,7 @@ again:
 		   {
 			     if(no_copy_flag)
 			     {
-				free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-				nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
+				free_addr=nbuff=async_write_buffer(gc,reclen,depth);
 				if(verify || dedup || dedup_interior)
 					fill_buffer(nbuff,reclen,(long long)pattern,sverify,i);
 			        async_write_no_copy(gc, (long long)fd, nbuff, reclen, (traj_offset), depth,free_addr);
@@ -14287,7 +16361,7 @@ again:
 			   if(check_filename(dummyfile[xx]))
 				unlink(dummyfile[xx]);
 			}
-			child_stat->flag = CHILD_STATE_HOLD;
+			child_flag_set(child_stat,CHILD_STATE_HOLD);
 		    	exit(127);
 		      }
 		    }
@@ -14301,23 +16375,15 @@ again:
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
 		if(Q_flag)
 		{
 			thread_qtime_stop=time_so_far();
+			if(thread_qtr)
+				trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+				  thread_qtime_stop-thread_qtime_start-time_res);
+			else
 #ifdef NO_PRINT_LLD
 			fprintf(thread_wqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -14327,6 +16393,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 		w_traj_ops_completed++;
 		w_traj_bytes_completed+=reclen;
 		written_so_far+=reclen/1024;
+		child_publish(child_stat,(double)written_so_far,(double)written_so_far*1024.0/(double)reclen);
 		if(*stop_flag)
 		{
 			written_so_far-=reclen/1024;
@@ -14416,7 +16483,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			xx, walltime, cputime,
 			cpu_util(cputime, walltime));
 	}
-	child_stat->flag = CHILD_STATE_HOLD; /* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD); /* Tell parent I'm done */
 	stopped=0;
 	/*******************************************************************/
 	/* End pwrite performance test. *************************************/
@@ -14438,8 +16505,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			
 		close(fd);
 	}
-	if(Q_flag && (thread_wqfd !=0) )
+	if(Q_flag && !Q_bin_flag && (thread_wqfd !=0) )
 		fclose(thread_wqfd);
+	if(thread_qtr)
+		trace_close(thread_qtr);
 	free(dummyfile[xx]);
 	if(w_traj_flag)
 		fclose(w_traj_fd);
@@ -14492,8 +16561,9 @@ thread_rwrite_test(x)
 	float delay = (float)0;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	off64_t traj_offset;
 	off64_t lock_offset=0;
 	long long w_traj_bytes_completed;
@@ -14513,6 +16583,7 @@ thread_rwrite_test(x)
 	char now_string[30];
 	int anwser,bind_cpu,wval;
 	FILE *thread_rwqfd,*thread_Lwqfd;
+	struct trace_ring *thread_qtr=0;
 	char tmpname[256];
 #if defined(VXFS) || defined(solaris)
 	int test_foo = 0;
@@ -14573,7 +16644,7 @@ thread_rwrite_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	child_stat = (struct child_stats *)&shmaddr[xx];
@@ -14663,7 +16734,7 @@ thread_rwrite_test(x)
 #else
 		printf("\nChild %lld\n",xx);
 #endif
-		child_stat->flag = CHILD_STATE_HOLD;
+		child_flag_set(child_stat,CHILD_STATE_HOLD);
 		perror(dummyfile[xx]);
 		exit(128);
 	}
@@ -14707,7 +16778,7 @@ thread_rwrite_test(x)
 		fetchit(nbuff,reclen);
 	if(w_traj_flag)
 		w_traj_fd=open_w_traj();
-	if(Q_flag)
+	if(Q_flag && !Q_bin_flag)
 	{
 		sprintf(tmpname,"Child_%d_rwol.dat",(int)xx);
 		thread_rwqfd=fopen(tmpname,"a");
@@ -14723,6 +16794,18 @@ thread_rwrite_test(x)
 		}
 		fprintf(thread_rwqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
 	}
+	if(Q_flag && Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_rwol.dat",(int)xx);
+		thread_qtr=trace_open((int)xx,tmpname,
+			"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+			TRACE_OP_REWRITE);
+		if(thread_qtr==0)
+		{
+			printf("Unable to allocate trace ring for %s\n",tmpname);
+			exit(40);
+		}
+	}
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -14740,7 +16823,10 @@ thread_rwrite_test(x)
 		get_date(now_string);
 		fprintf(thread_Lwqfd,"%-25s %s","Rewrite test start: ",now_string);
 	}
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
 #ifdef NET_BENCH
 	if(distributed && client_iozone)
 		tell_master_ready(chid);
@@ -14763,7 +16849,7 @@ thread_rwrite_test(x)
 	}
 	else
 	{
-		while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+		while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
 			Poll((long long)1);
 	}
 	starttime1 = time_so_far();
@@ -14784,12 +16870,26 @@ thread_rwrite_test(x)
 		rewind(w_traj_fd);
 	if((verify && !no_copy_flag) || dedup || dedup_interior)
 		fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)0);
-	for(i=0; i<numrecs64; i++){
-		traj_offset= i*reclen ;
-		if(w_traj_flag)
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,mmapflag ? -1 : fd)) != DUR_RUN)
 		{
-			traj_offset=get_traj(w_traj_fd, (long long *)&traj_size,(float *)&delay,(long)1);
-			reclen=traj_size;
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				re_written_so_far=0;
+				w_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
+		traj_offset= i*reclen ;
+		if(w_traj_flag)
+		{
+			traj_offset=get_traj(w_traj_fd, (long long *)&traj_size,(float *)&delay,(long)1);
+			reclen=traj_size;
 #if defined(Windows)
 			if(unbuffered)
 			  SetFilePointer(hand,(LONG)traj_offset,0,FILE_BEGIN);
@@ -14828,7 +16928,10 @@ thread_rwrite_test(x)
 			purgeit(nbuff,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
 		{
-			thread_qtime_start=time_so_far();
+			if(op_rate_flag)
+				thread_qtime_start=rate_wait(&rsched,(long long)xx);
+			else
+				thread_qtime_start=time_so_far();
 		}
 		if(mmapflag)
 		{
@@ -14854,8 +16957,7 @@ fprintf(newstdout,"Chid: %lld Rewriting offset %lld for length of %lld\n",chid,
 #ifdef ASYNC_IO
 			     if(no_copy_flag)
 			     {
-				free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-				nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
+				free_addr=nbuff=async_write_buffer(gc,reclen,depth);
 				if(verify || dedup || dedup_interior)
 					fill_buffer(nbuff,reclen,(long long)pattern,sverify,i);
 			        async_write_no_copy(gc, (long long)fd, nbuff, reclen, (i*reclen), depth,free_addr);
@@ -14873,7 +16975,7 @@ fprintf(newstdout,"Chid: %lld Rewriting offset %lld for length of %lld\n",chid,
 			   }
 			   else
 #endif
-			   wval=write(fd, nbuff, (size_t) reclen);
+			   wval=I_WRITE(fd, nbuff, reclen);
 			   if(wval != reclen)
 			   {
 				if(*stop_flag)
@@ -14896,12 +16998,13 @@ fprintf(newstdout,"Chid: %lld Rewriting offset %lld for length of %lld\n",chid,
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				signal_handler();
 			   }
 			}
 		}
 		re_written_so_far+=reclen/1024;
+		child_publish(child_stat,(double)re_written_so_far,(double)re_written_so_far*1024.0/(double)reclen);
 	   	w_traj_ops_completed++;
 		w_traj_bytes_completed+=reclen;
 		if(*stop_flag)
@@ -14913,23 +17016,15 @@ fprintf(newstdout,"Chid: %lld Rewriting offset %lld for length of %lld\n",chid,
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
 		if(Q_flag)
 		{
 			thread_qtime_stop=time_so_far();
+			if(thread_qtr)
+				trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+				  thread_qtime_stop-thread_qtime_start-time_res);
+			else
 #ifdef NO_PRINT_LLD
 			fprintf(thread_rwqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -15023,7 +17118,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			(char)*stop_flag,
 			(long long)CHILD_STATE_HOLD);
 #endif
-	child_stat->flag = CHILD_STATE_HOLD;	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD);	/* Tell parent I'm done */
 	if(!include_close)
 	{
 		if(mmapflag)
@@ -15042,8 +17137,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 	}
 	free(dummyfile[xx]);
 
-	if(Q_flag && (thread_rwqfd !=0) )
+	if(Q_flag && !Q_bin_flag && (thread_rwqfd !=0) )
 		fclose(thread_rwqfd);
+	if(thread_qtr)
+		trace_close(thread_qtr);
 
 	if(w_traj_flag)
 		fclose(w_traj_fd);
@@ -15067,7 +17164,8 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
             rtems_status_code status;
             printf("thread_rwrite_test(), task:%lld waiting on barrier\n", xx);
             status = rtems_barrier_wait(stopBarrier, RTEMS_NO_TIMEOUT);
-            rtems_task_delete(RTEMS_SELF);
+            if(!pool_flag)
+                rtems_task_delete(RTEMS_SELF);
         }
 #else
 	if(distributed && client_iozone)
@@ -15102,6 +17200,7 @@ thread_read_test(x)
 	long long r_traj_ops_completed;
 	int fd;
 	FILE *r_traj_fd,*thread_rqfd;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd;
 	long long flags = 0;
 	off64_t traj_offset;
@@ -15111,8 +17210,9 @@ thread_read_test(x)
 	double temp_time;
 	double thread_qtime_start,thread_qtime_stop;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	double compute_val = (double)0;
 	off64_t written_so_far, read_so_far, re_written_so_far,re_read_so_far;
 	long long recs_per_buffer,traj_size;
@@ -15187,7 +17287,7 @@ thread_read_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	dummyfile[xx]=(char *)malloc((size_t)MAXNAMESIZE);
@@ -15311,7 +17411,7 @@ thread_read_test(x)
 	/*****************/
 	/* Children only */
 	/*****************/
-	if(Q_flag)
+	if(Q_flag && !Q_bin_flag)
 	{
 		sprintf(tmpname,"Child_%d_rol.dat",(int)xx);
 		thread_rqfd=fopen(tmpname,"a");
@@ -15327,6 +17427,18 @@ thread_read_test(x)
 		}
 		fprintf(thread_rqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
 	}
+	if(Q_flag && Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_rol.dat",(int)xx);
+		thread_qtr=trace_open((int)xx,tmpname,
+			"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+			TRACE_OP_READ);
+		if(thread_qtr==0)
+		{
+			printf("Unable to allocate trace ring for %s\n",tmpname);
+			exit(40);
+		}
+	}
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -15350,7 +17462,10 @@ thread_read_test(x)
 	if(fetchon)
 		fetchit(nbuff,reclen);
 	child_stat=(struct child_stats *)&shmaddr[xx];
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
 	if(distributed && client_iozone)
         {
 #ifdef NET_BENCH
@@ -15361,7 +17476,7 @@ thread_read_test(x)
         else
         {
 		/* Wait for signal from parent */
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   
                         Poll((long long)1);
         }
 	if(file_lock)
@@ -15376,7 +17491,21 @@ thread_read_test(x)
 
 	if(r_traj_flag)
 		rewind(r_traj_fd);
-	for(i=0; i<numrecs64; i++){
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,mmapflag ? -1 : fd)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				read_so_far=0;
+				r_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		traj_offset= i*reclen;
 		if(disrupt_flag && ((i%DISRUPT)==0))
 		{
@@ -15428,7 +17557,10 @@ thread_read_test(x)
 			purgeit(nbuff,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
                 {
-                        thread_qtime_start=time_so_far();
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
                 }
 		if(mmapflag)
 		{
@@ -15457,7 +17589,7 @@ thread_read_test(x)
 			      }
 			      else
 #endif
-			      wval=read((int)fd, (void*)nbuff, (size_t) reclen);
+			      wval=I_READ(fd, nbuff, reclen);
 			      if(wval != reclen)
 			      {
 				if(*stop_flag)
@@ -15479,7 +17611,7 @@ thread_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 		    		exit(132);
 			      }
 			  }
@@ -15494,7 +17626,7 @@ thread_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(133);
 			   }
 #endif
@@ -15507,7 +17639,7 @@ thread_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(134);
 			   }
 		   }
@@ -15517,6 +17649,7 @@ thread_read_test(x)
 			async_release(gc);
 #endif
 		read_so_far+=reclen/1024;
+		child_publish(child_stat,(double)read_so_far,(double)read_so_far*1024.0/(double)reclen);
 		r_traj_bytes_completed+=reclen;
 		r_traj_ops_completed++;
 		if(*stop_flag)
@@ -15528,23 +17661,15 @@ thread_read_test(x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
                 if(Q_flag)
                 {
                         thread_qtime_stop=time_so_far();
+                        if(thread_qtr)
+                        	trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+                        	  thread_qtime_stop-thread_qtime_start-time_res);
+                        else
 #ifdef NO_PRINT_LLD
                         fprintf(thread_rqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -15638,7 +17763,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			(char)*stop_flag,
                         (long long)CHILD_STATE_HOLD);
 #endif
-	child_stat->flag = CHILD_STATE_HOLD; 	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD); 	/* Tell parent I'm done */
 	/*fsync(fd);*/
 	if(!include_close)
 	{
@@ -15655,8 +17780,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 #endif
 		close(fd);
 	}
-        if(Q_flag && (thread_rqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_rqfd !=0) )
                 fclose(thread_rqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
 	free(dummyfile[xx]);
 	if(r_traj_flag)
 		fclose(r_traj_fd);
@@ -15707,6 +17834,7 @@ thread_pread_test(x)
 	long long r_traj_ops_completed;
 	int fd;
 	FILE *r_traj_fd,*thread_rqfd;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd;
 	long long flags = 0;
 	off64_t traj_offset;
@@ -15716,8 +17844,9 @@ thread_pread_test(x)
 	double temp_time;
 	double thread_qtime_start,thread_qtime_stop;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	double compute_val = (double)0;
 	off64_t written_so_far, read_so_far, re_written_so_far,re_read_so_far;
 	long long recs_per_buffer,traj_size;
@@ -15780,7 +17909,7 @@ thread_pread_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	dummyfile[xx]=(char *)malloc((size_t)MAXNAMESIZE);
@@ -15887,7 +18016,7 @@ thread_pread_test(x)
 	/*****************/
 	/* Children only */
 	/*****************/
-	if(Q_flag)
+	if(Q_flag && !Q_bin_flag)
 	{
 		sprintf(tmpname,"Child_%d_prol.dat",(int)xx);
 		thread_rqfd=fopen(tmpname,"a");
@@ -15903,6 +18032,18 @@ thread_pread_test(x)
 		}
 		fprintf(thread_rqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
 	}
+	if(Q_flag && Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_prol.dat",(int)xx);
+		thread_qtr=trace_open((int)xx,tmpname,
+			"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+			TRACE_OP_PREAD);
+		if(thread_qtr==0)
+		{
+			printf("Unable to allocate trace ring for %s\n",tmpname);
+			exit(40);
+		}
+	}
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -15926,7 +18067,10 @@ thread_pread_test(x)
 	if(fetchon)
 		fetchit(nbuff,reclen);
 	child_stat=(struct child_stats *)&shmaddr[xx];
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
 	if(distributed && client_iozone)
         {
 #ifdef NET_BENCH
@@ -15937,7 +18081,7 @@ thread_pread_test(x)
         else
         {
 		/* Wait for signal from parent */
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   
                         Poll((long long)1);
         }
 	if(file_lock)
@@ -15952,7 +18096,21 @@ thread_pread_test(x)
 
 	if(r_traj_flag)
 		rewind(r_traj_fd);
-	for(i=0; i<numrecs64; i++){
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,-1)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				read_so_far=0;
+				r_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		traj_offset = i*reclen;
 		if(disrupt_flag && ((i%DISRUPT)==0))
 		{
@@ -15986,7 +18144,10 @@ thread_pread_test(x)
 			purgeit(nbuff,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
                 {
-                        thread_qtime_start=time_so_far();
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
                 }
 		if(mmapflag)
 		{
@@ -16027,7 +18188,7 @@ thread_pread_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 		    		exit(132);
 			      }
 			  }
@@ -16041,7 +18202,7 @@ thread_pread_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(133);
 			   }
 		   }
@@ -16053,7 +18214,7 @@ thread_pread_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(134);
 			   }
 		   }
@@ -16061,6 +18222,7 @@ thread_pread_test(x)
 		if(async_flag && no_copy_flag)
 			async_release(gc);
 		read_so_far+=reclen/1024;
+		child_publish(child_stat,(double)read_so_far,(double)read_so_far*1024.0/(double)reclen);
 		r_traj_bytes_completed+=reclen;
 		r_traj_ops_completed++;
 		if(*stop_flag)
@@ -16072,23 +18234,15 @@ thread_pread_test(x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
                 if(Q_flag)
                 {
                         thread_qtime_stop=time_so_far();
+                        if(thread_qtr)
+                        	trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+                        	  thread_qtime_stop-thread_qtime_start-time_res);
+                        else
 #ifdef NO_PRINT_LLD
                         fprintf(thread_rqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -16177,7 +18331,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			(char)*stop_flag,
                         (long long)CHILD_STATE_HOLD);
 #endif
-	child_stat->flag = CHILD_STATE_HOLD; 	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD); 	/* Tell parent I'm done */
 	/*fsync(fd);*/
 	if(!include_close)
 	{
@@ -16189,8 +18343,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			fsync(fd);
 		close(fd);
 	}
-        if(Q_flag && (thread_rqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_rqfd !=0) )
                 fclose(thread_rqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
 	free(dummyfile[xx]);
 	if(r_traj_flag)
 		fclose(r_traj_fd);
@@ -16240,6 +18396,7 @@ thread_rread_test(x)
 	struct child_stats *child_stat;
 	int fd;
 	FILE *r_traj_fd,*thread_rrqfd;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd;
 	long long r_traj_bytes_completed;
 	double walltime, cputime;
@@ -16252,8 +18409,9 @@ thread_rread_test(x)
 	double temp_time;
 	double thread_qtime_start,thread_qtime_stop;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	double compute_val = (double)0;
 	long long recs_per_buffer,traj_size;
 	off64_t i;
@@ -16329,7 +18487,7 @@ thread_rread_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	if(debug1)
@@ -16452,7 +18610,7 @@ thread_rread_test(x)
 		r_traj_fd=open_r_traj();
 	if(fetchon)
 		fetchit(nbuff,reclen);
-        if(Q_flag)
+        if(Q_flag && !Q_bin_flag)
         {
                 sprintf(tmpname,"Child_%d_rrol.dat",(int)xx);
                 thread_rrqfd=fopen(tmpname,"a");
@@ -16468,6 +18626,18 @@ thread_rread_test(x)
                 }
 		fprintf(thread_rrqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
         }
+        if(Q_flag && Q_bin_flag)
+        {
+        	sprintf(tmpname,"Child_%d_rrol.dat",(int)xx);
+        	thread_qtr=trace_open((int)xx,tmpname,
+        		"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+        		TRACE_OP_REREAD);
+        	if(thread_qtr==0)
+        	{
+        		printf("Unable to allocate trace ring for %s\n",tmpname);
+        		exit(40);
+        	}
+        }
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -16489,7 +18659,10 @@ thread_rread_test(x)
 	child_stat = (struct child_stats *)&shmaddr[xx];
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
 
 	if(distributed && client_iozone)
 	{
@@ -16501,7 +18674,7 @@ thread_rread_test(x)
 	else
 	
 		/* Wait for signal from parent */
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   
                         Poll((long long)1);
 	if(file_lock)
 		if(mylockf((int) fd, (int) 1, (int)1) != 0)
@@ -16515,7 +18688,21 @@ thread_rread_test(x)
 
 	if(r_traj_flag)
 		rewind(r_traj_fd);
-	for(i=0; i<numrecs64; i++){
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,mmapflag ? -1 : fd)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				re_read_so_far=0;
+				r_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		traj_offset=i*reclen;
 		if(disrupt_flag && ((i%DISRUPT)==0))
 		{
@@ -16567,7 +18754,10 @@ thread_rread_test(x)
 			purgeit(nbuff,reclen);
                 if(Q_flag || hist_summary || op_rate_flag)
                 {
-                        thread_qtime_start=time_so_far();
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
                 }
 		if(mmapflag)
 		{
@@ -16596,7 +18786,7 @@ thread_rread_test(x)
 			      }
 			      else
 #endif
-			      wval=read((int)fd, (void*)nbuff, (size_t) reclen);
+			      wval=I_READ(fd, nbuff, reclen);
 			      if(wval != reclen)
 			      {
 				if(*stop_flag)
@@ -16618,7 +18808,7 @@ thread_rread_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 		    		exit(137);
 			      }
 			   }
@@ -16633,7 +18823,7 @@ thread_rread_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(138);
 			}
 #endif
@@ -16646,7 +18836,7 @@ thread_rread_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(139);
 			}
 		   }
@@ -16656,6 +18846,7 @@ thread_rread_test(x)
 			async_release(gc);
 #endif
 		re_read_so_far+=reclen/1024;
+		child_publish(child_stat,(double)re_read_so_far,(double)re_read_so_far*1024.0/(double)reclen);
 		r_traj_bytes_completed+=reclen;
 		r_traj_ops_completed++;
 		if(*stop_flag)
@@ -16667,23 +18858,15 @@ thread_rread_test(x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
                 if(Q_flag)
                 {
                         thread_qtime_stop=time_so_far();
+                        if(thread_qtr)
+                        	trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+                        	  thread_qtime_stop-thread_qtime_start-time_res);
+                        else
 #ifdef NO_PRINT_LLD
                         fprintf(thread_rrqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -16773,7 +18956,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			(long long)CHILD_STATE_HOLD);
 	}
 #endif
-	child_stat->flag = CHILD_STATE_HOLD;	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD);	/* Tell parent I'm done */
 	if(!include_close)
 	{
 		if(mmapflag)
@@ -16789,8 +18972,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 #endif
 		close(fd);
 	}
-        if(Q_flag && (thread_rrqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_rrqfd !=0) )
                 fclose(thread_rrqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
 	free(dummyfile[xx]);
 	if(r_traj_flag)
 		fclose(r_traj_fd);
@@ -16842,8 +19027,7 @@ thread_reverse_read_test(x)
 	double walltime, cputime;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
 	double starttime2 = 0;
 	float delay = 0;
 	double temp_time;
@@ -16864,6 +19048,7 @@ thread_reverse_read_test(x)
 	off64_t traj_offset;
 	char tmpname[256];
 	FILE *thread_revqfd=0;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd=0;
 #if defined(VXFS) || defined(solaris)
 	int test_foo = 0;
@@ -16914,7 +19099,7 @@ thread_reverse_read_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	if(debug1)
@@ -17029,7 +19214,7 @@ thread_reverse_read_test(x)
 	}
 	if(fetchon)
 		fetchit(nbuff,reclen);
-        if(Q_flag)
+        if(Q_flag && !Q_bin_flag)
         {
                 sprintf(tmpname,"Child_%d_revol.dat",(int)xx);
                 thread_revqfd=fopen(tmpname,"a");
@@ -17045,6 +19230,18 @@ thread_reverse_read_test(x)
                 }
 		fprintf(thread_revqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
         }
+        if(Q_flag && Q_bin_flag)
+        {
+        	sprintf(tmpname,"Child_%d_revol.dat",(int)xx);
+        	thread_qtr=trace_open((int)xx,tmpname,
+        		"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+        		TRACE_OP_REVERSE);
+        	if(thread_qtr==0)
+        	{
+        		printf("Unable to allocate trace ring for %s\n",tmpname);
+        		exit(40);
+        	}
+        }
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -17065,7 +19262,10 @@ thread_reverse_read_test(x)
 	child_stat = (struct child_stats *)&shmaddr[xx];
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
         if(distributed && client_iozone)
         {
 #ifdef NET_BENCH
@@ -17075,7 +19275,7 @@ thread_reverse_read_test(x)
         }
         else
         {
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
                         Poll((long long)1);
         }
 	starttime2 = time_so_far();
@@ -17147,7 +19347,10 @@ thread_reverse_read_test(x)
 			purgeit(nbuff,reclen);
                 if(Q_flag || hist_summary || op_rate_flag)
                 {
-                        thread_qtime_start=time_so_far();
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
                 }
 		if(mmapflag)
 		{
@@ -17169,7 +19372,7 @@ thread_reverse_read_test(x)
 			  }
 			  else
 			  {
-			      if(read((int)fd, (void*)nbuff, (size_t) reclen) != reclen)
+			      if(I_READ(fd, nbuff, reclen) != reclen)
 			      {
 				if(*stop_flag)
 				{
@@ -17188,7 +19391,7 @@ thread_reverse_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(144);
 			      }
 			  }
@@ -17203,7 +19406,7 @@ thread_reverse_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(145);
 			}
 #endif
@@ -17216,7 +19419,7 @@ thread_reverse_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(146);
 			}
 		   }
@@ -17238,6 +19441,7 @@ thread_reverse_read_test(x)
 		}
 		current_position-=(2 *reclen);
 		reverse_read +=reclen/1024;
+		child_publish(child_stat,(double)reverse_read,(double)reverse_read*1024.0/(double)reclen);
 		if(*stop_flag)
 		{
 			reverse_read -=reclen/1024;
@@ -17246,23 +19450,15 @@ thread_reverse_read_test(x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
                 if(Q_flag)
                 {
                         thread_qtime_stop=time_so_far();
+                        if(thread_qtr)
+                        	trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+                        	  thread_qtime_stop-thread_qtime_start-time_res);
+                        else
 #ifdef NO_PRINT_LLD
                         fprintf(thread_revqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -17336,7 +19532,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			(char)*stop_flag,
 			(long long)CHILD_STATE_HOLD);
 #endif
-	child_stat->flag = CHILD_STATE_HOLD;	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD);	/* Tell parent I'm done */
 	if(!include_close)
 	{
 		if(mmapflag)
@@ -17348,8 +19544,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 		close(fd);
 	}
 	free(dummyfile[xx]);
-        if(Q_flag && (thread_revqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_revqfd !=0) )
                 fclose(thread_revqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
 	if(debug1)
 #ifdef NO_PRINT_LLD
 		printf("\nChild finished %ld\n",xx);
@@ -17397,8 +19595,7 @@ thread_stride_read_test(x)
 	long long flags = 0;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
 	double starttime2 = 0;
 	float delay = 0;
 	double compute_val = (double)0;
@@ -17421,6 +19618,7 @@ thread_stride_read_test(x)
 	char tmpname[256];
 	char now_string[30];
 	FILE *thread_strqfd=0;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd=0;
 #if defined(VXFS) || defined(solaris)
 	int test_foo = 0;
@@ -17471,7 +19669,7 @@ thread_stride_read_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
 	if(debug1)
@@ -17586,7 +19784,7 @@ thread_stride_read_test(x)
 	}
 	if(fetchon)
 		fetchit(nbuff,reclen);
-        if(Q_flag)
+        if(Q_flag && !Q_bin_flag)
         {
                 sprintf(tmpname,"Child_%d_strol.dat",(int)xx);
                 thread_strqfd=fopen(tmpname,"a");
@@ -17602,6 +19800,18 @@ thread_stride_read_test(x)
                 }
 		fprintf(thread_strqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
         }
+        if(Q_flag && Q_bin_flag)
+        {
+        	sprintf(tmpname,"Child_%d_strol.dat",(int)xx);
+        	thread_qtr=trace_open((int)xx,tmpname,
+        		"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+        		TRACE_OP_STRIDE);
+        	if(thread_qtr==0)
+        	{
+        		printf("Unable to allocate trace ring for %s\n",tmpname);
+        		exit(40);
+        	}
+        }
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -17623,7 +19833,10 @@ thread_stride_read_test(x)
 	child_stat = (struct child_stats *)&shmaddr[xx];
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
         if(distributed && client_iozone)
         {
 #ifdef NET_BENCH
@@ -17634,7 +19847,7 @@ thread_stride_read_test(x)
         else
 
 		/* wait for parent to say go */
-                while(child_stat->flag!=CHILD_STATE_BEGIN)      
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)      
                         Poll((long long)1);
 	if(file_lock)
 		if(mylockf((int) fd, (int) 1,  (int)1)!=0)
@@ -17672,7 +19885,10 @@ thread_stride_read_test(x)
 			purgeit(nbuff,reclen);
                 if(Q_flag || hist_summary || op_rate_flag)
                 {
-                        thread_qtime_start=time_so_far();
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
                 }
 		if(verify)
 			savepos64=current_position/(off64_t)reclen;
@@ -17696,7 +19912,7 @@ thread_stride_read_test(x)
 			}
 			else
 			{
-			  if(read((int)fd, (void*)nbuff, (size_t) reclen) != reclen)
+			  if(I_READ(fd, nbuff, reclen) != reclen)
 			  {
 				if(*stop_flag)
 				{
@@ -17715,7 +19931,7 @@ thread_stride_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 		    		exit(149);
 			  }
 			}
@@ -17736,7 +19952,7 @@ thread_stride_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(150);
 			}
 #endif
@@ -17749,7 +19965,7 @@ thread_stride_read_test(x)
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
 				exit(151);
 			}
 		   }
@@ -17804,6 +20020,7 @@ thread_stride_read_test(x)
 			}
 		}
 		stride_read +=reclen/1024;
+		child_publish(child_stat,(double)stride_read,(double)stride_read*1024.0/(double)reclen);
 		if(*stop_flag)
 		{
 			stride_read -=reclen/1024;
@@ -17812,23 +20029,15 @@ thread_stride_read_test(x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
                 if(Q_flag)
                 {
                         thread_qtime_stop=time_so_far();
+                        if(thread_qtr)
+                        	trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+                        	  thread_qtime_stop-thread_qtime_start-time_res);
+                        else
 #ifdef NO_PRINT_LLD
                         fprintf(thread_strqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -17904,7 +20113,7 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
                         (long long)CHILD_STATE_HOLD);
         }
 #endif
-	child_stat->flag = CHILD_STATE_HOLD;	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD);	/* Tell parent I'm done */
 	if(!include_close)
 	{
 		if(mmapflag)
@@ -17915,8 +20124,10 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			fsync(fd);
 		close(fd);
 	}
-        if(Q_flag && (thread_strqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_strqfd !=0) )
                 fclose(thread_strqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
 	free(dummyfile[xx]);
 	if(debug1)
 #ifdef NO_PRINT_LLD
@@ -17974,6 +20185,8 @@ thread_mix_test(x)
 		xx=(long)chid;
 	}
 #endif
+	if(op_mix)
+		return(thread_opmix_test(x));
 	if(pct_read!=0)
 	{
  		num_readers = (pct_read * num_child)/100;
@@ -18014,14 +20227,55 @@ thread_mix_test(x)
 	return(0);
 }
 /************************************************************************/
-/* Thread random read test				        	*/
+/* opmix_report() Splits the -+p #:op mixed workload results into	*/
+/* reads and writes: throughput, ops and mean latency of each.		*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static void
+opmix_report(char *unit)
+#else
+static void
+opmix_report(unit)
+char *unit;
+#endif
+{
+	double rkilos=0, wkilos=0, rops=0, wops=0, rtime=0, wtime=0, per_op;
+	long long xyz;
+
+	/* actual is in ops with -O, else in kilobytes */
+	per_op = OPS_flag ? 1.0 : (double)reclen/1024.0;
+	for(xyz=0;xyz<num_child;xyz++){
+		child_stat = (struct child_stats *)&shmaddr[xyz];
+		if(child_stat->actual > 0)
+		{
+			rkilos+=child_stat->throughput*child_stat->read_actual/child_stat->actual;
+			wkilos+=child_stat->throughput*(child_stat->actual-child_stat->read_actual)/child_stat->actual;
+		}
+		rops+=child_stat->read_actual/per_op;
+		wops+=(child_stat->actual-child_stat->read_actual)/per_op;
+		rtime+=child_stat->read_time;
+		wtime+=child_stat->write_time;
+	}
+	printf("\tReads in the mix \t\t\t\t= %10.2f %s/sec %10.0f ops, mean latency %10.2f us\n",
+		rkilos,unit,rops,rops ? rtime*1000000.0/rops : 0.0);
+	printf("\tWrites in the mix \t\t\t\t= %10.2f %s/sec %10.0f ops, mean latency %10.2f us\n",
+		wkilos,unit,wops,wops ? wtime*1000000.0/wops : 0.0);
+}
+
+/************************************************************************/
+/* Thread per op mixed test (-+p #:op)					*/
+/* Each child reads and writes its own file, picking every op at random	*/
+/* so that pct_read percent are reads. Offsets are sequential with -+B,	*/
+/* else in the random read order and -+Y distribution. Writes carry the	*/
+/* same pattern as the write test, so -V still verifies every read.	*/
+/* Plain read()/write() only: -k, -H and -B are not applied here.	*/
 /************************************************************************/
 #ifdef HAVE_ANSIC_C
 void *
-thread_ranread_test(void *x)
+thread_opmix_test(void *x)
 #else
 void *
-thread_ranread_test(x)
+thread_opmix_test(x)
 #endif
 {
 	long long xx,xx2;
@@ -18031,106 +20285,39 @@ thread_ranread_test(x)
 	long long flags = 0;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
 	double starttime1 = 0;
 	float delay = 0;
 	double temp_time;
 	double compute_val = (double)0;
-	off64_t written_so_far, ranread_so_far, re_written_so_far,re_read_so_far;
-	long long recs_per_buffer;
+	double read_time, write_time, op_time;
+	off64_t read_so_far, write_so_far;
 	off64_t current_offset=0;
 	off64_t i;
 	char *dummyfile[MAXSTREAMS];           /* name of dummy file     */
 	char *nbuff=0;
-	char *maddr=0;
-	char *wmaddr=0;
-#ifdef ASYNC_IO
-	volatile char *buffer1;
-#endif
 	int anwser,bind_cpu;
-	off64_t traj_offset;
-	off64_t lock_offset=0;
 	char tmpname[256];
 	char now_string[30];
-	FILE *thread_randrfd=0;
 	FILE *thread_Lwqfd=0;
-	long long *recnum=0;
-#if defined(VXFS) || defined(solaris)
-	int test_foo = 0;
-#endif
+	struct perm recnum;
+	struct dist_walk walk;
+	unsigned long long seed;
 	long long save_pos;
-#if defined (bsd4_2) || defined(Windows)
-	long long rand1,rand2,rand3;
-#endif
-	unsigned long long big_rand;
-#ifdef ASYNC_IO
-	struct cache *gc=0;
-#else
-/* igorv	long long *gc=0;*/
-#endif
-#ifdef MERSENNE
-        unsigned long long init[4]={0x12345ULL, 0x23456ULL, 0x34567ULL, 0x45678ULL}, length=4;
-#endif
+	long long ret;
+	int reading;
 
-#ifdef MERSENNE
-        init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-        srand(0);
-#else
-#ifdef Windows
-        srand(0);
-#else
-        srand48(0);
-#endif
-#endif
-#endif
-        recnum = (long long *)malloc(sizeof(*recnum)*numrecs64);
-        if (recnum){
-             /* pre-compute random sequence based on 
-		Fischer-Yates (Knuth) card shuffle */
-            for(i = 0; i < numrecs64; i++){
-                recnum[i] = i;
-            }
-            for(i = 0; i < numrecs64; i++) {
-                long long tmp = recnum[i];
-#ifdef MERSENNE
-      	       big_rand = genrand64_int64();
-#else
-#ifdef bsd4_2
-               rand1=(long long)rand();
-               rand2=(long long)rand();
-               rand3=(long long)rand();
-               big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-#else
-#ifdef Windows
-               rand1=(long long)rand();
-               rand2=(long long)rand();
-               rand3=(long long)rand();
-               big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-#else
-               big_rand = lrand48();
-#endif
-#endif
-#endif
-               big_rand = big_rand%numrecs64;
-               tmp = recnum[i];
-               recnum[i] = recnum[big_rand];
-               recnum[big_rand] = tmp;
-            }
-        }
-	else
-	{
-		fprintf(stderr,"Random uniqueness fallback.\n");
-	}
+	perm_init(&recnum,(unsigned long long)numrecs64,PERMSEED);
+	dist_setup((unsigned long long)numrecs64);
 	if(compute_flag)
 		delay=compute_time;
 	hist_time=thread_qtime_stop=thread_qtime_start=0;
-	traj_offset=walltime=cputime=0;
+	walltime=cputime=0;
 	anwser=bind_cpu=0;
-	written_so_far=ranread_so_far=re_written_so_far=re_read_so_far=0;
-	recs_per_buffer = cache_size/reclen ;
+	read_time=write_time=0;
+	read_so_far=write_so_far=0;
 #ifdef NO_THREADS
 	xx=chid;
 #else
@@ -18162,20 +20349,18 @@ thread_ranread_test(x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
+	/* Same op sequence on every run, different in every child */
+	seed = ((unsigned long long)(xx+1) * 0x9E3779B97F4A7C15ULL) | 1;
 	dummyfile[xx]=(char *)malloc((size_t)MAXNAMESIZE);
 	xx2=xx;
 	if(share_file)
 		xx2=(long long)0;
 	if(mfflag)
 	{
-#ifdef NO_PRINT_LLD
-		sprintf(dummyfile[xx],"%s",filearray[xx2]);
-#else
 		sprintf(dummyfile[xx],"%s",filearray[xx2]);
-#endif
 	}
 	else
 	{
@@ -18186,16 +20371,13 @@ thread_ranread_test(x)
 #endif
 	}
 	if(oflag)
-	{
-		flags=O_RDONLY|O_SYNC;
-	}
+		flags=O_RDWR|O_SYNC;
 	else
-		flags=O_RDONLY;
+		flags=O_RDWR;
 #if defined(_HPUX_SOURCE) || defined(linux)
 	if(read_sync)
 		flags |=O_RSYNC|O_SYNC;
 #endif
-
 #if ! defined(DONT_HAVE_O_DIRECT)
 #if defined(linux) || defined(__AIX__) || defined(IRIX) || defined(IRIX64) || defined(Windows) || defined (__FreeBSD__)
 	if(direct_flag)
@@ -18205,18 +20387,6 @@ thread_ranread_test(x)
 	if(direct_flag)
 		flags |=O_DIRECTIO;
 #endif
-#endif
-
-#if defined(Windows)
-       	if(unbuffered)
-        {
-        	hand=CreateFile(dummyfile[xx],
-		  GENERIC_READ|GENERIC_WRITE,
-	          FILE_SHARE_WRITE|FILE_SHARE_READ,
-		  NULL,OPEN_EXISTING,FILE_FLAG_NO_BUFFERING|
-		  FILE_FLAG_WRITE_THROUGH|FILE_FLAG_POSIX_SEMANTICS,
-		  NULL);
-       	}
 #endif
 	if((fd = I_OPEN(dummyfile[xx], ((int)flags),0))<0)
 	{
@@ -18226,83 +20396,24 @@ thread_ranread_test(x)
 			send_stop();
 #endif
 		perror(dummyfile[xx]);
-		exit(156);
-	}
-#ifdef ASYNC_IO
-	if(async_flag)
-		async_init(&gc,fd,direct_flag);
-#endif
-
-#ifdef VXFS
-	if(direct_flag)
-	{
-		ioctl(fd,VX_SETCACHE,VX_DIRECT);
-		ioctl(fd,VX_GETCACHE,&test_foo);
-		if(test_foo == 0)
-		{
-			if(!client_iozone)
-			  printf("\nVxFS advanced setcache feature not available.\n");
-			exit(3);
-		}
-	}
-#endif
-#if defined(solaris)
-        if(direct_flag)
-        {
-                test_foo = directio(fd, DIRECTIO_ON);
-                if(test_foo != 0)
-                {
-                        if(!client_iozone)
-                          printf("\ndirectio not available.\n");
-                        exit(3);
-                }
-        }
-#endif
-
-	if(mmapflag)
-	{
-		maddr=(char *)initfile(fd,(numrecs64*reclen),0,PROT_READ);
+		exit(190);
 	}
 	child_stat = (struct child_stats *)&shmaddr[xx];
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
+	child_stat->read_actual = 0;
+	child_stat->read_time = 0;
+	child_stat->write_time = 0;
 	if(debug1)
 	{
-	   if(use_thread)
 #ifdef NO_PRINT_LLD
-		printf("\nStarting child %ld\n",xx);
-#else
-		printf("\nStarting child %lld\n",xx);
-#endif
-	   else
-#ifdef NO_PRINT_LLD
-		printf("\nStarting process %d slot %ld\n",getpid(),xx);
+		printf("\nStarting mixed child %ld\n",xx);
 #else
-		printf("\nStarting process %d slot %lld\n",getpid(),xx);
+		printf("\nStarting mixed child %lld\n",xx);
 #endif
-		
 	}
-	/*****************/
-	/* Children only */
-	/*****************/
 	if(fetchon)
 		fetchit(nbuff,reclen);
-        if(Q_flag)
-        {
-                sprintf(tmpname,"Child_%d_randrol.dat",(int)xx);
-                thread_randrfd=fopen(tmpname,"a");
-                if(thread_randrfd==0)
-                {
-			client_error=errno;
-#ifdef NET_BENCH
-			if(distributed && client_iozone)
-				send_stop();
-#endif
-                        printf("Unable to open %s\n",tmpname);
-                        exit(40);
-                }
-		fprintf(thread_randrfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
-        }
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -18318,11 +20429,13 @@ thread_ranread_test(x)
 			exit(40);
 		}
 		get_date(now_string);
-		fprintf(thread_Lwqfd,"%-25s %s","Random read start: ",
+		fprintf(thread_Lwqfd,"%-25s %s","Mixed start: ",
 			now_string);
 	}
-	child_stat=(struct child_stats *)&shmaddr[xx];
-	child_stat->flag = CHILD_STATE_READY;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
         if(distributed && client_iozone)
         {
 #ifdef NET_BENCH
@@ -18332,7 +20445,7 @@ thread_ranread_test(x)
         }
         else
         {
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
                         Poll((long long)1);
         }
 	starttime1 = time_so_far();
@@ -18342,228 +20455,119 @@ thread_ranread_test(x)
 		cputime = cputime_so_far();
 	}
 
-#ifdef MERSENNE
-        init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-        srand(0);
-#else
-#ifdef Windows
-        srand(0);
-#else
-	srand48(0);
-#endif
-#endif
-#endif
-	if(file_lock)
-		if(mylockf((int) fd, (int) 1, (int)1)!=0)
-			printf("File lock for read failed. %d\n",errno);
-	for(i=0; i<numrecs64; i++) {
+	dist_start(&walk,(int)xx);
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,-1)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				read_so_far=write_so_far=0;
+				read_time=write_time=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		if(compute_flag)
 			compute_val+=do_compute(delay);
 		if(*stop_flag)
 		{
 			if(debug1)
-				printf("\n(%ld) Stopped by another 2\n", (long)xx);
+				printf("\n(%ld) Stopped by another\n", (long)xx);
 			break;
 		}
 		if(purge)
 			purgeit(nbuff,reclen);
-		if (recnum) {
-			current_offset = reclen * (long long)recnum[i];
-                } else {
-#ifdef MERSENNE
-                   big_rand = genrand64_int64();
-		   current_offset = (off64_t)reclen * (big_rand%numrecs64);
-#else
-#ifdef bsd4_2
-		   rand1=(long long)rand();
-		   rand2=(long long)rand();
-		   rand3=(long long)rand();
-		   big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-		   current_offset = (off64_t)reclen * (big_rand%numrecs64);
-#else
-#ifdef Windows
-		   rand1=(long long)rand();
-		   rand2=(long long)rand();
-		   rand3=(long long)rand();
-		   big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-		   current_offset = (off64_t)reclen * (big_rand%numrecs64);
-#else
-		   current_offset = reclen * (lrand48()%numrecs64);
-#endif
-#endif
-#endif
-		}
-
-		if (!(h_flag || k_flag || mmapflag))
+		if(seq_mix)
+			save_pos = (long long)i;
+		else
+			save_pos = (long long)dist_record(&walk,&recnum,
+				(unsigned long long)i);
+		current_offset = reclen * save_pos;
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		reading = (int)(seed % 100) < pct_read;
+		if(!reading && (verify || dedup || dedup_interior))
+			fill_buffer(nbuff,reclen,(long long)pattern,sverify,save_pos);
+		if(I_LSEEK( fd, current_offset, SEEK_SET )<0)
 		{
-		  if(I_LSEEK( fd, current_offset, SEEK_SET )<0)
-		  {
 			client_error=errno;
 #ifdef NET_BENCH
 			if(distributed && client_iozone)
 				send_stop();
 #endif
 			perror("lseek");
-			exit(158);
-		  };
-		}
-		if(rlocking)
-		{
-			lock_offset=I_LSEEK(fd,0,SEEK_CUR);
-			mylockr((int) fd, (int) 1, (int)1,
-			  lock_offset, reclen);
-		}
-		if(Q_flag || hist_summary || op_rate_flag)
-		{
-			traj_offset=I_LSEEK(fd,0,SEEK_CUR);
-                        thread_qtime_start=time_so_far();
-		}
-		if(mmapflag)
-		{
-			wmaddr = &maddr[current_offset];
-			fill_area((long long*)wmaddr,(long long*)nbuff,(long long)reclen);
+			exit(191);
 		}
+		if(op_rate_flag)
+			thread_qtime_start=rate_wait(&rsched,(long long)xx);
+		else
+			thread_qtime_start=time_so_far();
+		if(reading)
+			ret=(long long)I_READ(fd, nbuff, reclen);
 		else
+			ret=(long long)I_WRITE(fd, nbuff, reclen);
+		thread_qtime_stop=time_so_far();
+		if(ret != reclen)
 		{
-			if(async_flag)
-			{
-#ifdef ASYNC_IO
-			    if(no_copy_flag)
-			      async_read_no_copy(gc, (long long)fd, &buffer1, (current_offset),
-			      	 reclen, 0LL,(numrecs64*reclen),depth);
-			    else
-			      async_read(gc, (long long)fd, nbuff, (current_offset), reclen,
-			    	0LL,(numrecs64*reclen),depth);
-#endif
-			}
-			else
-			{
-	  		  if(read((int)fd, (void*)nbuff, (size_t)reclen) != reclen)
-	  		  {
-				if(*stop_flag)
-				{
-					if(debug1)
-						printf("\n(%ld) Stopped by another 2\n", (long)xx);
-					break;
-				}
+			if(*stop_flag)
+				break;
 #ifdef NO_PRINT_LLD
-				printf("\nError reading block at %ld\n",
-					 offset); 
+			printf("\nError %s block at %ld\n",
+				reading?"reading":"writing",(long)current_offset);
 #else
-				printf("\nError reading block at %lld\n",
-					 offset); 
+			printf("\nError %s block at %lld\n",
+				reading?"reading":"writing",(long long)current_offset);
 #endif
-				perror("ranread");
-				if (!no_unlink)
-				{
-				   if(check_filename(dummyfile[xx]))
-					unlink(dummyfile[xx]);
-				}
-				child_stat->flag = CHILD_STATE_HOLD;
-				exit(160);
-	 		  }
+			perror(reading?"read":"write");
+			if (!no_unlink)
+			{
+			   if(check_filename(dummyfile[xx]))
+				unlink(dummyfile[xx]);
 			}
+			child_flag_set(child_stat,CHILD_STATE_HOLD);
+			exit(192);
 		}
-		if(rlocking)
+		if(reading && verify)
 		{
-			mylockr((int) fd, (int) 0, (int)1,
-			  lock_offset, reclen);
-		}
-		save_pos=current_offset/reclen;
-		current_offset+=reclen;
-		if(verify){
-		   if(async_flag && no_copy_flag)
-		   {
-#ifdef ASYNC_IO
-			if(verify_buffer(buffer1,reclen,(off64_t)save_pos,reclen,(long long)pattern,sverify)){
-				if (!no_unlink)
-				{
-				   if(check_filename(dummyfile[xx]))
-					unlink(dummyfile[xx]);
-				}
-				child_stat->flag = CHILD_STATE_HOLD;
-				exit(161);
-			}
-#endif
-		   }
-		   else
-		   {
 			if(verify_buffer(nbuff,reclen,(off64_t)save_pos,reclen,(long long)pattern,sverify)){
 				if (!no_unlink)
 				{
 				   if(check_filename(dummyfile[xx]))
 					unlink(dummyfile[xx]);
 				}
-				child_stat->flag = CHILD_STATE_HOLD;
-				exit(162);
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
+				exit(193);
 			}
-		   }
 		}
-#ifdef ASYNC_IO
-		if(async_flag && no_copy_flag)
-			async_release(gc);
-#endif
-		ranread_so_far+=reclen/1024;
 		if(*stop_flag)
+			break;
+		/* The split is summed raw: less time_res it can go negative */
+		op_time = thread_qtime_stop-thread_qtime_start;
+		hist_time = op_time-time_res;
+		if(reading)
 		{
-			ranread_so_far-=reclen/1024;
-		}
-		if(hist_summary)
-		{
-			thread_qtime_stop=time_so_far();
-			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
+			read_so_far+=reclen/1024;
+			read_time+=op_time;
 		}
-		if(op_rate_flag)
+		else
 		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			write_so_far+=reclen/1024;
+			write_time+=op_time;
 		}
-                if(Q_flag)
-                {
-                        thread_qtime_stop=time_so_far();
-#ifdef NO_PRINT_LLD
-                        fprintf(thread_randrfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
-#else
-                        fprintf(thread_randrfd,"%10.1lld %10.0f %10.1lld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
-#endif
-                }
-	}
-	if(file_lock)
-		if(mylockf((int) fd,(int)0,(int)1))
-			printf("Read unlock failed %d\n",errno);
-#ifdef ASYNC_IO
-	if(async_flag)
-	{
-		end_async(gc);
-		gc=0;
+		child_publish(child_stat,(double)(read_so_far+write_so_far),
+			(double)(read_so_far+write_so_far)*1024.0/(double)reclen);
+		if(hist_summary)
+			hist_insert((int)xx,hist_time);
 	}
-#endif
 	if(include_flush)
-	{
-		if(mmapflag)
-		{
-			msync(maddr,(size_t)(numrecs64*reclen),MS_SYNC);
-		}else
-			fsync(fd);
-	}
+		fsync(fd);
 	if(include_close)
-	{	
-		if(mmapflag)
-		{
-			mmap_end(maddr,(unsigned long long)numrecs64*reclen);
-		}
 		close(fd);
-	}
 	temp_time = time_so_far();
 	child_stat=(struct child_stats *)&shmaddr[xx];
 	child_stat->throughput = ((temp_time - starttime1)-time_res)
@@ -18576,10 +20580,14 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 		res_prob=1;
 	}
 	if(OPS_flag){
-	   ranread_so_far=(ranread_so_far*1024)/reclen;
-	}
-	child_stat->throughput = ranread_so_far/child_stat->throughput;
-	child_stat->actual = ranread_so_far;
+	   read_so_far=(read_so_far*1024)/reclen;
+	   write_so_far=(write_so_far*1024)/reclen;
+	}
+	child_stat->throughput = (read_so_far+write_so_far)/child_stat->throughput;
+	child_stat->actual = read_so_far+write_so_far;
+	child_stat->read_actual = read_so_far;
+	child_stat->read_time = read_time;
+	child_stat->write_time = write_time;
 	if(!xflag)
 	{
 		*stop_flag=1;
@@ -18588,12 +20596,6 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 			send_stop();
 #endif
 	}
-        if(cdebug)
-	{
-                fprintf(newstdout,"Child %d: throughput %f actual %f \n",(int)chid,child_stat->throughput,
-                        child_stat->actual);
-		fflush(newstdout);
-	}
 	if(cpuutilflag)
 	{
 		cputime = cputime_so_far() - cputime;
@@ -18605,43 +20607,27 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 	}
 #ifdef NET_BENCH
         if(distributed && client_iozone)
-                tell_master_stats(THREAD_RANDOM_READ_TEST, chid, child_stat->throughput,
+                tell_master_stats(THREAD_RANDOM_MIX_TEST, chid, child_stat->throughput,
                         child_stat->actual,
 			child_stat->cputime, child_stat->walltime,
 			(char)*stop_flag,
                         (long long)CHILD_STATE_HOLD);
 #endif
-	child_stat->flag = CHILD_STATE_HOLD; 	/* Tell parent I'm done */
+	child_flag_set(child_stat,CHILD_STATE_HOLD); 	/* Tell parent I'm done */
 	if(!include_close)
 	{
-		if(mmapflag)
-		{
-			msync(maddr,(size_t)(numrecs64*reclen),MS_SYNC);
-			mmap_end(maddr,(unsigned long long)numrecs64*reclen);
-		}else
-			fsync(fd);
+		fsync(fd);
 		close(fd);
 	}
-        if(Q_flag && (thread_randrfd !=0) )
-                fclose(thread_randrfd);
 	free(dummyfile[xx]);
-	if(debug1)
-#ifdef NO_PRINT_LLD
-		printf("\nChild finished %ld\n",xx);
-#else
-		printf("\nChild finished %lld\n",xx);
-#endif
-
 	if(L_flag)
 	{
 		get_date(now_string);
-		fprintf(thread_Lwqfd,"%-25s %s","Random read finished: ",now_string);
+		fprintf(thread_Lwqfd,"%-25s %s","Mixed finished: ",now_string);
 		fclose(thread_Lwqfd);
 	}
-	if(recnum)
-		free(recnum);
 	if(hist_summary)
-	   dump_hist("Random Read",(int)xx);
+	   dump_hist("Mixed",(int)xx);
 	if(distributed && client_iozone)
 		return(0);
 #ifdef NO_THREADS
@@ -18654,142 +20640,81 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 #endif
 return(0);
 }
-
 /************************************************************************/
-/* Thread random write test			        		*/
+/* Thread random read test				        	*/
 /************************************************************************/
 #ifdef HAVE_ANSIC_C
 void *
-thread_ranwrite_test(void *x)
+thread_ranread_test(void *x)
 #else
 void *
-thread_ranwrite_test( x)
+thread_ranread_test(x)
 #endif
 {
-
+	long long xx,xx2;
 	struct child_stats *child_stat;
-	double starttime1 = 0;
-	double temp_time;
 	double walltime, cputime;
-	double compute_val = (double)0;
-	float delay = (double)0;
+	int fd;
+	long long flags = 0;
 	double thread_qtime_stop,thread_qtime_start;
 	double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
-	off64_t traj_offset;
-	off64_t current_offset=0;
-	long long flags;
-	long long w_traj_bytes_completed;
-	long long w_traj_ops_completed;
-	int fd;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
+	double starttime1 = 0;
+	float delay = 0;
+	double temp_time;
+	double compute_val = (double)0;
+	off64_t written_so_far, ranread_so_far, re_written_so_far,re_read_so_far;
 	long long recs_per_buffer;
-	long long stopped,i;
-	off64_t written_so_far, read_so_far, re_written_so_far,re_read_so_far;
-	long long xx,xx2;
-	char *dummyfile [MAXSTREAMS];           /* name of dummy file     */
+	off64_t current_offset=0;
+	off64_t i;
+	char *dummyfile[MAXSTREAMS];           /* name of dummy file     */
 	char *nbuff=0;
 	char *maddr=0;
 	char *wmaddr=0;
 #ifdef ASYNC_IO
-	char *free_addr=0;
+	volatile char *buffer1;
 #endif
-	int anwser,bind_cpu,wval;
-	off64_t filebytes64;
+	int anwser,bind_cpu;
+	off64_t traj_offset;
 	off64_t lock_offset=0;
 	char tmpname[256];
 	char now_string[30];
-	FILE *thread_randwqfd=0;
+	FILE *thread_randrfd=0;
+	struct trace_ring *thread_qtr=0;
 	FILE *thread_Lwqfd=0;
-	long long *recnum = 0;
+	struct perm recnum;
+	struct dist_walk walk;
 #if defined(VXFS) || defined(solaris)
 	int test_foo = 0;
 #endif
-#if defined (bsd4_2) || defined(Windows)
-	long long rand1,rand2,rand3;
-#endif
-	unsigned long long big_rand;
-
+	long long save_pos;
 #ifdef ASYNC_IO
 	struct cache *gc=0;
 #else
 /* igorv	long long *gc=0;*/
-#endif
-#ifdef MERSENNE
-        unsigned long long init[4]={0x12345ULL, 0x23456ULL, 0x34567ULL, 0x45678ULL}, length=4;
 #endif
 
+	/* Every record once, in the same random order on each pass */
+	perm_init(&recnum,(unsigned long long)numrecs64,PERMSEED);
+	dist_setup((unsigned long long)numrecs64);
 	if(compute_flag)
 		delay=compute_time;
 	hist_time=thread_qtime_stop=thread_qtime_start=0;
 	traj_offset=walltime=cputime=0;
 	anwser=bind_cpu=0;
-	filebytes64 = numrecs64*reclen;
-	written_so_far=read_so_far=re_written_so_far=re_read_so_far=0;
-	w_traj_bytes_completed=w_traj_ops_completed=0;
+	written_so_far=ranread_so_far=re_written_so_far=re_read_so_far=0;
 	recs_per_buffer = cache_size/reclen ;
-#ifdef MERSENNE
-        init_by_array64(init, length);
-#else
-#ifdef bsd4_2
-        srand(0);
-#else
-#ifdef Windows
-        srand(0);
+#ifdef NO_THREADS
+	xx=chid;
 #else
-        srand48(0);
-#endif
-#endif
-#endif
-        recnum = (long long *) malloc(sizeof(*recnum)*numrecs64);
-        if (recnum){
-             /* pre-compute random sequence based on 
-		Fischer-Yates (Knuth) card shuffle */
-            for(i = 0; i < numrecs64; i++){
-                recnum[i] = i;
-            }
-            for(i = 0; i < numrecs64; i++) {
-                long long tmp = recnum[i];
-#ifdef MERSENNE
-      	       big_rand = genrand64_int64();
-#else
-#ifdef bsd4_2
-               rand1=(long long)rand();
-               rand2=(long long)rand();
-               rand3=(long long)rand();
-               big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-#else
-#ifdef Windows
-               rand1=(long long)rand();
-               rand2=(long long)rand();
-               rand3=(long long)rand();
-               big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-#else
-               big_rand = lrand48();
-#endif
-#endif
-#endif
-               big_rand = big_rand%numrecs64;
-               tmp = recnum[i];
-               recnum[i] = recnum[big_rand];
-               recnum[big_rand] = tmp;
-            }
-        }
-	else
-	{
-		fprintf(stderr,"Random uniqueness fallback.\n");
-	}
-#ifdef NO_THREADS
-	xx=chid;
-#else
-	if(use_thread)
-	{
-		xx = (long long)((long)x);
-	}
-	else
-	{
-		xx=chid;
-	}
+	if(use_thread)
+		xx = (long long)((long)x);
+	else
+	{
+		xx=chid;
+	}
 #endif
 #ifndef NO_THREADS
 #if defined( _HPUX_SOURCE ) || defined ( linux )
@@ -18812,25 +20737,9 @@ thread_ranwrite_test( x)
 #endif
 #endif
 	if(use_thread)
-		nbuff=barray[xx];
+		nbuff=mem_local(barray[xx]);
 	else
 		nbuff=buffer;
-	if(debug1 )
-	{
-	   if(use_thread)
-#ifdef NO_PRINT_LLD
-		printf("\nStarting child %ld\n",xx);
-#else
-		printf("\nStarting child %lld\n",xx);
-#endif
-	   else
-#ifdef NO_PRINT_LLD
-		printf("\nStarting process %d slot %ld\n",getpid(),xx);
-#else
-		printf("\nStarting process %d slot %lld\n",getpid(),xx);
-#endif
-		
-	}
 	dummyfile[xx]=(char *)malloc((size_t)MAXNAMESIZE);
 	xx2=xx;
 	if(share_file)
@@ -18851,19 +20760,12 @@ thread_ranwrite_test( x)
 		sprintf(dummyfile[xx],"%s.DUMMY.%lld",filearray[xx2],xx2);
 #endif
 	}
-	/*****************/
-	/* Children only */
-	/*******************************************************************/
-	/* Random write throughput performance test. **********************/
-	/*******************************************************************/
 	if(oflag)
-		flags=O_RDWR|O_SYNC|O_CREAT;
+	{
+		flags=O_RDONLY|O_SYNC;
+	}
 	else
-		flags=O_RDWR|O_CREAT;
-#if defined(O_DSYNC)
-	if(odsync)
-		flags |= O_DSYNC;
-#endif
+		flags=O_RDONLY;
 #if defined(_HPUX_SOURCE) || defined(linux)
 	if(read_sync)
 		flags |=O_RSYNC|O_SYNC;
@@ -18879,6 +20781,7 @@ thread_ranwrite_test( x)
 		flags |=O_DIRECTIO;
 #endif
 #endif
+
 #if defined(Windows)
        	if(unbuffered)
         {
@@ -18890,18 +20793,21 @@ thread_ranwrite_test( x)
 		  NULL);
        	}
 #endif
-	if((fd = I_OPEN(dummyfile[xx], ((int)flags),0640))<0)
+	if((fd = I_OPEN(dummyfile[xx], ((int)flags),0))<0)
 	{
 		client_error=errno;
 #ifdef NET_BENCH
 		if(distributed && client_iozone)
 			send_stop();
 #endif
-		printf("\nCan not open temp file: %s\n", 
-			filename);
-		perror("open");
-		exit(125);
+		perror(dummyfile[xx]);
+		exit(156);
 	}
+#ifdef ASYNC_IO
+	if(async_flag)
+		async_init(&gc,fd,direct_flag);
+#endif
+
 #ifdef VXFS
 	if(direct_flag)
 	{
@@ -18927,62 +20833,63 @@ thread_ranwrite_test( x)
                 }
         }
 #endif
-#ifdef ASYNC_IO
-	if(async_flag)
-		async_init(&gc,fd,direct_flag);
-#endif
+
 	if(mmapflag)
 	{
-		maddr=(char *)initfile(fd,(filebytes64),1,PROT_READ|PROT_WRITE);
-	}
-	if(reclen < cache_size )
-	{
-		recs_per_buffer = cache_size/reclen ;
-		nbuff=&nbuff[(xx%recs_per_buffer)*reclen];
+		maddr=(char *)initfile(fd,(numrecs64*reclen),0,PROT_READ);
 	}
-	if(fetchon)			/* Prefetch into processor cache */
-		fetchit(nbuff,reclen);
-
-	child_stat = (struct child_stats *)&shmaddr[xx];	
+	child_stat = (struct child_stats *)&shmaddr[xx];
 	child_stat->throughput = 0;
 	child_stat->actual = 0;
-	child_stat->flag=CHILD_STATE_READY; /* Tell parent child is ready to go */
-	if(distributed && client_iozone)
+	if(debug1)
 	{
-#ifdef NET_BENCH
-		tell_master_ready(chid);
-		wait_for_master_go(chid);
+	   if(use_thread)
+#ifdef NO_PRINT_LLD
+		printf("\nStarting child %ld\n",xx);
+#else
+		printf("\nStarting child %lld\n",xx);
 #endif
+	   else
+#ifdef NO_PRINT_LLD
+		printf("\nStarting process %d slot %ld\n",getpid(),xx);
+#else
+		printf("\nStarting process %d slot %lld\n",getpid(),xx);
+#endif
+		
 	}
-	else
-	{
-		while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
-			Poll((long long)1);
-	}
-	written_so_far=0;
-	child_stat = (struct child_stats *)&shmaddr[xx];
-	child_stat->actual = 0;
-	child_stat->throughput = 0;
-	stopped=0;
-	if(file_lock)
-		if(mylockf((int) fd, (int) 1, (int)0) != 0)
-			printf("File lock for write failed. %d\n",errno);
-	if(Q_flag)
-	{
-		sprintf(tmpname,"Child_%d_randwol.dat",(int)xx);
-		thread_randwqfd=fopen(tmpname,"a");
-		if(thread_randwqfd==0)
-		{
+	/*****************/
+	/* Children only */
+	/*****************/
+	if(fetchon)
+		fetchit(nbuff,reclen);
+        if(Q_flag && !Q_bin_flag)
+        {
+                sprintf(tmpname,"Child_%d_randrol.dat",(int)xx);
+                thread_randrfd=fopen(tmpname,"a");
+                if(thread_randrfd==0)
+                {
 			client_error=errno;
 #ifdef NET_BENCH
 			if(distributed && client_iozone)
 				send_stop();
 #endif
-			printf("Unable to open %s\n",tmpname);
-			exit(40);
-		}
-		fprintf(thread_randwqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
-	}
+                        printf("Unable to open %s\n",tmpname);
+                        exit(40);
+                }
+		fprintf(thread_randrfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
+        }
+        if(Q_flag && Q_bin_flag)
+        {
+        	sprintf(tmpname,"Child_%d_randrol.dat",(int)xx);
+        	thread_qtr=trace_open((int)xx,tmpname,
+        		"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+        		TRACE_OP_RANDOM_READ);
+        	if(thread_qtr==0)
+        	{
+        		printf("Unable to allocate trace ring for %s\n",tmpname);
+        		exit(40);
+        	}
+        }
 	if(L_flag)
 	{
 		sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -18998,41 +20905,63 @@ thread_ranwrite_test( x)
 			exit(40);
 		}
 		get_date(now_string);
-		fprintf(thread_Lwqfd,"%-25s %s","Random write start: ",
+		fprintf(thread_Lwqfd,"%-25s %s","Random read start: ",
 			now_string);
 	}
-	if((verify && !no_copy_flag) || dedup || dedup_interior)
-		fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)0);
+	child_stat=(struct child_stats *)&shmaddr[xx];
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
+        if(distributed && client_iozone)
+        {
+#ifdef NET_BENCH
+                tell_master_ready(chid);
+                wait_for_master_go(chid);
+#endif
+        }
+        else
+        {
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+                        Poll((long long)1);
+        }
 	starttime1 = time_so_far();
 	if(cpuutilflag)
 	{
 		walltime = starttime1;
 		cputime = cputime_so_far();
 	}
-	for(i=0; i<numrecs64; i++){
+
+	dist_start(&walk,(int)xx);
+	if(file_lock)
+		if(mylockf((int) fd, (int) 1, (int)1)!=0)
+			printf("File lock for read failed. %d\n",errno);
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,-1)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				ranread_so_far=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
 		if(compute_flag)
 			compute_val+=do_compute(delay);
-		if (recnum) {
-			current_offset = reclen * (long long)recnum[i];
-                } else {
-#ifdef bsd4_2
-		   rand1=rand();
-		   rand2=rand();
-		   rand3=rand();
-		   big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-		   current_offset = (off64_t)reclen * (big_rand%numrecs64);
-#else
-#ifdef Windows
-		   rand1=rand();
-		   rand2=rand();
-		   rand3=rand();
-		   big_rand=(rand1<<32)|(rand2<<16)|(rand3);
-		   current_offset = (off64_t)reclen * (big_rand%numrecs64);
-#else
-		   current_offset = reclen * (lrand48()%numrecs64);
-#endif
-#endif
+		if(*stop_flag)
+		{
+			if(debug1)
+				printf("\n(%ld) Stopped by another 2\n", (long)xx);
+			break;
 		}
+		if(purge)
+			purgeit(nbuff,reclen);
+		current_offset = reclen * (long long)dist_record(&walk,&recnum,
+			(unsigned long long)i);
 
 		if (!(h_flag || k_flag || mmapflag))
 		{
@@ -19047,196 +20976,134 @@ thread_ranwrite_test( x)
 			exit(158);
 		  };
 		}
-		if(Q_flag || hist_summary || op_rate_flag)
-		{
-			traj_offset=I_LSEEK(fd,0,SEEK_CUR);
-                        thread_qtime_start=time_so_far();
-		}
 		if(rlocking)
 		{
 			lock_offset=I_LSEEK(fd,0,SEEK_CUR);
-			mylockr((int) fd, (int) 1, (int)0,
+			mylockr((int) fd, (int) 1, (int)1,
 			  lock_offset, reclen);
 		}
-		if((verify && !no_copy_flag) || dedup || dedup_interior)
-			fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)(current_offset/reclen));
-		if(*stop_flag && !stopped){
-			if(include_flush)
-			{
-				if(mmapflag)
-					msync(maddr,(size_t)filebytes64,MS_SYNC);
-				else
-					fsync(fd);
-			}
-			child_stat->throughput = 
-				(time_so_far() - starttime1)-time_res;
-			if(child_stat->throughput < (double).000001) 
-			{
-				child_stat->throughput = time_res;
-				if(rec_prob < reclen)
-					rec_prob = reclen;
-				res_prob=1;
-			}
-
-			if(OPS_flag){
-			   /*written_so_far=(written_so_far*1024)/reclen;*/
-			   written_so_far=w_traj_ops_completed;
-			}
-			child_stat->throughput = 
-			  (double)written_so_far/child_stat->throughput;
-			child_stat->actual = (double)written_so_far;
-			if(debug1)
-			{
-				printf("\n(%ld) Stopped by another\n", (long)xx);
-			}
-			stopped=1;
-		}
-		if(purge)
-			purgeit(nbuff,reclen);
-		if(Q_flag || hist_summary)
+		if(Q_flag || hist_summary || op_rate_flag)
 		{
-			thread_qtime_start=time_so_far();
+			traj_offset=I_LSEEK(fd,0,SEEK_CUR);
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
 		}
-again:		
 		if(mmapflag)
 		{
 			wmaddr = &maddr[current_offset];
-			fill_area((long long*)nbuff,(long long*)wmaddr,(long long)reclen);
-			if(!mmapnsflag)
-			{
-			  if(mmapasflag)
-			    msync(wmaddr,(size_t)reclen,MS_ASYNC);
-			  if(mmapssflag)
-			    msync(wmaddr,(size_t)reclen,MS_SYNC);
-			}
+			fill_area((long long*)wmaddr,(long long*)nbuff,(long long)reclen);
 		}
 		else
 		{
-		   if(async_flag)
-		   {
+			if(async_flag)
+			{
 #ifdef ASYNC_IO
-			     if(no_copy_flag)
-			     {
-				free_addr=nbuff=(char *)malloc((size_t)reclen+page_size);
-				nbuff=(char *)(((long)nbuff+(long)page_size) & (long)~(page_size-1));
-				if(verify || dedup || dedup_interior)
-					fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)(current_offset/reclen));
-			        async_write_no_copy(gc, (long long)fd, nbuff, reclen, (current_offset), depth,free_addr);
-			     }
-			     else
-				async_write(gc, (long long)fd, nbuff, reclen, current_offset, depth);
-#endif
-		   }
-		   else
-		   {
-		      wval = write(fd, nbuff, (size_t) reclen);
-		      if(wval != reclen)
-		      {
-			if(*stop_flag && !stopped){
-				if(include_flush)
+			    if(no_copy_flag)
+			      async_read_no_copy(gc, (long long)fd, &buffer1, (current_offset),
+			      	 reclen, 0LL,(numrecs64*reclen),depth);
+			    else
+			      async_read(gc, (long long)fd, nbuff, (current_offset), reclen,
+			    	0LL,(numrecs64*reclen),depth);
+#endif
+			}
+			else
+			{
+	  		  if(I_READ(fd, nbuff, reclen) != reclen)
+	  		  {
+				if(*stop_flag)
 				{
-					if(mmapflag)
-						msync(maddr,(size_t)filebytes64,MS_SYNC);
-					else
-						fsync(fd);
+					if(debug1)
+						printf("\n(%ld) Stopped by another 2\n", (long)xx);
+					break;
 				}
-				temp_time = time_so_far();
-				child_stat->throughput = 
-					(temp_time - starttime1)-time_res;
-				if(child_stat->throughput < (double).000001) 
+#ifdef NO_PRINT_LLD
+				printf("\nError reading block at %ld\n",
+					 offset); 
+#else
+				printf("\nError reading block at %lld\n",
+					 offset); 
+#endif
+				perror("ranread");
+				if (!no_unlink)
 				{
-					child_stat->throughput= time_res;
-					if(rec_prob < reclen)
-						rec_prob = reclen;
-					res_prob=1;
-				}
-
-				if(OPS_flag){
-				   /*written_so_far=(written_so_far*1024)/reclen;*/
-				   written_so_far=w_traj_ops_completed;
+				   if(check_filename(dummyfile[xx]))
+					unlink(dummyfile[xx]);
 				}
-				child_stat->throughput = 
-				  (double)written_so_far/child_stat->throughput;
-				child_stat->actual = (double)written_so_far;
-				if(debug1)
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
+				exit(160);
+	 		  }
+			}
+		}
+		if(rlocking)
+		{
+			mylockr((int) fd, (int) 0, (int)1,
+			  lock_offset, reclen);
+		}
+		save_pos=current_offset/reclen;
+		current_offset+=reclen;
+		if(verify){
+		   if(async_flag && no_copy_flag)
+		   {
+#ifdef ASYNC_IO
+			if(verify_buffer(buffer1,reclen,(off64_t)save_pos,reclen,(long long)pattern,sverify)){
+				if (!no_unlink)
 				{
-					printf("\n(%ld) Stopped by another\n", (long)xx);
+				   if(check_filename(dummyfile[xx]))
+					unlink(dummyfile[xx]);
 				}
-				stopped=1;
-				goto again;
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
+				exit(161);
 			}
-			/* Note: Writer must finish even though told
-			   to stop. Otherwise the readers will fail.
-			   The code will capture bytes transfered
-			   before told to stop but let the writer
-			   complete.
-			*/
-#ifdef NO_PRINT_LLD
-		    	printf("\nError writing block %ld, fd= %d\n", i,
-				 fd);
-#else
-		    	printf("\nError writing block %lld, fd= %d\n", i,
-				 fd);
 #endif
-			if(wval==-1)
-				perror("write");
-			if (!no_unlink)
-			{
-		            if(check_filename(dummyfile[xx]))
-				unlink(dummyfile[xx]);
+		   }
+		   else
+		   {
+			if(verify_buffer(nbuff,reclen,(off64_t)save_pos,reclen,(long long)pattern,sverify)){
+				if (!no_unlink)
+				{
+				   if(check_filename(dummyfile[xx]))
+					unlink(dummyfile[xx]);
+				}
+				child_flag_set(child_stat,CHILD_STATE_HOLD);
+				exit(162);
 			}
-			child_stat->flag = CHILD_STATE_HOLD;
-		    	exit(127);
-		      }
-		    }
+		   }
 		}
-		if(rlocking)
+#ifdef ASYNC_IO
+		if(async_flag && no_copy_flag)
+			async_release(gc);
+#endif
+		ranread_so_far+=reclen/1024;
+		child_publish(child_stat,(double)ranread_so_far,(double)ranread_so_far*1024.0/(double)reclen);
+		if(*stop_flag)
 		{
-			mylockr((int) fd, (int) 0, (int)0,
-			  lock_offset, reclen);
+			ranread_so_far-=reclen/1024;
 		}
 		if(hist_summary)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-/*
-printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_time,
-	actual_rate, (desired_op_rate_time-actual_rate));
-*/
-			if( actual_rate < desired_op_rate_time)
-				my_unap((unsigned long long) ((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
-		if(Q_flag)
-		{
-			thread_qtime_stop=time_so_far();
+                if(Q_flag)
+                {
+                        thread_qtime_stop=time_so_far();
+                        if(thread_qtr)
+                        	trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+                        	  thread_qtime_stop-thread_qtime_start-time_res);
+                        else
 #ifdef NO_PRINT_LLD
-			fprintf(thread_randwqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
+                        fprintf(thread_randrfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
-			fprintf(thread_randwqfd,"%10.1lld %10.0f %10.1lld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
+                        fprintf(thread_randrfd,"%10.1lld %10.0f %10.1lld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #endif
-		}
-		w_traj_ops_completed++;
-		w_traj_bytes_completed+=reclen;
-		written_so_far+=reclen/1024;
-		if(*stop_flag)
-		{
-			written_so_far-=reclen/1024;
-			w_traj_bytes_completed-=reclen;
-		}
+                }
 	}
-	
-
 	if(file_lock)
-		if(mylockf((int) fd, (int) 0, (int)0))
-			printf("Write unlock failed. %d\n",errno);
-	
+		if(mylockf((int) fd,(int)0,(int)1))
+			printf("Read unlock failed %d\n",errno);
 #ifdef ASYNC_IO
 	if(async_flag)
 	{
@@ -19244,49 +21111,46 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 		gc=0;
 	}
 #endif
-	if(!xflag)
-	{
-		*stop_flag=1;
-#ifdef NET_BENCH
-		if(distributed && client_iozone)
-			send_stop();
-#endif
-	}
-	
 	if(include_flush)
 	{
 		if(mmapflag)
-			msync(maddr,(size_t)filebytes64,MS_SYNC);
-		else
+		{
+			msync(maddr,(size_t)(numrecs64*reclen),MS_SYNC);
+		}else
 			fsync(fd);
 	}
 	if(include_close)
-	{
+	{	
 		if(mmapflag)
-			mmap_end(maddr,(unsigned long long)filebytes64);
-		close(fd);
-	}
-	if(!stopped){
-		temp_time = time_so_far();
-		child_stat->throughput = ((temp_time - starttime1)-time_res)
-			-compute_val;
-		if(child_stat->throughput < (double).000001) 
 		{
-			child_stat->throughput= time_res;
-			if(rec_prob < reclen)
-				rec_prob = reclen;
-			res_prob=1;
-		}
-
-		if(OPS_flag){
-		   /*written_so_far=(written_so_far*1024)/reclen;*/
-		   written_so_far=w_traj_ops_completed;
+			mmap_end(maddr,(unsigned long long)numrecs64*reclen);
 		}
-		child_stat->throughput =
-			(double)written_so_far/child_stat->throughput;
-		child_stat->actual = (double)written_so_far;
+		close(fd);
+	}
+	temp_time = time_so_far();
+	child_stat=(struct child_stats *)&shmaddr[xx];
+	child_stat->throughput = ((temp_time - starttime1)-time_res)
+		-compute_val;
+	if(child_stat->throughput < (double).000001) 
+	{
+		child_stat->throughput= time_res;
+		if(rec_prob < reclen)
+			rec_prob = reclen;
+		res_prob=1;
+	}
+	if(OPS_flag){
+	   ranread_so_far=(ranread_so_far*1024)/reclen;
+	}
+	child_stat->throughput = ranread_so_far/child_stat->throughput;
+	child_stat->actual = ranread_so_far;
+	if(!xflag)
+	{
+		*stop_flag=1;
+#ifdef NET_BENCH
+		if(distributed && client_iozone)
+			send_stop();
+#endif
 	}
-	child_stat->flag = CHILD_STATE_HOLD; /* Tell parent I'm done */
         if(cdebug)
 	{
                 fprintf(newstdout,"Child %d: throughput %f actual %f \n",(int)chid,child_stat->throughput,
@@ -19304,48 +21168,43 @@ printf("Desired rate %g  Actual rate %g Nap %g microseconds\n",desired_op_rate_t
 	}
 #ifdef NET_BENCH
         if(distributed && client_iozone)
-                tell_master_stats(THREAD_RANDOM_WRITE_TEST, chid, child_stat->throughput,
+                tell_master_stats(THREAD_RANDOM_READ_TEST, chid, child_stat->throughput,
                         child_stat->actual,
 			child_stat->cputime, child_stat->walltime,
 			(char)*stop_flag,
                         (long long)CHILD_STATE_HOLD);
 #endif
-	stopped=0;
-	/*******************************************************************/
-	/* End random write performance test. ******************************/
-	/*******************************************************************/
-	if(debug1)
-#ifdef NO_PRINT_LLD
-		printf("\nChild finished %ld\n",xx);
-#else
-		printf("\nChild finished %lld\n",xx);
-#endif
+	child_flag_set(child_stat,CHILD_STATE_HOLD); 	/* Tell parent I'm done */
 	if(!include_close)
 	{
 		if(mmapflag)
 		{
-			msync(maddr,(size_t)numrecs64*reclen,MS_SYNC); /*Clean up before read starts running*/ 
+			msync(maddr,(size_t)(numrecs64*reclen),MS_SYNC);
 			mmap_end(maddr,(unsigned long long)numrecs64*reclen);
 		}else
 			fsync(fd);
-			
 		close(fd);
 	}
-	if(Q_flag && (thread_randwqfd !=0) )
-		fclose(thread_randwqfd);
+        if(Q_flag && !Q_bin_flag && (thread_randrfd !=0) )
+                fclose(thread_randrfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
 	free(dummyfile[xx]);
+	if(debug1)
+#ifdef NO_PRINT_LLD
+		printf("\nChild finished %ld\n",xx);
+#else
+		printf("\nChild finished %lld\n",xx);
+#endif
 
 	if(L_flag)
 	{
 		get_date(now_string);
-		fprintf(thread_Lwqfd,"%-25s %s","Random write finished: ",
-			now_string);
+		fprintf(thread_Lwqfd,"%-25s %s","Random read finished: ",now_string);
 		fclose(thread_Lwqfd);
 	}
-	if(recnum)
-		free(recnum);
 	if(hist_summary)
-	   dump_hist("Random Write",(int)xx);
+	   dump_hist("Random Read",(int)xx);
 	if(distributed && client_iozone)
 		return(0);
 #ifdef NO_THREADS
@@ -19360,104 +21219,1047 @@ return(0);
 }
 
 /************************************************************************/
-/* Thread cleanup test				        		*/
-/* This is not a measurement. It is a mechanism to cleanup all of the   */
-/* temporary files that were being used. This becomes very important    */
-/* when testing multiple clients over a network :-)                     */
+/* Thread random write test			        		*/
 /************************************************************************/
 #ifdef HAVE_ANSIC_C
 void *
-thread_cleanup_test(void *x)
+thread_ranwrite_test(void *x)
 #else
 void *
-thread_cleanup_test(x)
+thread_ranwrite_test( x)
 #endif
 {
-	long long xx;
-	struct child_stats *child_stat;
-	char *dummyfile[MAXSTREAMS];           /* name of dummy file     */
 
-	
-#ifdef NO_THREADS
-	xx=chid;
-#else
-	if(use_thread)
+	struct child_stats *child_stat;
+	double starttime1 = 0;
+	double temp_time;
+	double walltime, cputime;
+	double compute_val = (double)0;
+	float delay = (double)0;
+	double thread_qtime_stop,thread_qtime_start;
+	double hist_time;
+	struct rate_sched rsched = { 0.0, 0 };
+	struct dur_clock dclock;
+	int dur;
+	off64_t traj_offset;
+	off64_t current_offset=0;
+	long long flags;
+	long long w_traj_bytes_completed;
+	long long w_traj_ops_completed;
+	int fd;
+	long long recs_per_buffer;
+	long long stopped,i;
+	off64_t written_so_far, read_so_far, re_written_so_far,re_read_so_far;
+	long long xx,xx2;
+	char *dummyfile [MAXSTREAMS];           /* name of dummy file     */
+	char *nbuff=0;
+	char *maddr=0;
+	char *wmaddr=0;
+#ifdef ASYNC_IO
+	char *free_addr=0;
+#endif
+	int anwser,bind_cpu,wval;
+	off64_t filebytes64;
+	off64_t lock_offset=0;
+	char tmpname[256];
+	char now_string[30];
+	FILE *thread_randwqfd=0;
+	struct trace_ring *thread_qtr=0;
+	FILE *thread_Lwqfd=0;
+	struct perm recnum;
+	struct dist_walk walk;
+#if defined(VXFS) || defined(solaris)
+	int test_foo = 0;
+#endif
+
+#ifdef ASYNC_IO
+	struct cache *gc=0;
+#else
+/* igorv	long long *gc=0;*/
+#endif
+
+	if(compute_flag)
+		delay=compute_time;
+	hist_time=thread_qtime_stop=thread_qtime_start=0;
+	traj_offset=walltime=cputime=0;
+	anwser=bind_cpu=0;
+	filebytes64 = numrecs64*reclen;
+	written_so_far=read_so_far=re_written_so_far=re_read_so_far=0;
+	w_traj_bytes_completed=w_traj_ops_completed=0;
+	recs_per_buffer = cache_size/reclen ;
+	/* Every record once, in the same random order on each pass */
+	perm_init(&recnum,(unsigned long long)numrecs64,PERMSEED);
+	dist_setup((unsigned long long)numrecs64);
+#ifdef NO_THREADS
+	xx=chid;
+#else
+	if(use_thread)
+	{
 		xx = (long long)((long)x);
+	}
 	else
 	{
 		xx=chid;
 	}
 #endif
+#ifndef NO_THREADS
+#if defined( _HPUX_SOURCE ) || defined ( linux )
+	if(ioz_processor_bind)
+	{
+		 bind_cpu=(begin_proc+(int)xx)%num_processors;
+#if defined(_HPUX_SOURCE)
+		 pthread_processor_bind_np(PTHREAD_BIND_FORCED_NP,
+                         (pthread_spu_t *)&anwser, (pthread_spu_t)bind_cpu, pthread_self());
+#else
+     cpu_set_t cpuset;
+
+     CPU_ZERO(&cpuset);
+     CPU_SET(bind_cpu, &cpuset);
+
+     pthread_setaffinity_np(pthread_self(), sizeof(cpuset),&cpuset);
+#endif
+		my_nap(40);	/* Switch to new cpu */
+	}
+#endif
+#endif
+	if(use_thread)
+		nbuff=mem_local(barray[xx]);
+	else
+		nbuff=buffer;
+	if(debug1 )
+	{
+	   if(use_thread)
+#ifdef NO_PRINT_LLD
+		printf("\nStarting child %ld\n",xx);
+#else
+		printf("\nStarting child %lld\n",xx);
+#endif
+	   else
+#ifdef NO_PRINT_LLD
+		printf("\nStarting process %d slot %ld\n",getpid(),xx);
+#else
+		printf("\nStarting process %d slot %lld\n",getpid(),xx);
+#endif
+		
+	}
 	dummyfile[xx]=(char *)malloc((size_t)MAXNAMESIZE);
+	xx2=xx;
+	if(share_file)
+		xx2=(long long)0;
 	if(mfflag)
 	{
 #ifdef NO_PRINT_LLD
-		sprintf(dummyfile[xx],"%s",filearray[xx]);
+		sprintf(dummyfile[xx],"%s",filearray[xx2]);
 #else
-		sprintf(dummyfile[xx],"%s",filearray[xx]);
+		sprintf(dummyfile[xx],"%s",filearray[xx2]);
 #endif
 	}
 	else
 	{
 #ifdef NO_PRINT_LLD
-		sprintf(dummyfile[xx],"%s.DUMMY.%ld",filearray[xx],xx);
+		sprintf(dummyfile[xx],"%s.DUMMY.%ld",filearray[xx2],xx2);
 #else
-		sprintf(dummyfile[xx],"%s.DUMMY.%lld",filearray[xx],xx);
+		sprintf(dummyfile[xx],"%s.DUMMY.%lld",filearray[xx2],xx2);
 #endif
 	}
-	if(!no_unlink)
-	{
-	    if(check_filename(dummyfile[xx]))
-		unlink(dummyfile[xx]);
-	}
-
-	child_stat = (struct child_stats *)&shmaddr[xx];
 	/*****************/
 	/* Children only */
-	/*****************/
-	child_stat=(struct child_stats *)&shmaddr[xx];
-	child_stat->flag = CHILD_STATE_READY;
-	if(distributed && client_iozone)
+	/*******************************************************************/
+	/* Random write throughput performance test. **********************/
+	/*******************************************************************/
+	if(oflag)
+		flags=O_RDWR|O_SYNC|O_CREAT;
+	else
+		flags=O_RDWR|O_CREAT;
+#if defined(O_DSYNC)
+	if(odsync)
+		flags |= O_DSYNC;
+#endif
+#if defined(_HPUX_SOURCE) || defined(linux)
+	if(read_sync)
+		flags |=O_RSYNC|O_SYNC;
+#endif
+
+#if ! defined(DONT_HAVE_O_DIRECT)
+#if defined(linux) || defined(__AIX__) || defined(IRIX) || defined(IRIX64) || defined(Windows) || defined (__FreeBSD__)
+	if(direct_flag)
+		flags |=O_DIRECT;
+#endif
+#if defined(TRU64)
+	if(direct_flag)
+		flags |=O_DIRECTIO;
+#endif
+#endif
+#if defined(Windows)
+       	if(unbuffered)
         {
+        	hand=CreateFile(dummyfile[xx],
+		  GENERIC_READ|GENERIC_WRITE,
+	          FILE_SHARE_WRITE|FILE_SHARE_READ,
+		  NULL,OPEN_EXISTING,FILE_FLAG_NO_BUFFERING|
+		  FILE_FLAG_WRITE_THROUGH|FILE_FLAG_POSIX_SEMANTICS,
+		  NULL);
+       	}
+#endif
+	if((fd = I_OPEN(dummyfile[xx], ((int)flags),0640))<0)
+	{
+		client_error=errno;
 #ifdef NET_BENCH
-		tell_master_ready(chid);
-                wait_for_master_go(chid);
+		if(distributed && client_iozone)
+			send_stop();
 #endif
-        }
-        else
+		printf("\nCan not open temp file: %s\n", 
+			filename);
+		perror("open");
+		exit(125);
+	}
+#ifdef VXFS
+	if(direct_flag)
+	{
+		ioctl(fd,VX_SETCACHE,VX_DIRECT);
+		ioctl(fd,VX_GETCACHE,&test_foo);
+		if(test_foo == 0)
+		{
+			if(!client_iozone)
+			  printf("\nVxFS advanced setcache feature not available.\n");
+			exit(3);
+		}
+	}
+#endif
+#if defined(solaris)
+        if(direct_flag)
         {
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
-                        Poll((long long)1);
+                test_foo = directio(fd, DIRECTIO_ON);
+                if(test_foo != 0)
+                {
+                        if(!client_iozone)
+                          printf("\ndirectio not available.\n");
+                        exit(3);
+                }
         }
+#endif
+#ifdef ASYNC_IO
+	if(async_flag)
+		async_init(&gc,fd,direct_flag);
+#endif
+	if(mmapflag)
+	{
+		maddr=(char *)initfile(fd,(filebytes64),1,PROT_READ|PROT_WRITE);
+	}
+	if(reclen < cache_size )
+	{
+		recs_per_buffer = cache_size/reclen ;
+		nbuff=&nbuff[(xx%recs_per_buffer)*reclen];
+	}
+	if(fetchon)			/* Prefetch into processor cache */
+		fetchit(nbuff,reclen);
 
-	*stop_flag=1;
-#ifdef NET_BENCH
+	child_stat = (struct child_stats *)&shmaddr[xx];	
+	child_stat->throughput = 0;
+	child_stat->actual = 0;
+	if(hist_summary)
+		hist_reset((int)xx);
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY); /* Tell parent child is ready to go */
 	if(distributed && client_iozone)
-		send_stop();
-        if(distributed && client_iozone)
-                tell_master_stats(THREAD_CLEANUP_TEST, chid, child_stat->throughput,
-                        child_stat->actual,
-			child_stat->cputime, child_stat->walltime,
-			(char)*stop_flag,
-                        (long long)CHILD_STATE_HOLD);
-#endif
-	child_stat->flag = CHILD_STATE_HOLD; 	/* Tell parent I'm done */
-	free(dummyfile[xx]);
+	{
 #ifdef NET_BENCH
-	if(distributed && client_iozone)
-		return(0);
+		tell_master_ready(chid);
+		wait_for_master_go(chid);
 #endif
-#ifdef NO_THREADS
-	exit(0);
-#else
-	if(use_thread)
-		thread_exit();
+	}
 	else
-		exit(0);
+	{
+		while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+			Poll((long long)1);
+	}
+	written_so_far=0;
+	child_stat = (struct child_stats *)&shmaddr[xx];
+	child_stat->actual = 0;
+	child_stat->throughput = 0;
+	stopped=0;
+	if(file_lock)
+		if(mylockf((int) fd, (int) 1, (int)0) != 0)
+			printf("File lock for write failed. %d\n",errno);
+	if(Q_flag && !Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_randwol.dat",(int)xx);
+		thread_randwqfd=fopen(tmpname,"a");
+		if(thread_randwqfd==0)
+		{
+			client_error=errno;
+#ifdef NET_BENCH
+			if(distributed && client_iozone)
+				send_stop();
 #endif
-return(0);
-}
-
+			printf("Unable to open %s\n",tmpname);
+			exit(40);
+		}
+		fprintf(thread_randwqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
+	}
+	if(Q_flag && Q_bin_flag)
+	{
+		sprintf(tmpname,"Child_%d_randwol.dat",(int)xx);
+		thread_qtr=trace_open((int)xx,tmpname,
+			"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+			TRACE_OP_RANDOM_WRITE);
+		if(thread_qtr==0)
+		{
+			printf("Unable to allocate trace ring for %s\n",tmpname);
+			exit(40);
+		}
+	}
+	if(L_flag)
+	{
+		sprintf(tmpname,"Child_%d.log",(int)xx);
+		thread_Lwqfd=fopen(tmpname,"a");
+		if(thread_Lwqfd==0)
+		{
+			client_error=errno;
+#ifdef NET_BENCH
+			if(distributed && client_iozone)
+				send_stop();
+#endif
+			printf("Unable to open %s\n",tmpname);
+			exit(40);
+		}
+		get_date(now_string);
+		fprintf(thread_Lwqfd,"%-25s %s","Random write start: ",
+			now_string);
+	}
+	if((verify && !no_copy_flag) || dedup || dedup_interior)
+		fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)0);
+	starttime1 = time_so_far();
+	if(cpuutilflag)
+	{
+		walltime = starttime1;
+		cputime = cputime_so_far();
+	}
+	dist_start(&walk,(int)xx);
+	dur_start(&dclock,(long long)xx);
+	for(i=0; i<numrecs64 || dur_secs != 0.0; i++){
+		if(dur_secs != 0.0 &&
+		   (dur=dur_next(&dclock,(long long *)&i,-1)) != DUR_RUN)
+		{
+			if(dur == DUR_DONE)
+				break;
+			if(dur == DUR_RAMPED)
+			{
+				written_so_far=0;
+				w_traj_ops_completed=0;
+				dur_restart((int)xx,&starttime1,&walltime,
+					&cputime,&compute_val);
+			}
+		}
+		if(compute_flag)
+			compute_val+=do_compute(delay);
+		current_offset = reclen * (long long)dist_record(&walk,&recnum,
+			(unsigned long long)i);
+
+		if (!(h_flag || k_flag || mmapflag))
+		{
+		  if(I_LSEEK( fd, current_offset, SEEK_SET )<0)
+		  {
+			client_error=errno;
+#ifdef NET_BENCH
+			if(distributed && client_iozone)
+				send_stop();
+#endif
+			perror("lseek");
+			exit(158);
+		  };
+		}
+		if(Q_flag || hist_summary || op_rate_flag)
+		{
+			traj_offset=I_LSEEK(fd,0,SEEK_CUR);
+                        if(op_rate_flag)
+                            thread_qtime_start=rate_wait(&rsched,(long long)xx);
+                        else
+                            thread_qtime_start=time_so_far();
+		}
+		if(rlocking)
+		{
+			lock_offset=I_LSEEK(fd,0,SEEK_CUR);
+			mylockr((int) fd, (int) 1, (int)0,
+			  lock_offset, reclen);
+		}
+		if((verify && !no_copy_flag) || dedup || dedup_interior)
+			fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)(current_offset/reclen));
+		if(*stop_flag && !stopped){
+			if(include_flush)
+			{
+				if(mmapflag)
+					msync(maddr,(size_t)filebytes64,MS_SYNC);
+				else
+					fsync(fd);
+			}
+			child_stat->throughput = 
+				(time_so_far() - starttime1)-time_res;
+			if(child_stat->throughput < (double).000001) 
+			{
+				child_stat->throughput = time_res;
+				if(rec_prob < reclen)
+					rec_prob = reclen;
+				res_prob=1;
+			}
+
+			if(OPS_flag){
+			   /*written_so_far=(written_so_far*1024)/reclen;*/
+			   written_so_far=w_traj_ops_completed;
+			}
+			child_stat->throughput = 
+			  (double)written_so_far/child_stat->throughput;
+			child_stat->actual = (double)written_so_far;
+			if(debug1)
+			{
+				printf("\n(%ld) Stopped by another\n", (long)xx);
+			}
+			stopped=1;
+		}
+		if(purge)
+			purgeit(nbuff,reclen);
+		if(Q_flag || hist_summary)
+		{
+			thread_qtime_start=time_so_far();
+		}
+again:		
+		if(mmapflag)
+		{
+			wmaddr = &maddr[current_offset];
+			fill_area((long long*)nbuff,(long long*)wmaddr,(long long)reclen);
+			if(!mmapnsflag)
+			{
+			  if(mmapasflag)
+			    msync(wmaddr,(size_t)reclen,MS_ASYNC);
+			  if(mmapssflag)
+			    msync(wmaddr,(size_t)reclen,MS_SYNC);
+			}
+		}
+		else
+		{
+		   if(async_flag)
+		   {
+#ifdef ASYNC_IO
+			     if(no_copy_flag)
+			     {
+				free_addr=nbuff=async_write_buffer(gc,reclen,depth);
+				if(verify || dedup || dedup_interior)
+					fill_buffer(nbuff,reclen,(long long)pattern,sverify,(long long)(current_offset/reclen));
+			        async_write_no_copy(gc, (long long)fd, nbuff, reclen, (current_offset), depth,free_addr);
+			     }
+			     else
+				async_write(gc, (long long)fd, nbuff, reclen, current_offset, depth);
+#endif
+		   }
+		   else
+		   {
+		      wval = I_WRITE(fd, nbuff, reclen);
+		      if(wval != reclen)
+		      {
+			if(*stop_flag && !stopped){
+				if(include_flush)
+				{
+					if(mmapflag)
+						msync(maddr,(size_t)filebytes64,MS_SYNC);
+					else
+						fsync(fd);
+				}
+				temp_time = time_so_far();
+				child_stat->throughput = 
+					(temp_time - starttime1)-time_res;
+				if(child_stat->throughput < (double).000001) 
+				{
+					child_stat->throughput= time_res;
+					if(rec_prob < reclen)
+						rec_prob = reclen;
+					res_prob=1;
+				}
+
+				if(OPS_flag){
+				   /*written_so_far=(written_so_far*1024)/reclen;*/
+				   written_so_far=w_traj_ops_completed;
+				}
+				child_stat->throughput = 
+				  (double)written_so_far/child_stat->throughput;
+				child_stat->actual = (double)written_so_far;
+				if(debug1)
+				{
+					printf("\n(%ld) Stopped by another\n", (long)xx);
+				}
+				stopped=1;
+				goto again;
+			}
+			/* Note: Writer must finish even though told
+			   to stop. Otherwise the readers will fail.
+			   The code will capture bytes transfered
+			   before told to stop but let the writer
+			   complete.
+			*/
+#ifdef NO_PRINT_LLD
+		    	printf("\nError writing block %ld, fd= %d\n", i,
+				 fd);
+#else
+		    	printf("\nError writing block %lld, fd= %d\n", i,
+				 fd);
+#endif
+			if(wval==-1)
+				perror("write");
+			if (!no_unlink)
+			{
+		            if(check_filename(dummyfile[xx]))
+				unlink(dummyfile[xx]);
+			}
+			child_flag_set(child_stat,CHILD_STATE_HOLD);
+		    	exit(127);
+		      }
+		    }
+		}
+		if(rlocking)
+		{
+			mylockr((int) fd, (int) 0, (int)0,
+			  lock_offset, reclen);
+		}
+		if(hist_summary)
+		{
+			thread_qtime_stop=time_so_far();
+			hist_time =(thread_qtime_stop-thread_qtime_start-time_res);
+			hist_insert((int)xx,hist_time);
+		}
+		if(Q_flag)
+		{
+			thread_qtime_stop=time_so_far();
+			if(thread_qtr)
+				trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+				  thread_qtime_stop-thread_qtime_start-time_res);
+			else
+#ifdef NO_PRINT_LLD
+			fprintf(thread_randwqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
+#else
+			fprintf(thread_randwqfd,"%10.1lld %10.0f %10.1lld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
+#endif
+		}
+		w_traj_ops_completed++;
+		w_traj_bytes_completed+=reclen;
+		written_so_far+=reclen/1024;
+		child_publish(child_stat,(double)written_so_far,(double)written_so_far*1024.0/(double)reclen);
+		if(*stop_flag)
+		{
+			written_so_far-=reclen/1024;
+			w_traj_bytes_completed-=reclen;
+		}
+	}
+	
+
+	if(file_lock)
+		if(mylockf((int) fd, (int) 0, (int)0))
+			printf("Write unlock failed. %d\n",errno);
+	
+#ifdef ASYNC_IO
+	if(async_flag)
+	{
+		end_async(gc);
+		gc=0;
+	}
+#endif
+	if(!xflag)
+	{
+		*stop_flag=1;
+#ifdef NET_BENCH
+		if(distributed && client_iozone)
+			send_stop();
+#endif
+	}
+	
+	if(include_flush)
+	{
+		if(mmapflag)
+			msync(maddr,(size_t)filebytes64,MS_SYNC);
+		else
+			fsync(fd);
+	}
+	if(include_close)
+	{
+		if(mmapflag)
+			mmap_end(maddr,(unsigned long long)filebytes64);
+		close(fd);
+	}
+	if(!stopped){
+		temp_time = time_so_far();
+		child_stat->throughput = ((temp_time - starttime1)-time_res)
+			-compute_val;
+		if(child_stat->throughput < (double).000001) 
+		{
+			child_stat->throughput= time_res;
+			if(rec_prob < reclen)
+				rec_prob = reclen;
+			res_prob=1;
+		}
+
+		if(OPS_flag){
+		   /*written_so_far=(written_so_far*1024)/reclen;*/
+		   written_so_far=w_traj_ops_completed;
+		}
+		child_stat->throughput =
+			(double)written_so_far/child_stat->throughput;
+		child_stat->actual = (double)written_so_far;
+	}
+	child_flag_set(child_stat,CHILD_STATE_HOLD); /* Tell parent I'm done */
+        if(cdebug)
+	{
+                fprintf(newstdout,"Child %d: throughput %f actual %f \n",(int)chid,child_stat->throughput,
+                        child_stat->actual);
+		fflush(newstdout);
+	}
+	if(cpuutilflag)
+	{
+		cputime = cputime_so_far() - cputime;
+		if (cputime < cputime_res)
+			cputime = 0.0;
+		child_stat->cputime = cputime;
+		walltime = time_so_far() - walltime;
+		child_stat->walltime = walltime;
+	}
+#ifdef NET_BENCH
+        if(distributed && client_iozone)
+                tell_master_stats(THREAD_RANDOM_WRITE_TEST, chid, child_stat->throughput,
+                        child_stat->actual,
+			child_stat->cputime, child_stat->walltime,
+			(char)*stop_flag,
+                        (long long)CHILD_STATE_HOLD);
+#endif
+	stopped=0;
+	/*******************************************************************/
+	/* End random write performance test. ******************************/
+	/*******************************************************************/
+	if(debug1)
+#ifdef NO_PRINT_LLD
+		printf("\nChild finished %ld\n",xx);
+#else
+		printf("\nChild finished %lld\n",xx);
+#endif
+	if(!include_close)
+	{
+		if(mmapflag)
+		{
+			msync(maddr,(size_t)numrecs64*reclen,MS_SYNC); /*Clean up before read starts running*/ 
+			mmap_end(maddr,(unsigned long long)numrecs64*reclen);
+		}else
+			fsync(fd);
+			
+		close(fd);
+	}
+	if(Q_flag && !Q_bin_flag && (thread_randwqfd !=0) )
+		fclose(thread_randwqfd);
+	if(thread_qtr)
+		trace_close(thread_qtr);
+	free(dummyfile[xx]);
+
+	if(L_flag)
+	{
+		get_date(now_string);
+		fprintf(thread_Lwqfd,"%-25s %s","Random write finished: ",
+			now_string);
+		fclose(thread_Lwqfd);
+	}
+	if(hist_summary)
+	   dump_hist("Random Write",(int)xx);
+	if(distributed && client_iozone)
+		return(0);
+#ifdef NO_THREADS
+	exit(0);
+#else
+	if(use_thread)
+		thread_exit();
+	else
+		exit(0);
+#endif
+return(0);
+}
+
+/************************************************************************/
+/* Thread cleanup test				        		*/
+/* This is not a measurement. It is a mechanism to cleanup all of the   */
+/* temporary files that were being used. This becomes very important    */
+/* when testing multiple clients over a network :-)                     */
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+void *
+thread_cleanup_test(void *x)
+#else
+void *
+thread_cleanup_test(x)
+#endif
+{
+	long long xx;
+	struct child_stats *child_stat;
+	char *dummyfile[MAXSTREAMS];           /* name of dummy file     */
+
+	
+#ifdef NO_THREADS
+	xx=chid;
+#else
+	if(use_thread)
+		xx = (long long)((long)x);
+	else
+	{
+		xx=chid;
+	}
+#endif
+	dummyfile[xx]=(char *)malloc((size_t)MAXNAMESIZE);
+	if(mfflag)
+	{
+#ifdef NO_PRINT_LLD
+		sprintf(dummyfile[xx],"%s",filearray[xx]);
+#else
+		sprintf(dummyfile[xx],"%s",filearray[xx]);
+#endif
+	}
+	else
+	{
+#ifdef NO_PRINT_LLD
+		sprintf(dummyfile[xx],"%s.DUMMY.%ld",filearray[xx],xx);
+#else
+		sprintf(dummyfile[xx],"%s.DUMMY.%lld",filearray[xx],xx);
+#endif
+	}
+	if(!no_unlink)
+	{
+	    if(check_filename(dummyfile[xx]))
+		unlink(dummyfile[xx]);
+	}
+
+	child_stat = (struct child_stats *)&shmaddr[xx];
+	/*****************/
+	/* Children only */
+	/*****************/
+	child_stat=(struct child_stats *)&shmaddr[xx];
+	child_publish(child_stat,0.0,0.0);
+	child_flag_set(child_stat,CHILD_STATE_READY);
+	if(distributed && client_iozone)
+        {
+#ifdef NET_BENCH
+		tell_master_ready(chid);
+                wait_for_master_go(chid);
+#endif
+        }
+        else
+        {
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+                        Poll((long long)1);
+        }
+
+	*stop_flag=1;
+#ifdef NET_BENCH
+	if(distributed && client_iozone)
+		send_stop();
+        if(distributed && client_iozone)
+                tell_master_stats(THREAD_CLEANUP_TEST, chid, child_stat->throughput,
+                        child_stat->actual,
+			child_stat->cputime, child_stat->walltime,
+			(char)*stop_flag,
+                        (long long)CHILD_STATE_HOLD);
+#endif
+	child_flag_set(child_stat,CHILD_STATE_HOLD); 	/* Tell parent I'm done */
+	free(dummyfile[xx]);
+#ifdef NET_BENCH
+	if(distributed && client_iozone)
+		return(0);
+#endif
+#ifdef NO_THREADS
+	exit(0);
+#else
+	if(use_thread)
+		thread_exit();
+	else
+		exit(0);
+#endif
+return(0);
+}
+
+
+/************************************************************************/
+/* pool_topology() Orders the CPUs this process may run on for -+G.	*/
+/* compact fills one NUMA node at a time with hyperthread siblings next	*/
+/* to each other, scatter deals the first thread of every core across	*/
+/* the nodes before using any siblings. Worker n gets entry n modulo	*/
+/* the list, rotated by the -P starting CPU.				*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static int
+pool_sysfs(char *path)
+#else
+static int
+pool_sysfs(path)
+char *path;
+#endif
+{
+	FILE *fp;
+	int val = -1;
+
+	if((fp=fopen(path,"r")) == 0)
+		return(-1);
+	if(fscanf(fp,"%d",&val) != 1)
+		val = -1;
+	fclose(fp);
+	return(val);
+}
+
+#ifdef HAVE_ANSIC_C
+void
+pool_topology(void)
+#else
+void
+pool_topology()
+#endif
+{
+	static int cpu[POOL_MAXCPU], node[POOL_MAXCPU], core[POOL_MAXCPU];
+	static int thr[POOL_MAXCPU], rank[POOL_MAXCPU], key[POOL_MAXCPU][3];
+	static int order[POOL_MAXCPU];
+	char path[256];
+	int n = 0, i, j, k, t, lo, hi, nodes = 0;
+	FILE *fp;
+
+#if defined(linux) && !defined(NO_THREADS)
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	if(sched_getaffinity(0,sizeof(set),&set) == 0)
+	{
+		for(i=0;i<CPU_SETSIZE && n<POOL_MAXCPU;i++)
+			if(CPU_ISSET(i,&set))
+				cpu[n++]=i;
+	}
+#endif
+	if(n == 0)
+	{
+		/*
+		 * No affinity mask, as on RTEMS and NO_THREADS builds. Only
+		 * -P sets num_processors, so ask for the online CPUs instead
+		 * of placing every -+G worker, or RTEMS task, on CPU 0.
+		 */
+		if(num_processors <= 0)
+			num_processors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		if(num_processors <= 0)
+			num_processors = 1;
+		for(i=0;i<num_processors && n<POOL_MAXCPU;i++)
+			cpu[n++]=i;
+	}
+	for(i=0;i<n;i++)
+	{
+		node[i] = -1;
+		sprintf(path,"/sys/devices/system/cpu/cpu%d/topology/physical_package_id",cpu[i]);
+		k = pool_sysfs(path);
+		sprintf(path,"/sys/devices/system/cpu/cpu%d/topology/core_id",cpu[i]);
+		t = pool_sysfs(path);
+		/* Unique core number, or the CPU itself if sysfs is absent */
+		core[i] = (t < 0) ? cpu[i] : ((k < 0 ? 0 : k)*65536 + t);
+		rank[i] = (k < 0) ? 0 : k;	/* Package, until a node is found */
+	}
+	for(j=0;j<POOL_MAXNODE;j++)
+	{
+		sprintf(path,"/sys/devices/system/node/node%d/cpulist",j);
+		if((fp=fopen(path,"r")) == 0)
+			continue;
+		nodes++;
+		while(fscanf(fp,"%d",&lo) == 1)
+		{
+			hi = lo;
+			if((t=getc(fp)) == '-')
+			{
+				if(fscanf(fp,"%d",&hi) != 1)
+					break;
+				t=getc(fp);
+			}
+			for(i=0;i<n;i++)
+				if(cpu[i] >= lo && cpu[i] <= hi)
+					node[i] = j;
+			if(t != ',')
+				break;
+		}
+		fclose(fp);
+	}
+	for(i=0;i<n;i++)
+		if(nodes == 0 || node[i] < 0)
+			node[i] = rank[i];
+	/* Sibling number within the core, and core number within the node */
+	for(i=0;i<n;i++)
+	{
+		thr[i] = 0;
+		for(j=0;j<i;j++)
+			if(core[j] == core[i])
+				thr[i]++;
+	}
+	for(i=0;i<n;i++)
+	{
+		rank[i] = 0;
+		for(j=0;j<n;j++)
+			if(node[j] == node[i] && thr[j] == 0 && core[j] < core[i])
+				rank[i]++;
+	}
+	for(i=0;i<n;i++)
+	{
+		order[i] = i;
+		switch(pool_policy)
+		{
+		case POOL_COMPACT:
+			key[i][0]=node[i]; key[i][1]=core[i]; key[i][2]=thr[i];
+			break;
+		case POOL_SCATTER:
+			key[i][0]=thr[i]; key[i][1]=rank[i]; key[i][2]=node[i];
+			break;
+		default:
+			key[i][0]=0; key[i][1]=0; key[i][2]=i;
+			break;
+		}
+	}
+	for(i=1;i<n;i++)	/* Insertion sort, stable */
+	{
+		t = order[i];
+		for(j=i;j>0;j--)
+		{
+			k = order[j-1];
+			if(key[k][0] < key[t][0] || (key[k][0] == key[t][0] &&
+			   (key[k][1] < key[t][1] || (key[k][1] == key[t][1] &&
+			    key[k][2] <= key[t][2]))))
+				break;
+			order[j] = k;
+		}
+		order[j] = t;
+	}
+	for(i=0;i<n;i++)
+		pool_cpus[i] = cpu[order[(i+begin_proc)%n]];
+	pool_ncpus = n;
+	if(debug1)
+	{
+		printf("Worker pool CPUs:");
+		for(i=0;i<n;i++)
+			printf(" %d",pool_cpus[i]);
+		printf("\n");
+	}
+}
+
+#ifndef NO_THREADS
+/************************************************************************/
+/* pool_main() A -+G worker. Pins itself once, then runs each phase it	*/
+/* is handed and parks until the next one or pool_stop().		*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static void *
+pool_main(void *x)
+#else
+static void *
+pool_main(x)
+void *x;
+#endif
+{
+	struct pool_worker *w = &pool_w[(long)x];
+	void *(*func)(void *);
+#if defined(_HPUX_SOURCE)
+	int anwser;
+#endif
+
+	if(w->cpu >= 0)
+	{
+#if defined(_HPUX_SOURCE)
+		pthread_processor_bind_np(PTHREAD_BIND_FORCED_NP,
+			(pthread_spu_t *)&anwser, (pthread_spu_t)w->cpu, pthread_self());
+#elif defined(linux)
+		cpu_set_t cpuset;
+
+		CPU_ZERO(&cpuset);
+		CPU_SET(w->cpu, &cpuset);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuset),&cpuset);
+#endif
+	}
+	pthread_mutex_lock(&pool_lock);
+	for(;;)
+	{
+		while(w->func == 0 && !pool_quit)
+			pthread_cond_wait(&w->go,&pool_lock);
+		if(w->func == 0)
+			break;
+		func = w->func;
+		pthread_mutex_unlock(&pool_lock);
+		(*func)(w->arg);
+		pthread_mutex_lock(&pool_lock);
+		w->func = 0;
+		pthread_cond_broadcast(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	return(0);
+}
+
+/************************************************************************/
+/* pool_dispatch() Hands a phase to worker x, starting it the first	*/
+/* time it is needed.							*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static long long
+pool_dispatch(void *(*func)(void *), void *x)
+#else
+static long long
+pool_dispatch(func, x)
+void *(*func)(void *);
+void *x;
+#endif
+{
+	long id = (long)x;
+	struct pool_worker *w = &pool_w[id];
+
+	if(!w->started)
+	{
+		w->cpu = (pool_policy != POOL_NONE && pool_ncpus > 0) ?
+			pool_cpus[id % pool_ncpus] : -1;
+		pthread_cond_init(&w->go, 0);
+		if(pthread_create(&w->tid, 0, pool_main, (void *)id) != 0)
+		{
+			printf("Worker create failed. Errno = %d\n",errno);
+			return(-1);
+		}
+		w->started = 1;
+		bcopy(&w->tid,&p_childids[id],sizeof(pthread_t));
+		if(debug1)
+			printf("Worker %ld on cpu %d\n",id,w->cpu);
+	}
+	pthread_mutex_lock(&pool_lock);
+	w->arg = x;
+	w->func = func;
+	pthread_cond_signal(&w->go);
+	pthread_mutex_unlock(&pool_lock);
+	return((long long)id);
+}
+#endif
+
+/************************************************************************/
+/* pool_stop() Releases the -+G workers at the end of the run.		*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+void
+pool_stop(void)
+#else
+void
+pool_stop()
+#endif
+{
+#ifndef NO_THREADS
+	int i;
+
+	if(!pool_flag)
+		return;
+	pthread_mutex_lock(&pool_lock);
+	pool_quit = 1;
+	for(i=0;i<=MAXSTREAMS;i++)
+		if(pool_w[i].started)
+			pthread_cond_signal(&pool_w[i].go);
+	pthread_mutex_unlock(&pool_lock);
+	for(i=0;i<=MAXSTREAMS;i++)
+		if(pool_w[i].started)
+		{
+			pthread_join(pool_w[i].tid, 0);
+			pool_w[i].started = 0;
+		}
+#endif
+}
 
 /************************************************************************/
 /* mythread_create() Internal routine that calls pthread_create()	*/
@@ -19486,6 +22288,8 @@ void *x;
 #endif
 	yy=(int *)x;
 
+	if(pool_flag)
+		return(pool_dispatch(func,x));
 
 #ifdef OSFV3
 	
@@ -19535,6 +22339,8 @@ int
 thread_exit()
 #endif
 {
+	if(pool_flag)
+		return(0);	/* Back to the pool loop */
 	pthread_exit((void *)NULL);
 return(0);
 }
@@ -19600,6 +22406,14 @@ void *status;
 	pthread_t eek;
 	pthread_attr_t foo;
 
+	if(pool_flag)
+	{
+		pthread_mutex_lock(&pool_lock);
+		while(pool_w[tid].func != 0)
+			pthread_cond_wait(&pool_done,&pool_lock);
+		pthread_mutex_unlock(&pool_lock);
+		return(0);
+	}
 	bcopy(&p_childids[tid],&eek,sizeof(pthread_t));
 	xx=pthread_join(eek,(void **)&foo);
 	if(xx<0)
@@ -19915,6 +22729,10 @@ int flag, prot;
 		mflags=MAP_FILE|MAP_PRIVATE;
 #endif
 #endif
+#ifdef MAP_POPULATE
+	if(mmap_populate)
+		mflags|=MAP_POPULATE;
+#endif
 
 #if defined(bsd4_2) && !defined(macosx)
 	 pa = (char *)mmap( 0,&filebytes, (int)prot, 
@@ -20028,10 +22846,242 @@ long long length;
 #endif
 {
 	/*printf("Fill area %d\n",(size_t)length);*/
+#ifdef __rtems__
+	emap_touch((char *)src_buffer,length,0);
+	emap_touch((char *)dest_buffer,length,1);
+#endif
 	bcopy((void *)src_buffer,(void *)dest_buffer,(size_t)length);
 }
 
-#ifdef ASYNC_IO
+#ifdef __rtems__
+/************************************************************************/
+/* mmap() emulation for RTEMS, which has no MMU backed mappings.	*/
+/* A file mapping is a page aligned image of the file range plus a	*/
+/* state byte per page. fill_area(), the only way iozone touches mapped	*/
+/* memory, calls emap_touch() which reads absent pages in from the	*/
+/* file, like a page fault would, and marks stored to pages dirty.	*/
+/* msync(MS_SYNC) and munmap() write the dirty pages of a MAP_SHARED	*/
+/* mapping back with pwrite(). MS_ASYNC leaves them dirty, as the Linux	*/
+/* page cache does. MAP_POPULATE reads the whole range at mmap() time.	*/
+/* Mappings sit in a fixed table whose slots are claimed with compare	*/
+/* and swap, so the child tasks need no lock.				*/
+/************************************************************************/
+#define EMAP_PAGE	4096
+#define EMAP_MAX	(MAXSTREAMS+16)
+#define EMAP_ABSENT	0
+#define EMAP_CLEAN	1
+#define EMAP_DIRTY	2
+
+struct emap {
+	int used;			/* slot claimed */
+	char *addr;			/* page aligned image, 0 when unmapped */
+	char *real;			/* Real address to free */
+	size_t len;
+	size_t pages;
+	int fd;				/* -1 for MAP_ANONYMOUS */
+	off_t off;
+	int flags;
+	unsigned char *state;		/* EMAP_xxx per page */
+};
+static struct emap emap_tab[EMAP_MAX];
+static int emap_top;			/* slots ever used */
+
+static struct emap *
+emap_find(char *addr)
+{
+	struct emap *m;
+	char *base;
+	int i,top;
+
+	top=__atomic_load_n(&emap_top,__ATOMIC_ACQUIRE);
+	for(i=0;i<top;i++)
+	{
+		m=&emap_tab[i];
+		base=__atomic_load_n(&m->addr,__ATOMIC_ACQUIRE);
+		if(base && addr >= base && addr < base+m->len)
+			return(m);
+	}
+	return(0);
+}
+
+/* Read the absent pages in [first,last), a run per pread() */
+static int
+emap_load(struct emap *m, size_t first, size_t last)
+{
+	size_t i,j,len;
+	ssize_t got;
+
+	for(i=first;i<last;i=j)
+	{
+		if(m->state[i] != EMAP_ABSENT)
+		{
+			j=i+1;
+			continue;
+		}
+		for(j=i+1;j<last && m->state[j]==EMAP_ABSENT;j++)
+			;
+		len=(j-i)*EMAP_PAGE;
+		if(i*EMAP_PAGE+len > m->len)
+			len=m->len-i*EMAP_PAGE;
+		got=pread(m->fd,m->addr+i*EMAP_PAGE,len,m->off+(off_t)(i*EMAP_PAGE));
+		if(got < 0)
+			return(-1);
+		if((size_t)got < len)	/* Past end of file */
+			bzero(m->addr+i*EMAP_PAGE+got,len-got);
+		memset(&m->state[i],EMAP_CLEAN,j-i);
+	}
+	return(0);
+}
+
+/* Write the dirty pages in [first,last) back, a run per pwrite() */
+static int
+emap_flush(struct emap *m, size_t first, size_t last)
+{
+	size_t i,j,len;
+
+	for(i=first;i<last;i=j)
+	{
+		if(m->state[i] != EMAP_DIRTY)
+		{
+			j=i+1;
+			continue;
+		}
+		for(j=i+1;j<last && m->state[j]==EMAP_DIRTY;j++)
+			;
+		len=(j-i)*EMAP_PAGE;
+		if(i*EMAP_PAGE+len > m->len)
+			len=m->len-i*EMAP_PAGE;
+		if(pwrite(m->fd,m->addr+i*EMAP_PAGE,len,m->off+(off_t)(i*EMAP_PAGE))
+			!= (ssize_t)len)
+			return(-1);
+		memset(&m->state[i],EMAP_CLEAN,j-i);
+	}
+	return(0);
+}
+
+static void
+emap_touch(char *addr, long long len, int write)
+{
+	struct emap *m;
+	size_t first,last;
+
+	if((m=emap_find(addr)) == 0)
+		return;
+	first=(size_t)(addr-m->addr)/EMAP_PAGE;
+	last=((size_t)(addr-m->addr)+(size_t)len+EMAP_PAGE-1)/EMAP_PAGE;
+	if(last > m->pages)
+		last=m->pages;
+	if(m->fd >= 0 && emap_load(m,first,last) < 0)
+	{
+		printf("Mapping read failed, errno %d\n",errno);
+		exit(166);
+	}
+	if(write)
+		memset(&m->state[first],EMAP_DIRTY,last-first);
+}
+
+static void *
+mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	struct emap *m;
+	int i,top;
+
+	if(length == 0)
+	{
+		errno=EINVAL;
+		return(MAP_FAILED);
+	}
+	for(i=0;i<EMAP_MAX;i++)
+		if(__sync_bool_compare_and_swap(&emap_tab[i].used,0,1))
+			break;
+	if(i == EMAP_MAX)
+	{
+		errno=ENOMEM;
+		return(MAP_FAILED);
+	}
+	m=&emap_tab[i];
+	m->pages=(length+EMAP_PAGE-1)/EMAP_PAGE;
+	m->real=(char *)malloc(m->pages*EMAP_PAGE+EMAP_PAGE);
+	m->state=(unsigned char *)malloc(m->pages);
+	if(m->real == 0 || m->state == 0)
+	{
+		free(m->real);
+		free(m->state);
+		__atomic_store_n(&m->used,0,__ATOMIC_RELEASE);
+		errno=ENOMEM;
+		return(MAP_FAILED);
+	}
+	m->len=length;
+	m->off=offset;
+	m->flags=flags;
+	if(flags & MAP_ANONYMOUS)
+	{
+		m->fd=-1;
+		bzero(m->real,m->pages*EMAP_PAGE+EMAP_PAGE);
+		memset(m->state,EMAP_CLEAN,m->pages);
+	}
+	else
+	{
+		m->fd=fd;
+		memset(m->state,EMAP_ABSENT,m->pages);
+	}
+	__atomic_store_n(&m->addr,
+		(char *)(((long)m->real+EMAP_PAGE-1) & ~((long)EMAP_PAGE-1)),
+		__ATOMIC_RELEASE);
+	while((top=__atomic_load_n(&emap_top,__ATOMIC_ACQUIRE)) <= i)
+		__sync_bool_compare_and_swap(&emap_top,top,i+1);
+	if((flags & MAP_POPULATE) && m->fd >= 0 && emap_load(m,0,m->pages) < 0)
+	{
+		i=errno;
+		munmap(m->addr,length);
+		errno=i;
+		return(MAP_FAILED);
+	}
+	return(m->addr);
+}
+
+static int
+munmap(void *addr, size_t length)
+{
+	struct emap *m;
+	int ret=0;
+
+	if((m=emap_find((char *)addr)) == 0 || m->addr != (char *)addr)
+	{
+		errno=EINVAL;
+		return(-1);
+	}
+	if(m->fd >= 0 && (m->flags & MAP_SHARED))
+		ret=emap_flush(m,0,m->pages);
+	__atomic_store_n(&m->addr,(char *)0,__ATOMIC_RELEASE);
+	free(m->real);
+	free(m->state);
+	__atomic_store_n(&m->used,0,__ATOMIC_RELEASE);
+	return(ret);
+}
+
+static int
+msync(void *addr, size_t length, int flags)
+{
+	struct emap *m;
+	size_t first,last;
+
+	if((m=emap_find((char *)addr)) == 0)
+	{
+		errno=ENOMEM;
+		return(-1);
+	}
+	if(!(flags & MS_SYNC) || m->fd < 0 || !(m->flags & MAP_SHARED))
+		return(0);
+	first=(size_t)((char *)addr-m->addr)/EMAP_PAGE;
+	last=((size_t)((char *)addr-m->addr)+length+EMAP_PAGE-1)/EMAP_PAGE;
+	if(last > m->pages)
+		last=m->pages;
+	return(emap_flush(m,first,last));
+}
+#endif
+
+#ifndef ASYNC_IO
 int
 async_read()
 {
@@ -20044,6 +23094,12 @@ async_write_no_copy()
 	printf("Your system does not support async I/O\n");
 	exit(170);
 }
+char *
+async_write_buffer()
+{
+	printf("Your system does not support async I/O\n");
+	exit(170);
+}
 size_t
 async_write()
 {
@@ -20135,6 +23191,260 @@ unsigned long long microsecs;
 
 }
 
+/************************************************************************/
+/* Time based duration (-+f). dur_start() is called as a child's timed	*/
+/* loop begins. It times the phase from the master's release of the	*/
+/* children, so all of them ramp up and stop together. dur_next() is	*/
+/* called before each record: it wraps i back to the first record at	*/
+/* the end of the file, rewinding fd for the tests that move through	*/
+/* the file with read() and write(), and says when the ramp-up is over	*/
+/* and when the phase is.						*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static void
+dur_start(struct dur_clock *d, long long xx)
+#else
+static void
+dur_start(d, xx)
+struct dur_clock *d;
+long long xx;
+#endif
+{
+	d->ramp_end = phase_origin(xx) + dur_ramp;
+	d->end = d->ramp_end + dur_secs;
+	d->ramped = (dur_ramp == 0.0);
+}
+
+#ifdef HAVE_ANSIC_C
+static int
+dur_next(struct dur_clock *d, long long *i, int fd)
+#else
+static int
+dur_next(d, i, fd)
+struct dur_clock *d;
+long long *i;
+int fd;
+#endif
+{
+	double now;
+
+	if(*i >= numrecs64)
+	{
+		*i = 0;
+		if(fd >= 0)
+			I_LSEEK(fd,(off64_t)0,SEEK_SET);
+	}
+	now = time_so_far();
+	if(now >= d->end)
+		return(DUR_DONE);
+	if(!d->ramped && now >= d->ramp_end)
+	{
+		d->ramped = 1;
+		return(DUR_RAMPED);
+	}
+	return(DUR_RUN);
+}
+
+/*
+ * The ramp-up just ended: restart a child's clocks, compute delay and
+ * histogram. The caller zeroes its own transfer counters.
+ */
+#ifdef HAVE_ANSIC_C
+static void
+dur_restart(int xx, double *starttime, double *wall, double *cpu,
+	double *compute)
+#else
+static void
+dur_restart(xx, starttime, wall, cpu, compute)
+int xx;
+double *starttime;
+double *wall;
+double *cpu;
+double *compute;
+#endif
+{
+	*compute = 0;
+	*starttime = time_so_far();
+	if(cpuutilflag)
+	{
+		*wall = *starttime;
+		*cpu = cputime_so_far();
+	}
+	if(hist_summary)
+		hist_reset(xx);
+}
+
+/************************************************************************/
+/* Open-loop rate control (-+O). Wait for the scheduled start of the	*/
+/* next op and return it, so the caller's latency includes any time the	*/
+/* op spent waiting behind a slow predecessor. Sleeps most of the gap	*/
+/* and spins the last RATE_SPIN seconds, which keeps the CPU free at	*/
+/* low rates without giving up the start accuracy of a spin.		*/
+/************************************************************************/
+#ifdef HAVE_ANSIC_C
+static double
+rate_wait(struct rate_sched *rs, long long xx)
+#else
+static double
+rate_wait(rs, xx)
+struct rate_sched *rs;
+long long xx;
+#endif
+{
+	double now, start, left, u;
+#if !defined(Windows)
+	struct timespec req;
+#endif
+
+	now = time_so_far();
+	if(rs->next == 0.0)
+	{
+		/* Lay the timeline down from the start of the phase, the
+		   same for every child, so a child that is late to its
+		   first op catches up instead of shifting its schedule.
+		   Constant arrivals are staggered across the children so
+		   they do not all issue in the same instant. */
+		rs->seed = (unsigned long long)(now*1000000.0) ^
+			((unsigned long long)(xx+1) * 0x9E3779B97F4A7C15ULL);
+		rs->next = phase_origin(xx);
+		if(op_rate_flag == RATE_CONST && num_child > 1)
+			rs->next += (double)xx/((double)num_child*(double)op_rate);
+	}
+	start = rs->next;
+	if(op_rate_flag == RATE_POISSON)
+	{
+		/* xorshift64*, top 53 bits to a uniform in (0,1] */
+		rs->seed ^= rs->seed >> 12;
+		rs->seed ^= rs->seed << 25;
+		rs->seed ^= rs->seed >> 27;
+		u = (double)(((rs->seed * 0x2545F4914F6CDD1DULL) >> 11) + 1) /
+			9007199254740992.0;
+		rs->next += -dist_ln(u)/(double)op_rate;
+	}
+	else
+		rs->next += (double)1.0/(double)op_rate;
+
+	left = start - now;
+	if(left <= 0.0)
+		return(start);
+#if !defined(Windows)
+	if(left > RATE_SPIN)
+	{
+		left -= RATE_SPIN;
+		req.tv_sec = (time_t)left;
+		req.tv_nsec = (long)((left - (double)req.tv_sec)*1000000000.0);
+		nanosleep(&req,(struct timespec *)0);
+	}
+#endif
+	while(time_so_far() < start)
+		;
+	return(start);
+}
+
+/************************************************************************/
+/* Cycle counter timer (-+F).						*/
+/* Reading the system clock costs a system call, or a trip through	*/
+/* the RTEMS clock driver, per sample. The CPU timestamp counter (TSC	*/
+/* on x86, the timebase on PowerPC) is a single instruction. It is	*/
+/* scaled to seconds by a rate that is measured against the system	*/
+/* clock at startup. Its time counts from the calibration, not from	*/
+/* the epoch: a double holding epoch seconds only resolves about a	*/
+/* quarter of a microsecond, which would throw the counter's		*/
+/* resolution away. Only differences of time_so_far() are used, and	*/
+/* base_time is taken from the system clock.				*/
+/* The counter must run at a constant rate and be synchronized across	*/
+/* the CPUs the children run on.					*/
+/************************************************************************/
+#define CYCLE_CAL_TIME	0.1	/* seconds spent calibrating */
+
+#ifdef HAVE_CYCLE_COUNTER
+#ifdef HAVE_ANSIC_C
+static unsigned long long
+read_cycles(void)
+#else
+static unsigned long long
+read_cycles()
+#endif
+{
+#if defined(__i386__) || defined(__x86_64__)
+	unsigned int lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return(((unsigned long long)hi << 32) | lo);
+#elif defined(__powerpc64__)
+	unsigned long long tb;
+
+	__asm__ __volatile__("mftb %0" : "=r" (tb));
+	return(tb);
+#else
+	unsigned int hi, lo, hi2;
+
+	/* 32 bit PowerPC, retry if TBL wrapped between the two reads */
+	do {
+		__asm__ __volatile__("mftbu %0" : "=r" (hi));
+		__asm__ __volatile__("mftb %0" : "=r" (lo));
+		__asm__ __volatile__("mftbu %0" : "=r" (hi2));
+	} while(hi != hi2);
+	return(((unsigned long long)hi << 32) | lo);
+#endif
+}
+#endif
+
+#ifdef HAVE_ANSIC_C
+static double
+cycle_so_far(void)
+#else
+static double
+cycle_so_far()
+#endif
+{
+#ifdef HAVE_CYCLE_COUNTER
+	return((double)(read_cycles() - cycle_base) / cycle_rate);
+#else
+	return(clock_so_far());
+#endif
+}
+
+/*
+ * Measure the cycle counter rate against the system clock. Both ends
+ * of the interval are taken right after the clock ticks over so that
+ * the clock's own granularity drops out. Returns 0 and arms
+ * time_so_far() on success, -1 if there is no usable counter.
+ */
+#ifdef HAVE_ANSIC_C
+int
+calibrate_cycles(void)
+#else
+int
+calibrate_cycles()
+#endif
+{
+#ifdef HAVE_CYCLE_COUNTER
+	double t0, t1, t;
+	unsigned long long c0, c1;
+
+	cycle_rate = 0.0;
+	t = clock_so_far();
+	while((t0 = clock_so_far()) == t)
+		;
+	c0 = read_cycles();
+	do {
+		t = clock_so_far();
+	} while(t - t0 < CYCLE_CAL_TIME);
+	while((t1 = clock_so_far()) == t)
+		;
+	c1 = read_cycles();
+	if(c1 <= c0)
+		return(-1);
+	cycle_base = c0;
+	cycle_rate = (double)(c1 - c0) / (t1 - t0);
+	return(0);
+#else
+	cycle_rate = 0.0;
+	return(-1);
+#endif
+}
+
 /************************************************************************/
 /* Function that establishes the resolution 				*/
 /* of the gettimeofday() function.					*/
@@ -20222,6 +23532,21 @@ time_so_far1(void)
 static double
 time_so_far1()
 #endif
+{
+#ifdef HAVE_CYCLE_COUNTER
+	if(cycle_rate != 0.0)
+		return(cycle_so_far()*1000000.0);
+#endif
+	return(clock_so_far1());
+}
+
+#ifdef HAVE_ANSIC_C
+static double
+clock_so_far1(void)
+#else
+static double
+clock_so_far1()
+#endif
 {
      /* For Windows the time_of_day() is useless. It increments in 
         55 milli second  increments. By using the Win32api one can 
@@ -20260,13 +23585,13 @@ time_so_far1()
   if (getclock(TIMEOFDAY, (struct timespec *) &gp) == -1)
     perror("getclock");
   return (( (double) (gp.tv_sec)*1000000.0) +
-    ( ((float)(gp.tv_nsec)) * 0.001 ));
+    ( ((double)(gp.tv_nsec)) * 0.001 ));
 #else
 #if defined (__rtems__)
   struct timespec gp;
   rtems_clock_get_uptime(&gp);
   return (( (double) (gp.tv_sec)*1000000.0) +
-    ( ((float)(gp.tv_nsec)) * 0.001 ));
+    ( ((double)(gp.tv_nsec)) * 0.001 ));
 #else
   struct timeval tp;
 
@@ -21657,6 +24982,7 @@ int send_size;
 	sprintf(outbuf.c_direct_flag,"%d",send_buffer->c_direct_flag);
 	sprintf(outbuf.c_cpuutilflag,"%d",send_buffer->c_cpuutilflag);
 	sprintf(outbuf.c_seq_mix,"%d",send_buffer->c_seq_mix);
+	sprintf(outbuf.c_op_mix,"%d",send_buffer->c_op_mix);
 	sprintf(outbuf.c_client_number,"%d",send_buffer->c_client_number);
 	sprintf(outbuf.c_command,"%d",send_buffer->c_command);
 	sprintf(outbuf.c_testnum,"%d",send_buffer->c_testnum);
@@ -22309,29 +25635,117 @@ again:
 
 
 #ifdef __rtems__
+/* Parked child tasks for -+G, one per child slot */
+struct pool_task {
+    rtems_id tid;
+    rtems_task_entry entry;
+    rtems_task_argument arg;
+};
+struct pool_task pool_t[MAXSTREAMS+1];
+
+static rtems_task pool_task_main(rtems_task_argument x)
+{
+    struct pool_task *w = &pool_t[x];
+    rtems_event_set events;
+
+    for(;;) {
+        rtems_event_receive(RTEMS_EVENT_0, RTEMS_EVENT_ANY|RTEMS_WAIT,
+                RTEMS_NO_TIMEOUT, &events);
+        (*w->entry)(w->arg);
+    }
+}
+
 long long spawnTask(rtems_task_entry entryPoint,
                     rtems_task_priority priority,
                     rtems_task_argument arg)
 {
     rtems_status_code sc;
     rtems_id tid;
-
+    size_t stack = RTEMS_MINIMUM_STACK_SIZE+(16*1024);
+#if defined(RTEMS_SMP)
+    rtems_id sid;
+    cpu_set_t cpus;
+    int cpu = -1;
+#endif
+
+    if (pool_flag && pool_t[arg].tid != 0)
+        goto dispatch;
+    /* -+J overrides the caller's priority and the default stack */
+    if (task_prio != 0)
+        priority = task_prio + (rtems_task_priority)arg * task_prio_step;
+    if (priority > RTEMS_MAXIMUM_PRIORITY)
+        priority = RTEMS_MAXIMUM_PRIORITY;
+    if (task_stack != 0)
+        stack = task_stack;
     sc = rtems_task_create(rtems_build_name('t','a','s','k'),
             priority,
-            RTEMS_MINIMUM_STACK_SIZE+(16*1024),
-            RTEMS_PREEMPT|RTEMS_TIMESLICE|RTEMS_NO_ASR|RTEMS_INTERRUPT_LEVEL(0),
+            stack,
+            task_mode,
             RTEMS_FLOATING_POINT|RTEMS_LOCAL,
             &tid);
     if (sc != RTEMS_SUCCESSFUL) {
         printf("Can't create task: %s\n", rtems_status_text(sc));
         goto panic;
     }
-    sc = rtems_task_start(tid, entryPoint, arg);
+#if defined(RTEMS_SMP)
+    if (task_sched[0]) {
+        /* Short names are blank padded, as in the configuration */
+        sc = rtems_scheduler_ident(rtems_build_name(task_sched[0],
+                task_sched[1] ? task_sched[1] : ' ',
+                task_sched[2] ? task_sched[2] : ' ',
+                task_sched[3] ? task_sched[3] : ' '),
+                &sid);
+        if (sc == RTEMS_SUCCESSFUL)
+#if __RTEMS_MAJOR__ >= 5
+            sc = rtems_task_set_scheduler(tid, sid, priority);
+#else
+            sc = rtems_task_set_scheduler(tid, sid);
+#endif
+        if (sc != RTEMS_SUCCESSFUL) {
+            printf("Can't use scheduler %s: %s\n", task_sched, rtems_status_text(sc));
+            goto remove;
+        }
+    }
+    /* -+J cpus, else the -+G placement */
+    if (task_cpu_lo >= 0)
+        cpu = task_cpu_lo + (int)(arg % (task_cpu_hi - task_cpu_lo + 1));
+    else if (pool_flag && pool_policy != POOL_NONE && pool_ncpus > 0)
+        cpu = pool_cpus[arg % pool_ncpus];
+    if (cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        sc = rtems_task_set_affinity(tid, sizeof(cpus), &cpus);
+        if (sc != RTEMS_SUCCESSFUL) {
+            printf("Can't bind task to processor %d: %s\n", cpu, rtems_status_text(sc));
+            goto remove;
+        }
+    }
+#endif
+    if (pool_flag) {
+        pool_t[arg].tid = tid;
+        sc = rtems_task_start(tid, pool_task_main, arg);
+    }
+    else
+        sc = rtems_task_start(tid, entryPoint, arg);
     if (sc != RTEMS_SUCCESSFUL) {
         printf("Can't start task: %s\n", rtems_status_text(sc));
+        goto remove;
+    }
+    if (!pool_flag)
+        return (long long) tid;
+dispatch:
+    /* Hand the phase to the parked task */
+    pool_t[arg].entry = entryPoint;
+    pool_t[arg].arg = arg;
+    sc = rtems_event_send(pool_t[arg].tid, RTEMS_EVENT_0);
+    if (sc != RTEMS_SUCCESSFUL) {
+        printf("Can't wake task: %s\n", rtems_status_text(sc));
         goto panic;
     }
-    return (long long) tid;
+    return (long long) pool_t[arg].tid;
+remove:
+    pool_t[arg].tid = 0;
+    rtems_task_delete(tid);
 panic:
     return (-1);
 }
@@ -22505,6 +25919,7 @@ long long numrecs64, reclen;
 	cc.c_direct_flag = direct_flag;
 	cc.c_cpuutilflag = cpuutilflag;
 	cc.c_seq_mix = seq_mix;
+	cc.c_op_mix = op_mix;
 	cc.c_async_flag = async_flag;
 	cc.c_k_flag = k_flag;
 	cc.c_h_flag = h_flag;
@@ -22591,7 +26006,7 @@ long long numrecs64, reclen;
 
 	child_index = mc.m_client_number;
 	child_stat = (struct child_stats *)&shmaddr[child_index];	
-	child_stat->flag = (long long)(mc.m_child_flag);
+	child_flag_set(child_stat,(int)mc.m_child_flag);
 	if(mdebug>=1)
 	   printf("Master sees child %d at barrier message.\n",child_index);
 
@@ -22761,6 +26176,7 @@ become_client()
 	sscanf(cnc->c_direct_flag,"%d",&cc.c_direct_flag);
 	sscanf(cnc->c_cpuutilflag,"%d",&cc.c_cpuutilflag);
 	sscanf(cnc->c_seq_mix,"%d",&cc.c_seq_mix);
+	sscanf(cnc->c_op_mix,"%d",&cc.c_op_mix);
 	sscanf(cnc->c_async_flag,"%d",&cc.c_async_flag);
 	sscanf(cnc->c_k_flag,"%d",&cc.c_k_flag);
 	sscanf(cnc->c_h_flag,"%d",&cc.c_h_flag);
@@ -22844,6 +26260,7 @@ become_client()
 	direct_flag = cc.c_direct_flag;
 	cpuutilflag = cc.c_cpuutilflag;
 	seq_mix = cc.c_seq_mix;
+	op_mix = cc.c_op_mix;
 	async_flag = cc.c_async_flag;
 	k_flag = cc.c_k_flag;
 	h_flag = cc.c_h_flag;
@@ -22929,6 +26346,8 @@ become_client()
 	if(hist_summary)
 	{
 		printf("Child got HISTORY flag\n");
+		if(hist_alloc((int)chid+1) != 0)
+			hist_summary=0;
 	}
 
 	/* 7. Run the test */
@@ -23289,7 +26708,7 @@ int num;
 			if(mdebug)
 				printf("loop: R_STAT_DATA for client %d\n",i);
 			child_stat = (struct child_stats *)&shmaddr[i];	
-			child_stat->flag = mc.m_child_flag;
+			child_flag_set(child_stat,(int)mc.m_child_flag);
 			child_stat->actual = mc.m_actual;
 			child_stat->throughput = mc.m_throughput;
 			child_stat->cputime = mc.m_cputime;
@@ -23310,7 +26729,7 @@ int num;
 				  (int)mc.m_child_flag);
 			i = mc.m_client_number;
 			child_stat = (struct child_stats *)&shmaddr[i];	
-			child_stat->flag = (long long)(mc.m_child_flag);
+			child_flag_set(child_stat,(int)mc.m_child_flag);
 			break;
 		case R_STOP_FLAG:
 			if(mc.m_mygen != mygen)
@@ -23328,727 +26747,1179 @@ int num;
 		}
 			
 	}
-	/* Let the clients report results before exiting.
-           Also, exiting too quickly can close the async
-           socket to the child, and cause it to become ill.
-           On Solaris, it gets stuck in a 0=read() loop. */
-
-#if defined(Windows)
-	sleep(1);
+	/* Let the clients report results before exiting.
+           Also, exiting too quickly can close the async
+           socket to the child, and cause it to become ill.
+           On Solaris, it gets stuck in a 0=read() loop. */
+
+#if defined(Windows)
+	sleep(1);
+#else
+	nanosleep(&req,&rem);
+#endif
+
+	exit(0);
+}
+/*
+ * Create a client listener for receiving async data from the
+ * the master. 
+ */
+#ifdef HAVE_ANSIC_C
+void
+start_child_listen_loop(void)
+#else
+void
+start_child_listen_loop()
+#endif
+{
+	int i;
+	struct child_stats *child_stat;
+	struct client_command cc;
+	struct client_neutral_command *cnc;
+
+	client_listen_pid=fork();
+	if(client_listen_pid!=0)
+		return;
+	if(cdebug>=1)
+	{
+		fprintf(newstdout,"Child %d starting client listen loop\n",(int)chid);
+		fflush(newstdout);
+	}
+	while(1)
+	{
+		bzero(&cc,sizeof(struct client_command));
+		child_listen_async(l_async_sock,sizeof(struct client_neutral_command));
+		cnc=(struct client_neutral_command *)&child_async_rcv_buf;
+		/*
+		 * Convert from string format to arch format
+	 	 */
+		sscanf(cnc->c_command,"%d",&cc.c_command);
+		sscanf(cnc->c_client_number,"%d",&cc.c_client_number);
+		sscanf(cnc->c_stop_flag,"%d",&cc.c_stop_flag);
+
+		switch(cc.c_command) {
+		case R_STOP_FLAG:
+			i = cc.c_client_number;
+			if(cdebug)
+			{
+				fprintf(newstdout,"child loop: R_STOP_FLAG for client %d\n",i);
+				fflush(newstdout);
+			}
+			child_stat = (struct child_stats *)&shmaddr[i];	
+			*stop_flag = cc.c_stop_flag; /* In shared memory with other copy */
+			sent_stop=1;
+			break;
+		case R_TERMINATE:
+			if(cdebug)
+			{
+				fprintf(newstdout,"Child loop: R_TERMINATE: Client %d \n",
+				  (int)cc.c_client_number);
+				fflush(newstdout);
+			}
+			sleep(2);
+			/* Aync listener goes away */
+			stop_child_listen(l_async_sock);
+			exit(0);
+		case R_DEATH:
+			if(cdebug)
+			{
+				fprintf(newstdout,"Child loop: R_DEATH: Client %d \n",
+				  (int)cc.c_client_number);
+				fflush(newstdout);
+			}
+			i = cc.c_client_number;
+			child_remove_files(i);
+			sleep(2);
+			/* Aync listener goes away */
+			stop_child_listen(l_async_sock);
+			exit(0);
+		}
+			
+	}
+}
+
+/*
+ * The controlling process "master" tells the children to begin.
+ */
+
+#ifdef HAVE_ANSIC_C
+void
+tell_children_begin(long long childnum)
+#else
+void
+tell_children_begin(childnum)
+long long childnum;
+#endif
+{
+	struct client_command cc;
+	int x;
+	bzero(&cc,sizeof(struct client_command));
+	x = (int) childnum;
+	if(mdebug>=1)
+		printf("Master: Tell child %d to begin\n",x);
+	cc.c_command = R_FLAG_DATA;
+	cc.c_child_flag = CHILD_STATE_BEGIN; 
+	cc.c_client_number = (int)childnum; 
+	master_send(master_send_sockets[x],child_idents[x].child_name, &cc,sizeof(struct client_command));
+}
+
+/*
+ * The master waits here for all of the the children to terminate.
+ * When the children are done the the master_join_count will be at zero
+ * and the master_listen_loop will exit. This function waits for this to happen.
+ */
+#ifdef HAVE_ANSIC_C
+void
+wait_dist_join(void)
+#else
+void
+wait_dist_join()
+#endif
+{
+	wait(0);
+	if(mdebug)
+		printf("Master: All children have finished. Sending terminate\n");
+	terminate_child_async(); /* All children are done, so terminate their async channel */
+	current_client_number=0; /* start again */
+}
+
+#ifdef NET_BENCH
+/* 
+ * This function reads a file that contains client information. 
+ * The information is:
+ * 	client name (DNS usable name)
+ *	client working directory (where to run the test)
+ * 	client directory that contains the Iozone executable.
+ *
+ * If the first character in a line is a # then it is a comment.
+ * The maximum number of clients is MAXSTREAMS.
+ */
+#ifdef HAVE_ANSIC_C
+int
+get_client_info(void)
+#else
+int
+get_client_info()
+#endif
+{
+	FILE *fd;
+	char *ret1;
+	int count;
+	char buffer[200];
+	count=0;
+	fd=fopen(client_filename,"r");
+	if(fd == (FILE *)NULL)
+	{
+		printf("Unable to open client file \"%s\"\n",
+			client_filename);
+		exit(176);
+	}
+	while(1)
+	{
+          	if (count > MAXSTREAMS) {                                                                           
+            	  printf("Too many lines in client file - max of %d supported\n",
+			MAXSTREAMS);
+            	  exit(7);
+          	}
+		ret1=fgets(buffer,200,fd);
+		if(ret1== (char *)NULL)
+			break;
+		count+=parse_client_line(buffer,count);
+	}
+	fclose(fd);
+	return(count);
+}
+
+
+/*
+ * This function parses a line from the client file. It is
+ * looking for:
+ *	Client name  (DNS usable)
+ *	Client working directory (where to run the test )
+ *	Client path to Iozone executable.
+ *
+ * Lines that start with # are comments.
+ */
+
+#ifdef HAVE_ANSIC_C
+int 
+parse_client_line(char *buffer,int line_num)
+#else
+int
+parse_client_line(buffer, line_num)
+char *buffer;
+int line_num;
+#endif
+{
+	int num;
+	/* Format is clientname, workdir, execute_path */
+	/* If column #1 contains a # symbol then skip this line */
+
+	if(buffer[0]=='#')
+		return(0);
+	num=sscanf(buffer,"%s %s %s %s\n",
+		child_idents[line_num].child_name,
+		child_idents[line_num].workdir,
+		child_idents[line_num].execute_path,
+		child_idents[line_num].file_name);
+	if((num > 0) && (num !=3) && (num !=4))
+	{
+		printf("Bad Client Identity at entry %d\n",line_num);
+		printf("Client: -> %s  Workdir: -> %s  Execute_path: -> %s \n",
+		child_idents[line_num].child_name,
+		child_idents[line_num].workdir,
+		child_idents[line_num].execute_path);
+		exit(203);
+	}
+	if(num == 4)
+		mfflag++;
+
+	return(1);
+}
+
+/* 
+ * This is a mechanism that the child uses to remove all
+ * of its temporary files. Only used at terminate time.
+ */
+#ifdef HAVE_ANSIC_C
+void
+child_remove_files(int i)
+#else
+void
+child_remove_files(i)
+int i;
+#endif
+{
+
+	char *dummyfile[MAXSTREAMS];           /* name of dummy file     */
+	dummyfile[i]=(char *)malloc((size_t)MAXNAMESIZE);
+	if(mfflag)
+	{
+		sprintf(dummyfile[i],"%s",filearray[i]);
+	}
+	else
+	{
+		sprintf(dummyfile[i],"%s.DUMMY.%d",filearray[i],i);
+	}
+	if(cdebug)
+	{
+		fprintf(newstdout,"Child %d remove: %s \n",(int)chid, dummyfile[i]);
+		fflush(newstdout);
+	}
+	if(check_filename(dummyfile[i]))
+		unlink(dummyfile[i]);
+}
+#endif /* NET_BENCH */
+	
+/*
+ * The master tells the child async listener that it is time
+ * to terminate its services.
+ */
+#ifdef HAVE_ANSIC_C
+void
+terminate_child_async(void)
 #else
-	nanosleep(&req,&rem);
+void
+terminate_child_async()
 #endif
-
-	exit(0);
+{
+	int i;
+	struct client_command cc;
+	bzero(&cc,sizeof(struct client_command));
+	cc.c_command = R_TERMINATE;
+	for(i=0;i<num_child;i++)
+	{
+		child_idents[i].state = C_STATE_ZERO;
+		cc.c_client_number = (int)i; 
+		if(mdebug)
+			printf("Master terminating async channels to children.\n");
+		master_send(master_send_async_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
+	}
 }
+
 /*
- * Create a client listener for receiving async data from the
- * the master. 
+ * The master has received an update to the stop flag and is
+ * now distributing this to all of the clients.
  */
 #ifdef HAVE_ANSIC_C
 void
-start_child_listen_loop(void)
+distribute_stop(void)
 #else
 void
-start_child_listen_loop()
+distribute_stop()
 #endif
 {
 	int i;
-	struct child_stats *child_stat;
 	struct client_command cc;
-	struct client_neutral_command *cnc;
 
-	client_listen_pid=fork();
-	if(client_listen_pid!=0)
-		return;
-	if(cdebug>=1)
+	/*
+	 * Only send one stop to the clients. Each client will
+	 * send stop to the master, but the master only needs
+	 * to distribute the first stop. Without this, the 
+	 * master may distribute too many stops and overflow
+	 * the socket buffer on the client.
+	 */
+	if(sent_stop)
 	{
-		fprintf(newstdout,"Child %d starting client listen loop\n",(int)chid);
-		fflush(newstdout);
+		if(mdebug)
+		{
+		  s_count++;
+		  printf("Master not send stop %d\n",s_count);
+		}
+		return;
 	}
-	while(1)
+	bzero(&cc,sizeof(struct client_command));
+	cc.c_command = R_STOP_FLAG;
+	cc.c_stop_flag = 1;
+	for(i=0;i<num_child;i++)
 	{
-		bzero(&cc,sizeof(struct client_command));
-		child_listen_async(l_async_sock,sizeof(struct client_neutral_command));
-		cnc=(struct client_neutral_command *)&child_async_rcv_buf;
-		/*
-		 * Convert from string format to arch format
-	 	 */
-		sscanf(cnc->c_command,"%d",&cc.c_command);
-		sscanf(cnc->c_client_number,"%d",&cc.c_client_number);
-		sscanf(cnc->c_stop_flag,"%d",&cc.c_stop_flag);
-
-		switch(cc.c_command) {
-		case R_STOP_FLAG:
-			i = cc.c_client_number;
-			if(cdebug)
-			{
-				fprintf(newstdout,"child loop: R_STOP_FLAG for client %d\n",i);
-				fflush(newstdout);
-			}
-			child_stat = (struct child_stats *)&shmaddr[i];	
-			*stop_flag = cc.c_stop_flag; /* In shared memory with other copy */
-			sent_stop=1;
-			break;
-		case R_TERMINATE:
-			if(cdebug)
-			{
-				fprintf(newstdout,"Child loop: R_TERMINATE: Client %d \n",
-				  (int)cc.c_client_number);
-				fflush(newstdout);
-			}
-			sleep(2);
-			/* Aync listener goes away */
-			stop_child_listen(l_async_sock);
-			exit(0);
-		case R_DEATH:
-			if(cdebug)
-			{
-				fprintf(newstdout,"Child loop: R_DEATH: Client %d \n",
-				  (int)cc.c_client_number);
-				fflush(newstdout);
-			}
-			i = cc.c_client_number;
-			child_remove_files(i);
-			sleep(2);
-			/* Aync listener goes away */
-			stop_child_listen(l_async_sock);
-			exit(0);
-		}
-			
+		cc.c_client_number = (int)i; 
+		if(mdebug)
+			printf("Master distributing stop flag to child %d\n",i);
+		master_send(master_send_async_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
 	}
+	sent_stop=1;
 }
 
 /*
- * The controlling process "master" tells the children to begin.
+ * Child is sending its stop flag to the master.
  */
+#ifdef HAVE_ANSIC_C
+void
+send_stop(void)
+#else
+void
+send_stop()
+#endif
+{
+	struct master_command mc;
+
+	bzero(&mc, sizeof(struct master_command));
+	mc.m_command = R_STOP_FLAG;
+	mc.m_mygen = mygen;
+	mc.m_version = proto_version;
+	mc.m_client_number = chid;
+	mc.m_client_error = client_error;
+	if(cdebug)
+	{
+		fprintf(newstdout,"Child %d sending stop flag to master\n",(int)chid);
+		fflush(newstdout);
+	}
+        child_send(controlling_host_name,(struct master_command *)&mc, sizeof(struct master_command));
+	client_error=0;  /* clear error, it has been delivered */
+}
 
+/*
+ * This is very tricky stuff. There are points in time when 
+ * someone can hit control-c and cause the master to want to die.
+ * Ok..now how does the master contact all the clients and tell
+ * them to stop ?  The clients may be in 3 different states.
+ * Not started yet, Joined and waiting for the WHO information, 
+ * or at the barrier.  If the client is not started... cool.
+ * ignore it. If the client has joined and is waiting at WHO
+ * then the client does not have an async listener yet. So 
+ * the master only needs to tell the client (sync) channel
+ * to terminate. If the client is at the barrier then the 
+ * client has two processes. One at the barrier and another
+ * that is providing the async services. So... the master
+ * needs to terminate both of these processes.
+ */
 #ifdef HAVE_ANSIC_C
 void
-tell_children_begin(long long childnum)
+cleanup_children(void)
 #else
 void
-tell_children_begin(childnum)
-long long childnum;
+cleanup_children()
 #endif
 {
+	int i;
 	struct client_command cc;
-	int x;
 	bzero(&cc,sizeof(struct client_command));
-	x = (int) childnum;
-	if(mdebug>=1)
-		printf("Master: Tell child %d to begin\n",x);
-	cc.c_command = R_FLAG_DATA;
-	cc.c_child_flag = CHILD_STATE_BEGIN; 
-	cc.c_client_number = (int)childnum; 
-	master_send(master_send_sockets[x],child_idents[x].child_name, &cc,sizeof(struct client_command));
+	cc.c_command = R_DEATH;
+	for(i=0;i<num_child;i++)
+	{
+		cc.c_client_number = (int)i; 
+		/* Child not started yet */
+		if(child_idents[i].state == C_STATE_ZERO)
+			;
+		/* Child is waiting for who info */
+		if(child_idents[i].state == C_STATE_WAIT_WHO)
+		{
+			if(mdebug)
+				printf("Master sending signaled death to child !!\n");
+			master_send(master_send_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
+		}
+		/* Child is waiting at the barrier */
+		if(child_idents[i].state == C_STATE_WAIT_BARRIER)
+		{
+			if(mdebug)
+				printf("Master sending signaled death to child !!\n");
+			master_send(master_send_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
+			if(mdebug)
+				printf("Master sending signaled death to child async !!\n");
+			master_send(master_send_async_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
+		}
+			
+	}
 }
 
 /*
- * The master waits here for all of the the children to terminate.
- * When the children are done the the master_join_count will be at zero
- * and the master_listen_loop will exit. This function waits for this to happen.
+ * This closes the file descriptors that were created for the master send and async send
+ * at the end of each phase of the throughput testing.
  */
 #ifdef HAVE_ANSIC_C
 void
-wait_dist_join(void)
+cleanup_comm(void)
+#else
+void
+cleanup_comm()
+#endif
+{
+	int i;
+	for(i=0;i<num_child;i++)
+	{
+        	close(master_send_sockets[i]);
+        	close(master_send_async_sockets[i]);
+	}
+}
+#if 0
+///#endif /*TODO: NET_BENCH - is this the end ??? */
+#endif
+
+#ifdef HAVE_ANSIC_C
+void
+find_remote_shell(char *shell)
+#else
+void
+find_remote_shell(shell)
+char *shell;
+#endif
+{
+	char *value;
+	value=(char *)getenv("RSH");
+	if(value)
+	{
+		strcpy(shell,value);
+		return;
+	}
+#ifdef _HPUX_SOURCE
+	strcpy(shell,"remsh");
 #else
-void
-wait_dist_join()
+	strcpy(shell,"rsh");
 #endif
-{
-	wait(0);
-	if(mdebug)
-		printf("Master: All children have finished. Sending terminate\n");
-	terminate_child_async(); /* All children are done, so terminate their async channel */
-	current_client_number=0; /* start again */
+	return;
 }
 
-#ifdef NET_BENCH
-/* 
- * This function reads a file that contains client information. 
- * The information is:
- * 	client name (DNS usable name)
- *	client working directory (where to run the test)
- * 	client directory that contains the Iozone executable.
- *
- * If the first character in a line is a # then it is a comment.
- * The maximum number of clients is MAXSTREAMS.
- */
+#ifdef IMON_ENABLED
 #ifdef HAVE_ANSIC_C
-int
-get_client_info(void)
+void
+find_external_mon(char * imon_start, char * imon_stop)
 #else
-int
-get_client_info()
+void
+find_external_mon(imon_start,imon_stop)
+char *imon_start,*imon_stop;
 #endif
 {
-	FILE *fd;
-	char *ret1;
-	int count;
-	char buffer[200];
-	count=0;
-	fd=fopen(client_filename,"r");
-	if(fd == (FILE *)NULL)
+	char *start,*stop,*sync;
+	imon_start[0]=(char)0;
+	imon_stop[0]=(char)0;
+	start=(char *)getenv("IMON_START");
+	if(start)
 	{
-		printf("Unable to open client file \"%s\"\n",
-			client_filename);
-		exit(176);
+		strcpy(imon_start,start);
 	}
-	while(1)
+	stop=(char *)getenv("IMON_STOP");
+	if(stop)
 	{
-          	if (count > MAXSTREAMS) {                                                                           
-            	  printf("Too many lines in client file - max of %d supported\n",
-			MAXSTREAMS);
-            	  exit(7);
-          	}
-		ret1=fgets(buffer,200,fd);
-		if(ret1== (char *)NULL)
-			break;
-		count+=parse_client_line(buffer,count);
+		strcpy(imon_stop,stop);
+	}
+	sync=(char *)getenv("IMON_SYNC");
+	if(sync)
+	{
+		imon_sync=1;
 	}
-	fclose(fd);
-	return(count);
-}
 
+	return;
+}	
+#endif
 
 /*
- * This function parses a line from the client file. It is
- * looking for:
- *	Client name  (DNS usable)
- *	Client working directory (where to run the test )
- *	Client path to Iozone executable.
- *
- * Lines that start with # are comments.
+ * This test is only valid in throughput mode.
  */
 
 #ifdef HAVE_ANSIC_C
-int 
-parse_client_line(char *buffer,int line_num)
+void 
+mix_perf_test(off64_t kilo64,long long reclen,long long *data1,long long *data2)
 #else
-int
-parse_client_line(buffer, line_num)
-char *buffer;
-int line_num;
+void 
+mix_perf_test(kilo64,reclen,data1,data2)
+off64_t kilo64;
+long long reclen;
+long long *data1,*data2;
 #endif
 {
-	int num;
-	/* Format is clientname, workdir, execute_path */
-	/* If column #1 contains a # symbol then skip this line */
+	return;
+/*
+	printf("\nMix mode test only valid in throughput mode.\n");
+	signal_handler();
+	exit(180);
+*/
+}
 
-	if(buffer[0]=='#')
-		return(0);
-	num=sscanf(buffer,"%s %s %s %s\n",
-		child_idents[line_num].child_name,
-		child_idents[line_num].workdir,
-		child_idents[line_num].execute_path,
-		child_idents[line_num].file_name);
-	if((num > 0) && (num !=3) && (num !=4))
-	{
-		printf("Bad Client Identity at entry %d\n",line_num);
-		printf("Client: -> %s  Workdir: -> %s  Execute_path: -> %s \n",
-		child_idents[line_num].child_name,
-		child_idents[line_num].workdir,
-		child_idents[line_num].execute_path);
-		exit(203);
-	}
-	if(num == 4)
-		mfflag++;
+/*
+ * Speed check code 
+ */
+char *sp_dest; /* Name of destination for messages */
 
-	return(1);
-}
+int sp_child_listen_port = SP_CHILD_LISTEN_PORT;
+int sp_child_esend_port  = SP_CHILD_ESEND_PORT;
 
-/* 
- * This is a mechanism that the child uses to remove all
- * of its temporary files. Only used at terminate time.
+int sp_master_listen_port = SP_MASTER_LISTEN_PORT;
+int sp_master_esend_port  = SP_MASTER_ESEND_PORT;
+
+int sp_master_results_port = SP_MASTER_RESULTS_PORT;
+
+struct in_addr sp_my_cs_addr;
+struct in_addr sp_my_ms_addr;
+struct sockaddr_in sp_child_sync_sock, sp_child_async_sock;
+struct sockaddr_in sp_master_sync_sock, sp_master_async_sock;
+char *sp_buf;
+char sp_command[1024];
+char sp_remote_shell[100];
+int sp_child_mode;
+int sp_count,sp_msize,sp_once;
+int sp_tcount;
+double sp_start_time,sp_finish_time;
+void sp_send_result(int, int, float );
+void sp_get_result(int , int );
+void sp_do_child_t(void);
+void sp_do_master_t(void);
+void speed_main(char *, char *, long long ,long long , int);
+int sp_cret;
+char sp_remote_host[256];
+char sp_master_host[256];
+char sp_location[256];
+
+
+/*
+ * This is the front end for the speed check code
  */
 #ifdef HAVE_ANSIC_C
 void
-child_remove_files(int i)
+speed_main(char *client_name, char *e_path, long long reclen,
+	long long kilos, int client_flag)
 #else
 void
-child_remove_files(i)
-int i;
+speed_main(client_name, e_path, reclen, kilos, client_flag)
+char *client_name;
+char *e_path;
+long long reclen;
+long long kilos;
+int client_flag;
 #endif
 {
+	int x;
 
-	char *dummyfile[MAXSTREAMS];           /* name of dummy file     */
-	dummyfile[i]=(char *)malloc((size_t)MAXNAMESIZE);
-	if(mfflag)
+
+	strcpy(sp_master_host,controlling_host_name);
+	sp_msize=(int)reclen;
+	sp_count=((int)kilos*1024)/(int)reclen;
+	if(!client_flag)
 	{
-		sprintf(dummyfile[i],"%s",filearray[i]);
+		printf("\n");
+		strcpy(sp_remote_host,client_name);
+		strcpy(sp_location,e_path);
 	}
-	else
+
+	if(client_flag)
+		sp_child_mode=1;
+	sp_buf=(char *)malloc(sp_msize);
+	bzero(sp_buf,sp_msize); /* get page faults out of the way */
+
+	if(sp_child_mode)
 	{
-		sprintf(dummyfile[i],"%s.DUMMY.%d",filearray[i],i);
+		close(0);
+		close(1);
+		close(2);
+		if(cdebug)
+		{
+			newstdin=freopen("/tmp/don_in","r+",stdin);
+			newstdout=freopen("/tmp/don_out","a+",stdout);
+			newstderr=freopen("/tmp/don_err","a+",stderr);
+		}
+		sp_dest=sp_master_host;
+		sp_do_child_t();
+		free(sp_buf);
+		exit(0);
 	}
-	if(cdebug)
+	x=fork();
+	if(x==0)
 	{
-		fprintf(newstdout,"Child %d remove: %s \n",(int)chid, dummyfile[i]);
-		fflush(newstdout);
+		find_remote_shell(sp_remote_shell);
+	 sprintf(sp_command,"%s %s %s -+s -t 1 -r %d -s %d -+c %s -+t ",
+			sp_remote_shell, sp_remote_host, 
+			sp_location, (int)reclen/1024, 
+			(int)kilos,sp_master_host);
+		/*printf("%s\n",sp_command);*/
+		junk=system(sp_command);
+		exit(0);
 	}
-	if(check_filename(dummyfile[i]))
-		unlink(dummyfile[i]);
-}
-#endif /* NET_BENCH */
-	
-/*
- * The master tells the child async listener that it is time
- * to terminate its services.
- */
-#ifdef HAVE_ANSIC_C
-void
-terminate_child_async(void)
-#else
-void
-terminate_child_async()
-#endif
-{
-	int i;
-	struct client_command cc;
-	bzero(&cc,sizeof(struct client_command));
-	cc.c_command = R_TERMINATE;
-	for(i=0;i<num_child;i++)
+	else
 	{
-		child_idents[i].state = C_STATE_ZERO;
-		cc.c_client_number = (int)i; 
-		if(mdebug)
-			printf("Master terminating async channels to children.\n");
-		master_send(master_send_async_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
+		if(!sp_once)
+		{
+		printf("***************************************************\n");
+		printf("* >>>>>     Client Network Speed check      <<<<< *\n");
+		printf("***************************************************\n\n");
+			printf("Master: %s\n",sp_master_host);
+			printf("Transfer size %d bytes  \n",sp_msize);
+			printf("Count %d\n",sp_count);
+			printf("Total size %d kbytes  \n\n",
+				(sp_msize*sp_count)/1024);
+			sp_once=1;
+		}
+		sp_dest=sp_remote_host;
+		sleep(1);
+		sp_do_master_t();
+		free(sp_buf);
 	}
 }
 
 /*
- * The master has received an update to the stop flag and is
- * now distributing this to all of the clients.
+ * Get results back from the client.
  */
 #ifdef HAVE_ANSIC_C
 void
-distribute_stop(void)
+sp_get_result(int port,int flag)
 #else
 void
-distribute_stop()
+sp_get_result(port,flag)
+int port,flag;
 #endif
 {
-	int i;
-	struct client_command cc;
+	int tcfd;
+	float throughput;
+	int count;
+	char mybuf[1024];
+	int sp_offset,xx;
 
-	/*
-	 * Only send one stop to the clients. Each client will
-	 * send stop to the master, but the master only needs
-	 * to distribute the first stop. Without this, the 
-	 * master may distribute too many stops and overflow
-	 * the socket buffer on the client.
-	 */
-	if(sent_stop)
-	{
-		if(mdebug)
-		{
-		  s_count++;
-		  printf("Master not send stop %d\n",s_count);
-		}
-		return;
-	}
-	bzero(&cc,sizeof(struct client_command));
-	cc.c_command = R_STOP_FLAG;
-	cc.c_stop_flag = 1;
-	for(i=0;i<num_child;i++)
+	tcfd=sp_start_master_listen(port, 1024);
+	sp_offset=0;
+	while(sp_offset < 1024)
 	{
-		cc.c_client_number = (int)i; 
-		if(mdebug)
-			printf("Master distributing stop flag to child %d\n",i);
-		master_send(master_send_async_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
+		xx=read(tcfd,&mybuf[sp_offset],1024);
+		sp_offset+=xx;
 	}
-	sent_stop=1;
+	sscanf(mybuf,"%d %f",&count,&throughput);
+	if(!flag)
+		printf("%-20s received  %10d Kbytes @ %10.2f Kbytes/sec \n",
+			sp_remote_host,count,throughput);
+	else
+		printf("%-20s  sent     %10d Kbytes @ %10.2f Kbytes/sec \n",
+			sp_remote_host,count,throughput);
+	close(tcfd);
 }
 
 /*
- * Child is sending its stop flag to the master.
+ * Send results to the master.
  */
 #ifdef HAVE_ANSIC_C
 void
-send_stop(void)
+sp_send_result(int port, int count, float throughput)
 #else
 void
-send_stop()
+sp_send_result(port, count, throughput)
+int port,count; 
+float throughput;
 #endif
 {
-	struct master_command mc;
-
-	bzero(&mc, sizeof(struct master_command));
-	mc.m_command = R_STOP_FLAG;
-	mc.m_mygen = mygen;
-	mc.m_version = proto_version;
-	mc.m_client_number = chid;
-	mc.m_client_error = client_error;
+	int msfd;
+	char mybuf[1024];
+	sprintf(mybuf,"%d %f",count, throughput);
+	msfd=sp_start_child_send(sp_dest, port, &sp_my_cs_addr);
+	junk=write(msfd,mybuf,1024);
 	if(cdebug)
 	{
-		fprintf(newstdout,"Child %d sending stop flag to master\n",(int)chid);
+		fprintf(newstdout,"Sending result\n");
 		fflush(newstdout);
 	}
-        child_send(controlling_host_name,(struct master_command *)&mc, sizeof(struct master_command));
-	client_error=0;  /* clear error, it has been delivered */
+	close(msfd);
 }
 
 /*
- * This is very tricky stuff. There are points in time when 
- * someone can hit control-c and cause the master to want to die.
- * Ok..now how does the master contact all the clients and tell
- * them to stop ?  The clients may be in 3 different states.
- * Not started yet, Joined and waiting for the WHO information, 
- * or at the barrier.  If the client is not started... cool.
- * ignore it. If the client has joined and is waiting at WHO
- * then the client does not have an async listener yet. So 
- * the master only needs to tell the client (sync) channel
- * to terminate. If the client is at the barrier then the 
- * client has two processes. One at the barrier and another
- * that is providing the async services. So... the master
- * needs to terminate both of these processes.
+ * Start the channel for the master to send a message to 
+ * a child on a port that the child
+ * has created for the parent to use to communicate.
  */
 #ifdef HAVE_ANSIC_C
-void
-cleanup_children(void)
+int
+sp_start_master_send(char *sp_child_host_name, int sp_child_listen_port, struct in_addr *sp_my_ms_addr)
 #else
-void
-cleanup_children()
+int
+sp_start_master_send(sp_child_host_name, sp_child_listen_port, sp_my_ms_addr)
+char *sp_child_host_name; 
+int sp_child_listen_port;
+struct in_addr *sp_my_ms_addr;
 #endif
 {
-	int i;
-	struct client_command cc;
-	bzero(&cc,sizeof(struct client_command));
-	cc.c_command = R_DEATH;
-	for(i=0;i<num_child;i++)
+	int rc,master_socket_val;
+	struct sockaddr_in addr,raddr;
+	struct hostent *he;
+	int port,tmp_port;
+	int ecount=0;
+	struct in_addr *ip;
+	struct timespec req,rem;
+
+	req.tv_sec = 0;
+	req.tv_nsec = 10000000;
+	rem.tv_sec = 0;
+	rem.tv_nsec = 10000000;
+
+        he = gethostbyname(sp_child_host_name);
+        if (he == NULL)
+        {
+                printf("Master: Bad hostname >%s<\n",sp_child_host_name);
+		fflush(stdout);
+                exit(22);
+        }
+	if(mdebug ==1)
 	{
-		cc.c_client_number = (int)i; 
-		/* Child not started yet */
-		if(child_idents[i].state == C_STATE_ZERO)
-			;
-		/* Child is waiting for who info */
-		if(child_idents[i].state == C_STATE_WAIT_WHO)
-		{
-			if(mdebug)
-				printf("Master sending signaled death to child !!\n");
-			master_send(master_send_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
-		}
-		/* Child is waiting at the barrier */
-		if(child_idents[i].state == C_STATE_WAIT_BARRIER)
-		{
-			if(mdebug)
-				printf("Master sending signaled death to child !!\n");
-			master_send(master_send_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
-			if(mdebug)
-				printf("Master sending signaled death to child async !!\n");
-			master_send(master_send_async_sockets[i],child_idents[i].child_name, &cc,sizeof(struct client_command));
-		}
-			
+	        printf("Master: start master send: %s\n", he->h_name);
+		fflush(stdout);
 	}
-}
-
-/*
- * This closes the file descriptors that were created for the master send and async send
- * at the end of each phase of the throughput testing.
- */
-#ifdef HAVE_ANSIC_C
-void
-cleanup_comm(void)
-#else
-void
-cleanup_comm()
-#endif
-{
-	int i;
-	for(i=0;i<num_child;i++)
+        ip = (struct in_addr *)he->h_addr_list[0];
+#ifndef UWIN
+	if(mdebug ==1)
 	{
-        	close(master_send_sockets[i]);
-        	close(master_send_async_sockets[i]);
+        	printf("Master: child name: %s\n", (char *)inet_ntoa(*ip));
+        	printf("Master: child Port: %d\n", sp_child_listen_port);
+		fflush(stdout);
 	}
-}
-#if 0
-///#endif /*TODO: NET_BENCH - is this the end ??? */
 #endif
 
-#ifdef HAVE_ANSIC_C
-void
-find_remote_shell(char *shell)
-#else
-void
-find_remote_shell(shell)
-char *shell;
-#endif
-{
-	char *value;
-	value=(char *)getenv("RSH");
-	if(value)
+	port=sp_child_listen_port;
+	sp_my_ms_addr->s_addr = ip->s_addr;
+	/*port=CHILD_LIST_PORT;*/
+
+        raddr.sin_family = AF_INET;
+        raddr.sin_port = htons(port);
+        raddr.sin_addr.s_addr = ip->s_addr;
+        master_socket_val = socket(AF_INET, SOCK_STREAM, 0);
+        if (master_socket_val < 0)
+        {
+                perror("Master: socket failed:");
+                exit(23);
+        }
+        bzero(&addr, sizeof(struct sockaddr_in));
+	tmp_port=sp_master_esend_port;
+        addr.sin_port = htons(tmp_port);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        rc = -1;
+        while (rc < 0)
+        {
+                rc = bind(master_socket_val, (struct sockaddr *)&addr,
+                                                sizeof(struct sockaddr_in));
+		if(rc < 0)
+		{
+			tmp_port++;
+                	addr.sin_port=htons(tmp_port);
+			continue;
+		}
+        }
+	if(mdebug ==1)
 	{
-		strcpy(shell,value);
-		return;
+		printf("Master: Bound port\n");
+		fflush(stdout);
 	}
-#ifdef _HPUX_SOURCE
-	strcpy(shell,"remsh");
+        if (rc < 0)
+        {
+                perror("Master: bind failed for sync channel to child.\n");
+                exit(24);
+        }
+#if defined(Windows)
+	sleep(1);
+#else
+	nanosleep(&req,&rem);
+#endif
+
+again:
+        rc = connect(master_socket_val, (struct sockaddr *)&raddr, 
+			sizeof(struct sockaddr_in));
+	if (rc < 0)
+        {
+		if(ecount++ < 300)
+		{
+#if defined(Windows)
+			sleep(1);
 #else
-	strcpy(shell,"rsh");
+			nanosleep(&req,&rem);
 #endif
-	return;
+			/*sleep(1);*/
+			goto again;
+		}
+                perror("Master: connect failed\n");
+		printf("Error %d\n",errno);
+                exit(25);
+        }
+	if(mdebug ==1)
+	{
+		printf("Master Connected\n");
+		fflush(stdout);
+	}
+	return (master_socket_val);
 }
 
-#ifdef IMON_ENABLED
+/*
+ * Start the childs listening service for messages from the master.
+ */
 #ifdef HAVE_ANSIC_C
-void
-find_external_mon(char * imon_start, char * imon_stop)
+int
+sp_start_child_listen(int listen_port, int size_of_message)
 #else
-void
-find_external_mon(imon_start,imon_stop)
-char *imon_start,*imon_stop;
+int
+sp_start_child_listen(listen_port, size_of_message)
+int listen_port;
+int size_of_message;
 #endif
 {
-	char *start,*stop,*sync;
-	imon_start[0]=(char)0;
-	imon_stop[0]=(char)0;
-	start=(char *)getenv("IMON_START");
-	if(start)
-	{
-		strcpy(imon_start,start);
+	int tsize;
+	int s,ns;
+	unsigned int me;
+	int rc;
+	int xx;
+	int tmp_port;
+	struct sockaddr_in *addr;
+	int sockerr;
+	int recv_buf_size=65536;
+	int optval=1;
+	xx = 0;
+	me=sizeof(struct sockaddr_in);
+	tsize=size_of_message; /* Number of messages to receive */
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        if (s < 0)
+        {
+                perror("socket failed:");
+                exit(19);
+        }
+	sockerr = setsockopt (s, SOL_SOCKET, SO_RCVBUF, (char *)
+		&recv_buf_size, sizeof(int));
+	if ( sockerr == -1 ) {
+		perror("Error in setsockopt 7\n");
 	}
-	stop=(char *)getenv("IMON_STOP");
-	if(stop)
+	sockerr = setsockopt (s, SOL_SOCKET, SO_REUSEADDR, (char *)
+		&optval, sizeof(int));
+	if ( sockerr == -1 ) {
+		perror("Error in setsockopt 8\n");
+	}
+        bzero(&sp_child_sync_sock, sizeof(struct sockaddr_in));
+	tmp_port=sp_child_listen_port;
+        sp_child_sync_sock.sin_port = htons(tmp_port);
+        sp_child_sync_sock.sin_family = AF_INET;
+        sp_child_sync_sock.sin_addr.s_addr = INADDR_ANY;
+        rc = -1;
+        while (rc < 0)
+        {
+                rc = bind(s, (struct sockaddr *)&sp_child_sync_sock,
+                                sizeof(struct sockaddr_in));
+		if(rc < 0)
+		{
+			tmp_port++;
+                	sp_child_sync_sock.sin_port=htons(tmp_port);
+			continue;
+		}
+        }
+	sp_child_listen_port = ntohs(sp_child_sync_sock.sin_port);
+	if(cdebug ==1)
 	{
-		strcpy(imon_stop,stop);
+		fprintf(newstdout,"Child: Listen: Bound at port %d\n", tmp_port);
+		fflush(newstdout);
 	}
-	sync=(char *)getenv("IMON_SYNC");
-	if(sync)
+	if(rc < 0)
 	{
-		imon_sync=1;
+		if(cdebug ==1)
+		{
+		   fprintf(newstdout,"bind failed. Errno %d\n", errno);
+		   fflush(newstdout);
+		}
+		exit(20);
 	}
 
-	return;
-}	
-#endif
-
-/*
- * This test is only valid in throughput mode.
- */
-
-#ifdef HAVE_ANSIC_C
-void 
-mix_perf_test(off64_t kilo64,long long reclen,long long *data1,long long *data2)
-#else
-void 
-mix_perf_test(kilo64,reclen,data1,data2)
-off64_t kilo64;
-long long reclen;
-long long *data1,*data2;
-#endif
-{
-	return;
-/*
-	printf("\nMix mode test only valid in throughput mode.\n");
-	signal_handler();
-	exit(180);
-*/
+	addr=&sp_child_async_sock;
+	listen(s,10);
+	if(cdebug)
+	{
+		fprintf(newstdout,"Child enters accept\n");
+		fflush(newstdout);
+	}
+	ns=accept(s,(void *)addr,&me);
+	if(cdebug)
+	{
+		fprintf(newstdout,"Child attached for receive. Sock %d  %d\n", ns,errno);
+		fflush(newstdout);
+	}
+	close(s);
+	return(ns);
 }
 
-/*
- * Speed check code 
- */
-char *sp_dest; /* Name of destination for messages */
-
-int sp_child_listen_port = SP_CHILD_LISTEN_PORT;
-int sp_child_esend_port  = SP_CHILD_ESEND_PORT;
-
-int sp_master_listen_port = SP_MASTER_LISTEN_PORT;
-int sp_master_esend_port  = SP_MASTER_ESEND_PORT;
-
-int sp_master_results_port = SP_MASTER_RESULTS_PORT;
-
-struct in_addr sp_my_cs_addr;
-struct in_addr sp_my_ms_addr;
-struct sockaddr_in sp_child_sync_sock, sp_child_async_sock;
-struct sockaddr_in sp_master_sync_sock, sp_master_async_sock;
-char *sp_buf;
-char sp_command[1024];
-char sp_remote_shell[100];
-int sp_child_mode;
-int sp_count,sp_msize,sp_once;
-int sp_tcount;
-double sp_start_time,sp_finish_time;
-void sp_send_result(int, int, float );
-void sp_get_result(int , int );
-void sp_do_child_t(void);
-void sp_do_master_t(void);
-void speed_main(char *, char *, long long ,long long , int);
-int sp_cret;
-char sp_remote_host[256];
-char sp_master_host[256];
-char sp_location[256];
-
 
 /*
- * This is the front end for the speed check code
+ * The client runs this code
  */
 #ifdef HAVE_ANSIC_C
 void
-speed_main(char *client_name, char *e_path, long long reclen,
-	long long kilos, int client_flag)
+sp_do_child_t(void)
 #else
 void
-speed_main(client_name, e_path, reclen, kilos, client_flag)
-char *client_name;
-char *e_path;
-long long reclen;
-long long kilos;
-int client_flag;
+sp_do_child_t()
 #endif
 {
-	int x;
-
-
-	strcpy(sp_master_host,controlling_host_name);
-	sp_msize=(int)reclen;
-	sp_count=((int)kilos*1024)/(int)reclen;
-	if(!client_flag)
-	{
-		printf("\n");
-		strcpy(sp_remote_host,client_name);
-		strcpy(sp_location,e_path);
-	}
-
-	if(client_flag)
-		sp_child_mode=1;
-	sp_buf=(char *)malloc(sp_msize);
-	bzero(sp_buf,sp_msize); /* get page faults out of the way */
-
-	if(sp_child_mode)
+	int i,y;
+	int offset;
+	int sp_tcount=0;
+	/* child */
+	/*
+	 * Child reads from master 
+	 */
+	sp_crfd=sp_start_child_listen(sp_child_listen_port, sp_msize);
+	sp_start_time=time_so_far();
+	for(i=0;i<sp_count;i++)
 	{
-		close(0);
-		close(1);
-		close(2);
-		if(cdebug)
+		offset=0;
+		while(offset<sp_msize)
 		{
-			newstdin=freopen("/tmp/don_in","r+",stdin);
-			newstdout=freopen("/tmp/don_out","a+",stdout);
-			newstderr=freopen("/tmp/don_err","a+",stderr);
+			y=read(sp_crfd,&sp_buf[offset],sp_msize-offset);
+			if(y < 0)
+			{
+			      	if(cdebug)
+				{
+					fprintf(newstdout,"Child error %d offset %d\n",
+						errno,offset);
+					fflush(newstdout);
+				}
+				exit(1);
+			}
+			offset+=y;
+			if(cdebug)
+			{
+				fprintf(newstdout,"Child offset %d read %d\n",offset,y);
+				fflush(newstdout);
+			}
 		}
-		sp_dest=sp_master_host;
-		sp_do_child_t();
-		free(sp_buf);
-		exit(0);
+		sp_tcount+=offset;
 	}
-	x=fork();
-	if(x==0)
+	sp_finish_time=time_so_far();
+
+	close(sp_crfd);
+	sleep(1); /* Wait for master to get into sp_get_result */
+	sp_send_result(sp_master_results_port, sp_tcount/1024, 
+		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
+
+	sleep(1);
+	/*
+	 * Child writes to master 
+	 */
+	sp_csfd=sp_start_child_send(sp_dest, sp_master_listen_port,
+		&sp_my_cs_addr);
+	sp_tcount=0;
+	offset=0;
+	sp_start_time=time_so_far();
+	for(i=0;i<sp_count;i++)
 	{
-		find_remote_shell(sp_remote_shell);
-	 sprintf(sp_command,"%s %s %s -+s -t 1 -r %d -s %d -+c %s -+t ",
-			sp_remote_shell, sp_remote_host, 
-			sp_location, (int)reclen/1024, 
-			(int)kilos,sp_master_host);
-		/*printf("%s\n",sp_command);*/
-		junk=system(sp_command);
-		exit(0);
+		y=write(sp_csfd,sp_buf,sp_msize);
+		sp_tcount+=y;
 	}
-	else
+	sp_finish_time=time_so_far();
+	close(sp_csfd);
+	sleep(1);
+	sp_send_result(sp_master_results_port, sp_tcount/1024, 
+		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
+	if(cdebug)
 	{
-		if(!sp_once)
-		{
-		printf("***************************************************\n");
-		printf("* >>>>>     Client Network Speed check      <<<<< *\n");
-		printf("***************************************************\n\n");
-			printf("Master: %s\n",sp_master_host);
-			printf("Transfer size %d bytes  \n",sp_msize);
-			printf("Count %d\n",sp_count);
-			printf("Total size %d kbytes  \n\n",
-				(sp_msize*sp_count)/1024);
-			sp_once=1;
-		}
-		sp_dest=sp_remote_host;
-		sleep(1);
-		sp_do_master_t();
-		free(sp_buf);
+		fprintf(newstdout,"child exits\n");
+		fflush(newstdout);
 	}
 }
 
 /*
- * Get results back from the client.
+ * The master runs this code.
  */
 #ifdef HAVE_ANSIC_C
 void
-sp_get_result(int port,int flag)
+sp_do_master_t(void)
 #else
 void
-sp_get_result(port,flag)
-int port,flag;
+sp_do_master_t()
 #endif
 {
-	int tcfd;
-	float throughput;
-	int count;
-	char mybuf[1024];
-	int sp_offset,xx;
+	int i,y,sp_offset;
+	int sp_tcount = 0;
 
-	tcfd=sp_start_master_listen(port, 1024);
+
+	/*
+	 * Master writes to child 
+	 */
+	sp_msfd=sp_start_master_send(sp_dest, sp_child_listen_port,
+		&sp_my_ms_addr);
+	sp_start_time=time_so_far();
+	for(i=0;i<sp_count;i++)
+	{
+		y=write(sp_msfd,sp_buf,sp_msize);
+		sp_tcount+=y;
+	}
+	sp_finish_time=time_so_far();
+	close(sp_msfd);
+	sp_msfd=0;
+	sp_get_result(sp_master_results_port,0);
+	printf("%-20s  sent     %10d kbytes @ %10.2f Kbytes/sec \n",
+		sp_master_host,sp_tcount/1024, 
+		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
+
+	/* printf("\n"); */
+	/*
+	 * Master reads from child 
+	 */
+	sp_mrfd=sp_start_master_listen(sp_master_listen_port, sp_msize);
 	sp_offset=0;
-	while(sp_offset < 1024)
+	sp_start_time=time_so_far();
+	sp_tcount=0;
+	for(i=0;i<sp_count;i++)
 	{
-		xx=read(tcfd,&mybuf[sp_offset],1024);
-		sp_offset+=xx;
+		sp_offset=0;
+		while(sp_offset<sp_msize)
+		{
+			y=read(sp_mrfd,&sp_buf[sp_offset],sp_msize-sp_offset);
+			if(y < 0)
+			{
+			      	printf("Master error %d offset %d\n",errno,
+					sp_offset);
+				exit(1);
+			}
+			sp_offset+=y;
+			/* printf("Master offset %d read %d\n",offset,y);*/
+		}
+		sp_tcount+=sp_offset;
 	}
-	sscanf(mybuf,"%d %f",&count,&throughput);
-	if(!flag)
-		printf("%-20s received  %10d Kbytes @ %10.2f Kbytes/sec \n",
-			sp_remote_host,count,throughput);
-	else
-		printf("%-20s  sent     %10d Kbytes @ %10.2f Kbytes/sec \n",
-			sp_remote_host,count,throughput);
-	close(tcfd);
+	sp_finish_time=time_so_far();
+	sp_get_result(sp_master_results_port,1);
+	printf("%-20s received  %10d kbytes @ %10.2f Kbytes/sec \n",
+		sp_master_host,sp_tcount/1024,
+		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
+	printf("\n");
+	wait(NULL);
+	close(sp_mrfd);
+	sp_mrfd=0;
 }
 
 /*
- * Send results to the master.
+ * Start the master listening service for messages from the child.
  */
 #ifdef HAVE_ANSIC_C
-void
-sp_send_result(int port, int count, float throughput)
+int
+sp_start_master_listen(int sp_master_listen_port, int sp_size_of_message)
 #else
-void
-sp_send_result(port, count, throughput)
-int port,count; 
-float throughput;
+int
+sp_start_master_listen(sp_master_listen_port, sp_size_of_message)
+int sp_size_of_message;
+int sp_master_listen_port;
 #endif
 {
-	int msfd;
-	char mybuf[1024];
-	sprintf(mybuf,"%d %f",count, throughput);
-	msfd=sp_start_child_send(sp_dest, port, &sp_my_cs_addr);
-	junk=write(msfd,mybuf,1024);
-	if(cdebug)
+	int tsize;
+	int s,ns;
+	unsigned int me;
+	int rc;
+	int xx;
+	int tmp_port;
+	struct sockaddr_in *addr;
+	int sockerr;
+	int recv_buf_size=65536;
+	int optval=1;
+	xx = 0;
+	me=sizeof(struct sockaddr_in);
+	tsize=sp_size_of_message; /* Number of messages to receive */
+        s = socket(AF_INET, SOCK_STREAM, 0);
+        if (s < 0)
+        {
+                perror("socket failed:");
+                exit(19);
+        }
+	sockerr = setsockopt (s, SOL_SOCKET, SO_RCVBUF, (char *)
+		&recv_buf_size, sizeof(int));
+	if ( sockerr == -1 ) {
+		perror("Error in setsockopt 9\n");
+	}
+	sockerr = setsockopt (s, SOL_SOCKET, SO_REUSEADDR, (char *)
+		&optval, sizeof(int));
+	if ( sockerr == -1 ) {
+		perror("Error in setsockopt 10\n");
+	}
+        bzero(&sp_master_sync_sock, sizeof(struct sockaddr_in));
+	tmp_port=sp_master_listen_port;
+        sp_master_sync_sock.sin_port = htons(tmp_port);
+        sp_master_sync_sock.sin_family = AF_INET;
+        sp_master_sync_sock.sin_addr.s_addr = INADDR_ANY;
+        rc = -1;
+        while (rc < 0)
+        {
+                rc = bind(s, (struct sockaddr *)&sp_master_sync_sock,
+                                sizeof(struct sockaddr_in));
+		if(rc < 0)
+		{
+			tmp_port++;
+                	sp_master_sync_sock.sin_port=htons(tmp_port);
+			continue;
+		}
+        }
+	sp_master_listen_port = ntohs(sp_master_sync_sock.sin_port);
+	if(mdebug ==1)
 	{
-		fprintf(newstdout,"Sending result\n");
-		fflush(newstdout);
+		printf("Master: Listen: Bound at port %d\n", tmp_port);
+		fflush(stdout);
 	}
-	close(msfd);
+	if(rc < 0)
+	{
+		perror("bind failed\n");
+		exit(20);
+	}
+
+	addr=&sp_master_async_sock;
+	listen(s,10);
+	if(mdebug)
+	{
+		printf("Master enters accept\n");
+		fflush(stdout);
+	}
+	ns=accept(s,(void *)addr,&me);
+	if(mdebug)
+	{
+		printf("Master attached for receive. Sock %d  %d\n", ns,errno);
+		fflush(stdout);
+	}
+	close(s);
+	return(ns);
 }
 
 /*
- * Start the channel for the master to send a message to 
- * a child on a port that the child
- * has created for the parent to use to communicate.
+ * Start the channel for the child to send a message to 
+ * the master.
  */
 #ifdef HAVE_ANSIC_C
 int
-sp_start_master_send(char *sp_child_host_name, int sp_child_listen_port, struct in_addr *sp_my_ms_addr)
+sp_start_child_send(char *sp_master_host_name, int sp_master_listen_port, struct in_addr *sp_my_cs_addr)
 #else
 int
-sp_start_master_send(sp_child_host_name, sp_child_listen_port, sp_my_ms_addr)
-char *sp_child_host_name; 
-int sp_child_listen_port;
-struct in_addr *sp_my_ms_addr;
+sp_start_child_send(sp_master_host_name, sp_master_listen_port, sp_my_cs_addr)
+char *sp_master_host_name; 
+int sp_master_listen_port;
+struct in_addr *sp_my_cs_addr;
 #endif
 {
-	int rc,master_socket_val;
+	int rc,sp_child_socket_val;
 	struct sockaddr_in addr,raddr;
 	struct hostent *he;
 	int port,tmp_port;
-	int ecount=0;
 	struct in_addr *ip;
+	int ecount=0;
 	struct timespec req,rem;
 
 	req.tv_sec = 0;
@@ -24056,50 +27927,43 @@ struct in_addr *sp_my_ms_addr;
 	rem.tv_sec = 0;
 	rem.tv_nsec = 10000000;
 
-        he = gethostbyname(sp_child_host_name);
-        if (he == NULL)
-        {
-                printf("Master: Bad hostname >%s<\n",sp_child_host_name);
-		fflush(stdout);
-                exit(22);
-        }
-	if(mdebug ==1)
-	{
-	        printf("Master: start master send: %s\n", he->h_name);
-		fflush(stdout);
-	}
-        ip = (struct in_addr *)he->h_addr_list[0];
-#ifndef UWIN
-	if(mdebug ==1)
-	{
-        	printf("Master: child name: %s\n", (char *)inet_ntoa(*ip));
-        	printf("Master: child Port: %d\n", sp_child_listen_port);
+        he = gethostbyname(sp_master_host_name);
+        if (he == NULL)
+        {
+                printf("Child: Bad hostname >%s<\n",sp_master_host_name);
 		fflush(stdout);
+                exit(22);
+        }
+	if(cdebug ==1)
+	{
+	        fprintf(newstdout,"Child: start child send: %s\n", he->h_name);
+	        fprintf(newstdout,"To: %s at port %d\n",sp_master_host_name,
+			sp_master_listen_port);
+		fflush(newstdout);
 	}
-#endif
+        ip = (struct in_addr *)he->h_addr_list[0];
 
-	port=sp_child_listen_port;
-	sp_my_ms_addr->s_addr = ip->s_addr;
-	/*port=CHILD_LIST_PORT;*/
+	port=sp_master_listen_port;
+	sp_my_cs_addr->s_addr = ip->s_addr;
 
         raddr.sin_family = AF_INET;
         raddr.sin_port = htons(port);
         raddr.sin_addr.s_addr = ip->s_addr;
-        master_socket_val = socket(AF_INET, SOCK_STREAM, 0);
-        if (master_socket_val < 0)
+        sp_child_socket_val = socket(AF_INET, SOCK_STREAM, 0);
+        if (sp_child_socket_val < 0)
         {
-                perror("Master: socket failed:");
+                perror("child: socket failed:");
                 exit(23);
         }
         bzero(&addr, sizeof(struct sockaddr_in));
-	tmp_port=sp_master_esend_port;
+	tmp_port=sp_child_esend_port;
         addr.sin_port = htons(tmp_port);
         addr.sin_family = AF_INET;
         addr.sin_addr.s_addr = INADDR_ANY;
         rc = -1;
         while (rc < 0)
         {
-                rc = bind(master_socket_val, (struct sockaddr *)&addr,
+                rc = bind(sp_child_socket_val, (struct sockaddr *)&addr,
                                                 sizeof(struct sockaddr_in));
 		if(rc < 0)
 		{
@@ -24108,14 +27972,14 @@ struct in_addr *sp_my_ms_addr;
 			continue;
 		}
         }
-	if(mdebug ==1)
+	if(cdebug ==1)
 	{
-		printf("Master: Bound port\n");
-		fflush(stdout);
+		fprintf(newstdout,"Child: Bound port %d\n",tmp_port);
+		fflush(newstdout);
 	}
         if (rc < 0)
         {
-                perror("Master: bind failed for sync channel to child.\n");
+                perror("Child: bind failed for sync channel to child.\n");
                 exit(24);
         }
 #if defined(Windows)
@@ -24123,772 +27987,1143 @@ struct in_addr *sp_my_ms_addr;
 #else
 	nanosleep(&req,&rem);
 #endif
-
 again:
-        rc = connect(master_socket_val, (struct sockaddr *)&raddr, 
+        rc = connect(sp_child_socket_val, (struct sockaddr *)&raddr, 
 			sizeof(struct sockaddr_in));
 	if (rc < 0)
         {
-		if(ecount++ < 300)
+		if(ecount++<300)
 		{
 #if defined(Windows)
 			sleep(1);
 #else
 			nanosleep(&req,&rem);
 #endif
-			/*sleep(1);*/
 			goto again;
 		}
-                perror("Master: connect failed\n");
-		printf("Error %d\n",errno);
-                exit(25);
+
+		fprintf(newstdout,"child: connect failed. Errno %d \n",errno);
+		fflush(newstdout);
+		exit(25);
         }
-	if(mdebug ==1)
+	if(cdebug ==1)
 	{
-		printf("Master Connected\n");
-		fflush(stdout);
+		fprintf(newstdout,"child Connected\n");
+		fflush(newstdout);
 	}
-	return (master_socket_val);
+	return (sp_child_socket_val);
 }
 
-/*
- * Start the childs listening service for messages from the master.
- */
 #ifdef HAVE_ANSIC_C
-int
-sp_start_child_listen(int listen_port, int size_of_message)
+void
+do_speed_check(int client_flag)
 #else
-int
-sp_start_child_listen(listen_port, size_of_message)
-int listen_port;
-int size_of_message;
+void
+do_speed_check(client_flag)
+int client_flag;
 #endif
 {
-	int tsize;
-	int s,ns;
-	unsigned int me;
-	int rc;
-	int xx;
-	int tmp_port;
-	struct sockaddr_in *addr;
-	int sockerr;
-	int recv_buf_size=65536;
-	int optval=1;
-	xx = 0;
-	me=sizeof(struct sockaddr_in);
-	tsize=size_of_message; /* Number of messages to receive */
-        s = socket(AF_INET, SOCK_STREAM, 0);
-        if (s < 0)
-        {
-                perror("socket failed:");
-                exit(19);
-        }
-	sockerr = setsockopt (s, SOL_SOCKET, SO_RCVBUF, (char *)
-		&recv_buf_size, sizeof(int));
-	if ( sockerr == -1 ) {
-		perror("Error in setsockopt 7\n");
-	}
-	sockerr = setsockopt (s, SOL_SOCKET, SO_REUSEADDR, (char *)
-		&optval, sizeof(int));
-	if ( sockerr == -1 ) {
-		perror("Error in setsockopt 8\n");
-	}
-        bzero(&sp_child_sync_sock, sizeof(struct sockaddr_in));
-	tmp_port=sp_child_listen_port;
-        sp_child_sync_sock.sin_port = htons(tmp_port);
-        sp_child_sync_sock.sin_family = AF_INET;
-        sp_child_sync_sock.sin_addr.s_addr = INADDR_ANY;
-        rc = -1;
-        while (rc < 0)
-        {
-                rc = bind(s, (struct sockaddr *)&sp_child_sync_sock,
-                                sizeof(struct sockaddr_in));
-		if(rc < 0)
-		{
-			tmp_port++;
-                	sp_child_sync_sock.sin_port=htons(tmp_port);
-			continue;
-		}
-        }
-	sp_child_listen_port = ntohs(sp_child_sync_sock.sin_port);
-	if(cdebug ==1)
+	int i;
+	if(client_flag)
 	{
-		fprintf(newstdout,"Child: Listen: Bound at port %d\n", tmp_port);
-		fflush(newstdout);
+		speed_main(" "," ",reclen,kilobytes64,client_flag);
 	}
-	if(rc < 0)
+	else
 	{
-		if(cdebug ==1)
+		printf("Checking %d clients\n",clients_found);
+		for(i=0;i<clients_found;i++)
 		{
-		   fprintf(newstdout,"bind failed. Errno %d\n", errno);
-		   fflush(newstdout);
+			speed_main(child_idents[i].child_name,
+				child_idents[i].execute_path,
+				reclen, kilobytes64,client_flag);
 		}
-		exit(20);
 	}
+}
 
-	addr=&sp_child_async_sock;
-	listen(s,10);
-	if(cdebug)
+#endif /* TODO:NET_BENCH - may be the end here ??? */
+
+
+#ifdef HAVE_ANSIC_C
+void
+get_date(char *where)
+#else
+get_date(where)
+char *where;
+#endif
+{
+	time_t t;
+	char *value;
+	t=time(0);
+	value=(char *)ctime(&t);
+	strcpy(where,value);
+}
+
+/* Richard Sharpe decided to hack up Samba and
+ * have it detect Iozone running, and then
+ * produce the data without doing any actual
+ * I/O. This was a HIGHLY questionable thing to
+ * be doing (my opinion). It may have been a lab
+ * experiment that was accidentally released into 
+ * the wild, but now that it is, no choice but
+ * to prevent its use. So... the pattern
+ * that he was locking on to, is now random,
+ * and will change with every release of Iozone.
+ * See: http://lists.samba.org/archive/samba-technical/2005-April/040541.html
+ */
+
+#ifdef HAVE_ANSIC_C
+int
+get_pattern(void)
+#else
+get_pattern(void)
+#endif
+{
+        int i,x,y;
+        char cp[100],*ptr;
+        int pat;
+	unsigned char inp_pat;
+	unsigned int temp;
+
+        y=0;
+        ptr=&cp[0];
+        strcpy(cp,THISVERSION);
+        x=strlen(THISVERSION);
+        for(i=0;i<x;i++)
+                y+=*ptr++;
+        srand(y);
+        pat=(rand()& 0xff);
+	/* For compatibility with old 0xa5 data sets. */
+	if(Z_flag)
+		pat=0xa5;
+	/* Lock pattern to 0xBB, for filesystem short circuit debug */
+	if(X_flag)
+		pat=PATTERN1;
+	/* Set global pattern */
+	inp_pat = pat;
+	temp =((inp_pat << 24) | (inp_pat << 16) | (inp_pat << 8) | inp_pat);
+        return(pat);
+}
+
+/* 
+ * Allocate the buffer for purge. 
+*/
+#ifdef HAVE_ANSIC_C
+void
+alloc_pbuf(void)
+#else
+alloc_pbuf(void)
+#endif
+{
+	pbuffer = (char *) alloc_mem((long long)(3 * cache_size),(int)0);
+	if(pbuffer == 0) {
+              	perror("(18) Memory allocation failed:");
+               	exit(9);
+	}
+#ifdef _64BIT_ARCH_
+	pbuffer = (char *) 
+		(((unsigned long long)pbuffer + cache_size ) 
+		& ~(cache_size-1));
+#else
+	pbuffer = (char *) 
+		(((long)pbuffer + (long)cache_size ) 
+		& ~((long)cache_size-1));
+#endif
+}
+
+/* 
+ * Check to see if the file descriptor points at a file
+ * or a device.
+ */
+#ifdef HAVE_ANSIC_C
+int
+check_filename(char *name)
+#else
+check_filename(name)
+char *name;
+#endif
+{
+#ifdef _LARGEFILE64_SOURCE
+	struct stat64 mystat;
+#else
+	struct stat mystat;
+#endif
+	int x;
+	if(strlen(name)==0)
+		return(0);
+	/* Lets try stat first.. may get an error if file is too big */
+	x=I_STAT(name,&mystat);
+	if(x<0)
 	{
-		fprintf(newstdout,"Child enters accept\n");
-		fflush(newstdout);
+		return(0);
+		/* printf("Stat failed %d\n",x); */
 	}
-	ns=accept(s,(void *)addr,&me);
-	if(cdebug)
+	if(mystat.st_mode & S_IFREG)
 	{
-		fprintf(newstdout,"Child attached for receive. Sock %d  %d\n", ns,errno);
-		fflush(newstdout);
+		/*printf("Is a regular file\n");*/
+		return(1);
 	}
-	close(s);
-	return(ns);
+	return(0);
 }
 
-
-/*
- * The client runs this code
- */
+#ifdef IMON_ENABLED
 #ifdef HAVE_ANSIC_C
 void
-sp_do_child_t(void)
+start_monitor(char *test)
 #else
-void
-sp_do_child_t()
+start_monitor(test)
+char *test;
 #endif
 {
-	int i,y;
-	int offset;
-	int sp_tcount=0;
-	/* child */
-	/*
-	 * Child reads from master 
-	 */
-	sp_crfd=sp_start_child_listen(sp_child_listen_port, sp_msize);
-	sp_start_time=time_so_far();
-	for(i=0;i<sp_count;i++)
-	{
-		offset=0;
-		while(offset<sp_msize)
-		{
-			y=read(sp_crfd,&sp_buf[offset],sp_msize-offset);
-			if(y < 0)
-			{
-			      	if(cdebug)
-				{
-					fprintf(newstdout,"Child error %d offset %d\n",
-						errno,offset);
-					fflush(newstdout);
-				}
-				exit(1);
-			}
-			offset+=y;
-			if(cdebug)
-			{
-				fprintf(newstdout,"Child offset %d read %d\n",offset,y);
-				fflush(newstdout);
-			}
-		}
-		sp_tcount+=offset;
-	}
-	sp_finish_time=time_so_far();
-
-	close(sp_crfd);
-	sleep(1); /* Wait for master to get into sp_get_result */
-	sp_send_result(sp_master_results_port, sp_tcount/1024, 
-		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
-
-	sleep(1);
-	/*
-	 * Child writes to master 
-	 */
-	sp_csfd=sp_start_child_send(sp_dest, sp_master_listen_port,
-		&sp_my_cs_addr);
-	sp_tcount=0;
-	offset=0;
-	sp_start_time=time_so_far();
-	for(i=0;i<sp_count;i++)
-	{
-		y=write(sp_csfd,sp_buf,sp_msize);
-		sp_tcount+=y;
-	}
-	sp_finish_time=time_so_far();
-	close(sp_csfd);
-	sleep(1);
-	sp_send_result(sp_master_results_port, sp_tcount/1024, 
-		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
-	if(cdebug)
+	char command_line[256];
+	if(strlen(imon_start)!=0)
 	{
-		fprintf(newstdout,"child exits\n");
-		fflush(newstdout);
+		if(imon_sync)
+		   sprintf(command_line,"%s %s",imon_start,test);
+		else
+		   sprintf(command_line,"%s %s&",imon_start,test);
+		junk=system(command_line);
 	}
 }
-
-/*
- * The master runs this code.
- */
 #ifdef HAVE_ANSIC_C
 void
-sp_do_master_t(void)
+stop_monitor(char *test)
 #else
-void
-sp_do_master_t()
+stop_monitor(test)
+char *test;
 #endif
 {
-	int i,y,sp_offset;
-	int sp_tcount = 0;
-
-
-	/*
-	 * Master writes to child 
-	 */
-	sp_msfd=sp_start_master_send(sp_dest, sp_child_listen_port,
-		&sp_my_ms_addr);
-	sp_start_time=time_so_far();
-	for(i=0;i<sp_count;i++)
+	char command_line[256];
+	if(strlen(imon_stop)!=0)
 	{
-		y=write(sp_msfd,sp_buf,sp_msize);
-		sp_tcount+=y;
+		if(imon_sync)
+		   sprintf(command_line,"%s %s",imon_stop,test);
+		else
+		   sprintf(command_line,"%s %s &",imon_stop,test);
+		junk=system(command_line);
 	}
-	sp_finish_time=time_so_far();
-	close(sp_msfd);
-	sp_msfd=0;
-	sp_get_result(sp_master_results_port,0);
-	printf("%-20s  sent     %10d kbytes @ %10.2f Kbytes/sec \n",
-		sp_master_host,sp_tcount/1024, 
-		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
+}
+#endif /* IMON_ENABLED */
 
-	/* printf("\n"); */
-	/*
-	 * Master reads from child 
-	 */
-	sp_mrfd=sp_start_master_listen(sp_master_listen_port, sp_msize);
-	sp_offset=0;
-	sp_start_time=time_so_far();
-	sp_tcount=0;
-	for(i=0;i<sp_count;i++)
+/* 
+ * As quickly as possible, generate a new buffer that
+ * can not be easily compressed, or de-duped. Also
+ * permit specified percentage of buffer to be updated.
+ *
+ * ibuf ... input buffer
+ * obuf ... output buffer
+ * seed ... Seed to use for srand, rand -> xor ops
+ *          Seed composed from: blocknumber
+		(do not include childnum as you want duplicates)
+ * size ... size of buffers. (in bytes)
+ * percent. Percent of buffer to modify.
+ * percent_interior. Percent of buffer that is dedupable within 
+ *                   and across files 
+ * percent_compress. Percent of buffer that is dedupable within 
+ *                   but not across files 
+ *
+ * Returns 0 (zero) for success, and -1 (minus one) for failure.
+ */
+int
+gen_new_buf(char *ibuf, char *obuf, long seed, int size, int percent,
+	int percent_interior, int percent_compress, int all)
+{
+	register long *ip, *op; /* Register for speed 	*/
+	register long iseed; 	/* Register for speed 	*/
+	register long isize; 	/* Register for speed 	*/
+	register long cseed;	/* seed for dedupable for within & ! across */
+	register int x,w; 	/* Register for speed 	*/
+	register long value; 	/* Register for speed 	*/
+	register int interior_size; 	/* size of interior dedup region */
+	register int compress_size; 	/* size of compression dedup region */
+	if(ibuf == NULL)	/* no input buf 	*/
+		return(-1);
+	if(obuf == NULL)	/* no output buf 	*/
+		return(-1);
+	if((percent > 100) || (percent < 0)) /* percent check */
+		return(-1);
+	if(size == 0)		/* size check 		*/
+		return(-1);
+	/* Same for every child: dedupable across files */
+	iseed = (long)counter_rand((unsigned long long)dedup_mseed,
+		(unsigned long long)numrecs64, (unsigned long long)seed);
+	isize = (size * percent)/100; /* percent that is dedupable */
+	interior_size = ((isize * percent_interior)/100);/* /sizeof(long) */
+	compress_size =((interior_size * percent_compress)/100);
+	ip = (long *)ibuf;	/* pointer to input buf */
+	op = (long *)obuf;	/* pointer to output buf */
+	if(all == 0)		/* Special case for verify only */
+		isize = sizeof(long);
+	/* interior_size = dedup_within + dedup_across */
+	for(w=0;w<interior_size;w+=sizeof(long))	
 	{
-		sp_offset=0;
-		while(sp_offset<sp_msize)
-		{
-			y=read(sp_mrfd,&sp_buf[sp_offset],sp_msize-sp_offset);
-			if(y < 0)
-			{
-			      	printf("Master error %d offset %d\n",errno,
-					sp_offset);
-				exit(1);
-			}
-			sp_offset+=y;
-			/* printf("Master offset %d read %d\n",offset,y);*/
-		}
-		sp_tcount+=sp_offset;
+		*op=0xdeadbeef+dedup_mseed;
+		*ip=0xdeadbeef+dedup_mseed;
+		op++;
+		ip++;
+	}	
+	/* Prepare for dedup within but not across */
+	w=interior_size - compress_size;
+	op=(long *)&obuf[w];
+	ip=(long *)&ibuf[w];
+	/* Same for every record of a child: dedupable within the file */
+	cseed = (long)counter_rand((unsigned long long)dedup_mseed + 1,
+		(unsigned long long)chid, 0);
+	for(w=(interior_size-compress_size);w<interior_size;w+=sizeof(long))	
+	{
+		*op=*ip ^ cseed; /* do the xor op */
+		op++;
+		ip++;
+	}	
+ 	/* isize = dedup across only */
+	for(x=interior_size;x<isize;x+=sizeof(long))	/* tight loop for transformation */
+	{
+		*op=*ip ^ iseed; /* do the xor op */
+		op++;
+		ip++;
+	}	
+	if(all == 0)		/* Special case for verify only */
+		return(0);
+	/* make the rest of the buffer non-dedupable */
+	if(100-percent > 0)
+	{
+		value=(long)counter_rand((unsigned long long)dedup_mseed + 2,
+			(unsigned long long)chid, (unsigned long long)seed);
+/* printf("Non-dedup value %x seed %x\n",value,seed);*/
+		for( ; x<size;x+=sizeof(long))
+			*op++=(*ip++)^value; /* randomize the remainder */
 	}
-	sp_finish_time=time_so_far();
-	sp_get_result(sp_master_results_port,1);
-	printf("%-20s received  %10d kbytes @ %10.2f Kbytes/sec \n",
-		sp_master_host,sp_tcount/1024,
-		(float)(sp_tcount/1024)/(sp_finish_time-sp_start_time));
-	printf("\n");
-	wait(NULL);
-	close(sp_mrfd);
-	sp_mrfd=0;
+	return(0);
+}
+/* 
+ * Used to touch all of the buffers so that the CPU data
+ * cache is hot, and not part of the measurement.
+ */
+void
+touch_dedup(char *i, int size)
+{
+	register int x;
+	register long *ip;
+	ip = (long *)i;
+	for(x=0;x<size/sizeof(long);x++)
+	{
+		/* fill initial buffer */
+		*ip=(long)counter_rand(DEDUPSEED, 0, (unsigned long long)x);
+		ip++;
+	}
+}
+
+/*
+ * Stateless counter based generator: returns the counter'th output of
+ * a SplitMix64 stream selected by (seed, stream). Unlike srand()/rand()
+ * it keeps no state, so children and threads can call it concurrently,
+ * any record's value can be recomputed by the verifier without replay,
+ * and the sequence is the same on every libc (newlib on RTEMS, glibc).
+ */
+#define SPLITMIX_GAMMA	0x9e3779b97f4a7c15ULL
+
+#ifdef HAVE_ANSIC_C
+static unsigned long long
+splitmix64_mix(unsigned long long z)
+#else
+static unsigned long long
+splitmix64_mix(z)
+unsigned long long z;
+#endif
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return(z ^ (z >> 31));
+}
+
+#ifdef HAVE_ANSIC_C
+unsigned long long
+counter_rand(unsigned long long seed, unsigned long long stream,
+	unsigned long long counter)
+#else
+unsigned long long
+counter_rand(seed, stream, counter)
+unsigned long long seed;
+unsigned long long stream;
+unsigned long long counter;
+#endif
+{
+	unsigned long long key;
+
+	key = splitmix64_mix(seed + splitmix64_mix(stream + SPLITMIX_GAMMA));
+	return(splitmix64_mix(key + (counter + 1) * SPLITMIX_GAMMA));
 }
 
 /*
- * Start the master listening service for messages from the child.
+ * Random record order without repeats. The records 0 .. n-1 are run
+ * through a Feistel network over the smallest power of two that holds
+ * n. The index is split in a left and a right half and each round xors
+ * one half with a keyed hash of the other, which is a bijection of the
+ * domain whatever the hash. Results at or beyond n are fed through the
+ * network again (cycle walking) until they land below n, which keeps it
+ * a bijection of [0,n). The domain is smaller than 2n, so that takes
+ * less than two passes on average.
+ *
+ * perm_index(p,i) for i = 0 .. n-1 thus visits every record exactly
+ * once, in random order, with no per-record memory. Any position can
+ * be computed on its own, so children and vector lists can each walk
+ * their own slice of the order.
  */
 #ifdef HAVE_ANSIC_C
-int
-sp_start_master_listen(int sp_master_listen_port, int sp_size_of_message)
+void
+perm_init(struct perm *p, unsigned long long n, unsigned long long key)
 #else
-int
-sp_start_master_listen(sp_master_listen_port, sp_size_of_message)
-int sp_size_of_message;
-int sp_master_listen_port;
+void
+perm_init(p, n, key)
+struct perm *p;
+unsigned long long n;
+unsigned long long key;
 #endif
 {
-	int tsize;
-	int s,ns;
-	unsigned int me;
-	int rc;
-	int xx;
-	int tmp_port;
-	struct sockaddr_in *addr;
-	int sockerr;
-	int recv_buf_size=65536;
-	int optval=1;
-	xx = 0;
-	me=sizeof(struct sockaddr_in);
-	tsize=sp_size_of_message; /* Number of messages to receive */
-        s = socket(AF_INET, SOCK_STREAM, 0);
-        if (s < 0)
-        {
-                perror("socket failed:");
-                exit(19);
-        }
-	sockerr = setsockopt (s, SOL_SOCKET, SO_RCVBUF, (char *)
-		&recv_buf_size, sizeof(int));
-	if ( sockerr == -1 ) {
-		perror("Error in setsockopt 9\n");
-	}
-	sockerr = setsockopt (s, SOL_SOCKET, SO_REUSEADDR, (char *)
-		&optval, sizeof(int));
-	if ( sockerr == -1 ) {
-		perror("Error in setsockopt 10\n");
-	}
-        bzero(&sp_master_sync_sock, sizeof(struct sockaddr_in));
-	tmp_port=sp_master_listen_port;
-        sp_master_sync_sock.sin_port = htons(tmp_port);
-        sp_master_sync_sock.sin_family = AF_INET;
-        sp_master_sync_sock.sin_addr.s_addr = INADDR_ANY;
-        rc = -1;
-        while (rc < 0)
-        {
-                rc = bind(s, (struct sockaddr *)&sp_master_sync_sock,
-                                sizeof(struct sockaddr_in));
-		if(rc < 0)
+	int bits, r;
+
+	for(bits = 0; bits < 64 && (1ULL << bits) < n; bits++)
+		;
+	p->n = n;
+	p->rbits = bits - bits / 2;
+	p->lmask = (1ULL << (bits / 2)) - 1;
+	p->rmask = (1ULL << p->rbits) - 1;
+	for(r = 0; r < PERM_ROUNDS; r++)
+		p->key[r] = counter_rand(key, n, (unsigned long long)r);
+}
+
+#ifdef HAVE_ANSIC_C
+unsigned long long
+perm_index(struct perm *p, unsigned long long i)
+#else
+unsigned long long
+perm_index(p, i)
+struct perm *p;
+unsigned long long i;
+#endif
+{
+	unsigned long long l, x;
+	int r;
+
+	if(p->n < 2)
+		return(0);
+	x = i % p->n;
+	do {
+		l = x >> p->rbits;
+		x &= p->rmask;
+		for(r = 0; r < PERM_ROUNDS; r += 2)
 		{
-			tmp_port++;
-                	sp_master_sync_sock.sin_port=htons(tmp_port);
-			continue;
+			l ^= splitmix64_mix(x ^ p->key[r]) & p->lmask;
+			x ^= splitmix64_mix(l ^ p->key[r + 1]) & p->rmask;
 		}
-        }
-	sp_master_listen_port = ntohs(sp_master_sync_sock.sin_port);
-	if(mdebug ==1)
-	{
-		printf("Master: Listen: Bound at port %d\n", tmp_port);
-		fflush(stdout);
-	}
-	if(rc < 0)
-	{
-		perror("bind failed\n");
-		exit(20);
-	}
-
-	addr=&sp_master_async_sock;
-	listen(s,10);
-	if(mdebug)
-	{
-		printf("Master enters accept\n");
-		fflush(stdout);
-	}
-	ns=accept(s,(void *)addr,&me);
-	if(mdebug)
-	{
-		printf("Master attached for receive. Sock %d  %d\n", ns,errno);
-		fflush(stdout);
-	}
-	close(s);
-	return(ns);
+		x |= l << p->rbits;
+	} while(x >= p->n);
+	return(x);
 }
 
 /*
- * Start the channel for the child to send a message to 
- * the master.
+ * Skewed random access (-+Y). Records are ranked by popularity and
+ * the ranks are spread over the file with a perm, so the hot records
+ * are scattered rather than bunched at the start of the file. A rank
+ * is drawn in constant time from an alias table (Walker/Vose): pick an
+ * entry uniformly, keep it with probability prob[] or take its alias.
+ *
+ * Files of up to DIST_BUCKETS records get one entry per rank. Larger
+ * files keep an entry of their own for the DIST_EXACT hottest ranks
+ * and share the rest of the table among geometrically growing ranges
+ * of ranks, each drawn from uniformly. That keeps the table a fixed
+ * 80 Kbytes for any file size while the head of the curve, where the
+ * cache hits come from, stays exact.
+ *
+ * The weights only need a logarithm and a power. dist_ln() and
+ * dist_exp() provide them so that iozone does not need libm. dist_ln()
+ * also draws the -+O Poisson interarrivals in rate_wait().
  */
+#define DIST_LN2	0.69314718055994530942
+
 #ifdef HAVE_ANSIC_C
-int
-sp_start_child_send(char *sp_master_host_name, int sp_master_listen_port, struct in_addr *sp_my_cs_addr)
+static double
+dist_ln(double x)
 #else
-int
-sp_start_child_send(sp_master_host_name, sp_master_listen_port, sp_my_cs_addr)
-char *sp_master_host_name; 
-int sp_master_listen_port;
-struct in_addr *sp_my_cs_addr;
+static double
+dist_ln(x)
+double x;
 #endif
 {
-	int rc,sp_child_socket_val;
-	struct sockaddr_in addr,raddr;
-	struct hostent *he;
-	int port,tmp_port;
-	struct in_addr *ip;
-	int ecount=0;
-	struct timespec req,rem;
-
-	req.tv_sec = 0;
-	req.tv_nsec = 10000000;
-	rem.tv_sec = 0;
-	rem.tv_nsec = 10000000;
+	double s, t, sum;
+	int e = 0, k;
 
-        he = gethostbyname(sp_master_host_name);
-        if (he == NULL)
-        {
-                printf("Child: Bad hostname >%s<\n",sp_master_host_name);
-		fflush(stdout);
-                exit(22);
-        }
-	if(cdebug ==1)
+	while(x > 1.5)
 	{
-	        fprintf(newstdout,"Child: start child send: %s\n", he->h_name);
-	        fprintf(newstdout,"To: %s at port %d\n",sp_master_host_name,
-			sp_master_listen_port);
-		fflush(newstdout);
+		x /= 2.0;
+		e++;
 	}
-        ip = (struct in_addr *)he->h_addr_list[0];
-
-	port=sp_master_listen_port;
-	sp_my_cs_addr->s_addr = ip->s_addr;
-
-        raddr.sin_family = AF_INET;
-        raddr.sin_port = htons(port);
-        raddr.sin_addr.s_addr = ip->s_addr;
-        sp_child_socket_val = socket(AF_INET, SOCK_STREAM, 0);
-        if (sp_child_socket_val < 0)
-        {
-                perror("child: socket failed:");
-                exit(23);
-        }
-        bzero(&addr, sizeof(struct sockaddr_in));
-	tmp_port=sp_child_esend_port;
-        addr.sin_port = htons(tmp_port);
-        addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = INADDR_ANY;
-        rc = -1;
-        while (rc < 0)
-        {
-                rc = bind(sp_child_socket_val, (struct sockaddr *)&addr,
-                                                sizeof(struct sockaddr_in));
-		if(rc < 0)
-		{
-			tmp_port++;
-                	addr.sin_port=htons(tmp_port);
-			continue;
-		}
-        }
-	if(cdebug ==1)
+	while(x < 0.75)
 	{
-		fprintf(newstdout,"Child: Bound port %d\n",tmp_port);
-		fflush(newstdout);
+		x *= 2.0;
+		e--;
 	}
-        if (rc < 0)
-        {
-                perror("Child: bind failed for sync channel to child.\n");
-                exit(24);
-        }
-#if defined(Windows)
-	sleep(1);
+	/* ln(x) = 2 atanh((x-1)/(x+1)), here |(x-1)/(x+1)| < 0.2 */
+	s = (x - 1.0) / (x + 1.0);
+	t = s * s;
+	sum = 0.0;
+	for(k = 25; k >= 1; k -= 2)
+		sum = sum * t + 1.0 / k;
+	return(2.0 * s * sum + e * DIST_LN2);
+}
+
+#ifdef HAVE_ANSIC_C
+static double
+dist_exp(double y)
 #else
-	nanosleep(&req,&rem);
+static double
+dist_exp(y)
+double y;
 #endif
-again:
-        rc = connect(sp_child_socket_val, (struct sockaddr *)&raddr, 
-			sizeof(struct sockaddr_in));
-	if (rc < 0)
-        {
-		if(ecount++<300)
-		{
-#if defined(Windows)
-			sleep(1);
+{
+	double r, term, sum;
+	int e, k;
+
+	e = (int)(y / DIST_LN2 + (y < 0.0 ? -0.5 : 0.5));
+	r = y - e * DIST_LN2;
+	term = sum = 1.0;
+	for(k = 1; k < 20; k++)
+	{
+		term *= r / k;
+		sum += term;
+	}
+	for(; e > 0; e--)
+		sum *= 2.0;
+	for(; e < 0; e++)
+		sum /= 2.0;
+	return(sum);
+}
+
+#ifdef HAVE_ANSIC_C
+static double
+dist_pow(double x, double y)
 #else
-			nanosleep(&req,&rem);
+static double
+dist_pow(x, y)
+double x;
+double y;
 #endif
-			goto again;
-		}
+{
+	return(dist_exp(y * dist_ln(x)));
+}
 
-		fprintf(newstdout,"child: connect failed. Errno %d \n",errno);
-		fflush(newstdout);
-		exit(25);
-        }
-	if(cdebug ==1)
-	{
-		fprintf(newstdout,"child Connected\n");
-		fflush(newstdout);
-	}
-	return (sp_child_socket_val);
+/*
+ * Share of the accesses that goes to ranks a .. b-1. Zipf gives rank k
+ * the weight (k+1)^-theta. Pareto gives each record a popularity drawn
+ * from a Pareto distribution of shape alpha; sorted, those fall off as
+ * (k+1)^(-1/alpha), so alpha 1.16 is the classic 80/20 split.
+ */
+#ifdef HAVE_ANSIC_C
+static double
+dist_weight(unsigned long long a, unsigned long long b)
+#else
+static double
+dist_weight(a, b)
+unsigned long long a;
+unsigned long long b;
+#endif
+{
+	double theta, e;
+
+	theta = (dist_type == DIST_PARETO) ? 1.0 / dist_param : dist_param;
+	if(b - a == 1)
+		return(dist_pow((double)a + 1.0, -theta));
+	/* Midpoint rule over a range of ranks */
+	e = 1.0 - theta;
+	if(e > -1e-9 && e < 1e-9)
+		return(dist_ln(((double)b + 0.5) / ((double)a + 0.5)));
+	return((dist_pow((double)b + 0.5, e) - dist_pow((double)a + 0.5, e)) / e);
 }
 
 #ifdef HAVE_ANSIC_C
 void
-do_speed_check(int client_flag)
+dist_setup(unsigned long long n)
 #else
 void
-do_speed_check(client_flag)
-int client_flag;
+dist_setup(n)
+unsigned long long n;
 #endif
 {
-	int i;
-	if(client_flag)
+	struct dist *d = &access_dist;
+	double total, step, bound;
+	unsigned long long hot;
+	int i, m, ns, nl, s, l;
+	int *work;
+
+	if(dist_type == DIST_UNIFORM || dist_type == DIST_SEQ || n == 0 ||
+	   d->n == n)
+		return;
+	if(d->start == 0)
 	{
-		speed_main(" "," ",reclen,kilobytes64,client_flag);
+		d->start = (unsigned long long *)malloc(sizeof(*d->start) * (DIST_BUCKETS + 1));
+		d->prob = (double *)malloc(sizeof(*d->prob) * DIST_BUCKETS);
+		d->alias = (int *)malloc(sizeof(*d->alias) * DIST_BUCKETS);
+	}
+	work = (int *)malloc(sizeof(*work) * DIST_BUCKETS);
+	if(d->start == 0 || d->prob == 0 || d->alias == 0 || work == 0)
+	{
+		printf("Unable to allocate the access distribution, using uniform\n");
+		dist_type = DIST_UNIFORM;
+		if(work)
+			free(work);
+		return;
+	}
+
+	/* Entry boundaries and weights */
+	if(dist_type == DIST_HOT)
+	{
+		hot = (unsigned long long)((double)n * dist_param / 100.0);
+		if(hot < 1)
+			hot = 1;
+		d->buckets = (hot < n) ? 2 : 1;
+		d->start[0] = 0;
+		d->start[1] = hot;
+		d->prob[0] = (d->buckets == 1) ? 1.0 : dist_share;
+		d->prob[1] = 100.0 - dist_share;
 	}
 	else
 	{
-		printf("Checking %d clients\n",clients_found);
-		for(i=0;i<clients_found;i++)
+		if(n <= DIST_BUCKETS)
+		{
+			d->buckets = (int)n;
+			for(i = 0; i < d->buckets; i++)
+				d->start[i] = i;
+		}
+		else
+		{
+			for(i = 0; i < DIST_EXACT; i++)
+				d->start[i] = i;
+			m = DIST_BUCKETS - DIST_EXACT;
+			step = dist_ln((double)n / DIST_EXACT) / m;
+			for(; i < DIST_BUCKETS; i++)
+			{
+				bound = DIST_EXACT * dist_exp((i - DIST_EXACT) * step);
+				d->start[i] = (unsigned long long)(bound + 0.5);
+				if(d->start[i] <= d->start[i - 1])
+					d->start[i] = d->start[i - 1] + 1;
+				if(d->start[i] >= n)
+					break;
+			}
+			d->buckets = i;
+		}
+		d->start[d->buckets] = n;
+		for(i = 0; i < d->buckets; i++)
+			d->prob[i] = dist_weight(d->start[i], d->start[i + 1]);
+	}
+	d->start[d->buckets] = n;
+
+	/* Vose's alias method; work[] holds the small then the large entries */
+	total = 0.0;
+	for(i = 0; i < d->buckets; i++)
+		total += d->prob[i];
+	ns = 0;
+	nl = d->buckets;
+	for(i = 0; i < d->buckets; i++)
+	{
+		d->prob[i] = d->prob[i] * d->buckets / total;
+		d->alias[i] = i;
+		if(d->prob[i] < 1.0)
+			work[ns++] = i;
+		else
+			work[--nl] = i;
+	}
+	while(ns > 0 && nl < d->buckets)
+	{
+		s = work[--ns];
+		l = work[nl];
+		d->alias[s] = l;
+		d->prob[l] -= 1.0 - d->prob[s];
+		if(d->prob[l] < 1.0)
 		{
-			speed_main(child_idents[i].child_name,
-				child_idents[i].execute_path,
-				reclen, kilobytes64,client_flag);
+			nl++;
+			work[ns++] = l;
 		}
 	}
+	while(ns > 0)
+		d->prob[work[--ns]] = 1.0;
+	for(; nl < d->buckets; nl++)
+		d->prob[work[nl]] = 1.0;
+	free(work);
+	perm_init(&d->order, n, PERMSEED);
+	d->n = n;
 }
 
-#endif /* TODO:NET_BENCH - may be the end here ??? */
-
-
+/*
+ * Start a child's walk. Each child draws from its own counter_rand()
+ * stream, kept in the walk, so children and threads never share
+ * generator state and every run repeats.
+ */
 #ifdef HAVE_ANSIC_C
 void
-get_date(char *where)
+dist_start(struct dist_walk *w, int child)
 #else
-get_date(where)
-char *where;
+void
+dist_start(w, child)
+struct dist_walk *w;
+int child;
 #endif
 {
-	time_t t;
-	char *value;
-	t=time(0);
-	value=(char *)ctime(&t);
-	strcpy(where,value);
+	w->next = 0;
+	w->left = 0;
+	w->stream = (unsigned long long)child;
+	w->draws = 0;
 }
 
-/* Richard Sharpe decided to hack up Samba and
- * have it detect Iozone running, and then
- * produce the data without doing any actual
- * I/O. This was a HIGHLY questionable thing to
- * be doing (my opinion). It may have been a lab
- * experiment that was accidentally released into 
- * the wild, but now that it is, no choice but
- * to prevent its use. So... the pattern
- * that he was locking on to, is now random,
- * and will change with every release of Iozone.
- * See: http://lists.samba.org/archive/samba-technical/2005-April/040541.html
+/*
+ * Record to access at step i of a random test. Uniform walks the perm
+ * so that every record is touched once; the other distributions draw
+ * with replacement.
  */
+#ifdef HAVE_ANSIC_C
+unsigned long long
+dist_record(struct dist_walk *w, struct perm *order, unsigned long long i)
+#else
+unsigned long long
+dist_record(w, order, i)
+struct dist_walk *w;
+struct perm *order;
+unsigned long long i;
+#endif
+{
+	struct dist *d = &access_dist;
+	unsigned long long r, width;
+	int b;
+
+	if(dist_type == DIST_UNIFORM || order->n < 2)
+		return(perm_index(order, i));
+	if(dist_type == DIST_SEQ)
+	{
+		if(w->left == 0)
+		{
+			w->next = counter_rand(DISTSEED, w->stream, w->draws++) % order->n;
+			w->left = (unsigned long long)dist_param;
+		}
+		r = w->next;
+		w->next = (r + 1 == order->n) ? 0 : r + 1;
+		w->left--;
+		return(r);
+	}
+	if(d->n != order->n)
+		return(perm_index(order, i));
+	r = counter_rand(DISTSEED, w->stream, w->draws++);
+	b = (int)(((r >> 32) * (unsigned long long)d->buckets) >> 32);
+	if((double)(r & 0xffffffffULL) >= d->prob[b] * 4294967296.0)
+		b = d->alias[b];
+	r = d->start[b];
+	width = d->start[b + 1] - r;
+	if(width > 1)
+		r += counter_rand(DISTSEED, w->stream, w->draws++) % width;
+	return(perm_index(&d->order, r));
+}
 
+/*
+ * Parse the -+v operand: a segment count, or a comma separated list of
+ * segment sizes with an optional k or m suffix, then :seq or :rand.
+ */
 #ifdef HAVE_ANSIC_C
 int
-get_pattern(void)
+parse_vec(char *arg)
 #else
-get_pattern(void)
+int
+parse_vec(arg)
+char *arg;
 #endif
 {
-        int i,x,y;
-        char cp[100],*ptr;
-        int pat;
-	unsigned char inp_pat;
-	unsigned int temp;
+	char *p;
+	long long v;
 
-        y=0;
-        ptr=&cp[0];
-        strcpy(cp,THISVERSION);
-        x=strlen(THISVERSION);
-        for(i=0;i<x;i++)
-                y+=*ptr++;
-        srand(y);
-        pat=(rand()& 0xff);
-	/* For compatibility with old 0xa5 data sets. */
-	if(Z_flag)
-		pat=0xa5;
-	/* Lock pattern to 0xBB, for filesystem short circuit debug */
-	if(X_flag)
-		pat=PATTERN1;
-	/* Set global pattern */
-	inp_pat = pat;
-	temp =((inp_pat << 24) | (inp_pat << 16) | (inp_pat << 8) | inp_pat);
-        return(pat);
+	vec_count = vec_nsizes = 0;
+	vec_random = 1;
+	p = arg;
+	while(*p && *p != ':')
+	{
+		v = 0;
+		if(*p < '0' || *p > '9')
+			return(-1);
+		while(*p >= '0' && *p <= '9')
+			v = v * 10 + (*p++ - '0');
+		if(*p == 'k' || *p == 'K')
+		{
+			v *= 1024;
+			p++;
+		}
+		else if(*p == 'm' || *p == 'M')
+		{
+			v *= 1024 * 1024;
+			p++;
+		}
+		if(v <= 0 || vec_nsizes == VEC_MAX)
+			return(-1);
+		vec_sizes[vec_nsizes++] = v;
+		if(*p == ',')
+			p++;
+	}
+	if(vec_nsizes == 1 && strchr(arg, ',') == 0 &&
+		!strpbrk(arg, "kKmM"))
+	{
+		/* A plain count */
+		if(vec_sizes[0] > VEC_MAX)
+			return(-1);
+		vec_count = (int)vec_sizes[0];
+		vec_nsizes = 0;
+	}
+	else
+		vec_count = vec_nsizes;
+	if(strcmp(p, ":rand") == 0)
+		vec_random = 1;
+	else if(strcmp(p, ":seq") == 0)
+		vec_random = 0;
+	else if(*p)
+		return(-1);
+	return(vec_count ? 0 : -1);
 }
 
-/* 
- * Allocate the buffer for purge. 
-*/
+/*
+ * Split len bytes at buf into the -+v segments.
+ */
 #ifdef HAVE_ANSIC_C
-void
-alloc_pbuf(void)
+static int
+vec_build(struct iovec *iov, char *buf, long long len)
 #else
-alloc_pbuf(void)
+static int
+vec_build(iov, buf, len)
+struct iovec *iov;
+char *buf;
+long long len;
 #endif
 {
-	pbuffer = (char *) alloc_mem((long long)(3 * cache_size),(int)0);
-	if(pbuffer == 0) {
-              	perror("(18) Memory allocation failed:");
-               	exit(9);
-	}
-#ifdef _64BIT_ARCH_
-	pbuffer = (char *) 
-		(((unsigned long long)pbuffer + cache_size ) 
-		& ~(cache_size-1));
+	long long seg, done;
+	int n;
+
+	for(n = 0, done = 0; done < len && n < VEC_MAX; n++)
+	{
+		if(vec_nsizes)
+			seg = vec_sizes[n % vec_nsizes];
+		else
+			seg = (len + vec_count - 1) / vec_count;
+		if(seg > len - done || n == VEC_MAX - 1)
+			seg = len - done;
+		iov[n].iov_base = buf + done;
+		iov[n].iov_len = (size_t)seg;
+		done += seg;
+	}
+	return(n);
+}
+
+/*
+ * One system call for rec_io(). off < 0 is the current file offset,
+ * which preadv2()/pwritev2() take as -1.
+ */
+#ifdef HAVE_ANSIC_C
+static ssize_t
+rec_xfer(int fd, struct iovec *iov, int n, off64_t off, int wr, int rwf)
 #else
-	pbuffer = (char *) 
-		(((long)pbuffer + (long)cache_size ) 
-		& ~((long)cache_size-1));
+static ssize_t
+rec_xfer(fd, iov, n, off, wr, rwf)
+int fd;
+struct iovec *iov;
+int n;
+off64_t off;
+int wr;
+int rwf;
+#endif
+{
+#ifdef RWF_NOWAIT
+	if(rwf)
+	{
+		if(off < 0)
+			off = -1;
+		return(wr ? pwritev2(fd, iov, n, (off_t)off, rwf) :
+			preadv2(fd, iov, n, (off_t)off, rwf));
+	}
 #endif
+#ifdef HAVE_PREAD
+	if(off >= 0)
+		return(wr ? I_PWRITE_SYS(fd, iov[0].iov_base, iov[0].iov_len, off) :
+			I_PREAD_SYS(fd, iov[0].iov_base, iov[0].iov_len, off));
+#endif
+	if(n == 1)
+		return(wr ? write(fd, iov[0].iov_base, iov[0].iov_len) :
+			read(fd, iov[0].iov_base, iov[0].iov_len));
+	return(wr ? writev(fd, iov, n) : readv(fd, iov, n));
 }
 
-/* 
- * Check to see if the file descriptor points at a file
- * or a device.
+#ifdef DIO_FALLBACK
+/*
+ * Direct I/O alignment of the file behind fd: statx() knows it for
+ * files on recent kernels, block devices have their logical block
+ * size, and 512 is what everything else has always wanted.
  */
 #ifdef HAVE_ANSIC_C
-int
-check_filename(char *name)
+static void
+dio_discover(int fd)
 #else
-check_filename(name)
-char *name;
+static void
+dio_discover(fd)
+int fd;
 #endif
 {
-#ifdef _LARGEFILE64_SOURCE
-	struct stat64 mystat;
+	long long mem = 0, blk = 0;
+	struct stat st;
+	int bs;
+#ifdef STATX_DIOALIGN
+	struct statx stx;
+
+	if(statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 &&
+		(stx.stx_mask & STATX_DIOALIGN))
+	{
+		mem = stx.stx_dio_mem_align;
+		blk = stx.stx_dio_offset_align;
+	}
+#endif
+	if(blk == 0 && fstat(fd, &st) == 0 && S_ISBLK(st.st_mode) &&
+		ioctl(fd, BLKSSZGET, &bs) == 0)
+		blk = bs;
+	if(blk == 0)
+		blk = 512;
+	if(mem == 0)
+		mem = blk;
+	dio_mem = mem;
+	dio_block = blk;
+}
+
+/*
+ * Redo an op without O_DIRECT on the same descriptor, so the file
+ * offset and everything else about it stay as the test left them.
+ */
+#ifdef HAVE_ANSIC_C
+static ssize_t
+dio_buffered(int fd, struct iovec *iov, int n, off64_t off, int wr)
 #else
-	struct stat mystat;
+static ssize_t
+dio_buffered(fd, iov, n, off, wr)
+int fd;
+struct iovec *iov;
+int n;
+off64_t off;
+int wr;
 #endif
-	int x;
-	if(strlen(name)==0)
-		return(0);
-	/* Lets try stat first.. may get an error if file is too big */
-	x=I_STAT(name,&mystat);
-	if(x<0)
-	{
-		return(0);
-		/* printf("Stat failed %d\n",x); */
-	}
-	if(mystat.st_mode & S_IFREG)
-	{
-		/*printf("Is a regular file\n");*/
-		return(1);
-	}
-	return(0);
+{
+	ssize_t ret;
+	int flags;
+
+	flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+	ret = rec_xfer(fd, iov, n, off, wr, 0);
+	fcntl(fd, F_SETFL, flags);
+	DIO_COUNT(dio_fallback);
+	return(ret);
 }
 
-#ifdef IMON_ENABLED
+/*
+ * fwrite/fread with -I. The stream is unbuffered, so stdio hands our
+ * records straight to the kernel, and it gets O_DIRECT when they are
+ * aligned. Otherwise the whole stream stays buffered.
+ */
 #ifdef HAVE_ANSIC_C
 void
-start_monitor(char *test)
+dio_stdio(int fd, char *buf, long long len)
 #else
-start_monitor(test)
-char *test;
+void
+dio_stdio(fd, buf, len)
+int fd;
+char *buf;
+long long len;
 #endif
 {
-	char command_line[256];
-	if(strlen(imon_start)!=0)
+	if(dio_block == 0)
+		dio_discover(fd);
+	if(((long)buf & (dio_mem - 1)) || (len & (dio_block - 1)) ||
+		(multi_buffer && ((long)mbuffer & (dio_mem - 1))))
 	{
-		if(imon_sync)
-		   sprintf(command_line,"%s %s",imon_start,test);
-		else
-		   sprintf(command_line,"%s %s&",imon_start,test);
-		junk=system(command_line);
+		DIO_COUNT(dio_fallback);
+		return;
 	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT);
 }
+#else
 #ifdef HAVE_ANSIC_C
 void
-stop_monitor(char *test)
+dio_stdio(int fd, char *buf, long long len)
 #else
-stop_monitor(test)
-char *test;
+void
+dio_stdio(fd, buf, len)
+int fd;
+char *buf;
+long long len;
 #endif
 {
-	char command_line[256];
-	if(strlen(imon_stop)!=0)
-	{
-		if(imon_sync)
-		   sprintf(command_line,"%s %s",imon_stop,test);
-		else
-		   sprintf(command_line,"%s %s &",imon_stop,test);
-		junk=system(command_line);
-	}
 }
-#endif /* IMON_ENABLED */
+#endif /* DIO_FALLBACK */
 
-/* 
- * As quickly as possible, generate a new buffer that
- * can not be easily compressed, or de-duped. Also
- * permit specified percentage of buffer to be updated.
- *
- * ibuf ... input buffer
- * obuf ... output buffer
- * seed ... Seed to use for srand, rand -> xor ops
- *          Seed composed from: blocknumber
-		(do not include childnum as you want duplicates)
- * size ... size of buffers. (in bytes)
- * percent. Percent of buffer to modify.
- * percent_interior. Percent of buffer that is dedupable within 
- *                   and across files 
- * percent_compress. Percent of buffer that is dedupable within 
- *                   but not across files 
- *
- * Returns 0 (zero) for success, and -1 (minus one) for failure.
+/*
+ * Moves one record for I_READ()/I_WRITE() (off < 0) and for
+ * I_PREAD()/I_PWRITE(). Applies the -+v segments and the -+W flags.
+ * With -I, an op whose buffer or length O_DIRECT can not take is
+ * done buffered instead, as is one the kernel refused with EINVAL.
  */
-int
-gen_new_buf(char *ibuf, char *obuf, long seed, int size, int percent,
-	int percent_interior, int percent_compress, int all)
+#ifdef HAVE_ANSIC_C
+ssize_t
+rec_io(int fd, char *buf, long long len, off64_t off, int wr)
+#else
+ssize_t
+rec_io(fd, buf, len, off, wr)
+int fd;
+char *buf;
+long long len;
+off64_t off;
+int wr;
+#endif
 {
-	register long *ip, *op; /* Register for speed 	*/
-	register long iseed; 	/* Register for speed 	*/
-	register long isize; 	/* Register for speed 	*/
-	register long cseed;	/* seed for dedupable for within & ! across */
-	register int x,w; 	/* Register for speed 	*/
-	register int value; 	/* Register for speed 	*/
-	register int interior_size; 	/* size of interior dedup region */
-	register int compress_size; 	/* size of compression dedup region */
-	if(ibuf == NULL)	/* no input buf 	*/
-		return(-1);
-	if(obuf == NULL)	/* no output buf 	*/
-		return(-1);
-	if((percent > 100) || (percent < 0)) /* percent check */
-		return(-1);
-	if(size == 0)		/* size check 		*/
-		return(-1);
-	srand(seed+1+(((int)numrecs64)*dedup_mseed)); /* set random seed */
-	iseed = rand();		/* generate random value */
-	isize = (size * percent)/100; /* percent that is dedupable */
-	interior_size = ((isize * percent_interior)/100);/* /sizeof(long) */
-	compress_size =((interior_size * percent_compress)/100);
-	ip = (long *)ibuf;	/* pointer to input buf */
-	op = (long *)obuf;	/* pointer to output buf */
-	if(all == 0)		/* Special case for verify only */
-		isize = sizeof(long);
-	/* interior_size = dedup_within + dedup_across */
-	for(w=0;w<interior_size;w+=sizeof(long))	
-	{
-		*op=0xdeadbeef+dedup_mseed;
-		*ip=0xdeadbeef+dedup_mseed;
-		op++;
-		ip++;
-	}	
-	/* Prepare for dedup within but not across */
-	w=interior_size - compress_size;
-	op=(long *)&obuf[w];
-	ip=(long *)&ibuf[w];
-	srand(chid+1+dedup_mseed);            /* set randdom seed 	*/
-	cseed = rand();		/* generate random value */
-	for(w=(interior_size-compress_size);w<interior_size;w+=sizeof(long))	
-	{
-		*op=*ip ^ cseed; /* do the xor op */
-		op++;
-		ip++;
-	}	
- 	/* isize = dedup across only */
-	for(x=interior_size;x<isize;x+=sizeof(long))	/* tight loop for transformation */
-	{
-		*op=*ip ^ iseed; /* do the xor op */
-		op++;
-		ip++;
-	}	
-	if(all == 0)		/* Special case for verify only */
-		return(0);
-	/* make the rest of the buffer non-dedupable */
-	if(100-percent > 0)
+	struct iovec iov[VEC_MAX];
+	ssize_t ret;
+	int n;
+#ifdef DIO_FALLBACK
+	long bits;
+	int i;
+#endif
+
+	if(vec_count && off < 0)
+		n = vec_build(iov, buf, len);
+	else
 	{
-		srand(1+seed+((chid+1)*(int)numrecs64)*dedup_mseed);
-		value=rand();
-/* printf("Non-dedup value %x seed %x\n",value,seed);*/
-		for( ; x<size;x+=sizeof(long))
-			*op++=(*ip++)^value; /* randomize the remainder */
+		iov[0].iov_base = buf;
+		iov[0].iov_len = (size_t)len;
+		n = 1;
+	}
+#ifdef DIO_FALLBACK
+	if(direct_flag)
+	{
+		if(dio_block == 0)
+			dio_discover(fd);
+		for(bits = 0, i = 0; i < n; i++)
+			bits |= (long)iov[i].iov_base | (long)iov[i].iov_len;
+		if((bits & (dio_mem - 1)) || (len & (dio_block - 1)))
+			return(dio_buffered(fd, iov, n, off, wr));
 	}
+#endif
+	ret = rec_xfer(fd, iov, n, off, wr, dio_rwf);
+#ifdef RWF_NOWAIT
+	if(ret < 0 && (errno == EAGAIN || errno == EOPNOTSUPP) &&
+		(dio_rwf & RWF_NOWAIT))
+	{
+		/* It would block, or this file can't tell. Do it the ordinary way */
+		DIO_COUNT(dio_again);
+		ret = rec_xfer(fd, iov, n, off, wr, dio_rwf & ~RWF_NOWAIT);
+	}
+#endif
+#ifdef DIO_FALLBACK
+	if(ret < 0 && errno == EINVAL && direct_flag)
+		ret = dio_buffered(fd, iov, n, off, wr);
+#endif
+	return(ret);
+}
+
+/*
+ * Data reduction profiles (-+R). The payload is described by a target
+ * compression ratio and a target dedup ratio at a given block size:
+ *
+ * - Dedup: absolute block number b of a child's file carries unique
+ *   content number b / dedup_ratio, so on average every content shows
+ *   up dedup_ratio times. Content also depends on the child, so files
+ *   do not dedup against each other.
+ * - Compression: every REDUCE_CHUNK bytes of a block start with
+ *   REDUCE_CHUNK / compress_ratio random bytes followed by zeros.
+ *
+ * The random bytes are a window of one precomputed template, chosen
+ * and XORed with a 64 bit key derived from the content number, so a
+ * record is built with vector XORs and memsets only. Any byte can be
+ * recomputed from its file offset, which is how verify works.
+ */
+#define REDUCE_CHUNK	256
+#define REDUCE_MIN_TWORDS	8192	/* 64 KB template at least */
+
+#ifdef HAVE_ANSIC_C
+int
+init_reduce(void)
+#else
+int
+init_reduce()
+#endif
+{
+	long long i;
+
+	reduce_rnd = ((long long)(REDUCE_CHUNK / reduce_comp)) & ~7LL;
+	if(reduce_rnd < 8)
+		reduce_rnd = 8;
+	reduce_twords = l_max(REDUCE_MIN_TWORDS, 2 * reduce_block / 8);
+	if(reduce_template)
+		free(reduce_template);
+	reduce_template = (unsigned long long *)malloc(
+		(size_t)reduce_twords * sizeof(unsigned long long));
+	if(reduce_template == 0)
+		return(-1);
+	for(i = 0; i < reduce_twords; i++)
+		reduce_template[i] = counter_rand((unsigned long long)dedup_mseed,
+			~0ULL, (unsigned long long)i);
 	return(0);
 }
-/* 
- * Used to touch all of the buffers so that the CPU data
- * cache is hot, and not part of the measurement.
+
+/*
+ * Build (check == 0) or check (check != 0) length bytes of record recnum.
+ * When checking, returns the offset in the record of the first chunk
+ * that differs, else -1.
  */
-void
-touch_dedup(char *i, int size)
+#ifdef HAVE_ANSIC_C
+long long
+gen_reduce_buf(char *buffer, long long length, long long recnum, int check)
+#else
+long long
+gen_reduce_buf(buffer, length, recnum, check)
+char *buffer;
+long long length;
+long long recnum;
+int check;
+#endif
 {
-	register int x;
-	register long *ip;
-	ip = (long *)i;
-	srand(DEDUPSEED);
-	for(x=0;x<size/sizeof(long);x++)
-	{
-		*ip=rand(); /* fill initial buffer */
-		ip++;
+	unsigned long long expect[REDUCE_CHUNK / sizeof(unsigned long long)];
+	unsigned long long *w, *d, key;
+	long long a, start, end, blk, blkend, o, p, n, toff;
+
+	w = (unsigned long long *)buffer;
+	start = a = recnum * length;
+	end = a + (length & ~7LL);
+	while(a < end)
+	{
+		blk = a / reduce_block;
+		o = a % reduce_block;
+		key = counter_rand((unsigned long long)dedup_mseed,
+			(unsigned long long)chid,
+			(unsigned long long)((double)blk / reduce_dedup));
+		toff = (long long)(key % (unsigned long long)
+			(reduce_twords - reduce_block / 8));
+		blkend = l_min(end, (blk + 1) * reduce_block);
+		while(a < blkend)
+		{
+			p = o % REDUCE_CHUNK;
+			d = check ? expect : w;
+			if(p < reduce_rnd)
+			{
+				n = l_min(reduce_rnd - p, blkend - a);
+				xor_words(d, &reduce_template[toff + o / 8], n / 8, key);
+			}
+			else
+			{
+				n = l_min(REDUCE_CHUNK - p, blkend - a);
+				bzero(d, (size_t)n);
+			}
+			if(check && memcmp(w, expect, (size_t)n) != 0)
+				return(a - start);
+			w += n / 8;
+			a += n;
+			o += n;
+		}
 	}
+	return(-1);
 }
 
 /* 
@@ -25291,8 +29526,25 @@ sync()
 #endif
 
 
+/*
+ * Latency histogram, HDR style.
+ *
+ * Latencies are kept in nanoseconds in log-linear buckets. Every power
+ * of two range is split into HIST_HALF_BUCKETS linear sub-buckets, so
+ * recording a value is a couple of shifts and any value read back from
+ * the histogram is within 1/HIST_HALF_BUCKETS of the recorded one.
+ * Each child owns one histogram (lat_hist[child]) in the shared segment
+ * so the parent can merge them after all of the children are done and
+ * report arbitrary percentiles for the whole run.
+ */
+struct lat_hist *lat_hist;
+int lat_hist_count;
+
+/*
+ * The legacy bands are still reported, they are now derived from
+ * the log-linear histogram when it is dumped.
+ */
 #define BUCKETS 40
-long long buckets[BUCKETS];
 long long bucket_val[BUCKETS] =
 	{ 20,40,60,80,100,
 	200,400,600,800,1000,
@@ -25302,6 +29554,17 @@ long long bucket_val[BUCKETS] =
 	200000,400000,600000,800000,1000000,
 	2000000,4000000,6000000,8000000,10000000,
 	20000000,30000000,60000000,90000000,120000000,120000001};
+char *bucket_name[BUCKETS] =
+	{ " 20us"," 40us"," 60us"," 80us","100us",
+	"200us","400us","600us","800us","  1ms",
+	"  2ms","  4ms","  6ms","  8ms"," 10ms",
+	" 12ms"," 14ms"," 16ms"," 18ms"," 20ms",
+	" 40ms"," 60ms"," 80ms","100ms",
+	"200ms","400ms","600ms","800ms","   1s",
+	"   2s","   4s","   6s","   8s","  10s",
+	"  20s","  40s","  60s","  80s"," 120s","120+s"};
+/* Number of buckets printed on each "Band" line */
+int bucket_band[] = { 5,5,5,5,4,5,5,5,1 };
 /*
  * Buckets: (Based on a Netapp internal consensus)
  *     0       1       2       3      4 
@@ -25328,172 +29591,473 @@ long long bucket_val[BUCKETS] =
  *   35       36      37      38      39
  * <=20s    <=30s   <=60    <=90s    >90
  */
-	
+
+/* Percentiles reported in the summaries */
+double hist_pct[] = { 50.0, 90.0, 99.0, 99.9, 99.99, 99.999 };
+#define HIST_NPCT (sizeof(hist_pct)/sizeof(double))
+
 /*
-	fp=fopen("/tmp/iozone_latency_summary.txt","a");
-	dump_hist(fp);
-*/
+ * Allocate one histogram per child. Uses the same shared memory
+ * mechanism as the child_stats so that forked children can be merged.
+ */
+#ifdef HAVE_ANSIC_C
+int
+hist_alloc(int count)
+#else
+int
+hist_alloc(count)
+int count;
+#endif
+{
+	if(lat_hist && count <= lat_hist_count)
+		return(0);
+	if(count < 1)
+		count = 1;
+	lat_hist = (struct lat_hist *)alloc_mem(
+		(long long)(sizeof(struct lat_hist) * count),(int)1);
+	if(lat_hist == 0 || (long)lat_hist == (long)-1)
+	{
+		lat_hist = 0;
+		lat_hist_count = 0;
+		return(-1);
+	}
+	lat_hist_count = count;
+	bzero(lat_hist, sizeof(struct lat_hist) * count);
+	return(0);
+}
 
+#ifdef HAVE_ANSIC_C
+void
+hist_reset(int id)
+#else
 void
-hist_insert(double my_value)
+hist_reset(id)
+int id;
+#endif
 {
-	int k;
-	long long value;
-	
-	/* Convert to micro-seconds */
-	value = (long long)(my_value * 1000000);
-	for(k=0;k<BUCKETS;k++)
+	if(lat_hist == 0 || id < 0 || id >= lat_hist_count)
+		return;
+	bzero(&lat_hist[id], sizeof(struct lat_hist));
+}
+
+/* Position of the most significant bit that is set. v must be non zero */
+static int
+hist_msb(unsigned long long v)
+{
+#if defined(__GNUC__)
+	return(63 - __builtin_clzll(v));
+#else
+	int n = 0;
+	while(v >>= 1)
+		n++;
+	return(n);
+#endif
+}
+
+static int
+hist_index(unsigned long long value)
+{
+	int bucket;
+	unsigned long long sub;
+
+	bucket = hist_msb(value | (HIST_SUB_BUCKETS - 1)) - (HIST_SUB_BITS - 1);
+	sub = value >> bucket;
+	return(((bucket + 1) << (HIST_SUB_BITS - 1)) + 
+		(int)(sub - HIST_HALF_BUCKETS));
+}
+
+/* Lowest value (in ns) that lands in counts[index] */
+static unsigned long long
+hist_lowest(int index)
+{
+	int bucket;
+	unsigned long long sub;
+
+	if(index < HIST_SUB_BUCKETS)
+		return((unsigned long long)index);
+	bucket = (index >> (HIST_SUB_BITS - 1)) - 1;
+	sub = (unsigned long long)((index & (HIST_HALF_BUCKETS - 1)) + HIST_HALF_BUCKETS);
+	return(sub << bucket);
+}
+
+/* Highest value (in ns) that lands in counts[index] */
+static unsigned long long
+hist_highest(int index)
+{
+	if(index < HIST_SUB_BUCKETS)
+		return((unsigned long long)index);
+	return(hist_lowest(index) + 
+		(1ULL << ((index >> (HIST_SUB_BITS - 1)) - 1)) - 1);
+}
+
+/*
+ * Record one latency, in seconds, for the given child. This is on the
+ * I/O path, so it must stay constant time.
+ */
+#ifdef HAVE_ANSIC_C
+void
+hist_insert(int id, double my_value)
+#else
+void
+hist_insert(id, my_value)
+int id;
+double my_value;
+#endif
+{
+	struct lat_hist *h;
+	unsigned long long value;
+
+	if(lat_hist == 0 || id < 0 || id >= lat_hist_count)
+		return;
+	h = &lat_hist[id];
+	/* Convert to nano-seconds */
+	if(my_value <= (double)0)
+		value = 0;
+	else if(my_value >= (double)HIST_MAX_VALUE / 1000000000.0)
+		value = HIST_MAX_VALUE;
+	else
+		value = (unsigned long long)(my_value * 1000000000.0);
+	h->counts[hist_index(value)]++;
+	if(h->total == 0 || value < h->min)
+		h->min = value;
+	if(value > h->max)
+		h->max = value;
+	h->total++;
+	h->sum += (double)value;
+}
+
+/* Add all of the samples in src into dst */
+#ifdef HAVE_ANSIC_C
+void
+hist_merge(struct lat_hist *dst, struct lat_hist *src)
+#else
+void
+hist_merge(dst, src)
+struct lat_hist *dst, *src;
+#endif
+{
+	int i;
+
+	if(src->total == 0)
+		return;
+	for(i = 0; i < HIST_COUNTS; i++)
+		dst->counts[i] += src->counts[i];
+	if(dst->total == 0 || src->min < dst->min)
+		dst->min = src->min;
+	if(src->max > dst->max)
+		dst->max = src->max;
+	dst->total += src->total;
+	dst->sum += src->sum;
+}
+
+/* Return the latency (in ns) that pct percent of the samples are at or below */
+#ifdef HAVE_ANSIC_C
+unsigned long long
+hist_percentile(struct lat_hist *h, double pct)
+#else
+unsigned long long
+hist_percentile(h, pct)
+struct lat_hist *h;
+double pct;
+#endif
+{
+	unsigned long long want, seen, value;
+	double rank;
+	int i;
+
+	if(h->total == 0)
+		return(0);
+	rank = (pct / 100.0) * (double)h->total;
+	want = (unsigned long long)rank;
+	if((double)want < rank)
+		want++;
+	if(want < 1)
+		want = 1;
+	seen = 0;
+	for(i = 0; i < HIST_COUNTS; i++)
+	{
+		seen += h->counts[i];
+		if(seen >= want)
+		{
+			value = hist_highest(i);
+			if(value > h->max)
+				value = h->max;
+			if(value < h->min)
+				value = h->min;
+			return(value);
+		}
+	}
+	return(h->max);
+}
+
+static void
+hist_fprint(FILE *fp, char *what, int id, struct lat_hist *h)
+{
+	long long band[BUCKETS];
+	unsigned long long us;
+	int i, k, b;
+
+	bzero(band, sizeof(band));
+	for(i = 0; i < HIST_COUNTS; i++)
 	{
-	   if(k < (BUCKETS-1)) 
-	   {
-	     if(value <= bucket_val[k])
-	     {
-		buckets[k]++;
-		break;
-	     }
-	   }
-	   else
-	   {
-	     if(value > bucket_val[k])
-	     {
-		buckets[k]++;
-		break;
-	     }
-	   }
+		if(h->counts[i] == 0)
+			continue;
+		us = hist_lowest(i) / 1000;
+		for(k = 0; k < BUCKETS - 1; k++)
+			if((long long)us <= bucket_val[k])
+				break;
+		band[k] += (long long)h->counts[i];
+	}
+	if(id < 0)
+		fprintf(fp,"All children Op: %s\n",what);
+	else
+		fprintf(fp,"Child: %d Op: %s\n",id,what);
+	k = 0;
+	for(b = 0; b < (int)(sizeof(bucket_band)/sizeof(int)); b++)
+	{
+		fprintf(fp,"Band %d:   ",b+1);
+		for(i = 0; i < bucket_band[b]; i++, k++)
+		{
+#ifdef NO_PRINT_LLD
+			fprintf(fp,"%s:%-7.1ld ",bucket_name[k],band[k]);
+#else
+			fprintf(fp,"%s:%-7.1lld ",bucket_name[k],band[k]);
+#endif
+		}
+		fprintf(fp,"\n");
 	}
+#ifdef NO_PRINT_LLD
+	fprintf(fp,"Samples: %ld ",(long)h->total);
+#else
+	fprintf(fp,"Samples: %lld ",(long long)h->total);
+#endif
+	if(h->total)
+		fprintf(fp," Min: %.3fus  Mean: %.3fus  Max: %.3fus",
+			(double)h->min/1000.0, (h->sum/(double)h->total)/1000.0,
+			(double)h->max/1000.0);
+	fprintf(fp,"\n");
+	for(i = 0; i < (int)HIST_NPCT; i++)
+		fprintf(fp,"p%g:%.3fus ",hist_pct[i],
+			(double)hist_percentile(h, hist_pct[i])/1000.0);
+	fprintf(fp,"\n\n");
 }
 
+#ifdef HAVE_ANSIC_C
 void
 dump_hist(char *what,int id)
+#else
+void
+dump_hist(what,id)
+char *what;
+int id;
+#endif
 {
    FILE *fp;
 
    char name[256];
  
+   if(lat_hist == 0 || id < 0 || id >= lat_hist_count)
+	return;
    sprintf(name,"%s_child_%d.txt","Iozone_histogram",id);
 
    fp = fopen(name,"a");
+   if(fp == 0)
+	return;
+   hist_fprint(fp, what, id, &lat_hist[id]);
+   fclose(fp);
+}
 
-#ifndef NO_PRINT_LLD
-   fprintf(fp,"Child: %d Op: %s\n",id,what);
-   fprintf(fp,"Band 1:   ");
-   fprintf(fp," 20us:%-7.1lld ",buckets[0]);
-   fprintf(fp," 40us:%-7.1lld ",buckets[1]);
-   fprintf(fp," 60us:%-7.1lld ",buckets[2]);
-   fprintf(fp," 80us:%-7.1lld ",buckets[3]);
-   fprintf(fp,"100us:%-7.1lld \n",buckets[4]);
-
-   fprintf(fp,"Band 2:   ");
-   fprintf(fp,"200us:%-7.1lld ",buckets[5]);
-   fprintf(fp,"400us:%-7.1lld ",buckets[6]);
-   fprintf(fp,"600us:%-7.1lld ",buckets[7]);
-   fprintf(fp,"800us:%-7.1lld ",buckets[8]);
-   fprintf(fp,"  1ms:%-7.1lld \n",buckets[9]);
-
-   fprintf(fp,"Band 3:   ");
-   fprintf(fp,"  2ms:%-7.1lld ",buckets[10]);
-   fprintf(fp,"  4ms:%-7.1lld ",buckets[11]);
-   fprintf(fp,"  6ms:%-7.1lld ",buckets[12]);
-   fprintf(fp,"  8ms:%-7.1lld ",buckets[13]);
-   fprintf(fp," 10ms:%-7.1lld \n",buckets[14]);
-
-   fprintf(fp,"Band 4:   ");
-   fprintf(fp," 12ms:%-7.1lld ",buckets[15]);
-   fprintf(fp," 14ms:%-7.1lld ",buckets[16]);
-   fprintf(fp," 16ms:%-7.1lld ",buckets[17]);
-   fprintf(fp," 18ms:%-7.1lld ",buckets[18]);
-   fprintf(fp," 20ms:%-7.1lld \n",buckets[19]);
-
-   fprintf(fp,"Band 5:   ");
-   fprintf(fp," 40ms:%-7.1lld ",buckets[20]);
-   fprintf(fp," 60ms:%-7.1lld ",buckets[21]);
-   fprintf(fp," 80ms:%-7.1lld ",buckets[22]);
-   fprintf(fp,"100ms:%-7.1lld \n",buckets[23]);
-
-   fprintf(fp,"Band 6:   ");
-   fprintf(fp,"200ms:%-7.1lld ",buckets[24]);
-   fprintf(fp,"400ms:%-7.1lld ",buckets[25]);
-   fprintf(fp,"600ms:%-7.1lld ",buckets[26]);
-   fprintf(fp,"800ms:%-7.1lld ",buckets[27]);
-   fprintf(fp,"   1s:%-7.1lld \n",buckets[28]);
-
-   fprintf(fp,"Band 7:   ");
-   fprintf(fp,"   2s:%-7.1lld ",buckets[29]);
-   fprintf(fp,"   4s:%-7.1lld ",buckets[30]);
-   fprintf(fp,"   6s:%-7.1lld ",buckets[31]);
-   fprintf(fp,"   8s:%-7.1lld ",buckets[32]);
-   fprintf(fp,"  10s:%-7.1lld \n",buckets[33]);
-
-   fprintf(fp,"Band 8:   ");
-   fprintf(fp,"  20s:%-7.1lld ",buckets[34]);
-   fprintf(fp,"  40s:%-7.1lld ",buckets[35]);
-   fprintf(fp,"  60s:%-7.1lld ",buckets[36]);
-   fprintf(fp,"  80s:%-7.1lld ",buckets[37]);
-   fprintf(fp," 120s:%-7.1lld \n",buckets[38]);
-
-   fprintf(fp,"Band 9:   ");
-   fprintf(fp,"120+s:%-7.1lld \n\n",buckets[39]);
-#else
-   fprintf(fp,"Child: %d Op: %s\n",id,what);
-   fprintf(fp,"Band 1:   ");
-   fprintf(fp," 20us:%-7.1ld ",buckets[0]);
-   fprintf(fp," 40us:%-7.1ld ",buckets[1]);
-   fprintf(fp," 60us:%-7.1ld ",buckets[2]);
-   fprintf(fp," 80us:%-7.1ld ",buckets[3]);
-   fprintf(fp,"100us:%-7.1ld \n",buckets[4]);
-
-   fprintf(fp,"Band 2:   ");
-   fprintf(fp,"200us:%-7.1ld ",buckets[5]);
-   fprintf(fp,"400us:%-7.1ld ",buckets[6]);
-   fprintf(fp,"600us:%-7.1ld ",buckets[7]);
-   fprintf(fp,"800us:%-7.1ld ",buckets[8]);
-   fprintf(fp,"  1ms:%-7.1ld \n",buckets[9]);
-
-   fprintf(fp,"Band 3:   ");
-   fprintf(fp,"  2ms:%-7.1ld ",buckets[10]);
-   fprintf(fp,"  4ms:%-7.1ld ",buckets[11]);
-   fprintf(fp,"  6ms:%-7.1ld ",buckets[12]);
-   fprintf(fp,"  8ms:%-7.1ld ",buckets[13]);
-   fprintf(fp," 10ms:%-7.1ld \n",buckets[14]);
-
-   fprintf(fp,"Band 4:   ");
-   fprintf(fp," 12ms:%-7.1ld ",buckets[15]);
-   fprintf(fp," 14ms:%-7.1ld ",buckets[16]);
-   fprintf(fp," 16ms:%-7.1ld ",buckets[17]);
-   fprintf(fp," 18ms:%-7.1ld ",buckets[18]);
-   fprintf(fp," 20ms:%-7.1ld \n",buckets[19]);
-
-   fprintf(fp,"Band 5:   ");
-   fprintf(fp," 40ms:%-7.1ld ",buckets[20]);
-   fprintf(fp," 60ms:%-7.1ld ",buckets[21]);
-   fprintf(fp," 80ms:%-7.1ld ",buckets[22]);
-   fprintf(fp,"100ms:%-7.1ld \n",buckets[23]);
-
-   fprintf(fp,"Band 6:   ");
-   fprintf(fp,"200ms:%-7.1ld ",buckets[24]);
-   fprintf(fp,"400ms:%-7.1ld ",buckets[25]);
-   fprintf(fp,"600ms:%-7.1ld ",buckets[26]);
-   fprintf(fp,"800ms:%-7.1ld ",buckets[27]);
-   fprintf(fp,"   1s:%-7.1ld \n",buckets[28]);
-
-   fprintf(fp,"Band 7:   ");
-   fprintf(fp,"   2s:%-7.1ld ",buckets[29]);
-   fprintf(fp,"   4s:%-7.1ld ",buckets[30]);
-   fprintf(fp,"   6s:%-7.1ld ",buckets[31]);
-   fprintf(fp,"   8s:%-7.1ld ",buckets[32]);
-   fprintf(fp,"  10s:%-7.1ld \n",buckets[33]);
-
-   fprintf(fp,"Band 8:   ");
-   fprintf(fp,"  20s:%-7.1ld ",buckets[34]);
-   fprintf(fp,"  40s:%-7.1ld ",buckets[35]);
-   fprintf(fp,"  60s:%-7.1ld ",buckets[36]);
-   fprintf(fp,"  80s:%-7.1ld ",buckets[37]);
-   fprintf(fp," 120s:%-7.1ld \n",buckets[38]);
-
-   fprintf(fp,"Band 9:   ");
-   fprintf(fp,"120+s:%-7.1ld \n\n",buckets[39]);
+/*
+ * Called by the parent once all of the children have finished a test.
+ * Merges the per-child histograms and reports the percentiles of the
+ * whole population.
+ */
+#ifdef HAVE_ANSIC_C
+void
+dump_hist_all(char *what,int count)
+#else
+void
+dump_hist_all(what,count)
+char *what;
+int count;
+#endif
+{
+   FILE *fp;
+   struct lat_hist *all;
+   int i;
+
+   if(lat_hist == 0 || distributed)
+	return;
+   if(count > lat_hist_count)
+	count = lat_hist_count;
+   all = (struct lat_hist *)malloc(sizeof(struct lat_hist));
+   if(all == 0)
+	return;
+   bzero(all, sizeof(struct lat_hist));
+   for(i = 0; i < count; i++)
+	hist_merge(all, &lat_hist[i]);
+
+   if(!silent && all->total)
+   {
+	printf("\tLatency percentiles (us)\t\t\t=");
+	for(i = 0; i < (int)HIST_NPCT; i++)
+		printf(" p%g %.3f",hist_pct[i],
+			(double)hist_percentile(all, hist_pct[i])/1000.0);
+	printf("\n");
+   }
+   fp = fopen("Iozone_histogram_all.txt","a");
+   if(fp)
+   {
+	hist_fprint(fp, what, -1, all);
+	fclose(fp);
+   }
+   free(all);
+}
+
+/*
+ * Binary latency trace rings. One per child, allocated the first
+ * time the child traces and reused by every following test so that
+ * nothing is allocated or written while the test is being timed.
+ */
+struct trace_ring *trace_rings[MAXSTREAMS];
+
+#ifdef HAVE_ANSIC_C
+struct trace_ring *
+trace_open(int id, char *name, char *title, int op)
+#else
+struct trace_ring *
+trace_open(id, name, title, op)
+int id;
+char *name;
+char *title;
+int op;
+#endif
+{
+	struct trace_ring *tr;
+	char *dot;
+
+	if(id < 0 || id >= MAXSTREAMS)
+		return(0);
+	tr = trace_rings[id];
+	if(tr == 0)
+	{
+		tr = (struct trace_ring *)malloc(sizeof(struct trace_ring));
+		if(tr == 0)
+			return(0);
+		tr->size = (long long)trace_recs;
+		tr->rec = (struct trace_rec *)malloc(
+			(size_t)tr->size * sizeof(struct trace_rec));
+		if(tr->rec == 0)
+		{
+			free(tr);
+			return(0);
+		}
+		/* Fault the ring in now, not in the middle of the test */
+		bzero(tr->rec, (size_t)tr->size * sizeof(struct trace_rec));
+		trace_rings[id] = tr;
+	}
+	bzero(&tr->hdr, sizeof(struct trace_header));
+	tr->hdr.magic = TRACE_MAGIC;
+	tr->hdr.version = TRACE_VERSION;
+	tr->hdr.child = (unsigned int)id;
+	tr->hdr.rec_size = (unsigned int)sizeof(struct trace_rec);
+	strncpy(tr->hdr.name, name, sizeof(tr->hdr.name)-1);
+	strncpy(tr->hdr.title, title, sizeof(tr->hdr.title)-1);
+	strncpy(tr->binname, name, sizeof(tr->binname)-5);
+	tr->binname[sizeof(tr->binname)-5] = 0;
+	dot = strrchr(tr->binname, '.');
+	if(dot)
+		*dot = 0;
+	strcat(tr->binname, ".bin");
+	tr->next = 0;
+	tr->total = 0;
+	tr->op = (unsigned int)op;
+	return(tr);
+}
+
+/*
+ * Record one operation. start and latency are in seconds, as returned
+ * by time_so_far(). Once the ring is full the oldest records are
+ * overwritten.
+ */
+#ifdef HAVE_ANSIC_C
+void
+trace_insert(struct trace_ring *tr, double start, off64_t where,
+	long long size, double latency)
+#else
+void
+trace_insert(tr, start, where, size, latency)
+struct trace_ring *tr;
+double start;
+off64_t where;
+long long size;
+double latency;
+#endif
+{
+	struct trace_rec *r;
+
+	r = &tr->rec[tr->next];
+	r->start = (unsigned long long)((start - run_start) * 1000000000.0);
+	r->offset = (long long)where;
+	r->latency = (long long)(latency * 1000000000.0);
+	r->size = (unsigned int)size;
+	r->op = tr->op;
+	if(++tr->next == tr->size)
+		tr->next = 0;
+	tr->total++;
+}
+
+/*
+ * Append the ring, oldest record first, to the .bin file. Called once
+ * the timed section is over.
+ */
+#ifdef HAVE_ANSIC_C
+void
+trace_close(struct trace_ring *tr)
+#else
+void
+trace_close(tr)
+struct trace_ring *tr;
+#endif
+{
+	FILE *fp;
+	long long first, count;
+
+	if(tr == 0)
+		return;
+	if(tr->total > (unsigned long long)tr->size)
+	{
+		count = tr->size;
+		first = tr->next;
+	}
+	else
+	{
+		count = (long long)tr->total;
+		first = 0;
+	}
+	tr->hdr.count = (unsigned long long)count;
+	tr->hdr.dropped = tr->total - (unsigned long long)count;
+	fp = fopen(tr->binname, "ab");
+	if(fp == 0)
+	{
+		printf("Unable to open %s\n",tr->binname);
+		return;
+	}
+	junk = fwrite(&tr->hdr, sizeof(struct trace_header), 1, fp);
+	junk = fwrite(&tr->rec[first], sizeof(struct trace_rec),
+		(size_t)(count - first), fp);
+	if(first)
+		junk = fwrite(&tr->rec[0], sizeof(struct trace_rec),
+			(size_t)first, fp);
+	fclose(fp);
+	if(tr->hdr.dropped && !silent)
+#ifdef NO_PRINT_LLD
+		printf("\n%s: ring full, %ld oldest records dropped\n",
+			tr->binname, (long)tr->hdr.dropped);
+#else
+		printf("\n%s: ring full, %lld oldest records dropped\n",
+			tr->binname, (long long)tr->hdr.dropped);
 #endif
-   fclose(fp);
 }
 
 #ifdef HAVE_ANSIC_C
@@ -25507,8 +30071,7 @@ void * thread_fwrite_test( x)
         double starttime1 = 0;
         double temp_time;
         double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
         double walltime, cputime;
         double compute_val = (double)0;
         float delay = (float)0;
@@ -25534,6 +30097,7 @@ void * thread_fwrite_test( x)
         off64_t filebytes64;
         char tmpname[256];
         FILE *thread_wqfd;
+        struct trace_ring *thread_qtr=0;
         FILE *thread_Lwqfd;
         char *filename;
 
@@ -25587,7 +30151,7 @@ void * thread_fwrite_test( x)
 #endif
 #endif
         if(use_thread)
-                nbuff=barray[xx];
+                nbuff=mem_local(barray[xx]);
         else
                 nbuff=buffer;
         if(debug1 )
@@ -25679,6 +30243,8 @@ void * thread_fwrite_test( x)
           setvbuf(stream,stdio_buf,_IOFBF,reclen);
 
         buffer=mainbuffer;
+        if(direct_flag)
+          dio_stdio(fd,buffer,reclen);
         if(fetchon)
                 fetchit(buffer,reclen);
         if(verify || dedup || dedup_interior)
@@ -25691,7 +30257,10 @@ void * thread_fwrite_test( x)
         child_stat = (struct child_stats *)&shmaddr[xx];
         child_stat->throughput = 0;
         child_stat->actual = 0;
-        child_stat->flag=CHILD_STATE_READY; /* Tell parent child is ready to go */
+        if(hist_summary)
+                hist_reset((int)xx);
+        child_publish(child_stat,0.0,0.0);
+        child_flag_set(child_stat,CHILD_STATE_READY); /* Tell parent child is ready to go */
 #ifdef NET_BENCH
         if(distributed && client_iozone)
                 tell_master_ready(chid);
@@ -25714,7 +30283,7 @@ void * thread_fwrite_test( x)
         }
         else
         {
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
                         Poll((long long)1);
         }
 
@@ -25723,7 +30292,7 @@ void * thread_fwrite_test( x)
         child_stat->actual = 0;
         child_stat->throughput = 0;
         stopped=0;
-        if(Q_flag)
+        if(Q_flag && !Q_bin_flag)
         {
                 sprintf(tmpname,"Child_%d_fwol.dat",(int)xx);
                 thread_wqfd=fopen(tmpname,"a");
@@ -25739,6 +30308,18 @@ void * thread_fwrite_test( x)
                 }
                 fprintf(thread_wqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
         }
+        if(Q_flag && Q_bin_flag)
+        {
+        	sprintf(tmpname,"Child_%d_fwol.dat",(int)xx);
+        	thread_qtr=trace_open((int)xx,tmpname,
+        		"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+        		TRACE_OP_FWRITE);
+        	if(thread_qtr==0)
+        	{
+        		printf("Unable to allocate trace ring for %s\n",tmpname);
+        		exit(40);
+        	}
+        }
         if(L_flag)
         {
                 sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -25779,7 +30360,10 @@ void * thread_fwrite_test( x)
                         purgeit(buffer,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
 		{
-			thread_qtime_start=time_so_far();
+			if(op_rate_flag)
+				thread_qtime_start=rate_wait(&rsched,(long long)xx);
+			else
+				thread_qtime_start=time_so_far();
 		}
                 if(fwrite(buffer, (size_t) reclen, 1, stream) != 1)
                 {
@@ -25797,19 +30381,15 @@ void * thread_fwrite_test( x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-			if( actual_rate < desired_op_rate_time)
-			      my_unap((unsigned long long)((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
 		if(Q_flag)
 		{
 			thread_qtime_stop=time_so_far();
+			if(thread_qtr)
+				trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+				  thread_qtime_stop-thread_qtime_start-time_res);
+			else
 #ifdef NO_PRINT_LLD
 			fprintf(thread_wqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -25819,6 +30399,7 @@ void * thread_fwrite_test( x)
                 w_traj_ops_completed++;
                 w_traj_bytes_completed+=reclen;
                 written_so_far+=reclen/1024;
+                child_publish(child_stat,(double)written_so_far,(double)written_so_far*1024.0/(double)reclen);
         }
         if(include_flush)
         {
@@ -25886,7 +30467,7 @@ void * thread_fwrite_test( x)
                         xx, walltime, cputime,
                         cpu_util(cputime, walltime));
         }
-        child_stat->flag = CHILD_STATE_HOLD; /* Tell parent I'm done */
+        child_flag_set(child_stat,CHILD_STATE_HOLD); /* Tell parent I'm done */
         stopped=0;
 
         /*******************************************************************/
@@ -25899,8 +30480,10 @@ void * thread_fwrite_test( x)
 #else
                 printf("\nChild finished %lld\n",xx);
 #endif
-        if(Q_flag && (thread_wqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_wqfd !=0) )
                 fclose(thread_wqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
         free(dummyfile[xx]);
         if(w_traj_flag)
                 fclose(w_traj_fd);
@@ -25966,8 +30549,7 @@ void * thread_fread_test( x)
         double starttime1 = 0;
         double temp_time;
         double hist_time;
-	double desired_op_rate_time;
-	double actual_rate;
+	struct rate_sched rsched = { 0.0, 0 };
         double walltime, cputime;
         double compute_val = (double)0;
         float delay = (float)0;
@@ -25993,6 +30575,7 @@ void * thread_fread_test( x)
         off64_t filebytes64;
         char tmpname[256];
         FILE *thread_wqfd;
+        struct trace_ring *thread_qtr=0;
         FILE *thread_Lwqfd;
 
         if(compute_flag)
@@ -26043,7 +30626,7 @@ void * thread_fread_test( x)
 #endif
 #endif
         if(use_thread)
-                nbuff=barray[xx];
+                nbuff=mem_local(barray[xx]);
         else
                 nbuff=buffer;
         if(debug1 )
@@ -26120,6 +30703,8 @@ void * thread_fread_test( x)
           setvbuf(stream,stdio_buf,_IOFBF,reclen);
 
 	buffer=mainbuffer;
+        if(direct_flag)
+          dio_stdio(fileno(stream),buffer,reclen);
 	if(fetchon)
 		fetchit(buffer,reclen);
 	compute_val=(double)0;
@@ -26130,7 +30715,10 @@ void * thread_fread_test( x)
         child_stat = (struct child_stats *)&shmaddr[xx];
         child_stat->throughput = 0;
         child_stat->actual = 0;
-        child_stat->flag=CHILD_STATE_READY; /* Tell parent child is ready to go */
+        if(hist_summary)
+                hist_reset((int)xx);
+        child_publish(child_stat,0.0,0.0);
+        child_flag_set(child_stat,CHILD_STATE_READY); /* Tell parent child is ready to go */
 #ifdef NET_BENCH
         if(distributed && client_iozone)
                 tell_master_ready(chid);
@@ -26153,7 +30741,7 @@ void * thread_fread_test( x)
         }
         else
         {
-                while(child_stat->flag!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
+                while(child_flag_get(child_stat)!=CHILD_STATE_BEGIN)   /* Wait for signal from parent */
                         Poll((long long)1);
         }
 
@@ -26162,7 +30750,7 @@ void * thread_fread_test( x)
         child_stat->actual = 0;
         child_stat->throughput = 0;
         stopped=0;
-        if(Q_flag)
+        if(Q_flag && !Q_bin_flag)
         {
                 sprintf(tmpname,"Child_%d_frol.dat",(int)xx);
                 thread_wqfd=fopen(tmpname,"a");
@@ -26178,6 +30766,18 @@ void * thread_fread_test( x)
                 }
                 fprintf(thread_wqfd,"Offset in Kbytes   Latency in microseconds  Transfer size in bytes\n");
         }
+        if(Q_flag && Q_bin_flag)
+        {
+        	sprintf(tmpname,"Child_%d_frol.dat",(int)xx);
+        	thread_qtr=trace_open((int)xx,tmpname,
+        		"Offset in Kbytes   Latency in microseconds  Transfer size in bytes",
+        		TRACE_OP_FREAD);
+        	if(thread_qtr==0)
+        	{
+        		printf("Unable to allocate trace ring for %s\n",tmpname);
+        		exit(40);
+        	}
+        }
         if(L_flag)
         {
                 sprintf(tmpname,"Child_%d.log",(int)xx);
@@ -26221,7 +30821,10 @@ void * thread_fread_test( x)
 			purgeit(buffer,reclen);
 		if(Q_flag || hist_summary || op_rate_flag)
 		{
-			thread_qtime_start=time_so_far();
+			if(op_rate_flag)
+				thread_qtime_start=rate_wait(&rsched,(long long)xx);
+			else
+				thread_qtime_start=time_so_far();
 		}
 		if(fread(buffer, (size_t) reclen,1, stream) != 1)
 		{
@@ -26254,19 +30857,15 @@ void * thread_fread_test( x)
 		{
 			thread_qtime_stop=time_so_far();
 			hist_time =(thread_qtime_stop-thread_qtime_start);
-			hist_insert(hist_time);
-		}
-		if(op_rate_flag)
-		{
-			thread_qtime_stop=time_so_far();
-			desired_op_rate_time = ((double)1.0/(double)op_rate);
-			actual_rate = (double)(thread_qtime_stop-thread_qtime_start);
-			if( actual_rate < desired_op_rate_time)
-			      my_unap((unsigned long long)((desired_op_rate_time-actual_rate)*1000000.0 ));
+			hist_insert((int)xx,hist_time);
 		}
 		if(Q_flag)
 		{
 			thread_qtime_stop=time_so_far();
+			if(thread_qtr)
+				trace_insert(thread_qtr,thread_qtime_start,traj_offset,reclen,
+				  thread_qtime_stop-thread_qtime_start-time_res);
+			else
 #ifdef NO_PRINT_LLD
 			fprintf(thread_wqfd,"%10.1ld %10.0f %10.1ld\n",(traj_offset)/1024,((thread_qtime_stop-thread_qtime_start-time_res))*1000000,reclen);
 #else
@@ -26276,6 +30875,7 @@ void * thread_fread_test( x)
                 w_traj_ops_completed++;
                 w_traj_bytes_completed+=reclen;
                 written_so_far+=reclen/1024;
+                child_publish(child_stat,(double)written_so_far,(double)written_so_far*1024.0/(double)reclen);
 
 	}
 	if(include_flush)
@@ -26335,7 +30935,7 @@ void * thread_fread_test( x)
                         xx, walltime, cputime,
                         cpu_util(cputime, walltime));
         }
-        child_stat->flag = CHILD_STATE_HOLD; /* Tell parent I'm done */
+        child_flag_set(child_stat,CHILD_STATE_HOLD); /* Tell parent I'm done */
         stopped=0;
 
         /*******************************************************************/
@@ -26348,8 +30948,10 @@ void * thread_fread_test( x)
 #else
                 printf("\nChild finished %lld\n",xx);
 #endif
-        if(Q_flag && (thread_wqfd !=0) )
+        if(Q_flag && !Q_bin_flag && (thread_wqfd !=0) )
                 fclose(thread_wqfd);
+        if(thread_qtr)
+        	trace_close(thread_qtr);
         free(dummyfile[xx]);
         if(w_traj_flag)
                 fclose(w_traj_fd);
@@ -0,0 +1,152 @@
+/******************************************************************************
+* File: iozone_trace.c
+*
+* Description: Host side decoder for the binary offset/latency traces
+* that iozone writes with -+Q. Each Child_<n>_<op>.bin file holds one
+* or more (trace_header, trace_rec[count]) runs, one per test pass.
+* Every run is appended to the text file named in its header, in the
+* same format that -Q writes directly:
+*
+*	Offset in Kbytes   Latency in microseconds  Transfer size in bytes
+*
+* Traces written on a target of the other byte order are swapped.
+*
+* Usage: iozone_trace [-v] Child_0_wol.bin [Child_1_wol.bin ...]
+*
+******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iozone_trace.h"
+
+static int verbose;
+
+static unsigned int
+swap32(unsigned int x)
+{
+	return ((x >> 24) & 0xff) | ((x >> 8) & 0xff00) |
+		((x << 8) & 0xff0000) | (x << 24);
+}
+
+static unsigned long long
+swap64(unsigned long long x)
+{
+	return ((unsigned long long)swap32((unsigned int)x) << 32) |
+		swap32((unsigned int)(x >> 32));
+}
+
+static void
+swap_header(struct trace_header *h)
+{
+	h->magic = swap32(h->magic);
+	h->version = swap32(h->version);
+	h->child = swap32(h->child);
+	h->rec_size = swap32(h->rec_size);
+	h->count = swap64(h->count);
+	h->dropped = swap64(h->dropped);
+}
+
+static void
+swap_rec(struct trace_rec *r)
+{
+	r->start = swap64(r->start);
+	r->offset = (long long)swap64((unsigned long long)r->offset);
+	r->latency = (long long)swap64((unsigned long long)r->latency);
+	r->size = swap32(r->size);
+	r->op = swap32(r->op);
+}
+
+static int
+decode(char *path)
+{
+	FILE *in, *out;
+	struct trace_header hdr;
+	struct trace_rec rec;
+	unsigned long long i;
+	int swap, runs = 0;
+
+	in = fopen(path, "rb");
+	if(in == 0)
+	{
+		perror(path);
+		return 1;
+	}
+	while(fread(&hdr, sizeof(hdr), 1, in) == 1)
+	{
+		swap = 0;
+		if(hdr.magic != TRACE_MAGIC)
+		{
+			if(swap32(hdr.magic) != TRACE_MAGIC)
+			{
+				fprintf(stderr, "%s: bad magic 0x%08x in run %d\n",
+					path, hdr.magic, runs);
+				fclose(in);
+				return 1;
+			}
+			swap = 1;
+			swap_header(&hdr);
+		}
+		if(hdr.version != TRACE_VERSION ||
+		   hdr.rec_size != sizeof(struct trace_rec))
+		{
+			fprintf(stderr, "%s: unsupported version %u record size %u\n",
+				path, hdr.version, hdr.rec_size);
+			fclose(in);
+			return 1;
+		}
+		hdr.name[sizeof(hdr.name)-1] = 0;
+		hdr.title[sizeof(hdr.title)-1] = 0;
+		out = fopen(hdr.name, "a");
+		if(out == 0)
+		{
+			perror(hdr.name);
+			fclose(in);
+			return 1;
+		}
+		fprintf(out, "%s\n", hdr.title);
+		for(i = 0; i < hdr.count; i++)
+		{
+			if(fread(&rec, sizeof(rec), 1, in) != 1)
+			{
+				fprintf(stderr, "%s: truncated, %llu of %llu records\n",
+					path, i, hdr.count);
+				fclose(out);
+				fclose(in);
+				return 1;
+			}
+			if(swap)
+				swap_rec(&rec);
+			fprintf(out, "%10.1lld %10.0f %10.1lld\n",
+				rec.offset / 1024, (double)rec.latency / 1000.0,
+				(long long)rec.size);
+		}
+		fclose(out);
+		if(verbose)
+			printf("%s: child %u, %llu records (%llu dropped) -> %s\n",
+				path, hdr.child, hdr.count, hdr.dropped, hdr.name);
+		runs++;
+	}
+	fclose(in);
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	int i, err = 0;
+
+	if(argc > 1 && strcmp(argv[1], "-v") == 0)
+	{
+		verbose = 1;
+		argc--;
+		argv++;
+	}
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: iozone_trace [-v] file.bin [file.bin ...]\n");
+		exit(1);
+	}
+	for(i = 1; i < argc; i++)
+		err |= decode(argv[i]);
+	exit(err);
+}
@@ -0,0 +1,54 @@
+#ifndef __IOZONE_TRACE_H__
+#define __IOZONE_TRACE_H__
+
+/*
+ * Binary per-operation latency trace. (-+Q)
+ *
+ * Instead of a fprintf() per operation each child records its
+ * operations into a preallocated ring of trace_rec entries. The ring
+ * is only written out once the timed section is over, as one
+ * trace_header followed by header.count records, appended to
+ * Child_<n>_<op>.bin. iozone_trace.c turns these files back into the
+ * same text files that -Q produces.
+ *
+ * The files are written in the byte order of the target. The decoder
+ * uses the magic number to detect a foreign byte order and swaps.
+ */
+#define TRACE_MAGIC		0x494f5a54
+#define TRACE_VERSION		1
+/* Default number of records kept per child */
+#define TRACE_DEFAULT_RECS	16384
+
+#define TRACE_OP_WRITE		1
+#define TRACE_OP_REWRITE	2
+#define TRACE_OP_READ		3
+#define TRACE_OP_REREAD		4
+#define TRACE_OP_REVERSE	5
+#define TRACE_OP_STRIDE		6
+#define TRACE_OP_RANDOM_READ	7
+#define TRACE_OP_RANDOM_WRITE	8
+#define TRACE_OP_PWRITE		9
+#define TRACE_OP_PREAD		10
+#define TRACE_OP_FWRITE		11
+#define TRACE_OP_FREAD		12
+
+struct trace_header {
+	unsigned int magic;		/* TRACE_MAGIC */
+	unsigned int version;		/* TRACE_VERSION */
+	unsigned int child;		/* child number */
+	unsigned int rec_size;		/* sizeof(struct trace_rec) */
+	unsigned long long count;	/* records following this header */
+	unsigned long long dropped;	/* oldest records lost to ring wrap */
+	char name[64];			/* text file the decoder writes */
+	char title[80];			/* first line of the text file */
+};
+
+struct trace_rec {
+	unsigned long long start;	/* ns since the start of the run */
+	long long offset;		/* file offset in bytes */
+	long long latency;		/* ns, time_res already removed */
+	unsigned int size;		/* transfer size in bytes */
+	unsigned int op;		/* TRACE_OP_xxx */
+};
+
+#endif /* __IOZONE_TRACE_H__ */
@@ -95,6 +95,7 @@
  */
 
 #include <sys/types.h>
+#include <sys/time.h>
 #include <aio.h>
 #if defined(solaris) || defined(linux) || defined(SCO_Unixware_gcc)
 #else
@@ -142,6 +143,22 @@ typedef long long off64_t;
 #include <string.h>
 #endif
 
+#if defined(linux) && defined(HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#else
+#undef HAVE_IO_URING
+#endif
+#if defined(linux) && defined(HAVE_LINUX_AIO)
+#include <linux/aio_abi.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#else
+#undef HAVE_LINUX_AIO
+#endif
+
 
 extern long long page_size;
 extern int one;
@@ -174,6 +191,18 @@ struct cache_ent {
 						/* accidents */
 	size_t oldsize;				/* Used for firewall to prevent in flight */
 						/* accidents */
+	long long buf_size;			/* Library buffer kept across reuse */
+#ifdef HAVE_IO_URING
+	struct iovec u_iov;			/* io_uring transfer, if not fixed */
+	int buf_index;				/* registered buffer slot or -1 */
+#endif
+#ifdef HAVE_LINUX_AIO
+	struct iocb k_iocb;			/* io_submit() control block */
+#endif
+#if defined(HAVE_IO_URING) || defined(HAVE_LINUX_AIO)
+	long long e_res;			/* engine completion result */
+	int e_done;				/* engine completion has been reaped */
+#endif
 };
 
 /*
@@ -187,15 +216,53 @@ struct cache {
 	struct cache_ent *w_head;		/* Head of cache list */
 	struct cache_ent *w_tail;		/* tail of cache list */
 	long long w_count;		/* How many elements on the write list */
+	struct cache_ent **hash;	/* Open addressed index of the cache list */
+	unsigned hash_mask;		/* Slots - 1, 0 until the first entry */
+	struct cache_ent *free_ce;	/* Recycled entries, buffers attached */
+	struct wslab *wslab;		/* Preallocated write slots */
+	struct cache_ent *w_pending;	/* Handed out by async_write_buffer() */
+#ifdef HAVE_IO_URING
+	struct uring *ring;		/* io_uring engine, 0 for POSIX aio */
+#endif
+#ifdef HAVE_LINUX_AIO
+	struct kaio *kaio;		/* Linux native aio engine, 0 for POSIX aio */
+#endif
 	};
 
 long long max_depth;
 extern int errno;
+/*
+ * Engine selection, set by the caller before async_init().
+ */
+#define ASYNC_ENGINE_POSIX	0
+#define ASYNC_ENGINE_URING	1
+#define ASYNC_ENGINE_KAIO	2
+int async_engine = ASYNC_ENGINE_POSIX;
+int async_ring_entries = 128;	/* io_uring / io_setup() queue entries */
+/*
+ * Completion strategy, also set before async_init(). Blocking sleeps
+ * in aio_suspend()/io_getevents()/io_uring_enter() until the transfer
+ * is done, spinning polls its completion state and never sleeps,
+ * hybrid spins for async_spin_usec and then sleeps. async_iopoll asks
+ * for an IORING_SETUP_IOPOLL ring on O_DIRECT files, where the kernel
+ * polls the device for completions instead of taking its interrupt.
+ */
+#define ASYNC_POLL_BLOCK	0
+#define ASYNC_POLL_SPIN		1
+#define ASYNC_POLL_HYBRID	2
+int async_poll = ASYNC_POLL_BLOCK;
+int async_spin_usec = 50;
+int async_iopoll;
 struct cache_ent *alloc_cache();
 struct cache_ent *incache();
 void async_init();
 void end_async();
 int async_suspend();
+int async_start();
+int async_error();
+ssize_t async_return();
+void async_cancel();
+void async_flush();
 int async_read();
 void takeoff_cache();
 void del_cache();
@@ -203,6 +270,7 @@ void async_release();
 void putoninuse();
 void takeoffinuse();
 struct cache_ent *allocate_write_buffer();
+char *async_write_buffer();
 size_t async_write();
 void async_wait_for_write();
 void async_put_on_write_queue();
@@ -219,6 +287,885 @@ void async_write_finish();
 #endif
 #endif
 
+/*
+ * The aiocb in each cache_ent describes the transfer whichever engine
+ * runs it.
+ */
+#ifdef _LARGEFILE64_SOURCE 
+#ifdef __LP64__
+#define CE_CB(ce)	((ce)->myaiocb)
+#else
+#define CE_CB(ce)	((ce)->myaiocb64)
+#endif
+#else
+#define CE_CB(ce)	((ce)->myaiocb)
+#endif
+
+/*
+ * For a waiter that started at *start (0 on its first call): keep
+ * polling rather than go to sleep ?
+ */
+static int
+async_spinning(start)
+long long *start;
+{
+	struct timeval tv;
+	long long now;
+
+	if(async_poll == ASYNC_POLL_BLOCK)
+		return(0);
+	if(async_poll == ASYNC_POLL_SPIN)
+		return(1);
+	gettimeofday(&tv,(struct timezone *)0);
+	now=(long long)tv.tv_sec*1000000LL+tv.tv_usec;
+	if(*start == 0)
+		*start=now;
+	return(now - *start < (long long)async_spin_usec);
+}
+
+#ifdef HAVE_IO_URING
+/*
+ * io_uring engine (-+I uring). The same cache_ent lists drive it but
+ * the transfers are queued on a submission ring, one per cache, and
+ * reaped from its completion ring instead of aio_read()/aio_suspend().
+ * Read-aheads are queued and then handed to the kernel with a single
+ * io_uring_enter(), writes are submitted in batches of the write
+ * depth. The file of the cache is registered as fixed file 0, and
+ * library owned buffers come from a pool that is registered once so
+ * that READ_FIXED/WRITE_FIXED skip the per I/O page pinning. Everything
+ * falls back (plain fd, malloc()ed buffers, POSIX aio) if the kernel
+ * refuses a step. No liburing is needed, only the kernel header.
+ */
+#define URING_POOL_MAX	(64LL * 1024 * 1024)	/* bytes of registered buffers */
+#define URING_POOL_SLOTS 1024
+
+struct uring {
+	int fd;				/* ring file descriptor */
+	unsigned entries;		/* submission queue entries */
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ring, *cq_ring;
+	size_t sq_len, cq_len, sqes_len;
+	unsigned queued;		/* filled in, not yet submitted */
+	unsigned inflight;		/* submitted, not yet reaped */
+	int file;			/* fd registered as fixed file 0, or -1 */
+	char *pool;			/* registered buffers, page aligned */
+	char *pool_real;		/* Real address to free */
+	long long pool_size;		/* bytes per registered buffer */
+	int pool_slots;			/* 0 not set up yet, -1 not available */
+	int *pool_free;			/* stack of free slots */
+	int pool_nfree;
+	int iopoll;			/* IORING_SETUP_IOPOLL ring */
+};
+
+static struct uring *
+uring_create(fd,iopoll)
+int fd;
+int iopoll;
+{
+	struct io_uring_params p;
+	struct uring *r;
+	int files[1];
+
+	r=(struct uring *)malloc(sizeof(struct uring));
+	if(r == 0)
+		return(0);
+	bzero(r,sizeof(struct uring));
+	bzero(&p,sizeof(p));
+	if(iopoll)
+		p.flags=IORING_SETUP_IOPOLL;
+	r->fd=(int)syscall(__NR_io_uring_setup,(unsigned)async_ring_entries,&p);
+	if(r->fd < 0)
+	{
+		free(r);
+		return(0);
+	}
+	r->iopoll=iopoll;
+	r->entries=p.sq_entries;
+	r->sq_len=p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	r->cq_len=p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(r->cq_len > r->sq_len)
+			r->sq_len=r->cq_len;
+		r->cq_len=r->sq_len;
+	}
+	r->sq_ring=mmap(0,r->sq_len,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+		r->fd,IORING_OFF_SQ_RING);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		r->cq_ring=r->sq_ring;
+	else
+		r->cq_ring=mmap(0,r->cq_len,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+			r->fd,IORING_OFF_CQ_RING);
+	r->sqes_len=p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes=(struct io_uring_sqe *)mmap(0,r->sqes_len,PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQES);
+	if(r->sq_ring == MAP_FAILED || r->cq_ring == MAP_FAILED ||
+		r->sqes == MAP_FAILED)
+	{
+		if(r->sq_ring != MAP_FAILED)
+			munmap(r->sq_ring,r->sq_len);
+		if(r->cq_ring != MAP_FAILED && r->cq_ring != r->sq_ring)
+			munmap(r->cq_ring,r->cq_len);
+		if(r->sqes != MAP_FAILED)
+			munmap(r->sqes,r->sqes_len);
+		close(r->fd);
+		free(r);
+		return(0);
+	}
+	r->sq_head=(unsigned *)((char *)r->sq_ring + p.sq_off.head);
+	r->sq_tail=(unsigned *)((char *)r->sq_ring + p.sq_off.tail);
+	r->sq_mask=(unsigned *)((char *)r->sq_ring + p.sq_off.ring_mask);
+	r->sq_array=(unsigned *)((char *)r->sq_ring + p.sq_off.array);
+	r->cq_head=(unsigned *)((char *)r->cq_ring + p.cq_off.head);
+	r->cq_tail=(unsigned *)((char *)r->cq_ring + p.cq_off.tail);
+	r->cq_mask=(unsigned *)((char *)r->cq_ring + p.cq_off.ring_mask);
+	r->cqes=(struct io_uring_cqe *)((char *)r->cq_ring + p.cq_off.cqes);
+	files[0]=fd;
+	if(syscall(__NR_io_uring_register,r->fd,IORING_REGISTER_FILES,files,1) == 0)
+		r->file=fd;
+	else
+		r->file=-1;
+	return(r);
+}
+
+static void
+uring_destroy(r)
+struct uring *r;
+{
+	munmap(r->sqes,r->sqes_len);
+	if(r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring,r->cq_len);
+	munmap(r->sq_ring,r->sq_len);
+	close(r->fd);	/* also drops the registered files and buffers */
+	if(r->pool_real)
+		free(r->pool_real);
+	if(r->pool_free)
+		free(r->pool_free);
+	free(r);
+}
+
+/*
+ * A transfer an IOPOLL ring refused because the device has no poll
+ * queues. Do it synchronously, and have later caches use interrupts.
+ */
+static long long
+uring_nopoll(ce)
+struct cache_ent *ce;
+{
+	ssize_t ret;
+
+	if(async_iopoll)
+	{
+		printf("Device can not poll, using interrupts from the next test on\n");
+		async_iopoll=0;
+	}
+	if(CE_CB(ce).aio_lio_opcode == LIO_READ)
+		ret=pread(CE_CB(ce).aio_fildes,(void *)CE_CB(ce).aio_buf,
+			CE_CB(ce).aio_nbytes,CE_CB(ce).aio_offset);
+	else
+		ret=pwrite(CE_CB(ce).aio_fildes,(void *)CE_CB(ce).aio_buf,
+			CE_CB(ce).aio_nbytes,CE_CB(ce).aio_offset);
+	return(ret < 0 ? -(long long)errno : (long long)ret);
+}
+
+/*
+ * Move completions from the ring to their cache_ent.
+ */
+static void
+uring_reap(r)
+struct uring *r;
+{
+	unsigned head,tail;
+	struct io_uring_cqe *cqe;
+	struct cache_ent *ce;
+
+	head=*r->cq_head;
+	tail=__atomic_load_n(r->cq_tail,__ATOMIC_ACQUIRE);
+	while(head != tail)
+	{
+		cqe=&r->cqes[head & *r->cq_mask];
+		ce=(struct cache_ent *)(unsigned long)cqe->user_data;
+		ce->e_res=cqe->res;
+		if(r->iopoll && cqe->res == -EOPNOTSUPP)
+			ce->e_res=uring_nopoll(ce);
+		ce->e_done=1;
+		r->inflight--;
+		head++;
+	}
+	__atomic_store_n(r->cq_head,head,__ATOMIC_RELEASE);
+}
+
+/*
+ * Hand everything queued to the kernel. With wait set also block until
+ * at least one completion is available.
+ */
+static void
+uring_submit(r,wait)
+struct uring *r;
+int wait;
+{
+	int ret;
+	unsigned flags=0;
+
+	if(r->queued == 0 && (!wait || r->inflight == 0))
+		return;
+	if(wait && r->inflight + r->queued)
+		flags=IORING_ENTER_GETEVENTS;
+	else
+		wait=0;
+	ret=(int)syscall(__NR_io_uring_enter,r->fd,r->queued,wait ? 1 : 0,flags,
+		(void *)0,0);
+	if(ret < 0)
+	{
+		if(errno == EINTR || errno == EAGAIN || errno == EBUSY)
+			return;
+		printf("io_uring_enter failed: errno %d\n",errno);
+		exit(183);
+	}
+	r->queued-=ret;
+	r->inflight+=ret;
+}
+
+/*
+ * Queue the transfer described by ce. Nothing is submitted here unless
+ * the ring is full.
+ */
+static void
+uring_queue(gc,ce,op)
+struct cache *gc;
+struct cache_ent *ce;
+long long op;
+{
+	struct uring *r=gc->ring;
+	struct io_uring_sqe *sqe;
+	unsigned tail,index;
+
+	while(r->queued + r->inflight >= r->entries)
+	{
+		uring_submit(r,1);
+		uring_reap(r);
+	}
+	tail=*r->sq_tail;
+	index=tail & *r->sq_mask;
+	sqe=&r->sqes[index];
+	bzero(sqe,sizeof(*sqe));
+	if(ce->buf_index >= 0)
+	{
+		sqe->opcode=(op == LIO_READ) ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+		sqe->addr=(unsigned long)CE_CB(ce).aio_buf;
+		sqe->len=(unsigned)CE_CB(ce).aio_nbytes;
+		sqe->buf_index=(unsigned short)ce->buf_index;
+	}
+	else
+	{
+		ce->u_iov.iov_base=(void *)CE_CB(ce).aio_buf;
+		ce->u_iov.iov_len=CE_CB(ce).aio_nbytes;
+		sqe->opcode=(op == LIO_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+		sqe->addr=(unsigned long)&ce->u_iov;
+		sqe->len=1;
+	}
+	if(r->file >= 0 && r->file == CE_CB(ce).aio_fildes)
+	{
+		sqe->fd=0;
+		sqe->flags|=IOSQE_FIXED_FILE;
+	}
+	else
+		sqe->fd=CE_CB(ce).aio_fildes;
+	sqe->off=(unsigned long long)CE_CB(ce).aio_offset;
+	sqe->user_data=(unsigned long)ce;
+	CE_CB(ce).aio_lio_opcode=(int)op;	/* for uring_nopoll() */
+	ce->e_done=0;
+	r->sq_array[index]=index;
+	__atomic_store_n(r->sq_tail,tail+1,__ATOMIC_RELEASE);
+	r->queued++;
+}
+
+/*
+ * Wait for ce and return what read()/write() would have.
+ */
+static ssize_t
+uring_wait(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	struct uring *r=gc->ring;
+	long long spin=0;
+
+	uring_reap(r);
+	while(!ce->e_done)
+	{
+		/* An IOPOLL ring only completes inside io_uring_enter() */
+		if(!r->iopoll && async_spinning(&spin))
+			uring_submit(r,0);
+		else
+			uring_submit(r,1);
+		uring_reap(r);
+	}
+	if(ce->e_res < 0)
+	{
+		errno=(int)-ce->e_res;
+		return(-1);
+	}
+	return((ssize_t)ce->e_res);
+}
+
+/*
+ * Registered buffer pool. Set up on first use, once the transfer size
+ * is known.
+ */
+static int
+uring_pool_get(r,size)
+struct uring *r;
+long long size;
+{
+	struct iovec *iov;
+	long temp;
+	int i;
+
+	if(r->pool_slots == 0)
+	{
+		r->pool_slots=-1;
+		r->pool_size=(size+page_size-1) & ~(page_size-1);
+		i=(int)(URING_POOL_MAX / r->pool_size);
+		if(i > (int)r->entries)
+			i=(int)r->entries;
+		if(i > URING_POOL_SLOTS)
+			i=URING_POOL_SLOTS;
+		if(i < 1)
+			return(-1);
+		r->pool_real=(char *)malloc((size_t)(i*r->pool_size+page_size));
+		r->pool_free=(int *)malloc(sizeof(int)*i);
+		iov=(struct iovec *)malloc(sizeof(struct iovec)*i);
+		if(r->pool_real && r->pool_free && iov)
+		{
+			temp=(long)r->pool_real;
+			temp = (temp+page_size) & ~(page_size-1);
+			r->pool=(char *)temp;
+			for(r->pool_nfree=0;r->pool_nfree<i;r->pool_nfree++)
+			{
+				iov[r->pool_nfree].iov_base=r->pool+r->pool_nfree*r->pool_size;
+				iov[r->pool_nfree].iov_len=(size_t)r->pool_size;
+				r->pool_free[r->pool_nfree]=i-1-r->pool_nfree;
+			}
+			if(syscall(__NR_io_uring_register,r->fd,IORING_REGISTER_BUFFERS,iov,i) == 0)
+				r->pool_slots=i;
+		}
+		if(iov)
+			free(iov);
+		if(r->pool_slots < 0)
+		{
+			/* RLIMIT_MEMLOCK, or an old kernel. Use malloc() */
+			if(r->pool_real)
+				free(r->pool_real);
+			if(r->pool_free)
+				free(r->pool_free);
+			r->pool_real=0;
+			r->pool_free=0;
+			r->pool_nfree=0;
+		}
+	}
+	if(r->pool_nfree == 0 || size > r->pool_size)
+		return(-1);
+	return(r->pool_free[--r->pool_nfree]);
+}
+#endif
+
+#ifdef HAVE_LINUX_AIO
+/*
+ * Linux native aio engine (-+I aio), io_setup()/io_submit()/io_getevents()
+ * called directly so that libaio is not needed. Like the io_uring engine
+ * the transfers are queued by async_start() and handed to the kernel as
+ * one io_submit() per batch, so a read-ahead of depth is depth device
+ * I/Os in flight. The kernel only runs these asynchronously on O_DIRECT
+ * files, everything else completes inside io_submit(), so async_init()
+ * only selects this engine with -I. Buffers, offsets and sizes must then
+ * be aligned to the device block size.
+ */
+#define KAIO_ALIGN	512
+
+struct kaio {
+	aio_context_t ctx;		/* from io_setup() */
+	unsigned entries;		/* max requests in flight */
+	struct iocb **queue;		/* filled in, not yet submitted */
+	unsigned queued;
+	unsigned inflight;		/* submitted, not yet reaped */
+	struct io_event *events;	/* io_getevents() results */
+};
+
+static struct kaio *
+kaio_create()
+{
+	struct kaio *k;
+
+	k=(struct kaio *)malloc(sizeof(struct kaio));
+	if(k == 0)
+		return(0);
+	bzero(k,sizeof(struct kaio));
+	k->entries=(unsigned)async_ring_entries;
+	k->queue=(struct iocb **)malloc(sizeof(struct iocb *)*k->entries);
+	k->events=(struct io_event *)malloc(sizeof(struct io_event)*k->entries);
+	if(k->queue == 0 || k->events == 0 ||
+		syscall(__NR_io_setup,k->entries,&k->ctx) < 0)
+	{
+		if(k->queue)
+			free(k->queue);
+		if(k->events)
+			free(k->events);
+		free(k);
+		return(0);
+	}
+	return(k);
+}
+
+static void
+kaio_destroy(k)
+struct kaio *k;
+{
+	syscall(__NR_io_destroy,k->ctx);	/* waits for anything in flight */
+	free(k->queue);
+	free(k->events);
+	free(k);
+}
+
+/*
+ * Reap at least min completions into their cache_ent.
+ */
+static void
+kaio_reap(k,min)
+struct kaio *k;
+long min;
+{
+	struct cache_ent *ce;
+	long ret,i;
+
+	if(k->inflight == 0)
+		return;
+	if(min > (long)k->inflight)
+		min=(long)k->inflight;
+	ret=syscall(__NR_io_getevents,k->ctx,min,(long)k->entries,k->events,
+		(struct timespec *)0);
+	if(ret < 0)
+	{
+		if(errno == EINTR)
+			return;
+		printf("io_getevents failed: errno %d\n",errno);
+		exit(184);
+	}
+	for(i=0;i<ret;i++)
+	{
+		ce=(struct cache_ent *)(unsigned long)k->events[i].data;
+		ce->e_res=k->events[i].res;
+		ce->e_done=1;
+		k->inflight--;
+	}
+}
+
+/*
+ * Hand everything queued to the kernel in one io_submit().
+ */
+static void
+kaio_submit(k)
+struct kaio *k;
+{
+	long ret;
+
+	while(k->queued)
+	{
+		ret=syscall(__NR_io_submit,k->ctx,(long)k->queued,k->queue);
+		if(ret < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN && k->inflight)
+			{
+				kaio_reap(k,1L);
+				continue;
+			}
+			printf("io_submit failed: errno %d\n",errno);
+			exit(185);
+		}
+		k->inflight+=ret;
+		k->queued-=ret;
+		if(k->queued)
+			memmove(k->queue,k->queue+ret,sizeof(struct iocb *)*k->queued);
+	}
+}
+
+/*
+ * Queue the transfer described by ce. Nothing is submitted here unless
+ * the context is full.
+ */
+static void
+kaio_queue(gc,ce,op)
+struct cache *gc;
+struct cache_ent *ce;
+long long op;
+{
+	struct kaio *k=gc->kaio;
+	struct iocb *cb=&ce->k_iocb;
+
+	if(((unsigned long)CE_CB(ce).aio_buf | (unsigned long)CE_CB(ce).aio_nbytes |
+		(unsigned long)CE_CB(ce).aio_offset) & (KAIO_ALIGN-1))
+	{
+		printf("Linux aio needs %d byte aligned transfers: offset %lld size %ld\n",
+			KAIO_ALIGN,(long long)CE_CB(ce).aio_offset,
+			(long)CE_CB(ce).aio_nbytes);
+		exit(186);
+	}
+	while(k->queued + k->inflight >= k->entries)
+	{
+		kaio_submit(k);
+		kaio_reap(k,1L);
+	}
+	bzero(cb,sizeof(struct iocb));
+	cb->aio_lio_opcode=(op == LIO_READ) ? IOCB_CMD_PREAD : IOCB_CMD_PWRITE;
+	cb->aio_fildes=(unsigned)CE_CB(ce).aio_fildes;
+	cb->aio_buf=(unsigned long)CE_CB(ce).aio_buf;
+	cb->aio_nbytes=(unsigned long)CE_CB(ce).aio_nbytes;
+	cb->aio_offset=(long long)CE_CB(ce).aio_offset;
+	cb->aio_data=(unsigned long)ce;
+	ce->e_done=0;
+	k->queue[k->queued++]=cb;
+}
+
+/*
+ * Wait for ce and return what read()/write() would have.
+ */
+static ssize_t
+kaio_wait(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	struct kaio *k=gc->kaio;
+	long long spin=0;
+
+	kaio_submit(k);
+	while(!ce->e_done)
+		kaio_reap(k,async_spinning(&spin) ? 0L : 1L);
+	if(ce->e_res < 0)
+	{
+		errno=(int)-ce->e_res;
+		return(-1);
+	}
+	return((ssize_t)ce->e_res);
+}
+#endif
+
+/*
+ * Get an aligned buffer of size bytes for ce. From the registered pool
+ * when there is one, else malloc()ed with real_address to free.
+ */
+static char *
+async_get_buf(gc,ce,size)
+struct cache *gc;
+struct cache_ent *ce;
+long long size;
+{
+	long temp;
+#ifdef HAVE_IO_URING
+	ce->buf_index=-1;
+	if(gc->ring && (ce->buf_index=uring_pool_get(gc->ring,size)) >= 0)
+	{
+		ce->real_address=0;
+		return(gc->ring->pool + ce->buf_index*gc->ring->pool_size);
+	}
+#endif
+	ce->real_address = (char *)malloc((size_t)(size+page_size));
+	if(ce->real_address == 0)
+		return(0);
+	temp=(long)ce->real_address;
+	temp = (temp+page_size) & ~(page_size-1);
+	return((char *)temp);
+}
+
+static void
+async_put_buf(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+#ifdef HAVE_IO_URING
+	if(ce->buf_index >= 0)
+	{
+		gc->ring->pool_free[gc->ring->pool_nfree++]=ce->buf_index;
+		return;
+	}
+#endif
+	free((void *)(ce->real_address));
+}
+
+/*
+ * Cache entries are recycled rather than freed, together with their
+ * buffer, so that the steady state read and write paths do no
+ * malloc()/free() per request.
+ */
+static void
+async_reset_ce(gc,ce,size)
+struct cache *gc;
+struct cache_ent *ce;
+long long size;
+{
+	char *real,*buf;
+	long long buf_size;
+#ifdef HAVE_IO_URING
+	int buf_index;
+#endif
+
+	real=ce->real_address;
+	buf=(char *)CE_CB(ce).aio_buf;
+	buf_size=ce->buf_size;
+#ifdef HAVE_IO_URING
+	buf_index=ce->buf_index;
+#endif
+	bzero(ce,sizeof(struct cache_ent));
+	if(buf_size == 0)
+	{
+		buf=async_get_buf(gc,ce,size);
+		if(buf == 0)
+		{
+			printf("Malloc failed\n");
+			exit(176);
+		}
+		buf_size=size;
+	}
+	else
+	{
+		ce->real_address=real;
+#ifdef HAVE_IO_URING
+		ce->buf_index=buf_index;
+#endif
+	}
+	ce->buf_size=buf_size;
+	CE_CB(ce).aio_buf=(volatile void *)buf;
+}
+
+static struct cache_ent *
+async_get_ce(gc,size)
+struct cache *gc;
+long long size;
+{
+	struct cache_ent *ce;
+
+	ce=gc->free_ce;
+	if(ce)
+	{
+		gc->free_ce=ce->forward;
+		if(ce->buf_size < size)
+		{
+			async_put_buf(gc,ce);
+			ce->buf_size=0;
+		}
+	}
+	else
+	{
+		ce=(struct cache_ent *)malloc((size_t)sizeof(struct cache_ent));
+		if(ce == (struct cache_ent *)0)
+		{
+			printf("Malloc failed\n");
+			exit(175);
+		}
+		ce->buf_size=0;
+	}
+	async_reset_ce(gc,ce,size);
+	return(ce);
+}
+
+/*
+ * Write slots. The first write on a cache sets up a slab of depth+2
+ * cache_ent, enough for every write async_write() lets be in flight
+ * plus the one being filled, each with an aligned buffer of the record
+ * size. Slots go back on a free stack as async_wait_for_write() retires
+ * them, so steady state writes do no heap allocation. A cache belongs
+ * to a single process or thread and so the stack needs no lock. Writes
+ * that do not fit (bigger records, slab full) use async_get_ce().
+ */
+#define WSLAB_MAX	(64LL * 1024 * 1024)	/* bytes of slot buffers */
+
+struct wslab {
+	struct cache_ent *ce;		/* the slots */
+	long long size;			/* bytes per slot buffer */
+	int slots;			/* 0 not set up yet, -1 not available */
+	int *free;			/* stack of free slots */
+	int nfree;
+};
+
+static struct cache_ent *
+wslab_get(gc,size,depth)
+struct cache *gc;
+long long size,depth;
+{
+	struct wslab *w=gc->wslab;
+	struct cache_ent *ce;
+	int i,slots;
+
+	if(w == 0)
+	{
+		w=gc->wslab=(struct wslab *)malloc(sizeof(struct wslab));
+		if(w == 0)
+			return(0);
+		bzero(w,sizeof(struct wslab));
+		w->slots=-1;
+		slots=(int)depth+2;
+		if(slots > (int)(WSLAB_MAX/size))
+			slots=(int)(WSLAB_MAX/size);
+		if(slots < 2)
+			return(0);
+		w->ce=(struct cache_ent *)malloc(sizeof(struct cache_ent)*slots);
+		w->free=(int *)malloc(sizeof(int)*slots);
+		if(w->ce == 0 || w->free == 0)
+			return(0);
+		bzero(w->ce,sizeof(struct cache_ent)*slots);
+		w->size=size;
+		for(i=0;i<slots;i++)
+		{
+			ce=&w->ce[i];
+			CE_CB(ce).aio_buf=(volatile void *)async_get_buf(gc,ce,size);
+			if(CE_CB(ce).aio_buf == 0)
+				break;
+			ce->buf_size=size;
+			w->free[w->nfree++]=i;
+		}
+		w->slots=i;
+	}
+	if(w->nfree == 0 || size > w->size)
+		return(0);
+	ce=&w->ce[w->free[--w->nfree]];
+	async_reset_ce(gc,ce,size);
+	return(ce);
+}
+
+static int
+wslab_put(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	struct wslab *w=gc->wslab;
+
+	if(w == 0 || w->slots <= 0 || ce < w->ce || ce >= w->ce+w->slots)
+		return(0);
+	w->free[w->nfree++]=(int)(ce-w->ce);
+	return(1);
+}
+
+static void
+wslab_destroy(gc)
+struct cache *gc;
+{
+	struct wslab *w=gc->wslab;
+	int i;
+
+	for(i=0;i<w->slots;i++)
+		async_put_buf(gc,&w->ce[i]);
+	if(w->ce)
+		free((void *)w->ce);
+	if(w->free)
+		free((void *)w->free);
+	free((void *)w);
+	gc->wslab=0;
+}
+
+static void
+async_put_ce(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	if(wslab_put(gc,ce))
+		return;
+	if(ce->buf_size == 0)	/* Caller's buffer, from async_write_no_copy() */
+	{
+		async_put_buf(gc,ce);
+		free((void *)ce);
+		return;
+	}
+	ce->forward=gc->free_ce;
+	gc->free_ce=ce;
+}
+
+/*
+ * Index of the cache list, open addressed with linear probing and
+ * keyed by (fd, offset). Kept at most half full.
+ */
+static unsigned
+cache_slot(gc,fd,offset)
+struct cache *gc;
+long long fd;
+off64_t offset;
+{
+	unsigned long long k;
+
+	k=((unsigned long long)offset ^ ((unsigned long long)fd << 48)) *
+		0x9e3779b97f4a7c15ULL;
+	return((unsigned)(k >> 32) & gc->hash_mask);
+}
+
+static void
+cache_hash_insert(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	struct cache_ent *move;
+	unsigned i,slots;
+
+	if((unsigned long long)(gc->count+1)*2 > (unsigned long long)gc->hash_mask+1)
+	{
+		/* Grow and re-index everything on the cache list */
+		slots=gc->hash_mask ? (gc->hash_mask+1)*2 : 64;
+		if(gc->hash)
+			free((void *)gc->hash);
+		gc->hash=(struct cache_ent **)malloc(sizeof(struct cache_ent *)*slots);
+		if(gc->hash == 0)
+		{
+			printf("Malloc failed\n");
+			exit(175);
+		}
+		bzero(gc->hash,sizeof(struct cache_ent *)*slots);
+		gc->hash_mask=slots-1;
+		for(move=gc->head;move;move=move->forward)
+			if(move != ce)
+				cache_hash_insert(gc,move);
+	}
+	i=cache_slot(gc,ce->fd,CE_CB(ce).aio_offset);
+	while(gc->hash[i])
+		i=(i+1) & gc->hash_mask;
+	gc->hash[i]=ce;
+}
+
+static int
+cache_hash_delete(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	unsigned i,j,k;
+
+	if(gc->hash_mask == 0)
+		return(0);
+	i=cache_slot(gc,ce->fd,CE_CB(ce).aio_offset);
+	while(gc->hash[i] != ce)
+	{
+		if(gc->hash[i] == 0)
+			return(0);
+		i=(i+1) & gc->hash_mask;
+	}
+	/* Shift the rest of the probe run back over the hole */
+	j=i;
+	while(1)
+	{
+		j=(j+1) & gc->hash_mask;
+		if(gc->hash[j] == 0)
+			break;
+		k=cache_slot(gc,gc->hash[j]->fd,CE_CB(gc->hash[j]).aio_offset);
+		if(((j-k) & gc->hash_mask) >= ((j-i) & gc->hash_mask))
+		{
+			gc->hash[i]=gc->hash[j];
+			i=j;
+		}
+	}
+	gc->hash[i]=0;
+	return(1);
+}
+
 
 /***********************************************/
 /* Initialization routine to setup the library */
@@ -249,6 +1196,44 @@ int flag;
 	max_depth=500;
 #else
 	max_depth=sysconf(_SC_AIO_MAX);
+	if(max_depth <= 0)	/* -1, no fixed limit (glibc) */
+		max_depth=500;
+#endif
+#ifdef HAVE_IO_URING
+	if(async_engine == ASYNC_ENGINE_URING)
+	{
+		if(async_iopoll && !flag)
+			printf("IORING_SETUP_IOPOLL needs O_DIRECT (-I). Using interrupts\n");
+		if(async_iopoll && flag &&
+			((*gc)->ring=uring_create(fd,1)) == 0)
+			printf("IOPOLL ring setup failed, errno %d. Using interrupts\n",errno);
+		if((*gc)->ring == 0)
+			(*gc)->ring=uring_create(fd,0);
+		if((*gc)->ring)
+			max_depth=(*gc)->ring->entries;
+		else
+		{
+			printf("io_uring setup failed, errno %d. Using POSIX async I/O\n",errno);
+			async_engine=ASYNC_ENGINE_POSIX;
+		}
+	}
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(async_engine == ASYNC_ENGINE_KAIO)
+	{
+		if(!flag)
+		{
+			printf("Linux aio needs O_DIRECT (-I). Using POSIX async I/O\n");
+			async_engine=ASYNC_ENGINE_POSIX;
+		}
+		else if(((*gc)->kaio=kaio_create()) != 0)
+			max_depth=(*gc)->kaio->entries;
+		else
+		{
+			printf("io_setup failed, errno %d. Using POSIX async I/O\n",errno);
+			async_engine=ASYNC_ENGINE_POSIX;
+		}
+	}
 #endif
 }
 
@@ -259,8 +1244,29 @@ void
 end_async(gc)
 struct cache *gc;
 {
+	struct cache_ent *ce;
 	del_cache(gc);
 	async_write_finish(gc);
+	if(gc->w_pending)
+		async_put_ce(gc,gc->w_pending);
+	if(gc->wslab)
+		wslab_destroy(gc);
+	while((ce=gc->free_ce))
+	{
+		gc->free_ce=ce->forward;
+		async_put_buf(gc,ce);
+		free((void *)ce);
+	}
+	if(gc->hash)
+		free((void *)gc->hash);
+#ifdef HAVE_IO_URING
+	if(gc->ring)
+		uring_destroy(gc->ring);
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(gc->kaio)
+		kaio_destroy(gc->kaio);
+#endif
 	free((void *)gc);
 }
 
@@ -291,6 +1297,186 @@ async_suspend(struct cache_ent *ce)
 #endif
 }
 
+/***********************************************/
+/* Start a transfer on the selected engine.    */
+/* Returns like aio_read()/aio_write().        */
+/***********************************************/
+int
+async_start(gc,ce,op)
+struct cache *gc;
+struct cache_ent *ce;
+long long op;
+{
+#ifdef HAVE_IO_URING
+	if(gc->ring)
+	{
+		uring_queue(gc,ce,op);
+		return(0);
+	}
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(gc->kaio)
+	{
+		kaio_queue(gc,ce,op);
+		return(0);
+	}
+#endif
+#ifdef _LARGEFILE64_SOURCE 
+#ifdef __LP64__
+	if(op == LIO_READ)
+		return(aio_read(&ce->myaiocb));
+	return(aio_write(&ce->myaiocb));
+#else
+	if(op == LIO_READ)
+		return(aio_read64(&ce->myaiocb64));
+	return(aio_write64(&ce->myaiocb64));
+#endif
+#else
+	if(op == LIO_READ)
+		return(aio_read(&ce->myaiocb));
+	return(aio_write(&ce->myaiocb));
+#endif
+}
+
+/***********************************************/
+/* Wait for a transfer to finish. Returns like */
+/* aio_error().                                */
+/***********************************************/
+int
+async_error(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+	long long spin=0;
+	int ret;
+#ifdef HAVE_IO_URING
+	if(gc->ring)
+	{
+		if(uring_wait(gc,ce) < 0)
+			return(errno);
+		return(0);
+	}
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(gc->kaio)
+	{
+		if(kaio_wait(gc,ce) < 0)
+			return(errno);
+		return(0);
+	}
+#endif
+#ifdef _LARGEFILE64_SOURCE 
+#ifdef __LP64__
+	while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
+	{
+		if(!async_spinning(&spin))
+			async_suspend(ce);
+	}
+#else
+	while((ret=aio_error64(&ce->myaiocb64))== EINPROGRESS)
+	{
+		if(!async_spinning(&spin))
+			async_suspend(ce);
+	}
+#endif
+#else
+	while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
+	{
+		if(!async_spinning(&spin))
+			async_suspend(ce);
+	}
+#endif
+	return(ret);
+}
+
+/***********************************************/
+/* Result of a finished transfer, like         */
+/* aio_return().                               */
+/***********************************************/
+ssize_t
+async_return(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+#ifdef HAVE_IO_URING
+	if(gc->ring)
+		return(uring_wait(gc,ce));
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(gc->kaio)
+		return(kaio_wait(gc,ce));
+#endif
+#ifdef _LARGEFILE64_SOURCE 
+#ifdef __LP64__
+	return(aio_return(&ce->myaiocb));
+#else
+#if defined(__CrayX1__)
+	return(aio_return64((aiocb64_t *)&ce->myaiocb64));
+#else
+	return(aio_return64((struct aiocb64 *)&ce->myaiocb64));
+#endif
+#endif
+#else
+	return(aio_return(&ce->myaiocb));
+#endif
+}
+
+/***********************************************/
+/* Get rid of a transfer that is no longer     */
+/* wanted. io_uring and Linux aio reads are   */
+/* left to finish.                             */
+/***********************************************/
+void
+async_cancel(gc,ce)
+struct cache *gc;
+struct cache_ent *ce;
+{
+#ifdef HAVE_IO_URING
+	if(gc->ring)
+	{
+		uring_wait(gc,ce);
+		return;
+	}
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(gc->kaio)
+	{
+		kaio_wait(gc,ce);
+		return;
+	}
+#endif
+#ifdef _LARGEFILE64_SOURCE 
+#ifdef __LP64__
+	while(aio_cancel(0,&ce->myaiocb)==AIO_NOTCANCELED)
+#else
+	while(aio_cancel64(0,&ce->myaiocb64)==AIO_NOTCANCELED)
+#endif
+#else
+	while(aio_cancel(0,&ce->myaiocb)==AIO_NOTCANCELED)
+#endif
+		; 
+	async_return(gc,ce);
+}
+
+/***********************************************/
+/* Submit what async_start() has queued once   */
+/* more than depth transfers are waiting.      */
+/***********************************************/
+void
+async_flush(gc,depth)
+struct cache *gc;
+long long depth;
+{
+#ifdef HAVE_IO_URING
+	if(gc->ring && gc->ring->queued > (unsigned)depth)
+		uring_submit(gc->ring,0);
+#endif
+#ifdef HAVE_LINUX_AIO
+	if(gc->kaio && gc->kaio->queued > (unsigned)depth)
+		kaio_submit(gc->kaio);
+#endif
+}
+
 /*************************************************************************
  * This routine is a generic async reader assist funtion. It takes
  * the same calling parameters as read() but also extends the
@@ -342,47 +1528,17 @@ long long depth;
 
 	a_offset=offset;
 	a_size = size;
-	/*
-	 * Check to see if it can be completed from the cache
-	 */
-	if((ce=(struct cache_ent *)incache(gc,fd,offset,size)))
-	{
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(ce);
-		}
-#else
-		while((ret=aio_error64(&ce->myaiocb64))== EINPROGRESS)
-		{
-			async_suspend(ce);
-		}
-#endif
-#else
-		while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(ce);
-		}
-#endif
+	/*
+	 * Check to see if it can be completed from the cache
+	 */
+	if((ce=(struct cache_ent *)incache(gc,fd,offset,size)))
+	{
+		ret=async_error(gc,ce);
 		if(ret)
 		{
 			printf("aio_error 1: ret %d %d\n",ret,errno);
 		}
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		retval=aio_return(&ce->myaiocb);
-#else
-#if defined(__CrayX1__)
-		retval=aio_return64((aiocb64_t *)&ce->myaiocb64);
-#else
-		retval=aio_return64((struct aiocb64 *)&ce->myaiocb64);
-#endif
-
-#endif
-#else
-		retval=aio_return(&ce->myaiocb);
-#endif
+		retval=async_return(gc,ce);
 		if(retval > 0)
 		{
 #ifdef _LARGEFILE64_SOURCE 
@@ -443,15 +1599,7 @@ long long depth;
 		del_read++;
 		first_ce=alloc_cache(gc,fd,offset,size,(long long)LIO_READ);
 again:
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		ret=aio_read(&first_ce->myaiocb);
-#else
-		ret=aio_read64(&first_ce->myaiocb64);
-#endif
-#else
-		ret=aio_read(&first_ce->myaiocb);
-#endif
+		ret=async_start(gc,first_ce,(long long)LIO_READ);
 		if(ret!=0)
 		{
 			if(errno==EAGAIN)
@@ -482,15 +1630,7 @@ again:
 		if((ce=incache(gc,fd,r_offset,a_size)))
 			continue;
 		ce=alloc_cache(gc,fd,r_offset,a_size,(long long)LIO_READ);
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		ret=aio_read(&ce->myaiocb);
-#else
-		ret=aio_read64(&ce->myaiocb64);
-#endif
-#else
-		ret=aio_read(&ce->myaiocb);
-#endif
+		ret=async_start(gc,ce,(long long)LIO_READ);
 		if(ret!=0)
 		{
 			takeoff_cache(gc,ce);
@@ -498,37 +1638,13 @@ again:
 		}
 	}			
 out:
+	async_flush(gc,0LL);	/* One submit for the whole batch */
 	if(del_read)	/* Wait for the first read to complete */
 	{
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		while((ret=aio_error(&first_ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(first_ce);
-		}
-#else
-		while((ret=aio_error64(&first_ce->myaiocb64))== EINPROGRESS)
-		{
-			async_suspend(first_ce);
-		}
-#endif
-#else
-		while((ret=aio_error(&first_ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(first_ce);
-		}
-#endif
+		ret=async_error(gc,first_ce);
 		if(ret)
 			printf("aio_error 2: ret %d %d\n",ret,errno);
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		retval=aio_return(&first_ce->myaiocb);
-#else
-		retval=aio_return64(&first_ce->myaiocb64);
-#endif
-#else
-		retval=aio_return(&first_ce->myaiocb);
-#endif
+		retval=async_return(gc,first_ce);
 #ifdef _LARGEFILE64_SOURCE 
 #ifdef __LP64__
 		if(retval < first_ce->myaiocb.aio_nbytes)
@@ -601,59 +1717,26 @@ long long fd,size,op;
 off64_t offset;
 {
 	struct cache_ent *ce;
-	long temp;
-	ce=(struct cache_ent *)malloc((size_t)sizeof(struct cache_ent));
-	if(ce == (struct cache_ent *)0)
-	{
-		printf("Malloc failed\n");
-		exit(175);
-	}
-	bzero(ce,sizeof(struct cache_ent));
+	ce=async_get_ce(gc,size);
 #ifdef _LARGEFILE64_SOURCE 
 #ifdef __LP64__
 	ce->myaiocb.aio_fildes=(int)fd;
 	ce->myaiocb.aio_offset=(off64_t)offset;
-	ce->real_address = (char *)malloc((size_t)(size+page_size));
-	temp=(long)ce->real_address;
-	temp = (temp+page_size) & ~(page_size-1);
-	ce->myaiocb.aio_buf=(volatile void *)temp;
-	if(ce->myaiocb.aio_buf == 0)
-#else
-	ce->myaiocb64.aio_fildes=(int)fd;
-	ce->myaiocb64.aio_offset=(off64_t)offset;
-	ce->real_address = (char *)malloc((size_t)(size+page_size));
-	temp=(long)ce->real_address;
-	temp = (temp+page_size) & ~(page_size-1);
-	ce->myaiocb64.aio_buf=(volatile void *)temp;
-	if(ce->myaiocb64.aio_buf == 0)
-#endif
-#else
-	ce->myaiocb.aio_fildes=(int)fd;
-	ce->myaiocb.aio_offset=(off_t)offset;
-	ce->real_address = (char *)malloc((size_t)(size+page_size));
-	temp=(long)ce->real_address;
-	temp = (temp+page_size) & ~(page_size-1);
-	ce->myaiocb.aio_buf=(volatile void *)temp;
-	if(ce->myaiocb.aio_buf == 0)
-#endif
-	{
-		printf("Malloc failed\n");
-		exit(176);
-	}
-	/*bzero(ce->myaiocb.aio_buf,(size_t)size);*/
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
 	ce->myaiocb.aio_reqprio=0;
 	ce->myaiocb.aio_nbytes=(size_t)size;
 	ce->myaiocb.aio_sigevent.sigev_notify=SIGEV_NONE;
 	ce->myaiocb.aio_lio_opcode=(int)op;
 #else
+	ce->myaiocb64.aio_fildes=(int)fd;
+	ce->myaiocb64.aio_offset=(off64_t)offset;
 	ce->myaiocb64.aio_reqprio=0;
 	ce->myaiocb64.aio_nbytes=(size_t)size;
 	ce->myaiocb64.aio_sigevent.sigev_notify=SIGEV_NONE;
 	ce->myaiocb64.aio_lio_opcode=(int)op;
 #endif
 #else
+	ce->myaiocb.aio_fildes=(int)fd;
+	ce->myaiocb.aio_offset=(off_t)offset;
 	ce->myaiocb.aio_reqprio=0;
 	ce->myaiocb.aio_nbytes=(size_t)size;
 	ce->myaiocb.aio_sigevent.sigev_notify=SIGEV_NONE;
@@ -667,6 +1750,7 @@ off64_t offset;
 	gc->tail= ce;
 	if(!gc->head)
 		gc->head=ce;
+	cache_hash_insert(gc,ce);
 	gc->count++;
 	return(ce);
 }
@@ -682,44 +1766,21 @@ long long fd,size;
 off64_t offset;
 {
 	struct cache_ent *move;
+	unsigned i;
 	if(gc->head==0)
 	{
 		return(0);
 	}
-	move=gc->head;
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-	while(move)
-	{
-		if((move->fd == fd) && (move->myaiocb.aio_offset==(off64_t)offset) &&
-			((size_t)size==move->myaiocb.aio_nbytes))
-			{
-				return(move);
-			}
-		move=move->forward;
-	}
-#else
-	while(move)
-	{
-		if((move->fd == fd) && (move->myaiocb64.aio_offset==(off64_t)offset) &&
-			((size_t)size==move->myaiocb64.aio_nbytes))
-			{
-				return(move);
-			}
-		move=move->forward;
-	}
-#endif
-#else
-	while(move)
+	i=cache_slot(gc,fd,offset);
+	while((move=gc->hash[i]))
 	{
-		if((move->fd == fd) && (move->myaiocb.aio_offset==(off_t)offset) &&
-			((size_t)size==move->myaiocb.aio_nbytes))
+		if((move->fd == fd) && (CE_CB(move).aio_offset==offset) &&
+			((size_t)size==CE_CB(move).aio_nbytes))
 			{
 				return(move);
 			}
-		move=move->forward;
+		i=(i+1) & gc->hash_mask;
 	}
-#endif
 	return(0);
 }
 
@@ -733,56 +1794,18 @@ takeoff_cache(gc,ce)
 struct cache *gc;
 struct cache_ent *ce;
 {
-	struct cache_ent *move;
-	long long found;
-	move=gc->head;
-	if(move==ce) /* Head of list */
-	{
-
-		gc->head=ce->forward;
-		if(gc->head)
-			gc->head->back=0;
-		else
-			gc->tail = 0;
-		if(!ce->direct)
-		{
-			free((void *)(ce->real_address));
-			free((void *)ce);
-		}
-		gc->count--;
-		return;
-	}
-	found=0;
-	while(move)
-	{
-		if(move==ce)
-		{
-			if(move->forward)
-			{
-				move->forward->back=move->back;
-			}
-			if(move->back)
-			{
-				move->back->forward=move->forward;
-			}
-			found=1;
-			break;
-		}
-		else
-		{
-			move=move->forward;
-		}
-	}
-	if(gc->head == ce)
-		gc->tail = ce;
-	if(!found)
+	if(!cache_hash_delete(gc,ce))
 		printf("Internal Error in takeoff cache\n");
-	move=gc->head;
+	if(ce->forward)
+		ce->forward->back=ce->back;
+	else
+		gc->tail=ce->back;
+	if(ce->back)
+		ce->back->forward=ce->forward;
+	else
+		gc->head=ce->forward;
 	if(!ce->direct)
-	{
-		free((void *)(ce->real_address));
-		free((void *)ce);
-	}
+		async_put_ce(gc,ce);
 	gc->count--;
 }
 
@@ -797,33 +1820,13 @@ del_cache(gc)
 struct cache *gc;
 {
 	struct cache_ent *ce;
-	ssize_t ret;
 	ce=gc->head;
 	while(1)
 	{
 		ce=gc->head;
 		if(ce==0)
 			return;
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		while((ret = aio_cancel(0,&ce->myaiocb))==AIO_NOTCANCELED)
-#else
-		while((ret = aio_cancel64(0,&ce->myaiocb64))==AIO_NOTCANCELED)
-#endif
-#else
-		while((ret = aio_cancel(0,&ce->myaiocb))==AIO_NOTCANCELED)
-#endif
-			; 
-
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		ret = aio_return(&ce->myaiocb);
-#else
-		ret = aio_return64(&ce->myaiocb64);
-#endif
-#else
-		ret = aio_return(&ce->myaiocb);
-#endif
+		async_cancel(gc,ce);
 		ce->direct=0;
 		takeoff_cache(gc,ce);	  /* remove from cache */
 	}
@@ -864,24 +1867,7 @@ long long depth;
 	 */
 	if((ce=(struct cache_ent *)incache(gc,fd,offset,size)))
 	{
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(ce);
-		}
-#else
-		while((ret=aio_error64(&ce->myaiocb64))== EINPROGRESS)
-		{
-			async_suspend(ce);
-		}
-#endif
-#else
-		while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(ce);
-		}
-#endif
+		ret=async_error(gc,ce);
 		if(ret)
 			printf("aio_error 3: ret %d %d\n",ret,errno);
 #ifdef _LARGEFILE64_SOURCE 
@@ -901,15 +1887,7 @@ long long depth;
 #endif
 			printf("It changed in flight\n");
 			
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		retval=aio_return(&ce->myaiocb);
-#else
-		retval=aio_return64(&ce->myaiocb64);
-#endif
-#else
-		retval=aio_return(&ce->myaiocb);
-#endif
+		retval=async_return(gc,ce);
 		if(retval > 0)
 		{
 #ifdef _LARGEFILE64_SOURCE 
@@ -973,24 +1951,10 @@ long long depth;
 		first_ce=alloc_cache(gc,fd,offset,size,(long long)LIO_READ); /* allocate buffer */
 		/*printf("allocated buffer/read %x offset %d\n",first_ce->myaiocb.aio_buf,offset);*/
 again:
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		first_ce->oldbuf=first_ce->myaiocb.aio_buf;
-		first_ce->oldfd=first_ce->myaiocb.aio_fildes;
-		first_ce->oldsize=first_ce->myaiocb.aio_nbytes;
-		ret=aio_read(&first_ce->myaiocb);
-#else
-		first_ce->oldbuf=first_ce->myaiocb64.aio_buf;
-		first_ce->oldfd=first_ce->myaiocb64.aio_fildes;
-		first_ce->oldsize=first_ce->myaiocb64.aio_nbytes;
-		ret=aio_read64(&first_ce->myaiocb64);
-#endif
-#else
-		first_ce->oldbuf=first_ce->myaiocb.aio_buf;
-		first_ce->oldfd=first_ce->myaiocb.aio_fildes;
-		first_ce->oldsize=first_ce->myaiocb.aio_nbytes;
-		ret=aio_read(&first_ce->myaiocb);
-#endif
+		first_ce->oldbuf=CE_CB(first_ce).aio_buf;
+		first_ce->oldfd=CE_CB(first_ce).aio_fildes;
+		first_ce->oldsize=CE_CB(first_ce).aio_nbytes;
+		ret=async_start(gc,first_ce,(long long)LIO_READ);
 		if(ret!=0)
 		{
 			if(errno==EAGAIN)
@@ -1021,24 +1985,10 @@ again:
 		if((ce=incache(gc,fd,r_offset,a_size)))
 			continue;
 		ce=alloc_cache(gc,fd,r_offset,a_size,(long long)LIO_READ);
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		ce->oldbuf=ce->myaiocb.aio_buf;
-		ce->oldfd=ce->myaiocb.aio_fildes;
-		ce->oldsize=ce->myaiocb.aio_nbytes;
-		ret=aio_read(&ce->myaiocb);
-#else
-		ce->oldbuf=ce->myaiocb64.aio_buf;
-		ce->oldfd=ce->myaiocb64.aio_fildes;
-		ce->oldsize=ce->myaiocb64.aio_nbytes;
-		ret=aio_read64(&ce->myaiocb64);
-#endif
-#else
-		ce->oldbuf=ce->myaiocb.aio_buf;
-		ce->oldfd=ce->myaiocb.aio_fildes;
-		ce->oldsize=ce->myaiocb.aio_nbytes;
-		ret=aio_read(&ce->myaiocb);
-#endif
+		ce->oldbuf=CE_CB(ce).aio_buf;
+		ce->oldfd=CE_CB(ce).aio_fildes;
+		ce->oldsize=CE_CB(ce).aio_nbytes;
+		ret=async_start(gc,ce,(long long)LIO_READ);
 		if(ret!=0)
 		{
 			takeoff_cache(gc,ce);
@@ -1046,26 +1996,10 @@ again:
 		}
 	}			
 out:
+	async_flush(gc,0LL);	/* One submit for the whole batch */
 	if(del_read)	/* Wait for the first read to complete */
 	{
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-		while((ret=aio_error(&first_ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(first_ce);
-		}
-#else
-		while((ret=aio_error64(&first_ce->myaiocb64))== EINPROGRESS)
-		{
-			async_suspend(first_ce);
-		}
-#endif
-#else
-		while((ret=aio_error(&first_ce->myaiocb))== EINPROGRESS)
-		{
-			async_suspend(first_ce);
-		}
-#endif
+		ret=async_error(gc,first_ce);
 		if(ret)
 			printf("aio_error 4: ret %d %d\n",ret,errno);
 #ifdef _LARGEFILE64_SOURCE 
@@ -1074,21 +2008,19 @@ out:
 			first_ce->oldfd != first_ce->myaiocb.aio_fildes ||
 			first_ce->oldsize != first_ce->myaiocb.aio_nbytes) 
 			printf("It changed in flight2\n");
-		retval=aio_return(&first_ce->myaiocb);
 #else
 		if(first_ce->oldbuf != first_ce->myaiocb64.aio_buf ||
 			first_ce->oldfd != first_ce->myaiocb64.aio_fildes ||
 			first_ce->oldsize != first_ce->myaiocb64.aio_nbytes) 
 			printf("It changed in flight2\n");
-		retval=aio_return64(&first_ce->myaiocb64);
 #endif
 #else
 		if(first_ce->oldbuf != first_ce->myaiocb.aio_buf ||
 			first_ce->oldfd != first_ce->myaiocb.aio_fildes ||
 			first_ce->oldsize != first_ce->myaiocb.aio_nbytes) 
 			printf("It changed in flight2\n");
-		retval=aio_return(&first_ce->myaiocb);
 #endif
+		retval=async_return(gc,first_ce);
 #ifdef _LARGEFILE64_SOURCE 
 #ifdef __LP64__
 		if(retval < first_ce->myaiocb.aio_nbytes)
@@ -1192,8 +2124,7 @@ struct cache *gc;
 	
 	if(gc->inuse_head !=0)
 		printf("Error in take off inuse\n");
-	free((void*)(ce->real_address));
-	free(ce);
+	async_put_ce(gc,ce);
 }
 
 /*************************************************************************
@@ -1234,15 +2165,8 @@ long long depth;
 	*/	
 
 again:
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-	ret=aio_write(&ce->myaiocb);
-#else
-	ret=aio_write64(&ce->myaiocb64);
-#endif
-#else
-	ret=aio_write(&ce->myaiocb);
-#endif
+	ret=async_start(gc,ce,(long long)LIO_WRITE);
+	async_flush(gc,depth);
 	if(ret==-1)
 	{
 		if(errno==EAGAIN)
@@ -1288,7 +2212,6 @@ long long direct;
 char *buffer,*free_addr;
 {
 	struct cache_ent *ce;
-	long temp;
 	if(fd==0LL)
 	{
 		printf("Setting up write buffer insane\n");
@@ -1296,67 +2219,44 @@ char *buffer,*free_addr;
 	}
 	if(gc->w_count > w_depth)
 		async_wait_for_write(gc);
-	ce=(struct cache_ent *)malloc((size_t)sizeof(struct cache_ent));
-	if(ce == (struct cache_ent *)0)
+	if(direct && gc->w_pending && buffer == (char *)CE_CB(gc->w_pending).aio_buf)
 	{
-		printf("Malloc failed 1\n");
-		exit(179);
+		/* Filled in place by the caller, see async_write_buffer() */
+		ce=gc->w_pending;
+		gc->w_pending=0;
 	}
-	bzero(ce,sizeof(struct cache_ent));
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-	ce->myaiocb.aio_fildes=(int)fd;
-	ce->myaiocb.aio_offset=(off64_t)offset;
-	if(!direct)
+	else if(!direct)
 	{
-		ce->real_address = (char *)malloc((size_t)(size+page_size));
-		temp=(long)ce->real_address;
-		temp = (temp+page_size) & ~(page_size-1);
-		ce->myaiocb.aio_buf=(volatile void *)temp;
-	}else
+		if((ce=wslab_get(gc,size,w_depth)) == 0)
+			ce=async_get_ce(gc,size);
+	}
+	else
 	{
-		ce->myaiocb.aio_buf=(volatile void *)buffer;
+		ce=(struct cache_ent *)malloc((size_t)sizeof(struct cache_ent));
+		if(ce == (struct cache_ent *)0)
+		{
+			printf("Malloc failed 1\n");
+			exit(179);
+		}
+		bzero(ce,sizeof(struct cache_ent));
+		CE_CB(ce).aio_buf=(volatile void *)buffer;
 		ce->real_address=(char *)free_addr;
+#ifdef HAVE_IO_URING
+		ce->buf_index=-1;
+#endif
 	}
-	if(ce->myaiocb.aio_buf == 0)
+#ifdef _LARGEFILE64_SOURCE 
+#ifdef __LP64__
+	ce->myaiocb.aio_fildes=(int)fd;
+	ce->myaiocb.aio_offset=(off64_t)offset;
 #else
 	ce->myaiocb64.aio_fildes=(int)fd;
 	ce->myaiocb64.aio_offset=(off64_t)offset;
-	if(!direct)
-	{
-		ce->real_address = (char *)malloc((size_t)(size+page_size));
-		temp=(long)ce->real_address;
-		temp = (temp+page_size) & ~(page_size-1);
-		ce->myaiocb64.aio_buf=(volatile void *)temp;
-	}
-	else
-	{
-		ce->myaiocb64.aio_buf=(volatile void *)buffer;
-		ce->real_address=(char *)free_addr;
-	}
-	if(ce->myaiocb64.aio_buf == 0)
 #endif
 #else
 	ce->myaiocb.aio_fildes=(int)fd;
 	ce->myaiocb.aio_offset=(off_t)offset;
-	if(!direct)
-	{
-		ce->real_address = (char *)malloc((size_t)(size+page_size));
-		temp=(long)ce->real_address;
-		temp = (temp+page_size) & ~(page_size-1);
-		ce->myaiocb.aio_buf=(volatile void *)temp;
-	}
-	else
-	{
-		ce->myaiocb.aio_buf=(volatile void *)buffer;
-		ce->real_address=(char *)free_addr;
-	}
-	if(ce->myaiocb.aio_buf == 0)
 #endif
-	{
-		printf("Malloc failed 2\n");
-		exit(180);
-	}
 #ifdef _LARGEFILE64_SOURCE 
 #ifdef __LP64__
 	ce->myaiocb.aio_reqprio=0;
@@ -1379,6 +2279,28 @@ char *buffer,*free_addr;
 	return(ce);
 }
 
+/*************************************************************************
+ * Hand the caller a write slot to fill in place, for a following
+ * async_write_no_copy() with this address as buffer and free_addr.
+ * This saves async_write()'s copy and the caller's malloc() per write.
+ *************************************************************************/
+char *
+async_write_buffer(gc,size,depth)
+struct cache *gc;
+long long size;
+long long depth;
+{
+	struct cache_ent *ce;
+	if(gc->w_pending)
+		async_put_ce(gc,gc->w_pending);
+	if(gc->w_count > depth)
+		async_wait_for_write(gc);
+	if((ce=wslab_get(gc,size,depth)) == 0)
+		ce=async_get_ce(gc,size);
+	gc->w_pending=ce;
+	return((char *)CE_CB(ce).aio_buf);
+}
+
 /*************************************************************************
  * Put it on the outbound queue.
  *************************************************************************/
@@ -1437,24 +2359,7 @@ struct cache *gc;
 		ce->myaiocb64.aio_nbytes);
 	printf("write count %lld \n",gc->w_count);
 	*/
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-	while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
-	{
-		async_suspend(ce);
-	}
-#else
-	while((ret=aio_error64(&ce->myaiocb64))== EINPROGRESS)
-	{
-		async_suspend(ce);
-	}
-#endif
-#else
-	while((ret=aio_error(&ce->myaiocb))== EINPROGRESS)
-	{
-		async_suspend(ce);
-	}
-#endif
+	ret=async_error(gc,ce);
 	if(ret)
 	{
 		printf("aio_error 5: ret %d %d\n",ret,errno);
@@ -1479,20 +2384,7 @@ struct cache *gc;
 		exit(181);
 	}
 
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-	retval=aio_return(&ce->myaiocb);
-#else
-#if defined(__CrayX1__)
-	retval=aio_return64((aiocb64_t *)&ce->myaiocb64);
-#else
-	retval=aio_return64((struct aiocb64 *)&ce->myaiocb64);
-#endif
-
-#endif
-#else
-	retval=aio_return(&ce->myaiocb);
-#endif
+	retval=async_return(gc,ce);
 	if((int)retval < 0)
 	{
 		printf("aio_return error: %d\n",errno);
@@ -1501,8 +2393,7 @@ struct cache *gc;
 	if(!ce->direct)
 	{
 		/* printf("Freeing buffer %x\n",ce->real_address);*/
-		free((void *)(ce->real_address));
-		free((void *)ce);
+		async_put_ce(gc,ce);
 	}
 
 }
@@ -1539,15 +2430,8 @@ char *free_addr;
 	*/
 
 again:
-#ifdef _LARGEFILE64_SOURCE 
-#ifdef __LP64__
-	ret=aio_write(&ce->myaiocb);
-#else
-	ret=aio_write64(&ce->myaiocb64);
-#endif
-#else
-	ret=aio_write(&ce->myaiocb);
-#endif
+	ret=async_start(gc,ce,(long long)LIO_WRITE);
+	async_flush(gc,depth);
 	if(ret==-1)
 	{
 		if(errno==EAGAIN)